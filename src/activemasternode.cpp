@@ -204,15 +204,19 @@ bool CActiveMasternode::SendMasternodePing(std::string& errorMessage)
 
         // SetLastPing locks the masternode cs, be careful with the lock order.
         pmn->SetLastPing(mnp);
-        mnodeman.mapSeenMasternodePing.emplace(mnp.GetHash(), mnp);
+        WITH_LOCK(mnodeman.cs_seen, mnodeman.mapSeenMasternodePing.emplace(mnp.GetHash(), mnp); );
 
         //mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
         CMasternodeBroadcast mnb(*pmn);
         uint256 hash = mnb.GetHash();
-        if (mnodeman.mapSeenMasternodeBroadcast.count(hash)) {
-            // SetLastPing locks the masternode cs, be careful with the lock order.
-            // TODO: check why are we double setting the last ping here..
-            mnodeman.mapSeenMasternodeBroadcast[hash].SetLastPing(mnp);
+        {
+            LOCK(mnodeman.cs_seen);
+            auto it = mnodeman.mapSeenMasternodeBroadcast.find(hash);
+            if (it != mnodeman.mapSeenMasternodeBroadcast.end()) {
+                // SetLastPing locks the masternode cs, be careful with the lock order.
+                // TODO: check why are we double setting the last ping here..
+                it->second.SetLastPing(mnp);
+            }
         }
 
         mnp.Relay();
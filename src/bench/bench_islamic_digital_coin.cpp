@@ -6,12 +6,16 @@
 
 #include "bench.h"
 
+#include "crypto/quark.h"
+#include "crypto/sha256.h"
 #include "key.h"
 #include "util.h"
 
 int
 main(int argc, char** argv)
 {
+    SHA256AutoDetect();
+    QuarkAutoDetect();
     ECC_Start();
     SetupEnvironment();
     g_logger->m_print_to_file = false; // don't want to write to debug.log file
@@ -0,0 +1,53 @@
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "primitives/block.h"
+#include "streams.h"
+#include "version.h"
+
+static CBlockHeader GetTestHeader(int32_t nVersion)
+{
+    CBlockHeader header;
+    header.nVersion = nVersion;
+    header.hashPrevBlock = uint256S("0x00000b4d1b3e7b3b2bb5b3c7e04aa5a41c6d9f8a6ad8e4c0a4d21b2c6b9b8f30");
+    header.hashMerkleRoot = uint256S("0x3f2b1fd5b1e36f3c2e1b8e52eb5b6f0ad1a6a3b4c3d5e2f1a0b9c8d7e6f5a4b3");
+    header.nTime = 1600000000;
+    header.nBits = 0x1e0ffff0;
+    header.nNonce = 2084524493;
+    return header;
+}
+
+// Hash of a header that changes at every call (as when mining): nothing is cached
+static void BlockHeaderHash(benchmark::State& state, int32_t nVersion)
+{
+    CBlockHeader header = GetTestHeader(nVersion);
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        header.GetHash();
+    }
+}
+
+// Hash of a header read from disk or network, used several times (as when validating)
+static void BlockHeaderHashCached(benchmark::State& state, int32_t nVersion)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << GetTestHeader(nVersion);
+    CBlockHeader header;
+    ss >> header;
+    while (state.KeepRunning()) {
+        header.GetHash();
+    }
+}
+
+static void BlockHeaderHashQuark(benchmark::State& state) { BlockHeaderHash(state, 3); }
+static void BlockHeaderHashSHA256(benchmark::State& state) { BlockHeaderHash(state, CBlockHeader::CURRENT_VERSION); }
+static void BlockHeaderHashCachedQuark(benchmark::State& state) { BlockHeaderHashCached(state, 3); }
+static void BlockHeaderHashCachedSHA256(benchmark::State& state) { BlockHeaderHashCached(state, CBlockHeader::CURRENT_VERSION); }
+
+BENCHMARK(BlockHeaderHashQuark);
+BENCHMARK(BlockHeaderHashSHA256);
+BENCHMARK(BlockHeaderHashCachedQuark);
+BENCHMARK(BlockHeaderHashCachedSHA256);
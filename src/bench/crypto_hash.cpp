@@ -6,10 +6,17 @@
 
 #include "bench.h"
 #include "bloom.h"
+#include "crypto/quark.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
 #include "crypto/sha512.h"
+#include "crypto/sph_blake.h"
+#include "crypto/sph_bmw.h"
+#include "crypto/sph_groestl.h"
+#include "crypto/sph_jh.h"
+#include "crypto/sph_keccak.h"
+#include "crypto/sph_skein.h"
 #include "random.h"
 #include "utiltime.h"
 
@@ -40,6 +47,92 @@ static void SHA256(benchmark::State& state)
         CSHA256().Write(begin_ptr(in), in.size()).Finalize(hash);
 }
 
+static void SHA256_32b(benchmark::State& state)
+{
+    std::vector<uint8_t> in(32,0);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000000; i++) {
+            CSHA256().Write(begin_ptr(in), in.size()).Finalize(begin_ptr(in));
+        }
+    }
+}
+
+static void SHA256D64_1024(benchmark::State& state, sha256_implementation::UseImplementation use_implementation)
+{
+    SHA256AutoDetect(use_implementation);
+    std::vector<uint8_t> in(64 * 1024, 0);
+    while (state.KeepRunning()) {
+        SHA256D64(begin_ptr(in), begin_ptr(in), 1024);
+    }
+    SHA256AutoDetect();
+}
+
+static void SHA256D64_1024_STANDARD(benchmark::State& state)
+{
+    SHA256D64_1024(state, sha256_implementation::STANDARD);
+}
+
+static void SHA256D64_1024_SSE41(benchmark::State& state)
+{
+    SHA256D64_1024(state, sha256_implementation::USE_SSE41);
+}
+
+static void SHA256D64_1024_AVX2(benchmark::State& state)
+{
+    SHA256D64_1024(state, sha256_implementation::USE_SSE41_AND_AVX2);
+}
+
+static void SHA256D64_1024_SHANI(benchmark::State& state)
+{
+    SHA256D64_1024(state, sha256_implementation::USE_SHANI);
+}
+
+// Kernel-sized (76-byte) messages, as hashed by the stake kernel search
+static void SHA256DMulti_76_1024(benchmark::State& state, sha256_implementation::UseImplementation use_implementation)
+{
+    SHA256AutoDetect(use_implementation);
+    std::vector<uint8_t> in(76 * 1024, 0);
+    std::vector<uint8_t> out(32 * 1024, 0);
+    while (state.KeepRunning()) {
+        SHA256DMulti(begin_ptr(out), begin_ptr(in), 76, 1024);
+    }
+    SHA256AutoDetect();
+}
+
+static void SHA256DMulti_76_1024_STANDARD(benchmark::State& state)
+{
+    SHA256DMulti_76_1024(state, sha256_implementation::STANDARD);
+}
+
+static void SHA256DMulti_76_1024_SSE41(benchmark::State& state)
+{
+    SHA256DMulti_76_1024(state, sha256_implementation::USE_SSE41);
+}
+
+static void SHA256DMulti_76_1024_AVX2(benchmark::State& state)
+{
+    SHA256DMulti_76_1024(state, sha256_implementation::USE_SSE41_AND_AVX2);
+}
+
+static void SHA256DMulti_76_1024_SHANI(benchmark::State& state)
+{
+    SHA256DMulti_76_1024(state, sha256_implementation::USE_SHANI);
+}
+
+static void SHA256_STANDARD(benchmark::State& state)
+{
+    SHA256AutoDetect(sha256_implementation::STANDARD);
+    SHA256(state);
+    SHA256AutoDetect();
+}
+
+static void SHA256_SHANI(benchmark::State& state)
+{
+    SHA256AutoDetect(sha256_implementation::USE_SHANI);
+    SHA256(state);
+    SHA256AutoDetect();
+}
+
 static void SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -48,6 +141,73 @@ static void SHA512(benchmark::State& state)
         CSHA512().Write(begin_ptr(in), in.size()).Finalize(hash);
 }
 
+// The Quark primitives, on the 64-byte intermediates they hash within the chain
+template <typename Context, void (*Init)(void*), void (*Write)(void*, const void*, size_t), void (*Close)(void*, void*)>
+static void Quark512_64_1000(benchmark::State& state)
+{
+    Context ctx;
+    uint8_t buf[64] = {0};
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++) {
+            Init(&ctx);
+            Write(&ctx, buf, sizeof(buf));
+            Close(&ctx, buf);
+        }
+    }
+}
+
+static void BLAKE512_64_1000(benchmark::State& state)
+{
+    Quark512_64_1000<sph_blake512_context, sph_blake512_init, sph_blake512, sph_blake512_close>(state);
+}
+
+static void BMW512_64_1000(benchmark::State& state)
+{
+    Quark512_64_1000<sph_bmw512_context, sph_bmw512_init, sph_bmw512, sph_bmw512_close>(state);
+}
+
+static void GROESTL512_64_1000(benchmark::State& state)
+{
+    Quark512_64_1000<sph_groestl512_context, sph_groestl512_init, sph_groestl512, sph_groestl512_close>(state);
+}
+
+static void JH512_64_1000(benchmark::State& state)
+{
+    Quark512_64_1000<sph_jh512_context, sph_jh512_init, sph_jh512, sph_jh512_close>(state);
+}
+
+static void KECCAK512_64_1000(benchmark::State& state)
+{
+    Quark512_64_1000<sph_keccak512_context, sph_keccak512_init, sph_keccak512, sph_keccak512_close>(state);
+}
+
+static void SKEIN512_64_1000(benchmark::State& state)
+{
+    Quark512_64_1000<sph_skein512_context, sph_skein512_init, sph_skein512, sph_skein512_close>(state);
+}
+
+// Header-sized (80-byte) messages, as hashed for the legacy block headers
+static void QuarkMulti_80_1024(benchmark::State& state, quark_implementation::UseImplementation use_implementation)
+{
+    QuarkAutoDetect(use_implementation);
+    std::vector<uint8_t> in(80 * 1024, 0);
+    std::vector<uint8_t> out(32 * 1024, 0);
+    while (state.KeepRunning()) {
+        QuarkHashMulti(begin_ptr(out), begin_ptr(in), 80, 1024);
+    }
+    QuarkAutoDetect();
+}
+
+static void QuarkMulti_80_1024_STANDARD(benchmark::State& state)
+{
+    QuarkMulti_80_1024(state, quark_implementation::STANDARD);
+}
+
+static void QuarkMulti_80_1024_AVX2(benchmark::State& state)
+{
+    QuarkMulti_80_1024(state, quark_implementation::USE_AVX2);
+}
+
 static void FastRandom_32bit(benchmark::State& state)
 {
     FastRandomContext rng(true);
@@ -73,7 +233,28 @@ static void FastRandom_1bit(benchmark::State& state)
 BENCHMARK(RIPEMD160);
 BENCHMARK(SHA1);
 BENCHMARK(SHA256);
+BENCHMARK(SHA256_STANDARD);
+BENCHMARK(SHA256_SHANI);
 BENCHMARK(SHA512);
 
+BENCHMARK(SHA256_32b);
+BENCHMARK(SHA256D64_1024_STANDARD);
+BENCHMARK(SHA256D64_1024_SSE41);
+BENCHMARK(SHA256D64_1024_AVX2);
+BENCHMARK(SHA256D64_1024_SHANI);
+BENCHMARK(SHA256DMulti_76_1024_STANDARD);
+BENCHMARK(SHA256DMulti_76_1024_SSE41);
+BENCHMARK(SHA256DMulti_76_1024_AVX2);
+BENCHMARK(SHA256DMulti_76_1024_SHANI);
+
+BENCHMARK(BLAKE512_64_1000);
+BENCHMARK(BMW512_64_1000);
+BENCHMARK(GROESTL512_64_1000);
+BENCHMARK(JH512_64_1000);
+BENCHMARK(KECCAK512_64_1000);
+BENCHMARK(SKEIN512_64_1000);
+BENCHMARK(QuarkMulti_80_1024_STANDARD);
+BENCHMARK(QuarkMulti_80_1024_AVX2);
+
 BENCHMARK(FastRandom_32bit);
 BENCHMARK(FastRandom_1bit);
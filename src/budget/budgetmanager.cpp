@@ -6,6 +6,7 @@
 
 #include "budget/budgetmanager.h"
 
+#include "index/txindex.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
 #include "net_processing.h"
@@ -1273,8 +1274,19 @@ bool CheckCollateral(const uint256& nTxCollateralHash, const uint256& nExpectedH
     CTransactionRef txCollateral;
     uint256 nBlockHash;
     if (!GetTransaction(nTxCollateralHash, txCollateral, nBlockHash, true)) {
-        strError = strprintf("Can't find collateral tx %s", nTxCollateralHash.ToString());
-        return false;
+        // The txindex is built in the background: wait for it to process the
+        // latest blocks, and don't take the collateral as missing before it
+        // got in sync.
+        if (g_txindex && !g_txindex->BlockUntilSyncedToCurrentChain()) {
+            strError = strprintf("Can't check collateral tx %s yet, txindex is syncing", nTxCollateralHash.ToString());
+            return false;
+        }
+        if (!g_txindex || !GetTransaction(nTxCollateralHash, txCollateral, nBlockHash, true)) {
+            // Without -txindex, a collateral in a pruned block can't be checked
+            strError = strprintf("Can't find collateral tx %s%s", nTxCollateralHash.ToString(),
+                                 fHavePruned ? " (block data may have been pruned)" : "");
+            return false;
+        }
     }
 
     if (txCollateral->vout.size() < 1) return false;
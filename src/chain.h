@@ -120,6 +120,11 @@ struct CDiskBlockPos {
         nPos = 0;
     }
     bool IsNull() const { return (nFile == -1); }
+
+    std::string ToString() const
+    {
+        return strprintf("CDiskBlockPos(nFile=%i, nPos=%i)", nFile, nPos);
+    }
 };
 
 enum BlockStatus {
@@ -391,7 +396,7 @@ public:
     }
 
 
-    uint256 GetBlockHash() const
+    CBlockHeader GetBlockHeader() const
     {
         CBlockHeader block;
         block.nVersion = nVersion;
@@ -402,7 +407,12 @@ public:
         block.nNonce = nNonce;
         if (nVersion >= 8)
             block.hashFinalSaplingRoot = hashFinalSaplingRoot;
-        return block.GetHash();
+        return block;
+    }
+
+    uint256 GetBlockHash() const
+    {
+        return GetBlockHeader().GetHash();
     }
 
 
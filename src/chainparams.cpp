@@ -141,6 +141,14 @@ public:
         consensus.nTargetSpacing = 2 * 60;
         consensus.nTimeSlotLength = 15;
         consensus.nMaxProposalPayments = 6;
+        // The best chain should have at least this much work: the 7544 blocks up to the last
+        // checkpoint, each with at least the work of the easiest target (2^20). Raise it to the
+        // chainwork of a recent block at each release (see doc/release-process.md).
+        consensus.nMinimumChainWork = uint256S("0x1d7800000");
+        // By default assume that the signatures in ancestors of this block are valid. Script checks
+        // are already skipped up to the last checkpoint: this only speeds up the sync once moved
+        // past it, to a recent block, at each release (see doc/release-process.md).
+        consensus.defaultAssumeValid = uint256S("0x6dd71b92f33b758ce295f93e90043248a7da4fc0fc80e91623b998c4221c04ad");
 
 
         // spork keys
@@ -180,6 +188,9 @@ public:
         pchMessageStart[2] = 0xd3;
         pchMessageStart[3] = 0xb2;
         nDefaultPort = 17151;
+        nPruneAfterHeight = 100000;
+        // Snapshots which can be loaded without -loadsnapshothash: none is pinned yet
+        mapAssumeutxo = {};
 
         // Note that of those with the service bits flag, most only support a subset of possible options
         vSeeds.emplace_back("51.195.113.208", "51.195.113.208", true);
@@ -296,6 +307,8 @@ public:
         consensus.nTargetSpacing = 2 * 60;
         consensus.nTimeSlotLength = 15;
         consensus.nMaxProposalPayments = 6;
+        consensus.nMinimumChainWork = uint256S("0x00");
+        consensus.defaultAssumeValid = uint256S("0x00");
 
         // spork keys
         consensus.strSporkPubKey = "04677c34726c491117265f4b1c83cef085684f36c8df5a97a3a42fc499316d0c4e63959c9eca0dba239d9aaaf72011afffeb3ef9f51b9017811dec686e412eb504";
@@ -327,6 +340,7 @@ public:
         pchMessageStart[2] = 0xc3;
         pchMessageStart[3] = 0x5a;
         nDefaultPort = 11012;
+        nPruneAfterHeight = 1000;
 
         // nodes with support for servicebits filtering should be at the top
        /* vSeeds.emplace_back(""fuzzbawls.pw", "islamic_digital_coin-testnet.seed.fuzzbawls.pw", true);
@@ -394,6 +408,8 @@ public:
         consensus.nTargetSpacing = 1 * 60;
         consensus.nTimeSlotLength = 15;
         consensus.nMaxProposalPayments = 20;
+        consensus.nMinimumChainWork = uint256S("0x00");
+        consensus.defaultAssumeValid = uint256S("0x00");
 
         /* Spork Key for RegTest:
         WIF private key: 932HEevBSujW2ud7RfB1YF91AFygbBRQj3de3LyaCRqNzKKgWXi
@@ -430,6 +446,7 @@ public:
         pchMessageStart[2] = 0x7e;
         pchMessageStart[3] = 0xac;
         nDefaultPort = 51476;
+        nPruneAfterHeight = 1000;
 
         base58Prefixes[PUBKEY_ADDRESS] = std::vector<unsigned char>(1, 139); // Testnet islamic_digital_coin addresses start with 'x' or 'y'
         base58Prefixes[SCRIPT_ADDRESS] = std::vector<unsigned char>(1, 19);  // Testnet islamic_digital_coin script addresses start with '8' or '9'
@@ -16,9 +16,22 @@
 #include "protocol.h"
 #include "uint256.h"
 
+#include <map>
 #include <memory>
 #include <vector>
 
+/**
+ * A UTXO snapshot trusted to start a node from (-loadsnapshot): the hash of its
+ * contents, as returned by dumptxoutset, for the snapshot at a given base block.
+ */
+struct AssumeutxoData {
+    uint256 hashBaseBlock;
+    uint256 hashSnapshot;
+};
+
+//! Trusted UTXO snapshots, by height of their base block
+typedef std::map<int, AssumeutxoData> MapAssumeutxo;
+
 struct CDNSSeedData {
     std::string name, host;
     bool supportsServiceBitsFiltering;
@@ -66,13 +79,13 @@ public:
     const Consensus::Params& GetConsensus() const { return consensus; }
     const CMessageHeader::MessageStartChars& MessageStart() const { return pchMessageStart; }
     int GetDefaultPort() const { return nDefaultPort; }
+    /** Height below which block files are never pruned */
+    uint64_t PruneAfterHeight() const { return nPruneAfterHeight; }
 
     const CBlock& GenesisBlock() const { return genesis; }
 
     /** Make miner wait to have peers to avoid wasting work */
     bool MiningRequiresPeers() const { return !IsRegTestNet(); }
-    /** Headers first syncing is disabled */
-    bool HeadersFirstSyncingActive() const { return false; };
     /** Default value for -checkmempool and -checkblockindex argument */
     bool DefaultConsistencyChecks() const { return IsRegTestNet(); }
 
@@ -83,6 +96,7 @@ public:
     const std::string& Bech32HRP(Bech32Type type) const { return bech32HRPs[type]; }
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     virtual const Checkpoints::CCheckpointData& Checkpoints() const = 0;
+    const MapAssumeutxo& Assumeutxo() const { return mapAssumeutxo; }
 
     bool IsRegTestNet() const { return NetworkIDString() == CBaseChainParams::REGTEST; }
     bool IsTestnet() const { return NetworkIDString() == CBaseChainParams::TESTNET; }
@@ -96,10 +110,12 @@ protected:
     Consensus::Params consensus;
     CMessageHeader::MessageStartChars pchMessageStart;
     int nDefaultPort;
+    uint64_t nPruneAfterHeight;
     std::vector<CDNSSeedData> vSeeds;
     std::vector<unsigned char> base58Prefixes[MAX_BASE58_TYPES];
     std::string bech32HRPs[MAX_BECH32_TYPES];
     std::vector<SeedSpec6> vFixedSeeds;
+    MapAssumeutxo mapAssumeutxo;
 };
 
 /**
@@ -94,9 +94,16 @@ typedef u_int SOCKET;
 size_t strnlen( const char *start, size_t max_len);
 #endif // HAVE_DECL_STRNLEN
 
+// poll() and epoll are used instead of select() for the sockets of the P2P network where they work
+// reliably: WSAPoll is broken on Windows, and so is poll() on macOS in some versions.
+#if defined(__linux__)
+#define USE_POLL
+#define USE_EPOLL
+#endif
+
 bool static inline IsSelectableSocket(SOCKET s)
 {
-#ifdef WIN32
+#if defined(USE_POLL) || defined(WIN32)
     return true;
 #else
     return (s < FD_SETSIZE);
@@ -103,6 +103,10 @@ struct Params {
     int64_t nTargetSpacing;
     int nTimeSlotLength;
     int nMaxProposalPayments;
+    //! Minimum chain work a header chain needs before -assumevalid may skip scripts
+    uint256 nMinimumChainWork;
+    //! Default for -assumevalid
+    uint256 defaultAssumeValid;
 
     // spork keys
     std::string strSporkPubKey;
@@ -0,0 +1,281 @@
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/quark.h"
+
+#include "crypto/sph_blake.h"
+#include "crypto/sph_bmw.h"
+#include "crypto/sph_groestl.h"
+#include "crypto/sph_jh.h"
+#include "crypto/sph_keccak.h"
+#include "crypto/sph_skein.h"
+
+#include <assert.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+#if defined(USE_ASM)
+#include <cpuid.h>
+namespace quark_avx2
+{
+void Blake512_4way(unsigned char** out, const unsigned char** in, size_t len);
+void Bmw512_64_4way(unsigned char** out, const unsigned char** in);
+void Jh512_64_4way(unsigned char** out, const unsigned char** in);
+void Keccak512_64_4way(unsigned char** out, const unsigned char** in);
+void Skein512_64_4way(unsigned char** out, const unsigned char** in);
+}
+#endif
+#endif
+
+namespace
+{
+typedef void (*HashFn)(unsigned char* out, const unsigned char* in, size_t len);
+typedef void (*Hash4wayFn)(unsigned char** out, const unsigned char** in, size_t len);
+
+/** Size of a Quark intermediate (every stage is a 512-bit hash). */
+const size_t STATE_SIZE = 64;
+/** Longest message the multi-way BLAKE-512 handles (it compresses a single padded block). */
+const size_t BLAKE_4WAY_MAX_LEN = 111;
+
+void Blake512(unsigned char* out, const unsigned char* in, size_t len)
+{
+    sph_blake512_context ctx;
+    sph_blake512_init(&ctx);
+    sph_blake512(&ctx, in, len);
+    sph_blake512_close(&ctx, out);
+}
+
+void Bmw512(unsigned char* out, const unsigned char* in, size_t len)
+{
+    sph_bmw512_context ctx;
+    sph_bmw512_init(&ctx);
+    sph_bmw512(&ctx, in, len);
+    sph_bmw512_close(&ctx, out);
+}
+
+void Groestl512(unsigned char* out, const unsigned char* in, size_t len)
+{
+    sph_groestl512_context ctx;
+    sph_groestl512_init(&ctx);
+    sph_groestl512(&ctx, in, len);
+    sph_groestl512_close(&ctx, out);
+}
+
+void Jh512(unsigned char* out, const unsigned char* in, size_t len)
+{
+    sph_jh512_context ctx;
+    sph_jh512_init(&ctx);
+    sph_jh512(&ctx, in, len);
+    sph_jh512_close(&ctx, out);
+}
+
+void Keccak512(unsigned char* out, const unsigned char* in, size_t len)
+{
+    sph_keccak512_context ctx;
+    sph_keccak512_init(&ctx);
+    sph_keccak512(&ctx, in, len);
+    sph_keccak512_close(&ctx, out);
+}
+
+void Skein512(unsigned char* out, const unsigned char* in, size_t len)
+{
+    sph_skein512_context ctx;
+    sph_skein512_init(&ctx);
+    sph_skein512(&ctx, in, len);
+    sph_skein512_close(&ctx, out);
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__)) && defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+void Blake512_AVX2(unsigned char** out, const unsigned char** in, size_t len)
+{
+    quark_avx2::Blake512_4way(out, in, len);
+}
+
+void Bmw512_AVX2(unsigned char** out, const unsigned char** in, size_t len)
+{
+    assert(len == STATE_SIZE);
+    quark_avx2::Bmw512_64_4way(out, in);
+}
+
+void Jh512_AVX2(unsigned char** out, const unsigned char** in, size_t len)
+{
+    assert(len == STATE_SIZE);
+    quark_avx2::Jh512_64_4way(out, in);
+}
+
+void Keccak512_AVX2(unsigned char** out, const unsigned char** in, size_t len)
+{
+    assert(len == STATE_SIZE);
+    quark_avx2::Keccak512_64_4way(out, in);
+}
+
+void Skein512_AVX2(unsigned char** out, const unsigned char** in, size_t len)
+{
+    assert(len == STATE_SIZE);
+    quark_avx2::Skein512_64_4way(out, in);
+}
+#endif
+
+Hash4wayFn Blake512_4way = nullptr;
+Hash4wayFn Bmw512_4way = nullptr;
+Hash4wayFn Jh512_4way = nullptr;
+Hash4wayFn Keccak512_4way = nullptr;
+Hash4wayFn Skein512_4way = nullptr;
+
+/** Hash the messages selected by idx from in (in_stride bytes apart) into out (STATE_SIZE bytes apart). */
+void RunStage(HashFn hash, Hash4wayFn hash_4way, const std::vector<size_t>& idx,
+              const unsigned char* in, size_t in_stride, size_t len, unsigned char* out)
+{
+    size_t i = 0;
+    if (hash_4way) {
+        for (; i + 4 <= idx.size(); i += 4) {
+            const unsigned char* pin[4];
+            unsigned char* pout[4];
+            for (int j = 0; j < 4; j++) {
+                pin[j] = in + idx[i + j] * in_stride;
+                pout[j] = out + idx[i + j] * STATE_SIZE;
+            }
+            hash_4way(pout, pin, len);
+        }
+    }
+    for (; i < idx.size(); i++) {
+        hash(out + idx[i] * STATE_SIZE, in + idx[i] * in_stride, len);
+    }
+}
+
+/** Quark branch: messages whose intermediate has bit 3 set take the first hash, the others the second. */
+void RunBranch(HashFn hash_set, Hash4wayFn hash_set_4way, HashFn hash_unset, Hash4wayFn hash_unset_4way,
+               const std::vector<size_t>& all, const unsigned char* in, unsigned char* out)
+{
+    std::vector<size_t> set, unset;
+    set.reserve(all.size());
+    unset.reserve(all.size());
+    for (size_t i : all) {
+        (in[i * STATE_SIZE] & 8 ? set : unset).push_back(i);
+    }
+    RunStage(hash_set, hash_set_4way, set, in, STATE_SIZE, STATE_SIZE, out);
+    RunStage(hash_unset, hash_unset_4way, unset, in, STATE_SIZE, STATE_SIZE, out);
+}
+
+bool SelfTest()
+{
+    // Compare every multi-way backend against the portable code on 8 distinct inputs.
+    unsigned char in[8 * 80];
+    for (size_t i = 0; i < sizeof(in); i++) in[i] = (unsigned char)(i * 37 + 11);
+
+    const struct {
+        HashFn hash;
+        Hash4wayFn hash_4way;
+        size_t len;
+    } backends[] = {
+        {Blake512, Blake512_4way, 80},
+        {Blake512, Blake512_4way, 64},
+        {Bmw512, Bmw512_4way, 64},
+        {Jh512, Jh512_4way, 64},
+        {Keccak512, Keccak512_4way, 64},
+        {Skein512, Skein512_4way, 64},
+    };
+    for (const auto& backend : backends) {
+        if (!backend.hash_4way) continue;
+        for (int n = 0; n < 2; n++) {
+            const unsigned char* pin[4];
+            unsigned char out[4][STATE_SIZE];
+            unsigned char* pout[4] = {out[0], out[1], out[2], out[3]};
+            for (int j = 0; j < 4; j++) pin[j] = in + (4 * n + j) * backend.len;
+            backend.hash_4way(pout, pin, backend.len);
+            for (int j = 0; j < 4; j++) {
+                unsigned char ref[STATE_SIZE];
+                backend.hash(ref, pin[j], backend.len);
+                if (memcmp(ref, out[j], STATE_SIZE)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+} // namespace
+
+
+std::string QuarkAutoDetect(quark_implementation::UseImplementation use_implementation)
+{
+    std::string ret = "standard";
+    Blake512_4way = nullptr;
+    Bmw512_4way = nullptr;
+    Jh512_4way = nullptr;
+    Keccak512_4way = nullptr;
+    Skein512_4way = nullptr;
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    bool have_xsave = false;
+    bool have_avx = false;
+    bool have_avx2 = false;
+    bool enabled_avx = false;
+
+    (void)AVXEnabled;
+    (void)have_avx2;
+    (void)enabled_avx;
+
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        have_xsave = (ecx >> 27) & 1;
+        have_avx = (ecx >> 28) & 1;
+    }
+    if (have_xsave && have_avx) {
+        enabled_avx = AVXEnabled();
+    }
+    if (__get_cpuid_max(0, nullptr) >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = (ebx >> 5) & 1;
+    }
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && have_avx && enabled_avx && (use_implementation & quark_implementation::USE_AVX2)) {
+        Blake512_4way = Blake512_AVX2;
+        Bmw512_4way = Bmw512_AVX2;
+        Jh512_4way = Jh512_AVX2;
+        Keccak512_4way = Keccak512_AVX2;
+        Skein512_4way = Skein512_AVX2;
+        ret = "standard,avx2(4way blake,bmw,jh,keccak,skein)";
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
+
+void QuarkHashMulti(unsigned char* out, const unsigned char* in, size_t len, size_t count)
+{
+    std::vector<size_t> all(count);
+    for (size_t i = 0; i < count; i++) all[i] = i;
+
+    // Intermediates ping-pong between two buffers.
+    std::vector<unsigned char> a(count * STATE_SIZE), b(count * STATE_SIZE);
+    unsigned char* x = a.data();
+    unsigned char* y = b.data();
+
+    RunStage(Blake512, len <= BLAKE_4WAY_MAX_LEN ? Blake512_4way : nullptr, all, in, len, len, x);
+    RunStage(Bmw512, Bmw512_4way, all, x, STATE_SIZE, STATE_SIZE, y);
+    RunBranch(Groestl512, nullptr, Skein512, Skein512_4way, all, y, x);
+    RunStage(Groestl512, nullptr, all, x, STATE_SIZE, STATE_SIZE, y);
+    RunStage(Jh512, Jh512_4way, all, y, STATE_SIZE, STATE_SIZE, x);
+    RunBranch(Blake512, Blake512_4way, Bmw512, Bmw512_4way, all, x, y);
+    RunStage(Keccak512, Keccak512_4way, all, y, STATE_SIZE, STATE_SIZE, x);
+    RunStage(Skein512, Skein512_4way, all, x, STATE_SIZE, STATE_SIZE, y);
+    RunBranch(Keccak512, Keccak512_4way, Jh512, Jh512_4way, all, y, x);
+
+    for (size_t i = 0; i < count; i++) {
+        memcpy(out + i * 32, x + i * STATE_SIZE, 32);
+    }
+}
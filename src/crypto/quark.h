@@ -0,0 +1,34 @@
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_QUARK_H
+#define BITCOIN_CRYPTO_QUARK_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+namespace quark_implementation {
+enum UseImplementation : uint8_t {
+    STANDARD = 0,
+    USE_AVX2 = 1 << 0,
+    USE_ALL = USE_AVX2,
+};
+}
+
+/** Autodetect the best available Quark batch implementation.
+ *  Returns the name of the implementation.
+ *  The optional argument restricts the candidates (used by tests and benchmarks
+ *  to compare the different backends).
+ */
+std::string QuarkAutoDetect(quark_implementation::UseImplementation use_implementation = quark_implementation::USE_ALL);
+
+/** Compute the Quark hashes of count messages of len bytes each, stored back to back in in.
+ *  Writes count 32-byte digests to out. The result equals HashQuark applied to every
+ *  message, but the chain is evaluated stage by stage over the whole batch so that every
+ *  stage with a multi-way backend hashes 4 messages at once.
+ */
+void QuarkHashMulti(unsigned char* out, const unsigned char* in, size_t len, size_t count);
+
+#endif // BITCOIN_CRYPTO_QUARK_H
@@ -0,0 +1,512 @@
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// 4-way AVX2 implementations of the Quark stages built from 64-bit word
+// operations: BLAKE-512, BMW-512, JH-512, Keccak-512 and Skein-512-512. Each
+// lane of a __m256i holds the corresponding state word of one of 4 messages.
+// Groestl-512 is table driven and stays on the portable sph code.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include "crypto/common.h"
+
+namespace quark_avx2 {
+namespace {
+
+__m256i inline K(uint64_t x) { return _mm256_set1_epi64x((long long)x); }
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi64(x, y); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline Xor(__m256i x, __m256i y, __m256i z) { return Xor(Xor(x, y), z); }
+__m256i inline Rotl(__m256i x, int n) { return _mm256_or_si256(_mm256_sll_epi64(x, _mm_cvtsi32_si128(n)), _mm256_srl_epi64(x, _mm_cvtsi32_si128(64 - n))); }
+__m256i inline Rotr(__m256i x, int n) { return Rotl(x, 64 - n); }
+
+/** Load the 64-bit word at offset of each of the 4 messages. */
+__m256i inline ReadLE(const unsigned char* const* in, size_t offset)
+{
+    return _mm256_set_epi64x((long long)ReadLE64(in[3] + offset), (long long)ReadLE64(in[2] + offset),
+                             (long long)ReadLE64(in[1] + offset), (long long)ReadLE64(in[0] + offset));
+}
+
+void inline WriteLE(unsigned char* const* out, size_t offset, __m256i x)
+{
+    alignas(32) uint64_t w[4];
+    _mm256_store_si256((__m256i*)w, x);
+    for (int i = 0; i < 4; i++) WriteLE64(out[i] + offset, w[i]);
+}
+
+void inline WriteBE(unsigned char* const* out, size_t offset, __m256i x)
+{
+    alignas(32) uint64_t w[4];
+    _mm256_store_si256((__m256i*)w, x);
+    for (int i = 0; i < 4; i++) WriteBE64(out[i] + offset, w[i]);
+}
+
+/** BLAKE-512 */
+const uint64_t BLAKE_IV[8] = {
+    0x6A09E667F3BCC908ull, 0xBB67AE8584CAA73Bull, 0x3C6EF372FE94F82Bull, 0xA54FF53A5F1D36F1ull,
+    0x510E527FADE682D1ull, 0x9B05688C2B3E6C1Full, 0x1F83D9ABFB41BD6Bull, 0x5BE0CD19137E2179ull
+};
+
+const uint64_t BLAKE_C[16] = {
+    0x243F6A8885A308D3ull, 0x13198A2E03707344ull, 0xA4093822299F31D0ull, 0x082EFA98EC4E6C89ull,
+    0x452821E638D01377ull, 0xBE5466CF34E90C6Cull, 0xC0AC29B7C97C50DDull, 0x3F84D5B5B5470917ull,
+    0x9216D5D98979FB1Bull, 0xD1310BA698DFB5ACull, 0x2FFD72DBD01ADFB7ull, 0xB8E1AFED6A267E96ull,
+    0xBA7C9045F12C7F99ull, 0x24A19947B3916CF7ull, 0x0801F2E2858EFC16ull, 0x636920D871574E69ull
+};
+
+const unsigned char BLAKE_SIGMA[10][16] = {
+    { 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15},
+    {14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3},
+    {11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4},
+    { 7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8},
+    { 9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13},
+    { 2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9},
+    {12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11},
+    {13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10},
+    { 6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5},
+    {10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0}
+};
+
+void inline BlakeG(const __m256i* m, const unsigned char* s, int i, __m256i& a, __m256i& b, __m256i& c, __m256i& d)
+{
+    a = Add(Add(a, b), Xor(m[s[2 * i]], K(BLAKE_C[s[2 * i + 1]])));
+    d = Rotr(Xor(d, a), 32);
+    c = Add(c, d);
+    b = Rotr(Xor(b, c), 25);
+    a = Add(Add(a, b), Xor(m[s[2 * i + 1]], K(BLAKE_C[s[2 * i]])));
+    d = Rotr(Xor(d, a), 16);
+    c = Add(c, d);
+    b = Rotr(Xor(b, c), 11);
+}
+
+/** Keccak-f[1600] */
+const uint64_t KECCAK_RC[24] = {
+    0x0000000000000001ull, 0x0000000000008082ull, 0x800000000000808Aull, 0x8000000080008000ull,
+    0x000000000000808Bull, 0x0000000080000001ull, 0x8000000080008081ull, 0x8000000000008009ull,
+    0x000000000000008Aull, 0x0000000000000088ull, 0x0000000080008009ull, 0x000000008000000Aull,
+    0x000000008000808Bull, 0x800000000000008Bull, 0x8000000000008089ull, 0x8000000000008003ull,
+    0x8000000000008002ull, 0x8000000000000080ull, 0x000000000000800Aull, 0x800000008000000Aull,
+    0x8000000080008081ull, 0x8000000000008080ull, 0x0000000080000001ull, 0x8000000080008008ull
+};
+
+const int KECCAK_ROTC[24] = {1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44};
+const int KECCAK_PILN[24] = {10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1};
+
+void KeccakF(__m256i* st)
+{
+    __m256i bc[5], t;
+    for (int round = 0; round < 24; round++) {
+        // Theta
+        for (int i = 0; i < 5; i++) bc[i] = Xor(Xor(st[i], st[i + 5], st[i + 10]), st[i + 15], st[i + 20]);
+        for (int i = 0; i < 5; i++) {
+            t = Xor(bc[(i + 4) % 5], Rotl(bc[(i + 1) % 5], 1));
+            for (int j = 0; j < 25; j += 5) st[j + i] = Xor(st[j + i], t);
+        }
+        // Rho and pi
+        t = st[1];
+        for (int i = 0; i < 24; i++) {
+            int j = KECCAK_PILN[i];
+            bc[0] = st[j];
+            st[j] = Rotl(t, KECCAK_ROTC[i]);
+            t = bc[0];
+        }
+        // Chi
+        for (int j = 0; j < 25; j += 5) {
+            for (int i = 0; i < 5; i++) bc[i] = st[j + i];
+            for (int i = 0; i < 5; i++) st[j + i] = Xor(st[j + i], _mm256_andnot_si256(bc[(i + 1) % 5], bc[(i + 2) % 5]));
+        }
+        // Iota
+        st[0] = Xor(st[0], K(KECCAK_RC[round]));
+    }
+}
+
+/** Threefish-512, as used by Skein-512 (version 1.3). */
+const int SKEIN_R[8][4] = {
+    {46, 36, 19, 37}, {33, 27, 14, 42}, {17, 49, 36, 39}, {44,  9, 54, 56},
+    {39, 30, 34, 24}, {13, 50, 10, 17}, {25, 29, 39, 43}, { 8, 35, 56, 22}
+};
+
+const uint64_t SKEIN_IV512[8] = {
+    0x4903ADFF749C51CEull, 0x0D95DE399746DF03ull, 0x8FD1934127C79BCEull, 0x9A255629FF352CB1ull,
+    0x5DB62599DF6CA7B0ull, 0xEABE394CA9D5C3F4ull, 0x991112C71A75B523ull, 0xAE18A40B660FCC33ull
+};
+
+void inline Mix(__m256i& x0, __m256i& x1, int r)
+{
+    x0 = Add(x0, x1);
+    x1 = Xor(Rotl(x1, r), x0);
+}
+
+/** Four rounds with the word order of the reference implementation (no explicit permutation). */
+void inline Rounds4(__m256i* x, const int (*r)[4])
+{
+    Mix(x[0], x[1], r[0][0]); Mix(x[2], x[3], r[0][1]); Mix(x[4], x[5], r[0][2]); Mix(x[6], x[7], r[0][3]);
+    Mix(x[2], x[1], r[1][0]); Mix(x[4], x[7], r[1][1]); Mix(x[6], x[5], r[1][2]); Mix(x[0], x[3], r[1][3]);
+    Mix(x[4], x[1], r[2][0]); Mix(x[6], x[3], r[2][1]); Mix(x[0], x[5], r[2][2]); Mix(x[2], x[7], r[2][3]);
+    Mix(x[6], x[1], r[3][0]); Mix(x[0], x[7], r[3][1]); Mix(x[2], x[5], r[3][2]); Mix(x[4], x[3], r[3][3]);
+}
+
+/** UBI: chain = Threefish_chain,tweak(block) ^ block. The tweak is the same for all lanes. */
+void Ubi(__m256i* h, const __m256i* block, uint64_t t0, uint64_t t1)
+{
+    __m256i k[9], x[8];
+    const uint64_t t[3] = {t0, t1, t0 ^ t1};
+    k[8] = K(0x1BD11BDAA9FC1A22ull);
+    for (int i = 0; i < 8; i++) {
+        k[i] = h[i];
+        k[8] = Xor(k[8], h[i]);
+        x[i] = block[i];
+    }
+    for (int s = 0; s <= 18; s++) {
+        for (int i = 0; i < 8; i++) x[i] = Add(x[i], k[(s + i) % 9]);
+        x[5] = Add(x[5], K(t[s % 3]));
+        x[6] = Add(x[6], K(t[(s + 1) % 3]));
+        x[7] = Add(x[7], K((uint64_t)s));
+        if (s == 18) break;
+        Rounds4(x, SKEIN_R + 4 * (s & 1));
+    }
+    for (int i = 0; i < 8; i++) h[i] = Xor(x[i], block[i]);
+}
+
+const uint64_t SKEIN_FIRST_FINAL = 3ull << 62;
+const uint64_t SKEIN_TYPE_MSG = 48ull << 56;
+const uint64_t SKEIN_TYPE_OUT = 63ull << 56;
+
+/** JH-512, bitsliced over 64-bit words as in the sph 64-bit code. The round constants
+ *  and the IV are kept in big-endian word order, so messages are loaded big-endian too. */
+const uint64_t JH_C[168] = {
+    0x72D5DEA2DF15F867ull, 0x7B84150AB7231557ull, 0x81ABD6904D5A87F6ull, 0x4E9F4FC5C3D12B40ull,
+    0xEA983AE05C45FA9Cull, 0x03C5D29966B2999Aull, 0x660296B4F2BB538Aull, 0xB556141A88DBA231ull,
+    0x03A35A5C9A190EDBull, 0x403FB20A87C14410ull, 0x1C051980849E951Dull, 0x6F33EBAD5EE7CDDCull,
+    0x10BA139202BF6B41ull, 0xDC786515F7BB27D0ull, 0x0A2C813937AA7850ull, 0x3F1ABFD2410091D3ull,
+    0x422D5A0DF6CC7E90ull, 0xDD629F9C92C097CEull, 0x185CA70BC72B44ACull, 0xD1DF65D663C6FC23ull,
+    0x976E6C039EE0B81Aull, 0x2105457E446CECA8ull, 0xEEF103BB5D8E61FAull, 0xFD9697B294838197ull,
+    0x4A8E8537DB03302Full, 0x2A678D2DFB9F6A95ull, 0x8AFE7381F8B8696Cull, 0x8AC77246C07F4214ull,
+    0xC5F4158FBDC75EC4ull, 0x75446FA78F11BB80ull, 0x52DE75B7AEE488BCull, 0x82B8001E98A6A3F4ull,
+    0x8EF48F33A9A36315ull, 0xAA5F5624D5B7F989ull, 0xB6F1ED207C5AE0FDull, 0x36CAE95A06422C36ull,
+    0xCE2935434EFE983Dull, 0x533AF974739A4BA7ull, 0xD0F51F596F4E8186ull, 0x0E9DAD81AFD85A9Full,
+    0xA7050667EE34626Aull, 0x8B0B28BE6EB91727ull, 0x47740726C680103Full, 0xE0A07E6FC67E487Bull,
+    0x0D550AA54AF8A4C0ull, 0x91E3E79F978EF19Eull, 0x8676728150608DD4ull, 0x7E9E5A41F3E5B062ull,
+    0xFC9F1FEC4054207Aull, 0xE3E41A00CEF4C984ull, 0x4FD794F59DFA95D8ull, 0x552E7E1124C354A5ull,
+    0x5BDF7228BDFE6E28ull, 0x78F57FE20FA5C4B2ull, 0x05897CEFEE49D32Eull, 0x447E9385EB28597Full,
+    0x705F6937B324314Aull, 0x5E8628F11DD6E465ull, 0xC71B770451B920E7ull, 0x74FE43E823D4878Aull,
+    0x7D29E8A3927694F2ull, 0xDDCB7A099B30D9C1ull, 0x1D1B30FB5BDC1BE0ull, 0xDA24494FF29C82BFull,
+    0xA4E7BA31B470BFFFull, 0x0D324405DEF8BC48ull, 0x3BAEFC3253BBD339ull, 0x459FC3C1E0298BA0ull,
+    0xE5C905FDF7AE090Full, 0x947034124290F134ull, 0xA271B701E344ED95ull, 0xE93B8E364F2F984Aull,
+    0x88401D63A06CF615ull, 0x47C1444B8752AFFFull, 0x7EBB4AF1E20AC630ull, 0x4670B6C5CC6E8CE6ull,
+    0xA4D5A456BD4FCA00ull, 0xDA9D844BC83E18AEull, 0x7357CE453064D1ADull, 0xE8A6CE68145C2567ull,
+    0xA3DA8CF2CB0EE116ull, 0x33E906589A94999Aull, 0x1F60B220C26F847Bull, 0xD1CEAC7FA0D18518ull,
+    0x32595BA18DDD19D3ull, 0x509A1CC0AAA5B446ull, 0x9F3D6367E4046BBAull, 0xF6CA19AB0B56EE7Eull,
+    0x1FB179EAA9282174ull, 0xE9BDF7353B3651EEull, 0x1D57AC5A7550D376ull, 0x3A46C2FEA37D7001ull,
+    0xF735C1AF98A4D842ull, 0x78EDEC209E6B6779ull, 0x41836315EA3ADBA8ull, 0xFAC33B4D32832C83ull,
+    0xA7403B1F1C2747F3ull, 0x5940F034B72D769Aull, 0xE73E4E6CD2214FFDull, 0xB8FD8D39DC5759EFull,
+    0x8D9B0C492B49EBDAull, 0x5BA2D74968F3700Dull, 0x7D3BAED07A8D5584ull, 0xF5A5E9F0E4F88E65ull,
+    0xA0B8A2F436103B53ull, 0x0CA8079E753EEC5Aull, 0x9168949256E8884Full, 0x5BB05C55F8BABC4Cull,
+    0xE3BB3B99F387947Bull, 0x75DAF4D6726B1C5Dull, 0x64AEAC28DC34B36Dull, 0x6C34A550B828DB71ull,
+    0xF861E2F2108D512Aull, 0xE3DB643359DD75FCull, 0x1CACBCF143CE3FA2ull, 0x67BBD13C02E843B0ull,
+    0x330A5BCA8829A175ull, 0x7F34194DB416535Cull, 0x923B94C30E794D1Eull, 0x797475D7B6EEAF3Full,
+    0xEAA8D4F7BE1A3921ull, 0x5CF47E094C232751ull, 0x26A32453BA323CD2ull, 0x44A3174A6DA6D5ADull,
+    0xB51D3EA6AFF2C908ull, 0x83593D98916B3C56ull, 0x4CF87CA17286604Dull, 0x46E23ECC086EC7F6ull,
+    0x2F9833B3B1BC765Eull, 0x2BD666A5EFC4E62Aull, 0x06F4B6E8BEC1D436ull, 0x74EE8215BCEF2163ull,
+    0xFDC14E0DF453C969ull, 0xA77D5AC406585826ull, 0x7EC1141606E0FA16ull, 0x7E90AF3D28639D3Full,
+    0xD2C9F2E3009BD20Cull, 0x5FAACE30B7D40C30ull, 0x742A5116F2E03298ull, 0x0DEB30D8E3CEF89Aull,
+    0x4BC59E7BB5F17992ull, 0xFF51E66E048668D3ull, 0x9B234D57E6966731ull, 0xCCE6A6F3170A7505ull,
+    0xB17681D913326CCEull, 0x3C175284F805A262ull, 0xF42BCBB378471547ull, 0xFF46548223936A48ull,
+    0x38DF58074E5E6565ull, 0xF2FC7C89FC86508Eull, 0x31702E44D00BCA86ull, 0xF04009A23078474Eull,
+    0x65A0EE39D1F73883ull, 0xF75EE937E42C3ABDull, 0x2197B2260113F86Full, 0xA344EDD1EF9FDEE7ull,
+    0x8BA0DF15762592D9ull, 0x3C85F7F612DC42BEull, 0xD8A7EC7CAB27B07Eull, 0x538D7DDAAA3EA8DEull,
+    0xAA25CE93BD0269D8ull, 0x5AF643FD1A7308F9ull, 0xC05FEFDA174A19A5ull, 0x974D66334CFD216Aull,
+    0x35B49831DB411570ull, 0xEA1E0FBBEDCD549Bull, 0x9AD063A151974072ull, 0xF6759DBF91476FE2ull
+};
+
+const uint64_t JH_IV512[16] = {
+    0x6FD14B963E00AA17ull, 0x636A2E057A15D543ull, 0x8A225E8D0C97EF0Bull, 0xE9341259F2B3C361ull,
+    0x891DA0C1536F801Eull, 0x2AA9056BEA2B6D80ull, 0x588ECCDB2075BAA6ull, 0xA90F3A76BAF83BF7ull,
+    0x0169E60541E34A69ull, 0x46B58A8E2E6FE65Aull, 0x1047A7D0C1843C24ull, 0x3B6E71B12D5AC199ull,
+    0xCF57F6EC9DB1F856ull, 0xA706887C5716B156ull, 0xE3C2FCDFE68517FBull, 0x545A4678CC8CDD4Bull
+};
+
+void inline JhSb(__m256i& x0, __m256i& x1, __m256i& x2, __m256i& x3, __m256i c)
+{
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    x3 = Xor(x3, ones);
+    x0 = Xor(x0, _mm256_andnot_si256(x2, c));
+    __m256i tmp = Xor(c, _mm256_and_si256(x0, x1));
+    x0 = Xor(x0, _mm256_and_si256(x2, x3));
+    x3 = Xor(x3, _mm256_andnot_si256(x1, x2));
+    x1 = Xor(x1, _mm256_and_si256(x0, x2));
+    x2 = Xor(x2, _mm256_andnot_si256(x3, x0));
+    x0 = Xor(x0, _mm256_or_si256(x1, x3));
+    x3 = Xor(x3, _mm256_and_si256(x1, x2));
+    x1 = Xor(x1, _mm256_and_si256(tmp, x0));
+    x2 = Xor(x2, tmp);
+}
+
+void inline JhLb(__m256i& x0, __m256i& x1, __m256i& x2, __m256i& x3, __m256i& x4, __m256i& x5, __m256i& x6, __m256i& x7)
+{
+    x4 = Xor(x4, x1);
+    x5 = Xor(x5, x2);
+    x6 = Xor(x6, x3, x0);
+    x7 = Xor(x7, x0);
+    x0 = Xor(x0, x5);
+    x1 = Xor(x1, x6);
+    x2 = Xor(x2, x7, x4);
+    x3 = Xor(x3, x4);
+}
+
+/** Swap adjacent groups of 2^ro bits (ro < 6), or the two halves of a 128-bit word (ro == 6). */
+template <int ro>
+void inline JhW(__m256i* x)
+{
+    if (ro == 6) {
+        __m256i t = x[0];
+        x[0] = x[1];
+        x[1] = t;
+        return;
+    }
+    static const uint64_t mask[6] = {
+        0x5555555555555555ull, 0x3333333333333333ull, 0x0F0F0F0F0F0F0F0Full,
+        0x00FF00FF00FF00FFull, 0x0000FFFF0000FFFFull, 0x00000000FFFFFFFFull
+    };
+    const __m256i c = K(mask[ro % 6]);
+    for (int i = 0; i < 2; i++) {
+        __m256i t = _mm256_slli_epi64(_mm256_and_si256(x[i], c), 1 << (ro % 6));
+        x[i] = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi64(x[i], 1 << (ro % 6)), c), t);
+    }
+}
+
+/** One round of E8 on the state h[8][2] (high and low 64-bit halves of the eight 128-bit words). */
+template <int ro>
+void inline JhRound(__m256i (*h)[2], int r)
+{
+    for (int i = 0; i < 2; i++) {
+        JhSb(h[0][i], h[2][i], h[4][i], h[6][i], K(JH_C[4 * r + i]));
+        JhSb(h[1][i], h[3][i], h[5][i], h[7][i], K(JH_C[4 * r + 2 + i]));
+        JhLb(h[0][i], h[2][i], h[4][i], h[6][i], h[1][i], h[3][i], h[5][i], h[7][i]);
+    }
+    JhW<ro>(h[1]);
+    JhW<ro>(h[3]);
+    JhW<ro>(h[5]);
+    JhW<ro>(h[7]);
+}
+
+void JhCompress(__m256i (*h)[2], const __m256i* m)
+{
+    for (int i = 0; i < 4; i++) {
+        h[i][0] = Xor(h[i][0], m[2 * i]);
+        h[i][1] = Xor(h[i][1], m[2 * i + 1]);
+    }
+    for (int r = 0; r < 42; r += 7) {
+        JhRound<0>(h, r);
+        JhRound<1>(h, r + 1);
+        JhRound<2>(h, r + 2);
+        JhRound<3>(h, r + 3);
+        JhRound<4>(h, r + 4);
+        JhRound<5>(h, r + 5);
+        JhRound<6>(h, r + 6);
+    }
+    for (int i = 0; i < 4; i++) {
+        h[4 + i][0] = Xor(h[4 + i][0], m[2 * i]);
+        h[4 + i][1] = Xor(h[4 + i][1], m[2 * i + 1]);
+    }
+}
+
+/** BMW-512 */
+const uint64_t BMW_IV512[16] = {
+    0x8081828384858687ull, 0x88898A8B8C8D8E8Full, 0x9091929394959697ull, 0x98999A9B9C9D9E9Full,
+    0xA0A1A2A3A4A5A6A7ull, 0xA8A9AAABACADAEAFull, 0xB0B1B2B3B4B5B6B7ull, 0xB8B9BABBBCBDBEBFull,
+    0xC0C1C2C3C4C5C6C7ull, 0xC8C9CACBCCCDCECFull, 0xD0D1D2D3D4D5D6D7ull, 0xD8D9DADBDCDDDEDFull,
+    0xE0E1E2E3E4E5E6E7ull, 0xE8E9EAEBECEDEEEFull, 0xF0F1F2F3F4F5F6F7ull, 0xF8F9FAFBFCFDFEFFull
+};
+
+/** Message expansion terms of W_j (indexes into M ^ H); an entry -(k + 1) subtracts term k. */
+const int BMW_W[16][5] = {
+    { 5,  -8, 10,  13,  14}, { 6,  -9, 11,  14, -16}, { 0,   7,  9, -13,  15}, { 0,  -2,   8, -11,  13},
+    { 1,   2,  9, -12, -15}, { 3,  -3, 10, -13,  15}, { 4,  -1, -4, -12,  13}, { 1,  -5,  -6, -13, -15},
+    { 2,  -6, -7,  13, -16}, { 0,  -4,  6,  -8,  14}, { 8,  -2, -5,  -8,  15}, { 8,  -1,  -3,  -6,   9},
+    { 1,   3, -7, -10,  10}, { 2,   4,  7,  10,  11}, { 3,  -6,  8, -12, -13}, {12,  -5,  -7, -10,  13}
+};
+
+__m256i inline Shl(__m256i x, int n) { return _mm256_sll_epi64(x, _mm_cvtsi32_si128(n)); }
+__m256i inline Shr(__m256i x, int n) { return _mm256_srl_epi64(x, _mm_cvtsi32_si128(n)); }
+
+__m256i inline BmwS(int i, __m256i x)
+{
+    switch (i) {
+    case 0: return Xor(Xor(Shr(x, 1), Shl(x, 3)), Rotl(x, 4), Rotl(x, 37));
+    case 1: return Xor(Xor(Shr(x, 1), Shl(x, 2)), Rotl(x, 13), Rotl(x, 43));
+    case 2: return Xor(Xor(Shr(x, 2), Shl(x, 1)), Rotl(x, 19), Rotl(x, 53));
+    case 3: return Xor(Xor(Shr(x, 2), Shl(x, 2)), Rotl(x, 28), Rotl(x, 59));
+    case 4: return Xor(Shr(x, 1), x);
+    default: return Xor(Shr(x, 2), x);
+    }
+}
+
+void BmwCompress(const __m256i* m, const __m256i* h, __m256i* dh)
+{
+    static const int R[7] = {5, 11, 27, 32, 37, 43, 53};
+    __m256i q[32], mh[16];
+    for (int i = 0; i < 16; i++) mh[i] = Xor(m[i], h[i]);
+    for (int i = 0; i < 16; i++) {
+        __m256i w = mh[BMW_W[i][0]];
+        for (int t = 1; t < 5; t++) {
+            const int j = BMW_W[i][t];
+            w = j >= 0 ? Add(w, mh[j]) : _mm256_sub_epi64(w, mh[-j - 1]);
+        }
+        q[i] = Add(BmwS(i % 5, w), h[(i + 1) % 16]);
+    }
+    for (int i = 16; i < 32; i++) {
+        const int j = i - 16;
+        __m256i s = Xor(Add(_mm256_sub_epi64(Add(Rotl(m[j], j + 1), Rotl(m[(j + 3) % 16], (j + 3) % 16 + 1)),
+                                             Rotl(m[(j + 10) % 16], (j + 10) % 16 + 1)),
+                            K((uint64_t)i * 0x0555555555555555ull)),
+                        h[(j + 7) % 16]);
+        if (i < 18) {
+            for (int t = 0; t < 16; t++) s = Add(s, BmwS((t + 1) % 4, q[j + t]));
+        } else {
+            for (int t = 0; t < 14; t += 2) s = Add(Add(s, q[j + t]), Rotl(q[j + t + 1], R[t / 2]));
+            s = Add(Add(s, BmwS(4, q[i - 2])), BmwS(5, q[i - 1]));
+        }
+        q[i] = s;
+    }
+
+    __m256i xl = q[16], xh;
+    for (int i = 17; i < 24; i++) xl = Xor(xl, q[i]);
+    xh = xl;
+    for (int i = 24; i < 32; i++) xh = Xor(xh, q[i]);
+
+    dh[0] = Add(Xor(Shl(xh, 5), Shr(q[16], 5), m[0]), Xor(xl, q[24], q[0]));
+    dh[1] = Add(Xor(Shr(xh, 7), Shl(q[17], 8), m[1]), Xor(xl, q[25], q[1]));
+    dh[2] = Add(Xor(Shr(xh, 5), Shl(q[18], 5), m[2]), Xor(xl, q[26], q[2]));
+    dh[3] = Add(Xor(Shr(xh, 1), Shl(q[19], 5), m[3]), Xor(xl, q[27], q[3]));
+    dh[4] = Add(Xor(Shr(xh, 3), q[20], m[4]), Xor(xl, q[28], q[4]));
+    dh[5] = Add(Xor(Shl(xh, 6), Shr(q[21], 6), m[5]), Xor(xl, q[29], q[5]));
+    dh[6] = Add(Xor(Shr(xh, 4), Shl(q[22], 6), m[6]), Xor(xl, q[30], q[6]));
+    dh[7] = Add(Xor(Shr(xh, 11), Shl(q[23], 2), m[7]), Xor(xl, q[31], q[7]));
+    dh[8] = Add(Add(Rotl(dh[4], 9), Xor(xh, q[24], m[8])), Xor(Shl(xl, 8), q[23], q[8]));
+    dh[9] = Add(Add(Rotl(dh[5], 10), Xor(xh, q[25], m[9])), Xor(Shr(xl, 6), q[16], q[9]));
+    dh[10] = Add(Add(Rotl(dh[6], 11), Xor(xh, q[26], m[10])), Xor(Shl(xl, 6), q[17], q[10]));
+    dh[11] = Add(Add(Rotl(dh[7], 12), Xor(xh, q[27], m[11])), Xor(Shl(xl, 4), q[18], q[11]));
+    dh[12] = Add(Add(Rotl(dh[0], 13), Xor(xh, q[28], m[12])), Xor(Shr(xl, 3), q[19], q[12]));
+    dh[13] = Add(Add(Rotl(dh[1], 14), Xor(xh, q[29], m[13])), Xor(Shr(xl, 4), q[20], q[13]));
+    dh[14] = Add(Add(Rotl(dh[2], 15), Xor(xh, q[30], m[14])), Xor(Shr(xl, 7), q[21], q[14]));
+    dh[15] = Add(Add(Rotl(dh[3], 16), Xor(xh, q[31], m[15])), Xor(Shr(xl, 2), q[22], q[15]));
+}
+
+} // namespace
+
+void Blake512_4way(unsigned char** out, const unsigned char** in, size_t len)
+{
+    // Single block: the message, the 0x80 pad byte, the final 0x01 bit and the 128-bit length.
+    unsigned char block[4][128];
+    const unsigned char* blocks[4];
+    for (int i = 0; i < 4; i++) {
+        memset(block[i], 0, sizeof(block[i]));
+        if (len) memcpy(block[i], in[i], len);
+        block[i][len] = 0x80;
+        block[i][111] |= 0x01;
+        WriteBE64(block[i] + 120, (uint64_t)len << 3);
+        blocks[i] = block[i];
+    }
+
+    __m256i m[16];
+    for (int i = 0; i < 16; i++) {
+        m[i] = _mm256_set_epi64x((long long)ReadBE64(blocks[3] + 8 * i), (long long)ReadBE64(blocks[2] + 8 * i),
+                                 (long long)ReadBE64(blocks[1] + 8 * i), (long long)ReadBE64(blocks[0] + 8 * i));
+    }
+
+    const uint64_t t0 = (uint64_t)len << 3;
+    __m256i v[16];
+    for (int i = 0; i < 8; i++) v[i] = K(BLAKE_IV[i]);
+    for (int i = 0; i < 4; i++) v[8 + i] = K(BLAKE_C[i]);
+    v[12] = K(t0 ^ BLAKE_C[4]);
+    v[13] = K(t0 ^ BLAKE_C[5]);
+    v[14] = K(BLAKE_C[6]);
+    v[15] = K(BLAKE_C[7]);
+
+    for (int r = 0; r < 16; r++) {
+        const unsigned char* s = BLAKE_SIGMA[r % 10];
+        BlakeG(m, s, 0, v[0], v[4], v[8], v[12]);
+        BlakeG(m, s, 1, v[1], v[5], v[9], v[13]);
+        BlakeG(m, s, 2, v[2], v[6], v[10], v[14]);
+        BlakeG(m, s, 3, v[3], v[7], v[11], v[15]);
+        BlakeG(m, s, 4, v[0], v[5], v[10], v[15]);
+        BlakeG(m, s, 5, v[1], v[6], v[11], v[12]);
+        BlakeG(m, s, 6, v[2], v[7], v[8], v[13]);
+        BlakeG(m, s, 7, v[3], v[4], v[9], v[14]);
+    }
+
+    for (int i = 0; i < 8; i++) WriteBE(out, 8 * i, Xor(K(BLAKE_IV[i]), v[i], v[i + 8]));
+}
+
+void Keccak512_64_4way(unsigned char** out, const unsigned char** in)
+{
+    __m256i st[25];
+    for (int i = 0; i < 8; i++) st[i] = ReadLE(in, 8 * i);
+    // Keccak (pre-SHA3) padding of a 64-byte message within the 72-byte rate.
+    st[8] = K(0x8000000000000001ull);
+    for (int i = 9; i < 25; i++) st[i] = _mm256_setzero_si256();
+    KeccakF(st);
+    for (int i = 0; i < 8; i++) WriteLE(out, 8 * i, st[i]);
+}
+
+void Skein512_64_4way(unsigned char** out, const unsigned char** in)
+{
+    __m256i h[8], block[8];
+    for (int i = 0; i < 8; i++) {
+        h[i] = K(SKEIN_IV512[i]);
+        block[i] = ReadLE(in, 8 * i);
+    }
+    Ubi(h, block, 64, SKEIN_FIRST_FINAL | SKEIN_TYPE_MSG);
+    for (int i = 0; i < 8; i++) block[i] = _mm256_setzero_si256();
+    Ubi(h, block, 8, SKEIN_FIRST_FINAL | SKEIN_TYPE_OUT);
+    for (int i = 0; i < 8; i++) WriteLE(out, 8 * i, h[i]);
+}
+
+void Jh512_64_4way(unsigned char** out, const unsigned char** in)
+{
+    __m256i h[8][2], m[8];
+    for (int i = 0; i < 8; i++) {
+        h[i][0] = K(JH_IV512[2 * i]);
+        h[i][1] = K(JH_IV512[2 * i + 1]);
+    }
+    for (int i = 0; i < 8; i++) {
+        m[i] = _mm256_set_epi64x((long long)ReadBE64(in[3] + 8 * i), (long long)ReadBE64(in[2] + 8 * i),
+                                 (long long)ReadBE64(in[1] + 8 * i), (long long)ReadBE64(in[0] + 8 * i));
+    }
+    JhCompress(h, m);
+    // Padding block of a 64-byte message: the 0x80 marker and the 512-bit length.
+    m[0] = K(0x8000000000000000ull);
+    for (int i = 1; i < 7; i++) m[i] = _mm256_setzero_si256();
+    m[7] = K(512);
+    JhCompress(h, m);
+    for (int i = 0; i < 4; i++) {
+        WriteBE(out, 16 * i, h[4 + i][0]);
+        WriteBE(out, 16 * i + 8, h[4 + i][1]);
+    }
+}
+
+void Bmw512_64_4way(unsigned char** out, const unsigned char** in)
+{
+    __m256i h[16], m[16], dh[16];
+    for (int i = 0; i < 16; i++) h[i] = K(BMW_IV512[i]);
+    for (int i = 0; i < 8; i++) m[i] = ReadLE(in, 8 * i);
+    m[8] = K(0x80);
+    for (int i = 9; i < 15; i++) m[i] = _mm256_setzero_si256();
+    m[15] = K(512);
+    BmwCompress(m, h, dh);
+    // Final compression of the chaining value with the constant key.
+    for (int i = 0; i < 16; i++) h[i] = K(0xAAAAAAAAAAAAAAA0ull + i);
+    BmwCompress(dh, h, m);
+    for (int i = 0; i < 8; i++) WriteLE(out, 8 * i, m[8 + i]);
+}
+
+} // namespace quark_avx2
+
+#endif
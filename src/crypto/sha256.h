@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string>
 
 /** A hasher class for SHA-256. */
 class CSHA256
@@ -26,4 +27,37 @@ public:
     CSHA256& Reset();
 };
 
+namespace sha256_implementation {
+enum UseImplementation : uint8_t {
+    STANDARD = 0,
+    USE_SSE41 = 1 << 0,
+    USE_AVX2 = 1 << 1,
+    USE_SHANI = 1 << 2,
+    USE_SSE41_AND_AVX2 = USE_SSE41 | USE_AVX2,
+    USE_ALL = USE_SSE41 | USE_AVX2 | USE_SHANI,
+};
+}
+
+/** Autodetect the best available SHA256 implementation.
+ *  Returns the name of the implementation.
+ *  The optional argument restricts the candidates (used by tests and benchmarks
+ *  to compare the different backends).
+ */
+std::string SHA256AutoDetect(sha256_implementation::UseImplementation use_implementation = sha256_implementation::USE_ALL);
+
+/** Compute multiple double-SHA256's of 64-byte blobs.
+ *  output:  pointer to a blocks*32 byte output buffer
+ *  input:   pointer to a blocks*64 byte input buffer
+ *  blocks:  the number of hashes to compute.
+ */
+void SHA256D64(unsigned char* output, const unsigned char* input, size_t blocks);
+
+/** Compute multiple double-SHA256's of messages of the same length.
+ *  output:  pointer to a count*32 byte output buffer
+ *  input:   pointer to the count messages, len bytes each, stored back to back
+ *  len:     the length of each message
+ *  count:   the number of hashes to compute.
+ */
+void SHA256DMulti(unsigned char* output, const unsigned char* input, size_t len, size_t count);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
@@ -0,0 +1,246 @@
+// Copyright (c) 2017-2019 The Bitcoin Core developers
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "crypto/common.h"
+
+namespace sha256d64_avx2 {
+namespace {
+
+/** SHA-256 round constants. */
+const uint32_t ROUND_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/** Round constants plus message schedule of the (constant) padding block of a 64-byte message. */
+const uint32_t PADDING_KW[64] = {
+    0xc28a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf374,
+    0x649b69c1, 0xf0fe4786, 0x0fe1edc6, 0x240cf254, 0x4fe9346f, 0x6cc984be, 0x61b9411e, 0x16f988fa,
+    0xf2c65152, 0xa88e5a6d, 0xb019fc65, 0xb9d99ec7, 0x9a1231c3, 0xe70eeaa0, 0xfdb1232b, 0xc7353eb0,
+    0x3069bad5, 0xcb976d5f, 0x5a0f118f, 0xdc1eeefd, 0x0a35b689, 0xde0b7a04, 0x58f4ca9d, 0xe15d5b16,
+    0x007f3e86, 0x37088980, 0xa507ea32, 0x6fab9537, 0x17406110, 0x0d8cd6f1, 0xcdaa3b6d, 0xc0bbbe37,
+    0x83613bda, 0xdb48a363, 0x0b02e931, 0x6fd15ca7, 0x521afaca, 0x31338431, 0x6ed41a95, 0x6d437890,
+    0xc39c91f2, 0x9eccabbd, 0xb5c9a0e6, 0x532fb63c, 0xd2c741c6, 0x07237ea3, 0xa4954b68, 0x4c191d76
+};
+
+__m256i inline K(uint32_t x) { return _mm256_set1_epi32(x); }
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+__m256i inline Add(__m256i x, __m256i y, __m256i z) { return Add(Add(x, y), z); }
+__m256i inline Add(__m256i x, __m256i y, __m256i z, __m256i w) { return Add(Add(x, y), Add(z, w)); }
+__m256i inline Add(__m256i x, __m256i y, __m256i z, __m256i w, __m256i v) { return Add(Add(x, y, z), Add(w, v)); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline Xor(__m256i x, __m256i y, __m256i z) { return Xor(Xor(x, y), z); }
+__m256i inline Or(__m256i x, __m256i y) { return _mm256_or_si256(x, y); }
+__m256i inline And(__m256i x, __m256i y) { return _mm256_and_si256(x, y); }
+__m256i inline ShR(__m256i x, int n) { return _mm256_srli_epi32(x, n); }
+__m256i inline ShL(__m256i x, int n) { return _mm256_slli_epi32(x, n); }
+
+__m256i inline Ch(__m256i x, __m256i y, __m256i z) { return Xor(z, And(x, Xor(y, z))); }
+__m256i inline Maj(__m256i x, __m256i y, __m256i z) { return Or(And(x, y), And(z, Or(x, y))); }
+__m256i inline Sigma0(__m256i x) { return Xor(Or(ShR(x, 2), ShL(x, 30)), Or(ShR(x, 13), ShL(x, 19)), Or(ShR(x, 22), ShL(x, 10))); }
+__m256i inline Sigma1(__m256i x) { return Xor(Or(ShR(x, 6), ShL(x, 26)), Or(ShR(x, 11), ShL(x, 21)), Or(ShR(x, 25), ShL(x, 7))); }
+__m256i inline sigma0(__m256i x) { return Xor(Or(ShR(x, 7), ShL(x, 25)), Or(ShR(x, 18), ShL(x, 14)), ShR(x, 3)); }
+__m256i inline sigma1(__m256i x) { return Xor(Or(ShR(x, 17), ShL(x, 15)), Or(ShR(x, 19), ShL(x, 13)), ShR(x, 10)); }
+
+/** One round of SHA-256, with k already including the message word. */
+void inline Round(__m256i a, __m256i b, __m256i c, __m256i& d, __m256i e, __m256i f, __m256i g, __m256i& h, __m256i k)
+{
+    __m256i t1 = Add(h, Sigma1(e), Ch(e, f, g), k);
+    __m256i t2 = Add(Sigma0(a), Maj(a, b, c));
+    d = Add(d, t1);
+    h = Add(t1, t2);
+}
+
+/** Load the big-endian 32-bit word at the given offset of each of the 8 64-byte inputs. */
+__m256i inline Read8(const unsigned char* chunk, int offset)
+{
+    return _mm256_set_epi32(
+        ReadBE32(chunk + 448 + offset),
+        ReadBE32(chunk + 384 + offset),
+        ReadBE32(chunk + 320 + offset),
+        ReadBE32(chunk + 256 + offset),
+        ReadBE32(chunk + 192 + offset),
+        ReadBE32(chunk + 128 + offset),
+        ReadBE32(chunk + 64 + offset),
+        ReadBE32(chunk + 0 + offset)
+    );
+}
+
+/** Load the big-endian 32-bit word at the given offset of each of the 8 inputs, stride bytes apart. */
+__m256i inline Read8(const unsigned char* chunk, size_t stride, int offset)
+{
+    return _mm256_set_epi32(
+        ReadBE32(chunk + 7 * stride + offset),
+        ReadBE32(chunk + 6 * stride + offset),
+        ReadBE32(chunk + 5 * stride + offset),
+        ReadBE32(chunk + 4 * stride + offset),
+        ReadBE32(chunk + 3 * stride + offset),
+        ReadBE32(chunk + 2 * stride + offset),
+        ReadBE32(chunk + 1 * stride + offset),
+        ReadBE32(chunk + offset)
+    );
+}
+
+/** Store each lane of v as a big-endian 32-bit word at the given offset of each of the 8 32-byte outputs. */
+void inline Write8(unsigned char* out, int offset, __m256i v)
+{
+    WriteBE32(out + 0 + offset, _mm256_extract_epi32(v, 0));
+    WriteBE32(out + 32 + offset, _mm256_extract_epi32(v, 1));
+    WriteBE32(out + 64 + offset, _mm256_extract_epi32(v, 2));
+    WriteBE32(out + 96 + offset, _mm256_extract_epi32(v, 3));
+    WriteBE32(out + 128 + offset, _mm256_extract_epi32(v, 4));
+    WriteBE32(out + 160 + offset, _mm256_extract_epi32(v, 5));
+    WriteBE32(out + 192 + offset, _mm256_extract_epi32(v, 6));
+    WriteBE32(out + 224 + offset, _mm256_extract_epi32(v, 7));
+}
+
+/** Run 64 rounds on the state s with message w (which is overwritten by its expansion). */
+void inline Compress(__m256i* s, __m256i* w)
+{
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for (int i = 0; i < 64; i += 8) {
+        for (int j = 0; j < 8; j++) {
+            int n = (i + j) & 15;
+            if (i >= 16) {
+                w[n] = Add(w[n], sigma1(w[(n + 14) & 15]), w[(n + 9) & 15], sigma0(w[(n + 1) & 15]));
+            }
+            w[16 + j] = Add(K(ROUND_K[i + j]), w[n]);
+        }
+        Round(a, b, c, d, e, f, g, h, w[16]);
+        Round(h, a, b, c, d, e, f, g, w[17]);
+        Round(g, h, a, b, c, d, e, f, w[18]);
+        Round(f, g, h, a, b, c, d, e, w[19]);
+        Round(e, f, g, h, a, b, c, d, w[20]);
+        Round(d, e, f, g, h, a, b, c, w[21]);
+        Round(c, d, e, f, g, h, a, b, w[22]);
+        Round(b, c, d, e, f, g, h, a, w[23]);
+    }
+
+    s[0] = Add(s[0], a);
+    s[1] = Add(s[1], b);
+    s[2] = Add(s[2], c);
+    s[3] = Add(s[3], d);
+    s[4] = Add(s[4], e);
+    s[5] = Add(s[5], f);
+    s[6] = Add(s[6], g);
+    s[7] = Add(s[7], h);
+}
+
+/** Run 64 rounds on the state s for the constant padding block of a 64-byte message. */
+void inline CompressPadding(__m256i* s)
+{
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for (int i = 0; i < 64; i += 8) {
+        Round(a, b, c, d, e, f, g, h, K(PADDING_KW[i + 0]));
+        Round(h, a, b, c, d, e, f, g, K(PADDING_KW[i + 1]));
+        Round(g, h, a, b, c, d, e, f, K(PADDING_KW[i + 2]));
+        Round(f, g, h, a, b, c, d, e, K(PADDING_KW[i + 3]));
+        Round(e, f, g, h, a, b, c, d, K(PADDING_KW[i + 4]));
+        Round(d, e, f, g, h, a, b, c, K(PADDING_KW[i + 5]));
+        Round(c, d, e, f, g, h, a, b, K(PADDING_KW[i + 6]));
+        Round(b, c, d, e, f, g, h, a, K(PADDING_KW[i + 7]));
+    }
+
+    s[0] = Add(s[0], a);
+    s[1] = Add(s[1], b);
+    s[2] = Add(s[2], c);
+    s[3] = Add(s[3], d);
+    s[4] = Add(s[4], e);
+    s[5] = Add(s[5], f);
+    s[6] = Add(s[6], g);
+    s[7] = Add(s[7], h);
+}
+
+void inline Initialize(__m256i* s)
+{
+    s[0] = K(0x6a09e667ul);
+    s[1] = K(0xbb67ae85ul);
+    s[2] = K(0x3c6ef372ul);
+    s[3] = K(0xa54ff53aul);
+    s[4] = K(0x510e527ful);
+    s[5] = K(0x9b05688cul);
+    s[6] = K(0x1f83d9abul);
+    s[7] = K(0x5be0cd19ul);
+}
+
+/** Replace the state s of a finished first hash by the SHA-256 of its 32-byte digest. */
+void inline HashDigest(__m256i* s, __m256i* w)
+{
+    for (int i = 0; i < 8; i++) {
+        w[i] = s[i];
+    }
+    w[8] = K(0x80000000ul);
+    for (int i = 9; i < 15; i++) {
+        w[i] = K(0);
+    }
+    w[15] = K(0x100ul);
+    Initialize(s);
+    Compress(s, w);
+}
+
+} // namespace
+
+void Transform_8way(unsigned char* out, const unsigned char* in)
+{
+    __m256i s[8], w[24];
+
+    // First transform: the 64-byte input itself.
+    Initialize(s);
+    for (int i = 0; i < 16; i++) {
+        w[i] = Read8(in, 4 * i);
+    }
+    Compress(s, w);
+
+    // Second transform: the padding block, whose message schedule is constant.
+    CompressPadding(s);
+
+    // Third transform: hash the 32-byte result of the first hash.
+    HashDigest(s, w);
+
+    for (int i = 0; i < 8; i++) {
+        Write8(out, 4 * i, s[i]);
+    }
+}
+
+void TransformD_8way(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    __m256i s[8], w[24];
+    const size_t stride = 64 * blocks;
+
+    // The (already padded) messages, one block at a time.
+    Initialize(s);
+    for (size_t b = 0; b < blocks; b++) {
+        for (int i = 0; i < 16; i++) {
+            w[i] = Read8(in + 64 * b, stride, 4 * i);
+        }
+        Compress(s, w);
+    }
+
+    // Hash the 32-byte results of the first hashes.
+    HashDigest(s, w);
+
+    for (int i = 0; i < 8; i++) {
+        Write8(out, 4 * i, s[i]);
+    }
+}
+
+} // namespace sha256d64_avx2
+
+#endif
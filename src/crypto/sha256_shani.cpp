@@ -0,0 +1,230 @@
+// Copyright (c) 2018-2019 The Bitcoin Core developers
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// Based on https://github.com/noloader/SHA-Intrinsics/blob/master/sha256-x86.c,
+// Written and placed in public domain by Jeffrey Walton.
+// Based on code from Intel, and by Sean Gulley for the miTLS project.
+
+#ifdef ENABLE_SHANI
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace {
+
+/** SHA-256 round constants. */
+alignas(16) const uint32_t ROUND_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/** Round constants plus message schedule of the (constant) padding block of a 64-byte message. */
+alignas(16) const uint32_t PADDING_KW[64] = {
+    0xc28a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf374,
+    0x649b69c1, 0xf0fe4786, 0x0fe1edc6, 0x240cf254, 0x4fe9346f, 0x6cc984be, 0x61b9411e, 0x16f988fa,
+    0xf2c65152, 0xa88e5a6d, 0xb019fc65, 0xb9d99ec7, 0x9a1231c3, 0xe70eeaa0, 0xfdb1232b, 0xc7353eb0,
+    0x3069bad5, 0xcb976d5f, 0x5a0f118f, 0xdc1eeefd, 0x0a35b689, 0xde0b7a04, 0x58f4ca9d, 0xe15d5b16,
+    0x007f3e86, 0x37088980, 0xa507ea32, 0x6fab9537, 0x17406110, 0x0d8cd6f1, 0xcdaa3b6d, 0xc0bbbe37,
+    0x83613bda, 0xdb48a363, 0x0b02e931, 0x6fd15ca7, 0x521afaca, 0x31338431, 0x6ed41a95, 0x6d437890,
+    0xc39c91f2, 0x9eccabbd, 0xb5c9a0e6, 0x532fb63c, 0xd2c741c6, 0x07237ea3, 0xa4954b68, 0x4c191d76
+};
+
+alignas(16) const uint32_t INIT0[4] = {0x9b05688c, 0x510e527f, 0xbb67ae85, 0x6a09e667}; // ABEF
+alignas(16) const uint32_t INIT1[4] = {0x5be0cd19, 0x1f83d9ab, 0xa54ff53a, 0x3c6ef372}; // CDGH
+
+/** Byte swap mask turning big-endian 32-bit words into native ones (and back). */
+const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+/** Four rounds, with the message words already added to the round constants. */
+void inline QuadRound(__m128i& s0, __m128i& s1, __m128i kw)
+{
+    s1 = _mm_sha256rnds2_epu32(s1, s0, kw);
+    s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(kw, 0x0e));
+}
+
+/** Four rounds i*4..i*4+3 on message words m. */
+void inline QuadRound(__m128i& s0, __m128i& s1, __m128i m, int i)
+{
+    QuadRound(s0, s1, _mm_add_epi32(m, _mm_load_si128((const __m128i*)(ROUND_K + 4 * i))));
+}
+
+/** Compute the next four message words into m0 (which holds the words 16 positions back). */
+void inline Schedule(__m128i& m0, __m128i m1, __m128i m2, __m128i m3)
+{
+    m0 = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(m0, m1), _mm_alignr_epi8(m3, m2, 4)), m3);
+}
+
+/** Convert a native a..h state into the ABEF/CDGH layout used by the SHA-NI instructions. */
+void inline Shuffle(__m128i& s0, __m128i& s1)
+{
+    const __m128i t1 = _mm_shuffle_epi32(s0, 0xB1);
+    const __m128i t2 = _mm_shuffle_epi32(s1, 0x1B);
+    s0 = _mm_alignr_epi8(t1, t2, 0x08);
+    s1 = _mm_blend_epi16(t2, t1, 0xF0);
+}
+
+/** Convert the ABEF/CDGH layout back into a native a..h state. */
+void inline Unshuffle(__m128i& s0, __m128i& s1)
+{
+    const __m128i t1 = _mm_shuffle_epi32(s0, 0x1B);
+    const __m128i t2 = _mm_shuffle_epi32(s1, 0xB1);
+    s0 = _mm_blend_epi16(t1, t2, 0xF0);
+    s1 = _mm_alignr_epi8(t2, t1, 0x08);
+}
+
+__m128i inline Load(const unsigned char* in)
+{
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in), MASK);
+}
+
+void inline Save(unsigned char* out, __m128i s)
+{
+    _mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(s, MASK));
+}
+
+/** Run 64 rounds on the (shuffled) state s0/s1 with message words m0..m3, including the feed-forward. */
+void inline Compress(__m128i& s0, __m128i& s1, __m128i m0, __m128i m1, __m128i m2, __m128i m3)
+{
+    const __m128i so0 = s0, so1 = s1;
+
+    QuadRound(s0, s1, m0, 0);
+    QuadRound(s0, s1, m1, 1);
+    QuadRound(s0, s1, m2, 2);
+    QuadRound(s0, s1, m3, 3);
+    for (int i = 4; i < 16; i += 4) {
+        Schedule(m0, m1, m2, m3);
+        QuadRound(s0, s1, m0, i);
+        Schedule(m1, m2, m3, m0);
+        QuadRound(s0, s1, m1, i + 1);
+        Schedule(m2, m3, m0, m1);
+        QuadRound(s0, s1, m2, i + 2);
+        Schedule(m3, m0, m1, m2);
+        QuadRound(s0, s1, m3, i + 3);
+    }
+
+    s0 = _mm_add_epi32(s0, so0);
+    s1 = _mm_add_epi32(s1, so1);
+}
+
+/** Run 64 rounds on two independent states, so their latency chains overlap. */
+void inline Compress2(__m128i& as0, __m128i& as1, __m128i am0, __m128i am1, __m128i am2, __m128i am3,
+                      __m128i& bs0, __m128i& bs1, __m128i bm0, __m128i bm1, __m128i bm2, __m128i bm3)
+{
+    const __m128i aso0 = as0, aso1 = as1, bso0 = bs0, bso1 = bs1;
+
+    QuadRound(as0, as1, am0, 0);
+    QuadRound(bs0, bs1, bm0, 0);
+    QuadRound(as0, as1, am1, 1);
+    QuadRound(bs0, bs1, bm1, 1);
+    QuadRound(as0, as1, am2, 2);
+    QuadRound(bs0, bs1, bm2, 2);
+    QuadRound(as0, as1, am3, 3);
+    QuadRound(bs0, bs1, bm3, 3);
+    for (int i = 4; i < 16; i += 4) {
+        Schedule(am0, am1, am2, am3);
+        Schedule(bm0, bm1, bm2, bm3);
+        QuadRound(as0, as1, am0, i);
+        QuadRound(bs0, bs1, bm0, i);
+        Schedule(am1, am2, am3, am0);
+        Schedule(bm1, bm2, bm3, bm0);
+        QuadRound(as0, as1, am1, i + 1);
+        QuadRound(bs0, bs1, bm1, i + 1);
+        Schedule(am2, am3, am0, am1);
+        Schedule(bm2, bm3, bm0, bm1);
+        QuadRound(as0, as1, am2, i + 2);
+        QuadRound(bs0, bs1, bm2, i + 2);
+        Schedule(am3, am0, am1, am2);
+        Schedule(bm3, bm0, bm1, bm2);
+        QuadRound(as0, as1, am3, i + 3);
+        QuadRound(bs0, bs1, bm3, i + 3);
+    }
+
+    as0 = _mm_add_epi32(as0, aso0);
+    as1 = _mm_add_epi32(as1, aso1);
+    bs0 = _mm_add_epi32(bs0, bso0);
+    bs1 = _mm_add_epi32(bs1, bso1);
+}
+
+/** Run 64 rounds of the constant padding block of a 64-byte message on two states. */
+void inline CompressPadding2(__m128i& as0, __m128i& as1, __m128i& bs0, __m128i& bs1)
+{
+    const __m128i aso0 = as0, aso1 = as1, bso0 = bs0, bso1 = bs1;
+
+    for (int i = 0; i < 16; i++) {
+        const __m128i kw = _mm_load_si128((const __m128i*)(PADDING_KW + 4 * i));
+        QuadRound(as0, as1, kw);
+        QuadRound(bs0, bs1, kw);
+    }
+
+    as0 = _mm_add_epi32(as0, aso0);
+    as1 = _mm_add_epi32(as1, aso1);
+    bs0 = _mm_add_epi32(bs0, bso0);
+    bs1 = _mm_add_epi32(bs1, bso1);
+}
+
+} // namespace
+
+namespace sha256_shani {
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    __m128i s0 = _mm_loadu_si128((const __m128i*)s);
+    __m128i s1 = _mm_loadu_si128((const __m128i*)(s + 4));
+    Shuffle(s0, s1);
+
+    while (blocks--) {
+        Compress(s0, s1, Load(chunk), Load(chunk + 16), Load(chunk + 32), Load(chunk + 48));
+        chunk += 64;
+    }
+
+    Unshuffle(s0, s1);
+    _mm_storeu_si128((__m128i*)s, s0);
+    _mm_storeu_si128((__m128i*)(s + 4), s1);
+}
+}
+
+namespace sha256d64_shani {
+void Transform_2way(unsigned char* out, const unsigned char* in)
+{
+    const __m128i init0 = _mm_load_si128((const __m128i*)INIT0);
+    const __m128i init1 = _mm_load_si128((const __m128i*)INIT1);
+    __m128i as0 = init0, as1 = init1, bs0 = init0, bs1 = init1;
+
+    // First transform: the two 64-byte inputs.
+    Compress2(as0, as1, Load(in), Load(in + 16), Load(in + 32), Load(in + 48),
+              bs0, bs1, Load(in + 64), Load(in + 80), Load(in + 96), Load(in + 112));
+
+    // Second transform: the padding block, whose message schedule is constant.
+    CompressPadding2(as0, as1, bs0, bs1);
+
+    // Third transform: hash the 32-byte results of the first hash, followed by padding.
+    Unshuffle(as0, as1);
+    Unshuffle(bs0, bs1);
+    const __m128i pad0 = _mm_set_epi32(0, 0, 0, 0x80000000);
+    const __m128i pad1 = _mm_set_epi32(0x100, 0, 0, 0);
+    __m128i am0 = as0, am1 = as1, bm0 = bs0, bm1 = bs1;
+    as0 = init0;
+    as1 = init1;
+    bs0 = init0;
+    bs1 = init1;
+    Compress2(as0, as1, am0, am1, pad0, pad1,
+              bs0, bs1, bm0, bm1, pad0, pad1);
+
+    Unshuffle(as0, as1);
+    Unshuffle(bs0, bs1);
+    Save(out, as0);
+    Save(out + 16, as1);
+    Save(out + 32, bs0);
+    Save(out + 48, bs1);
+}
+}
+
+#endif
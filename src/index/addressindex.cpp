@@ -0,0 +1,204 @@
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/addressindex.h"
+
+#include "chain.h"
+#include "coins.h"
+#include "pubkey.h"
+#include "script/standard.h"
+#include "undo.h"
+#include "util.h"
+#include "util/memory.h"
+#include "validation.h"
+
+constexpr char DB_ADDRESSINDEX = 'a';
+constexpr char DB_SPENTINDEX = 'p';
+constexpr char DB_ADDRESSUNSPENTINDEX = 'u';
+
+std::unique_ptr<AddressIndex> g_addressindex;
+
+/** Access to the address index database (indexes/addressindex/) */
+class AddressIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+};
+
+AddressIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "addressindex", n_cache_size, f_memory, f_wipe)
+{}
+
+/** The addresses an output is indexed under. P2CS outputs pay to both their owner and their staker. */
+static std::vector<std::pair<AddressType, uint160>> ExtractAddresses(const CScript& script)
+{
+    std::vector<std::pair<AddressType, uint160>> ret;
+    txnouttype type;
+    std::vector<std::vector<unsigned char>> vSolutions;
+    if (!Solver(script, type, vSolutions)) {
+        return ret;
+    }
+
+    switch (type) {
+    case TX_PUBKEY:
+        ret.emplace_back(AddressType::P2PKH, CPubKey(vSolutions[0]).GetID());
+        break;
+    case TX_PUBKEYHASH:
+        ret.emplace_back(AddressType::P2PKH, uint160(vSolutions[0]));
+        break;
+    case TX_SCRIPTHASH:
+        ret.emplace_back(AddressType::P2SH, uint160(vSolutions[0]));
+        break;
+    case TX_COLDSTAKE:
+        ret.emplace_back(AddressType::P2PKH, uint160(vSolutions[1]));
+        ret.emplace_back(AddressType::STAKER, uint160(vSolutions[0]));
+        break;
+    default:
+        break;
+    }
+    return ret;
+}
+
+AddressIndex::AddressIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<AddressIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+AddressIndex::~AddressIndex() {}
+
+bool AddressIndex::UpdateBlock(const CBlock& block, const CBlockIndex* pindex, bool fConnect)
+{
+    // The outputs spent by the block aren't in the chainstate anymore (or not yet,
+    // when disconnecting): take them from its undo data.
+    CBlockUndo blockundo;
+    if (block.vtx.size() > 1) {
+        if (!UndoReadFromDisk(blockundo, pindex)) {
+            return false;
+        }
+        if (blockundo.vtxundo.size() + 1 != block.vtx.size()) {
+            return error("%s: undo data mismatch for block %s", __func__, pindex->GetBlockHash().ToString());
+        }
+    }
+
+    const int nHeight = pindex->nHeight;
+    CDBBatch batch;
+    // Writes and erases of the same key apply in batch order: walk the block backwards
+    // when disconnecting, so that an output spent within the block ends up erased.
+    for (size_t n = 0; n < block.vtx.size(); n++) {
+        const size_t i = fConnect ? n : block.vtx.size() - 1 - n;
+        const CTransaction& tx = *block.vtx[i];
+        const uint256& txid = tx.GetHash();
+
+        if (i > 0) {
+            const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+            if (txundo.vprevout.size() != tx.vin.size()) {
+                return error("%s: undo data mismatch for tx %s", __func__, txid.ToString());
+            }
+            for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                const COutPoint& prevout = tx.vin[j].prevout;
+                const Coin& coin = txundo.vprevout[j];
+                const auto addresses = ExtractAddresses(coin.out.scriptPubKey);
+                for (const auto& addr : addresses) {
+                    const CAddressIndexKey key(addr.first, addr.second, nHeight, i, txid, j, true);
+                    const CAddressUnspentKey unspentKey(addr.first, addr.second, prevout.hash, prevout.n);
+                    if (fConnect) {
+                        batch.Write(std::make_pair(DB_ADDRESSINDEX, key), -coin.out.nValue);
+                        batch.Erase(std::make_pair(DB_ADDRESSUNSPENTINDEX, unspentKey));
+                    } else {
+                        batch.Erase(std::make_pair(DB_ADDRESSINDEX, key));
+                        batch.Write(std::make_pair(DB_ADDRESSUNSPENTINDEX, unspentKey),
+                                    CAddressUnspentValue(coin.out.nValue, coin.out.scriptPubKey, coin.nHeight));
+                    }
+                }
+                const CSpentIndexKey spentKey(prevout.hash, prevout.n);
+                if (fConnect) {
+                    const uint8_t addressType = addresses.empty() ? 0 : static_cast<uint8_t>(addresses[0].first);
+                    const uint160 addressHash = addresses.empty() ? uint160() : addresses[0].second;
+                    batch.Write(std::make_pair(DB_SPENTINDEX, spentKey),
+                                CSpentIndexValue(txid, j, nHeight, coin.out.nValue, addressType, addressHash));
+                } else {
+                    batch.Erase(std::make_pair(DB_SPENTINDEX, spentKey));
+                }
+            }
+        }
+
+        for (unsigned int k = 0; k < tx.vout.size(); k++) {
+            const CTxOut& out = tx.vout[k];
+            for (const auto& addr : ExtractAddresses(out.scriptPubKey)) {
+                const CAddressIndexKey key(addr.first, addr.second, nHeight, i, txid, k, false);
+                const CAddressUnspentKey unspentKey(addr.first, addr.second, txid, k);
+                if (fConnect) {
+                    batch.Write(std::make_pair(DB_ADDRESSINDEX, key), out.nValue);
+                    batch.Write(std::make_pair(DB_ADDRESSUNSPENTINDEX, unspentKey),
+                                CAddressUnspentValue(out.nValue, out.scriptPubKey, nHeight));
+                } else {
+                    batch.Erase(std::make_pair(DB_ADDRESSINDEX, key));
+                    batch.Erase(std::make_pair(DB_ADDRESSUNSPENTINDEX, unspentKey));
+                }
+            }
+        }
+    }
+
+    return m_db->WriteBatch(batch);
+}
+
+bool AddressIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    return UpdateBlock(block, pindex, true);
+}
+
+bool AddressIndex::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    return UpdateBlock(block, pindex, false);
+}
+
+BaseIndex::DB& AddressIndex::GetDB() const { return *m_db; }
+
+bool AddressIndex::GetAddressIndex(AddressType type, const uint160& hash,
+                                   std::vector<std::pair<CAddressIndexKey, CAmount>>& entries,
+                                   int start, int end) const
+{
+    std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+    pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, hash, start)));
+    for (; pcursor->Valid(); pcursor->Next()) {
+        std::pair<char, CAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX ||
+            key.second.type != type || key.second.hashBytes != hash) {
+            break;
+        }
+        if (end > 0 && key.second.blockHeight > end) {
+            break;
+        }
+        CAmount value;
+        if (!pcursor->GetValue(value)) {
+            return error("%s: failed to read address index value", __func__);
+        }
+        entries.emplace_back(key.second, value);
+    }
+    return true;
+}
+
+bool AddressIndex::GetAddressUnspent(AddressType type, const uint160& hash,
+                                     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& unspent) const
+{
+    std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressUnspentIteratorKey(type, hash)));
+    for (; pcursor->Valid(); pcursor->Next()) {
+        std::pair<char, CAddressUnspentKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSUNSPENTINDEX ||
+            key.second.type != type || key.second.hashBytes != hash) {
+            break;
+        }
+        CAddressUnspentValue value;
+        if (!pcursor->GetValue(value)) {
+            return error("%s: failed to read address unspent value", __func__);
+        }
+        unspent.emplace_back(key.second, value);
+    }
+    return true;
+}
+
+bool AddressIndex::GetSpentInfo(const CSpentIndexKey& key, CSpentIndexValue& value) const
+{
+    return m_db->Read(std::make_pair(DB_SPENTINDEX, key), value);
+}
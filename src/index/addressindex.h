@@ -0,0 +1,246 @@
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_ADDRESSINDEX_H
+#define BITCOIN_INDEX_ADDRESSINDEX_H
+
+#include "amount.h"
+#include "index/base.h"
+#include "script/script.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <vector>
+
+/** Kind of destination an address index entry is keyed by. */
+enum class AddressType : uint8_t {
+    P2PKH = 1,  //!< pay-to-pubkey(-hash) outputs, and the owner of P2CS outputs
+    P2SH = 2,
+    STAKER = 3, //!< the staker of P2CS outputs
+};
+
+/** One credit (output) or debit (spent input) of an address, sorted by height and position in the block. */
+struct CAddressIndexKey {
+    AddressType type;
+    uint160 hashBytes;
+    int blockHeight;
+    unsigned int txindex;
+    uint256 txhash;
+    unsigned int index;
+    bool spending;
+
+    CAddressIndexKey() : type(AddressType::P2PKH), blockHeight(0), txindex(0), index(0), spending(false) {}
+    CAddressIndexKey(AddressType typeIn, const uint160& hashIn, int heightIn, unsigned int txindexIn,
+                     const uint256& txhashIn, unsigned int indexIn, bool spendingIn) :
+        type(typeIn), hashBytes(hashIn), blockHeight(heightIn), txindex(txindexIn),
+        txhash(txhashIn), index(indexIn), spending(spendingIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, static_cast<uint8_t>(type));
+        hashBytes.Serialize(s);
+        // Heights and positions are big endian so that entries are iterated in chain order
+        ser_writedata32be(s, blockHeight);
+        ser_writedata32be(s, txindex);
+        txhash.Serialize(s);
+        ser_writedata32(s, index);
+        ser_writedata8(s, spending);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        type = static_cast<AddressType>(ser_readdata8(s));
+        hashBytes.Unserialize(s);
+        blockHeight = ser_readdata32be(s);
+        txindex = ser_readdata32be(s);
+        txhash.Unserialize(s);
+        index = ser_readdata32(s);
+        spending = ser_readdata8(s) != 0;
+    }
+};
+
+/** Prefix of the CAddressIndexKey entries of an address, optionally starting at a height. */
+struct CAddressIndexIteratorKey {
+    AddressType type;
+    uint160 hashBytes;
+    int blockHeight;
+
+    CAddressIndexIteratorKey(AddressType typeIn, const uint160& hashIn, int heightIn = 0) :
+        type(typeIn), hashBytes(hashIn), blockHeight(heightIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, static_cast<uint8_t>(type));
+        hashBytes.Serialize(s);
+        ser_writedata32be(s, blockHeight);
+    }
+};
+
+/** An unspent output of an address. */
+struct CAddressUnspentKey {
+    AddressType type;
+    uint160 hashBytes;
+    uint256 txhash;
+    unsigned int index;
+
+    CAddressUnspentKey() : type(AddressType::P2PKH), index(0) {}
+    CAddressUnspentKey(AddressType typeIn, const uint160& hashIn, const uint256& txhashIn, unsigned int indexIn) :
+        type(typeIn), hashBytes(hashIn), txhash(txhashIn), index(indexIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, static_cast<uint8_t>(type));
+        hashBytes.Serialize(s);
+        txhash.Serialize(s);
+        ser_writedata32(s, index);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        type = static_cast<AddressType>(ser_readdata8(s));
+        hashBytes.Unserialize(s);
+        txhash.Unserialize(s);
+        index = ser_readdata32(s);
+    }
+};
+
+/** Prefix of the CAddressUnspentKey entries of an address. */
+struct CAddressUnspentIteratorKey {
+    AddressType type;
+    uint160 hashBytes;
+
+    CAddressUnspentIteratorKey(AddressType typeIn, const uint160& hashIn) : type(typeIn), hashBytes(hashIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, static_cast<uint8_t>(type));
+        hashBytes.Serialize(s);
+    }
+};
+
+struct CAddressUnspentValue {
+    CAmount satoshis;
+    CScript script;
+    int blockHeight;
+
+    CAddressUnspentValue() : satoshis(-1), blockHeight(0) {}
+    CAddressUnspentValue(CAmount satoshisIn, const CScript& scriptIn, int heightIn) :
+        satoshis(satoshisIn), script(scriptIn), blockHeight(heightIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(satoshis);
+        READWRITE(script);
+        READWRITE(blockHeight);
+    }
+};
+
+/** A spent output. */
+struct CSpentIndexKey {
+    uint256 txid;
+    unsigned int outputIndex;
+
+    CSpentIndexKey() : outputIndex(0) {}
+    CSpentIndexKey(const uint256& txidIn, unsigned int indexIn) : txid(txidIn), outputIndex(indexIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(txid);
+        READWRITE(outputIndex);
+    }
+};
+
+/** The input spending an output, along with what the output paid to. */
+struct CSpentIndexValue {
+    uint256 txid;
+    unsigned int inputIndex;
+    int blockHeight;
+    CAmount satoshis;
+    uint8_t addressType; //!< 0 if the output doesn't pay to an indexed address
+    uint160 addressHash;
+
+    CSpentIndexValue() : inputIndex(0), blockHeight(0), satoshis(0), addressType(0) {}
+    CSpentIndexValue(const uint256& txidIn, unsigned int inputIndexIn, int heightIn, CAmount satoshisIn,
+                     uint8_t addressTypeIn, const uint160& addressHashIn) :
+        txid(txidIn), inputIndex(inputIndexIn), blockHeight(heightIn), satoshis(satoshisIn),
+        addressType(addressTypeIn), addressHash(addressHashIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(txid);
+        READWRITE(inputIndex);
+        READWRITE(blockHeight);
+        READWRITE(satoshis);
+        READWRITE(addressType);
+        READWRITE(addressHash);
+    }
+};
+
+/**
+ * AddressIndex keeps, for every transparent address, the list of its credits
+ * and debits, its unspent outputs, and for every spent output the input that
+ * spent it. P2CS outputs are indexed under both their owner and their staker.
+ * The spent outputs are read back from the block undo data, so the index can
+ * follow reorgs without any help from the chainstate.
+ */
+class AddressIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+    /// Add the entries of a connected block, or remove those of a disconnected one.
+    bool UpdateBlock(const CBlock& block, const CBlockIndex* pindex, bool fConnect);
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool DisconnectBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "addressindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit AddressIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~AddressIndex() override;
+
+    /// Credits and debits of an address, in chain order, optionally limited to a height range
+    /// (end = 0 for no upper bound).
+    bool GetAddressIndex(AddressType type, const uint160& hash,
+                         std::vector<std::pair<CAddressIndexKey, CAmount>>& entries,
+                         int start = 0, int end = 0) const;
+
+    /// Unspent outputs of an address.
+    bool GetAddressUnspent(AddressType type, const uint160& hash,
+                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& unspent) const;
+
+    /// Look up the input that spent an output.
+    bool GetSpentInfo(const CSpentIndexKey& key, CSpentIndexValue& value) const;
+};
+
+/// The global address and spent index. May be null.
+extern std::unique_ptr<AddressIndex> g_addressindex;
+
+#endif // BITCOIN_INDEX_ADDRESSINDEX_H
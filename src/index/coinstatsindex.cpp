@@ -0,0 +1,140 @@
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/coinstatsindex.h"
+
+#include "chain.h"
+#include "coins.h"
+#include "streams.h"
+#include "undo.h"
+#include "util.h"
+#include "util/memory.h"
+#include "validation.h"
+
+constexpr char DB_BLOCK_HEIGHT = 's';
+
+std::unique_ptr<CoinStatsIndex> g_coinstatsindex;
+
+/** Access to the coinstats index database (indexes/coinstats/) */
+class CoinStatsIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+};
+
+CoinStatsIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "coinstats", n_cache_size, f_memory, f_wipe)
+{}
+
+void TxOutHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin, bool fInsert)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << outpoint;
+    ss << (uint32_t)(coin.nHeight * 4 + (coin.fCoinBase ? 2 : 0) + (coin.fCoinStake ? 1 : 0));
+    ss << coin.out;
+    if (fInsert) {
+        muhash.Insert((const unsigned char*)ss.data(), ss.size());
+    } else {
+        muhash.Remove((const unsigned char*)ss.data(), ss.size());
+    }
+}
+
+uint64_t GetBogoSize(const CScript& scriptPubKey)
+{
+    return 32 /* txid */ +
+           4 /* vout index */ +
+           4 /* height + coinbase/coinstake */ +
+           8 /* amount */ +
+           2 /* scriptPubKey len */ +
+           scriptPubKey.size() /* scriptPubKey */;
+}
+
+static void ApplyCoin(CCoinStatsEntry& entry, const COutPoint& outpoint, const Coin& coin, bool fInsert)
+{
+    TxOutHash(entry.muhash, outpoint, coin, fInsert);
+    if (fInsert) {
+        entry.nTransactionOutputs++;
+        entry.nBogoSize += GetBogoSize(coin.out.scriptPubKey);
+        entry.nTotalAmount += coin.out.nValue;
+    } else {
+        entry.nTransactionOutputs--;
+        entry.nBogoSize -= GetBogoSize(coin.out.scriptPubKey);
+        entry.nTotalAmount -= coin.out.nValue;
+    }
+}
+
+CoinStatsIndex::CoinStatsIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<CoinStatsIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+CoinStatsIndex::~CoinStatsIndex() {}
+
+bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    CCoinStatsEntry entry;
+
+    // The outputs of the genesis block are never added to the chainstate
+    if (pindex->nHeight > 0) {
+        if (!m_db->Read(std::make_pair(DB_BLOCK_HEIGHT, pindex->nHeight - 1), entry)) {
+            return error("%s: no stats for the parent of block %s", __func__, pindex->GetBlockHash().ToString());
+        }
+        if (entry.hashBlock != pindex->pprev->GetBlockHash()) {
+            return error("%s: stats at height %d are for block %s, not the parent of block %s", __func__,
+                         pindex->nHeight - 1, entry.hashBlock.ToString(), pindex->GetBlockHash().ToString());
+        }
+
+        CBlockUndo blockundo;
+        if (block.vtx.size() > 1) {
+            if (!UndoReadFromDisk(blockundo, pindex)) {
+                return false;
+            }
+            if (blockundo.vtxundo.size() + 1 != block.vtx.size()) {
+                return error("%s: undo data mismatch for block %s", __func__, pindex->GetBlockHash().ToString());
+            }
+        }
+
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            const CTransaction& tx = *block.vtx[i];
+            const uint256& txid = tx.GetHash();
+
+            // Same outputs as AddCoins
+            for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                if (tx.vout[k].scriptPubKey.IsUnspendable()) continue;
+                ApplyCoin(entry, COutPoint(txid, k), Coin(tx.vout[k], pindex->nHeight, tx.IsCoinBase(), tx.IsCoinStake()), true);
+            }
+
+            if (i > 0) {
+                const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+                if (txundo.vprevout.size() != tx.vin.size()) {
+                    return error("%s: undo data mismatch for tx %s", __func__, txid.ToString());
+                }
+                for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                    const Coin& coin = txundo.vprevout[j];
+                    // Zerocoin spends don't spend a coin of the chainstate
+                    if (coin.IsSpent()) continue;
+                    ApplyCoin(entry, tx.vin[j].prevout, coin, false);
+                }
+            }
+        }
+    }
+
+    entry.hashBlock = pindex->GetBlockHash();
+    return m_db->Write(std::make_pair(DB_BLOCK_HEIGHT, pindex->nHeight), entry);
+}
+
+bool CoinStatsIndex::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // The entry of the parent is still there: only drop the one of the block.
+    return m_db->Erase(std::make_pair(DB_BLOCK_HEIGHT, pindex->nHeight));
+}
+
+BaseIndex::DB& CoinStatsIndex::GetDB() const { return *m_db; }
+
+bool CoinStatsIndex::LookUpStats(const CBlockIndex* pindex, CCoinStatsEntry& entry) const
+{
+    if (!m_db->Read(std::make_pair(DB_BLOCK_HEIGHT, pindex->nHeight), entry)) {
+        return false;
+    }
+    return entry.hashBlock == pindex->GetBlockHash();
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_COINSTATSINDEX_H
+#define BITCOIN_INDEX_COINSTATSINDEX_H
+
+#include "amount.h"
+#include "crypto/muhash.h"
+#include "index/base.h"
+#include "serialize.h"
+#include "uint256.h"
+
+class Coin;
+class COutPoint;
+class CScript;
+
+/** Statistics of the UTXO set after a block, as kept by the coinstats index. */
+struct CCoinStatsEntry {
+    uint256 hashBlock;
+    uint64_t nTransactionOutputs{0};
+    uint64_t nBogoSize{0};
+    CAmount nTotalAmount{0};
+    //! Running hash of the unspent outputs, see TxOutHash
+    MuHash3072 muhash;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(hashBlock);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nBogoSize);
+        READWRITE(nTotalAmount);
+        READWRITE(muhash);
+    }
+};
+
+/** Insert an unspent output into, or remove it from, a MuHash of the UTXO set. */
+void TxOutHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin, bool fInsert);
+
+/** Size of an unspent output counted in the bogosize statistic: a rough estimate of its size in the chainstate. */
+uint64_t GetBogoSize(const CScript& scriptPubKey);
+
+/**
+ * CoinStatsIndex keeps, for every block of the chain, the number of unspent
+ * outputs, their total value and bogosize, and a MuHash of the UTXO set after
+ * it. As the MuHash can be updated in any order, each entry is derived from the
+ * previous one and the block (with its undo data for the spent outputs),
+ * without walking the chainstate. The whole MuHash state is stored, so that
+ * the hash is only finalized when it is queried.
+ */
+class CoinStatsIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool DisconnectBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "coinstatsindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit CoinStatsIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~CoinStatsIndex() override;
+
+    /// Look up the statistics of the UTXO set after a block. Returns false if
+    /// the block isn't indexed (yet).
+    bool LookUpStats(const CBlockIndex* pindex, CCoinStatsEntry& entry) const;
+};
+
+/// The global UTXO set statistics index. May be null.
+extern std::unique_ptr<CoinStatsIndex> g_coinstatsindex;
+
+#endif // BITCOIN_INDEX_COINSTATSINDEX_H
@@ -23,11 +23,16 @@
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "consensus/upgrades.h"
+#include "crypto/quark.h"
+#include "crypto/sha256.h"
 #include "fs.h"
 #include "guiinterface.h"
 #include "guiinterfaceutil.h"
 #include "httprpc.h"
 #include "httpserver.h"
+#include "index/addressindex.h"
+#include "index/coinstatsindex.h"
+#include "index/txindex.h"
 #include "key.h"
 #include "masternode-payments.h"
 #include "masternodeconfig.h"
@@ -51,6 +56,7 @@
 #include "util.h"
 #include "util/threadnames.h"
 #include "utilmoneystr.h"
+#include "utxosnapshot.h"
 #include "validation.h"
 #include "validationinterface.h"
 
@@ -180,7 +186,6 @@ public:
     // Writes do not need similar protection, as failure to write is handled by the caller.
 };
 
-static CCoinsViewDB* pcoinsdbview = NULL;
 static CCoinsViewErrorCatcher* pcoinscatcher = NULL;
 static std::unique_ptr<ECCVerifyHandle> globalVerifyHandle;
 
@@ -196,6 +201,15 @@ void Interrupt()
     InterruptMapPort();
     if (g_connman)
         g_connman->Interrupt();
+    if (g_txindex) {
+        g_txindex->Interrupt();
+    }
+    if (g_addressindex) {
+        g_addressindex->Interrupt();
+    }
+    if (g_coinstatsindex) {
+        g_coinstatsindex->Interrupt();
+    }
 }
 
 /** Preparing steps before shutting down or restarting the wallet */
@@ -270,6 +284,20 @@ void PrepareShutdown()
     // CValidationInterface callbacks, flush them...
     GetMainSignals().FlushBackgroundCallbacks();
 
+    // Stop and delete all indexes only after flushing background callbacks.
+    if (g_txindex) {
+        g_txindex->Stop();
+        g_txindex.reset();
+    }
+    if (g_addressindex) {
+        g_addressindex->Stop();
+        g_addressindex.reset();
+    }
+    if (g_coinstatsindex) {
+        g_coinstatsindex->Stop();
+        g_coinstatsindex.reset();
+    }
+
     // Any future callbacks will be dropped. This should absolutely be safe - if
     // missing a callback results in an unrecoverable situation, unclean shutdown
     // would too. The only reason to do the above flushes is to let the wallet catch
@@ -418,6 +446,7 @@ std::string HelpMessage(HelpMessageMode mode)
     std::string strUsage = HelpMessageGroup(_("Options:"));
     strUsage += HelpMessageOpt("-?", _("This help message"));
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
+    strUsage += HelpMessageOpt("-assumevalid=<hex>", strprintf(_("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)"), defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex()));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), DEFAULT_CHECKBLOCKS));
@@ -436,6 +465,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-disablesystemnotifications", strprintf(_("Disable OS notifications for incoming transactions (default: %u)"), 0));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file") + " " + _("on startup"));
+    strUsage += HelpMessageOpt("-loadsnapshot=<file>", _("Start a node with an empty chainstate from a UTXO snapshot written by dumptxoutset, instead of validating the chain up to it. Implies -prune") + " " + _("on startup"));
+    strUsage += HelpMessageOpt("-loadsnapshothash=<hex>", _("Trust the -loadsnapshot file with this content hash, as returned by dumptxoutset, if its base block has no snapshot pinned in the chain parameters"));
     strUsage += HelpMessageOpt("-maxreorg=<n>", strprintf(_("Set the Maximum reorg depth (default: %u)"), DEFAULT_MAX_REORG_DEPTH));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
@@ -445,12 +476,17 @@ std::string HelpMessage(HelpMessageMode mode)
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), ISLAMIC_DIGITAL_COIN_PID_FILENAME));
 #endif
+    strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by pruning (deleting) old blocks. This mode is incompatible with -txindex, -addressindex, -coinstatsindex, -rescan and masternodes. "
+            "Warning: Reverting this setting requires re-downloading the entire blockchain. "
+            "(default: 0 = disable pruning blocks, >%u = target size in MiB to use for block files)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild block chain index from current blk000??.dat files") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-resync", _("Delete blockchain folders and resync from scratch") + " " + _("on startup"));
 #if !defined(WIN32)
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
-    strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), DEFAULT_TXINDEX));
+    strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call. The index is built in the background and can be enabled without -reindex (default: %u)"), DEFAULT_TXINDEX));
+    strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain an index of the transparent outputs and spends of every address, used by the getaddress* and getspentinfo rpc calls. The index is built in the background (default: %u)"), DEFAULT_ADDRESSINDEX));
+    strUsage += HelpMessageOpt("-coinstatsindex", strprintf(_("Maintain the statistics and MuHash of the UTXO set after every block, used by the gettxoutsetinfo rpc call. The index is built in the background (default: %u)"), DEFAULT_COINSTATSINDEX));
     strUsage += HelpMessageOpt("-forcestart", _("Attempt to force blockchain corruption recovery") + " " + _("on startup"));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
@@ -534,7 +570,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)");
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf(_("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default:%u)"), DEFAULT_LIMITFREERELAY));
         strUsage += HelpMessageOpt("-relaypriority", strprintf(_("Require high priority for relaying free or low-fee transactions (default:%u)"), DEFAULT_RELAYPRIORITY));
-        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf(_("Limit size of signature cache to <n> MiB (default: %u)"), DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf(_("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)"), DEFAULT_MAX_SIG_CACHE_SIZE));
     }
     strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE));
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in %s/Kb) smaller than this are considered zero fee for relaying, mining and transaction creation (default: %s)"), CURRENCY_UNIT, FormatMoney(::minRelayTxFee.GetFeePerK())));
@@ -654,6 +690,47 @@ struct CImportingNow {
     }
 };
 
+// If we're using -prune with -reindex, then delete block files that will be ignored by the
+// reindex.  Since reindexing works by starting at block file 0 and looping until a blockfile
+// is missing, do the same here to delete any later block files after a gap.  Also delete all
+// rev files since they'll be rewritten by the reindex anyway.  This ensures that vinfoBlockFile
+// is in sync with what's actually on disk by the time we start downloading, so that pruning
+// works correctly.
+void CleanupBlockRevFiles()
+{
+    std::map<std::string, fs::path> mapBlockFiles;
+
+    // Glob all blk?????.dat and rev?????.dat files from the blocks directory.
+    // Remove the rev files immediately and insert the blk file paths into an
+    // ordered map keyed by block file index.
+    LogPrintf("Removing unusable blk?????.dat and rev?????.dat files for -reindex with -prune\n");
+    fs::path blocksdir = GetDataDir() / "blocks";
+    for (fs::directory_iterator it(blocksdir); it != fs::directory_iterator(); it++) {
+        if (fs::is_regular_file(*it) &&
+            it->path().filename().string().length() == 12 &&
+            it->path().filename().string().substr(8,4) == ".dat")
+        {
+            if (it->path().filename().string().substr(0,3) == "blk")
+                mapBlockFiles[it->path().filename().string().substr(3,5)] = it->path();
+            else if (it->path().filename().string().substr(0,3) == "rev")
+                fs::remove(it->path());
+        }
+    }
+
+    // Remove all block files that aren't part of a contiguous set starting at
+    // zero by walking the ordered map (keys are block file indices) by
+    // keeping a separate counter.  Once we hit a gap (or if 0 doesn't exist)
+    // start removing block files.
+    int nContigCounter = 0;
+    for (const std::pair<const std::string, fs::path>& item : mapBlockFiles) {
+        if (atoi(item.first) == nContigCounter) {
+            nContigCounter++;
+            continue;
+        }
+        fs::remove(item.second);
+    }
+}
+
 void ThreadImport(const std::vector<fs::path>& vImportFiles)
 {
     util::ThreadRename("islamic_digital_coin-loadblk");
@@ -677,6 +754,9 @@ void ThreadImport(const std::vector<fs::path>& vImportFiles)
         pblocktree->WriteReindexing(false);
         fReindex = false;
         LogPrintf("Reindexing finished\n");
+        // Pruning was held off while reindexing
+        if (fPruneMode)
+            PruneAndFlush();
         // To avoid ending up in a situation without genesis block, re-try initializing (no-op if reindexing worked):
         if (!LoadGenesisBlock()) {
             throw std::runtime_error("Error initializing block database");
@@ -920,6 +1000,22 @@ void InitParameterInteraction()
             LogPrintf("%s : parameter interaction: -salvagewallet=1 -> setting -rescan=1\n", __func__);
     }
 
+    // a node started from a UTXO snapshot never has the blocks before it
+    if (gArgs.IsArgSet("-loadsnapshot")) {
+        if (gArgs.SoftSetArg("-prune", std::to_string(MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024)))
+            LogPrintf("%s : parameter interaction: -loadsnapshot set -> setting -prune=%d\n", __func__, MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024);
+    }
+
+    // -prune can't keep a transaction, address or coinstats index, which need every block on disk
+    if (gArgs.GetArg("-prune", 0) > 0) {
+        if (gArgs.SoftSetBoolArg("-txindex", false))
+            LogPrintf("%s : parameter interaction: -prune set -> setting -txindex=0\n", __func__);
+        if (gArgs.SoftSetBoolArg("-addressindex", false))
+            LogPrintf("%s : parameter interaction: -prune set -> setting -addressindex=0\n", __func__);
+        if (gArgs.SoftSetBoolArg("-coinstatsindex", false))
+            LogPrintf("%s : parameter interaction: -prune set -> setting -coinstatsindex=0\n", __func__);
+    }
+
     int zapwallettxes = gArgs.GetArg("-zapwallettxes", 0);
     // -zapwallettxes implies dropping the mempool on startup
     if (zapwallettxes != 0 && gArgs.SoftSetBoolArg("-persistmempool", false)) {
@@ -1023,18 +1119,38 @@ bool AppInitParameterInteraction()
         return UIError(_("Cannot set -bind or -whitebind together with -listen=0"));
     }
 
-    int nBind = std::max(nUserBind, size_t(1));
     nUserMaxConnections = gArgs.GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
     // Trim requested connection counts, to fit into system limitations
+    // (with select(), sockets can't go past FD_SETSIZE)
+#ifndef USE_POLL
+    int nBind = std::max(nUserBind, size_t(1));
     nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+#endif
     nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return UIError(_("Not enough file descriptors available."));
     if (nFD - MIN_CORE_FILEDESCRIPTORS < nMaxConnections)
         nMaxConnections = nFD - MIN_CORE_FILEDESCRIPTORS;
 
+    // if using block pruning, then disallow txindex
+    if (gArgs.GetArg("-prune", 0)) {
+        if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
+            return UIError(_("Prune mode is incompatible with -txindex."));
+        if (gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX))
+            return UIError(_("Prune mode is incompatible with -addressindex."));
+        if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX))
+            return UIError(_("Prune mode is incompatible with -coinstatsindex."));
+    } else if (gArgs.IsArgSet("-loadsnapshot")) {
+        return UIError(_("-loadsnapshot requires prune mode."));
+    }
+    if (gArgs.IsArgSet("-loadsnapshothash")) {
+        const std::string strHash = gArgs.GetArg("-loadsnapshothash", "");
+        if (!IsHex(strHash) || strHash.size() != 64)
+            return UIError(strprintf(_("Invalid hash for -loadsnapshothash: '%s'"), strHash));
+    }
+
     // ********************************************************* Step 3: parameter-to-internal-flags
 
     // Special-case: if -debug=0/-nodebug is set, turn off debugging messages
@@ -1084,6 +1200,12 @@ bool AppInitParameterInteraction()
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", Params().DefaultConsistencyChecks());
     Checkpoints::fEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
 
+    hashAssumeValid = uint256S(gArgs.GetArg("-assumevalid", Params().GetConsensus().defaultAssumeValid.GetHex()));
+    if (!hashAssumeValid.IsNull())
+        LogPrintf("Assuming ancestors of block %s have valid signatures.\n", hashAssumeValid.GetHex());
+    else
+        LogPrintf("Validating signatures for all blocks.\n");
+
     // -mempoollimit limits
     int64_t nMempoolSizeLimit = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     int64_t nMempoolDescendantSizeLimit = gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT) * 1000;
@@ -1100,6 +1222,20 @@ bool AppInitParameterInteraction()
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
+    int64_t nPruneArg = gArgs.GetArg("-prune", 0);
+    if (nPruneArg < 0) {
+        return UIError(_("Prune cannot be configured with a negative value."));
+    }
+    nPruneTarget = (uint64_t) nPruneArg * 1024 * 1024;
+    if (nPruneArg > 0) {
+        if (nPruneTarget < MIN_DISK_SPACE_FOR_BLOCK_FILES) {
+            return UIError(strprintf(_("Prune configured below the minimum of %d MiB.  Please use a higher number."), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
+        }
+        LogPrintf("Prune configured to target %uMiB on disk for block and undo files.\n", nPruneTarget / 1024 / 1024);
+        fPruneMode = true;
+    }
+
     setvbuf(stdout, NULL, _IOLBF, 0); /// ***TODO*** do we still need this after -printtoconsole is gone?
 
     RegisterAllCoreRPCCommands(tableRPC);
@@ -1191,6 +1327,11 @@ bool AppInitSanityChecks()
 {
     // ********************************************************* Step 4: sanity checks
 
+    std::string sha256_algo = SHA256AutoDetect();
+    LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string quark_algo = QuarkAutoDetect();
+    LogPrintf("Using the '%s' Quark batch implementation\n", quark_algo);
+
     // Initialize elliptic curve code
     RandomInit();
     ECC_Start();
@@ -1236,11 +1377,18 @@ bool AppInitMain()
     std::ostringstream strErrors;
 
     InitSignatureCache();
+    InitScriptExecutionCache();
 
-    LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
+    LogPrintf("Using %u threads for script and shielded proofs verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
-        for (int i = 0; i < nScriptCheckThreads - 1; i++)
+        for (int i = 0; i < nScriptCheckThreads - 1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadSaplingCheck);
+#ifdef ENABLE_WALLET
+            if (!gArgs.GetBoolArg("-disablewallet", false))
+                threadGroup.create_thread(&ThreadSaplingTrialDecryption);
+#endif
+        }
     }
 
     if (gArgs.IsArgSet("-sporkkey")) // spork priv key
@@ -1536,15 +1684,28 @@ bool AppInitMain()
     int64_t nTotalCache = (gArgs.GetArg("-dbcache", nDefaultDbCache) << 20);
     nTotalCache = std::max(nTotalCache, nMinDbCache << 20); // total cache cannot be less than nMinDbCache
     nTotalCache = std::min(nTotalCache, nMaxDbCache << 20); // total cache cannot be greater than nMaxDbcache
-    int64_t nBlockTreeDBCache = nTotalCache / 8;
-    if (nBlockTreeDBCache > (1 << 21) && !gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
-        nBlockTreeDBCache = (1 << 21); // block tree db cache shouldn't be larger than 2 MiB
+    int64_t nBlockTreeDBCache = std::min(nTotalCache / 8, nMaxBlockDBCache << 20);
     nTotalCache -= nBlockTreeDBCache;
+    int64_t nTxIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxTxIndexCache << 20 : 0);
+    nTotalCache -= nTxIndexCache;
+    int64_t nAddressIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) ? nMaxAddressIndexCache << 20 : 0);
+    nTotalCache -= nAddressIndexCache;
+    int64_t nCoinStatsIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX) ? nMaxCoinStatsIndexCache << 20 : 0);
+    nTotalCache -= nCoinStatsIndexCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
+        LogPrintf("* Using %.1fMiB for transaction index database\n", nTxIndexCache * (1.0 / 1024 / 1024));
+    }
+    if (gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+        LogPrintf("* Using %.1fMiB for address index database\n", nAddressIndexCache * (1.0 / 1024 / 1024));
+    }
+    if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        LogPrintf("* Using %.1fMiB for coinstats index database\n", nCoinStatsIndexCache * (1.0 / 1024 / 1024));
+    }
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set\n", nCoinCacheUsage * (1.0 / 1024 / 1024));
 
@@ -1574,6 +1735,9 @@ bool AppInitMain()
 
                 if (fReindex) {
                     pblocktree->WriteReindexing(true);
+                    //If we're reindexing in prune mode, wipe away unusable block files and all undo data files
+                    if (fPruneMode)
+                        CleanupBlockRevFiles();
                 }
 
                 // End loop if shutdown was requested
@@ -1583,9 +1747,26 @@ bool AppInitMain()
                 uiInterface.InitMessage(_("Loading sporks..."));
                 sporkManager.LoadSporksFromDB();
 
-                // LoadBlockIndex will load fTxIndex from the db, or set it if
-                // we're reindexing. It will also load fHavePruned if we've
-                // ever removed a block file from disk.
+                // A UTXO snapshot load interrupted half-way left a partial
+                // chainstate, which only resuming the load or a reindex fixes.
+                bool fSnapshotLoad = false;
+                if (pblocktree->ReadFlag("snapshotload", fSnapshotLoad) && fSnapshotLoad && !gArgs.IsArgSet("-loadsnapshot")) {
+                    return UIError(_("A UTXO snapshot load was interrupted. Restart with -loadsnapshot to resume it, or with -reindex."));
+                }
+
+                // A fresh node may start from a UTXO snapshot, which writes the
+                // block index and chainstate up to its base block.
+                if (gArgs.IsArgSet("-loadsnapshot") && !fReindex) {
+                    uiInterface.InitMessage(_("Loading UTXO snapshot..."));
+                    std::string strSnapshotError;
+                    if (!LoadUTXOSnapshot(gArgs.GetArg("-loadsnapshot", ""), uint256S(gArgs.GetArg("-loadsnapshothash", "")), nCoinDBCache, strSnapshotError)) {
+                        if (ShutdownRequested()) break;
+                        return UIError(strprintf(_("Unable to load UTXO snapshot: %s"), strSnapshotError));
+                    }
+                }
+
+                // LoadBlockIndex will load fHavePruned if we've ever removed a
+                // block file from disk.
                 uiInterface.InitMessage(_("Loading block index..."));
                 std::string strBlockIndexError;
                 if (!LoadBlockIndex(strBlockIndexError)) {
@@ -1600,9 +1781,10 @@ bool AppInitMain()
                 if (!mapBlockIndex.empty() && mapBlockIndex.count(consensus.hashGenesisBlock) == 0)
                     return UIError(_("Incorrect or no genesis block found. Wrong datadir for network?"));
 
-                // Check for changed -txindex state
-                if (fTxIndex != gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex to change -txindex");
+                // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
+                // in the past, but is now trying to run unpruned.
+                if (fHavePruned && !fPruneMode) {
+                    strLoadError = _("You need to rebuild the database using -reindex to go back to unpruned mode.  This will redownload the entire blockchain");
                     break;
                 }
 
@@ -1723,6 +1905,21 @@ bool AppInitMain()
         mempool.ReadFeeEstimates(est_filein);
     fFeeEstimatesInitialized = true;
 
+    // The transaction index is built in the background from the loaded chain,
+    // so it can be turned on (or off) without reindexing.
+    if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
+        g_txindex = MakeUnique<TxIndex>(nTxIndexCache, false, fReindex);
+        g_txindex->Start();
+    }
+    if (gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+        g_addressindex = MakeUnique<AddressIndex>(nAddressIndexCache, false, fReindex);
+        g_addressindex->Start();
+    }
+    if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        g_coinstatsindex = MakeUnique<CoinStatsIndex>(nCoinStatsIndexCache, false, fReindex);
+        g_coinstatsindex->Start();
+    }
+
 // ********************************************************* Step 8: load wallet
 #ifdef ENABLE_WALLET
     if (!CWallet::InitLoadWallet())
@@ -1730,6 +1927,19 @@ bool AppInitMain()
 #else
     LogPrintf("No wallet compiled in!\n");
 #endif
+    // ********************************************************* Step 8a: data directory maintenance
+
+    // if pruning, unset the service bit and perform the initial blockstore prune
+    // after any wallet rescanning has taken place.
+    if (fPruneMode) {
+        LogPrintf("Unsetting NODE_NETWORK on prune mode\n");
+        nLocalServices = ServiceFlags(nLocalServices & ~NODE_NETWORK);
+        if (!fReindex) {
+            uiInterface.InitMessage(_("Pruning blockstore..."));
+            PruneAndFlush();
+        }
+    }
+
     // ********************************************************* Step 9: import blocks
 
     if (!CheckDiskSpace())
@@ -1830,9 +2040,9 @@ bool AppInitMain()
 
     fMasterNode = gArgs.GetBoolArg("-masternode", DEFAULT_MASTERNODE);
 
-    if ((fMasterNode || masternodeConfig.getCount() > -1) && fTxIndex == false) {
+    if ((fMasterNode || masternodeConfig.getCount() > -1) && !g_txindex) {
         return UIError("Enabling Masternode support requires turning on transaction indexing."
-                       "Please add txindex=1 to your configuration and start with -reindex");
+                       "Please add txindex=1 to your configuration");
     }
 
     if (fMasterNode) {
@@ -8,6 +8,7 @@
 
 #include "kernel.h"
 
+#include "crypto/sha256.h"
 #include "db.h"
 #include "legacy/stakemodifier.h"
 #include "policy/policy.h"
@@ -81,6 +82,86 @@ bool CStakeKernel::CheckKernelHash(bool fSkipLog) const
     return res;
 }
 
+/**
+ * CStakeKernelSearch Constructor
+ *
+ * @param[in]   pindexPrev      index of the parent of the kernel block
+ * @param[in]   nBits           target difficulty bits of the kernel block
+ */
+CStakeKernelSearch::CStakeKernelSearch(const CBlockIndex* const pindexPrev, unsigned int nBits):
+    pindexPrev(pindexPrev),
+    nBits(nBits)
+{
+    // Modifier v1 depends on the stake input: those kernels are checked one by one.
+    if (Params().GetConsensus().NetworkUpgradeActive(pindexPrev->nHeight + 1, Consensus::UPGRADE_V3_4)) {
+        fModifierV2 = true;
+        nStakeModifierV2 = pindexPrev->GetStakeModifierV2();
+    }
+    bnTargetBase.SetCompact(nBits);
+}
+
+int CStakeKernelSearch::FindKernel(const std::vector<CStakeInput*>& vInputs, int64_t& nTimeTx) const
+{
+    // Get the new time slot (and verify it's not the same as previous block)
+    const bool fRegTest = Params().IsRegTestNet();
+    nTimeTx = (fRegTest ? GetAdjustedTime() : GetCurrentTimeSlot());
+    if (nTimeTx <= pindexPrev->nTime && !fRegTest) return -1;
+
+    // Stake input contextual checks
+    const int nHeightTx = pindexPrev->nHeight + 1;
+    std::vector<size_t> vPos;
+    vPos.reserve(vInputs.size());
+    for (size_t i = 0; i < vInputs.size(); i++) {
+        if (vInputs[i] && vInputs[i]->ContextCheck(nHeightTx, nTimeTx)) vPos.emplace_back(i);
+    }
+    if (vPos.empty()) return -1;
+
+    if (!fModifierV2) {
+        for (size_t i : vPos) {
+            if (CStakeKernel(pindexPrev, vInputs[i], nBits, nTimeTx).CheckKernelHash(true)) return i;
+        }
+        return -1;
+    }
+
+    // Serialize the kernels back to back (same message as CStakeKernel::GetHash)
+    CDataStream ss(SER_GETHASH, 0);
+    std::vector<size_t> vOffsets(vPos.size() + 1, 0);
+    bool fSameLength = true;
+    for (size_t j = 0; j < vPos.size(); j++) {
+        const CStakeInput* stakeInput = vInputs[vPos[j]];
+        const int nTimeBlockFrom = stakeInput->GetIndexFrom()->nTime;
+        ss << nStakeModifierV2 << nTimeBlockFrom << stakeInput->GetUniqueness() << (int) nTimeTx;
+        vOffsets[j + 1] = ss.size();
+        fSameLength &= (vOffsets[j + 1] - vOffsets[j] == vOffsets[1]);
+    }
+
+    // Hash them, all at once if they have the same length (as for IDC stakes)
+    std::vector<unsigned char> vHashes(32 * vPos.size());
+    const unsigned char* pbegin = (const unsigned char*) ss.data();
+    if (fSameLength) {
+        SHA256DMulti(vHashes.data(), pbegin, vOffsets[1], vPos.size());
+    } else {
+        for (size_t j = 0; j < vPos.size(); j++) {
+            const uint256& hash = Hash(pbegin + vOffsets[j], pbegin + vOffsets[j + 1]);
+            memcpy(vHashes.data() + 32 * j, hash.begin(), 32);
+        }
+    }
+
+    // Check them against the weighted target
+    for (size_t j = 0; j < vPos.size(); j++) {
+        CStakeInput* stakeInput = vInputs[vPos[j]];
+        uint256 hashProofOfStake;
+        memcpy(hashProofOfStake.begin(), vHashes.data() + 32 * j, 32);
+        uint256 bnTarget = bnTargetBase;
+        bnTarget *= uint256(stakeInput->GetValue() / 100);
+        if (hashProofOfStake < bnTarget) {
+            // Found: double check it (and log it) with the single kernel code
+            if (CStakeKernel(pindexPrev, stakeInput, nBits, nTimeTx).CheckKernelHash(true)) return vPos[j];
+        }
+    }
+    return -1;
+}
+
 
 /*
  * PoS Validation
@@ -40,6 +40,44 @@ private:
     CAmount stakeValue{0};     // target multiplier
 };
 
+//! Number of stake inputs checked at once by the kernel search of the wallet
+static const size_t STAKE_KERNEL_SEARCH_BATCH = 128;
+
+/*
+ * CStakeKernelSearch   Kernel search for many stake inputs on top of the same block.
+ *                      The stake modifier and the target of the block are computed once,
+ *                      and the kernels are hashed in batches (multi-buffer SHA256D).
+ */
+class CStakeKernelSearch {
+public:
+    /**
+     * CStakeKernelSearch Constructor
+     *
+     * @param[in]   pindexPrev      index of the parent of the kernel block
+     * @param[in]   nBits           target difficulty bits of the kernel block
+     */
+    CStakeKernelSearch(const CBlockIndex* const pindexPrev, unsigned int nBits);
+
+    /*
+     * FindKernel   Check the stake inputs, in order, as Stake() would
+     *
+     * @param[in]   vInputs         inputs for the coinstake of the kernel block
+     * @param[out]  nTimeTx         new blocktime (set by this function)
+     * @return      int             position in vInputs of the first input whose kernel
+     *                              hash meets the target (-1 if there is none)
+     */
+    int FindKernel(const std::vector<CStakeInput*>& vInputs, int64_t& nTimeTx) const;
+
+private:
+    const CBlockIndex* pindexPrev;
+    unsigned int nBits;
+    // modifier v2 (same for all the inputs), if active
+    bool fModifierV2{false};
+    uint256 nStakeModifierV2;
+    // target of a stake of one satoshi x 100
+    uint256 bnTargetBase;
+};
+
 /* PoS Validation */
 
 /*
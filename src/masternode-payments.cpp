@@ -400,7 +400,7 @@ void CMasternodePayments::ProcessMessageMasternodePayments(CNode* pfrom, std::st
 
         int nHeight = mnodeman.GetBestHeight();
 
-        if (masternodePayments.mapMasternodePayeeVotes.count(winner.GetHash())) {
+        if (WITH_LOCK(cs_mapMasternodePayeeVotes, return masternodePayments.mapMasternodePayeeVotes.count(winner.GetHash()))) {
             LogPrint(BCLog::MASTERNODE, "mnw - Already seen - %s bestHeight %d\n", winner.GetHash().ToString().c_str(), nHeight);
             masternodeSync.AddedMasternodeWinner(winner.GetHash());
             return;
@@ -510,8 +510,57 @@ bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerI
         }
     }
 
-    mapMasternodeBlocks[winnerIn.nBlockHeight].AddPayee(winnerIn.payee, 1);
+    LOCK(cs_mapMasternodeBlocks);
+    CMasternodeBlockPayees& blockPayees = mapMasternodeBlocks[winnerIn.nBlockHeight];
+    blockPayees.AddPayee(winnerIn.payee, 1);
+    if (blockPayees.HasPayeeWithVotes(winnerIn.payee, MNPAYMENTS_PAID_VOTES_REQUIRED)) {
+        mapPayeePaidHeights[winnerIn.payee].insert(winnerIn.nBlockHeight);
+    }
+
+    return true;
+}
+
+void CMasternodePayments::RebuildPaidHeightsIndex()
+{
+    LOCK2(cs_mapMasternodeBlocks, cs_vecPayments);
+    mapPayeePaidHeights.clear();
+    for (const auto& it : mapMasternodeBlocks) {
+        for (const CMasternodePayee& payee : it.second.vecPayments) {
+            if (payee.nVotes >= MNPAYMENTS_PAID_VOTES_REQUIRED) {
+                mapPayeePaidHeights[payee.scriptPubKey].insert(it.first);
+            }
+        }
+    }
+}
+
+void CMasternodePayments::UnindexBlockPayees(int nBlockHeight)
+{
+    AssertLockHeld(cs_mapMasternodeBlocks);
+    const auto& it = mapMasternodeBlocks.find(nBlockHeight);
+    if (it == mapMasternodeBlocks.end()) return;
+
+    LOCK(cs_vecPayments);
+    for (const CMasternodePayee& payee : it->second.vecPayments) {
+        const auto& itHeights = mapPayeePaidHeights.find(payee.scriptPubKey);
+        if (itHeights == mapPayeePaidHeights.end()) continue;
+        itHeights->second.erase(nBlockHeight);
+        if (itHeights->second.empty()) mapPayeePaidHeights.erase(itHeights);
+    }
+}
+
+bool CMasternodePayments::GetLastPaidHeight(const CScript& payee, int nMinHeight, int nMaxHeight, int& nHeightRet) const
+{
+    LOCK(cs_mapMasternodeBlocks);
+    const auto& it = mapPayeePaidHeights.find(payee);
+    if (it == mapPayeePaidHeights.end()) return false;
+
+    // first height above nMaxHeight, then step back to the latest one within range
+    auto itHeight = it->second.upper_bound(nMaxHeight);
+    if (itHeight == it->second.begin()) return false;
+    --itHeight;
+    if (*itHeight < nMinHeight) return false;
 
+    nHeightRet = *itHeight;
     return true;
 }
 
@@ -613,8 +662,9 @@ void CMasternodePayments::CleanPaymentList(int mnCount, int nHeight)
 
         if (nHeight - winner.nBlockHeight > nLimit) {
             LogPrint(BCLog::MASTERNODE, "CMasternodePayments::CleanPaymentList - Removing old Masternode payment - block %d\n", winner.nBlockHeight);
-            masternodeSync.mapSeenSyncMNW.erase((*it).first);
+            masternodeSync.EraseSeenSyncMNW((*it).first);
             mapMasternodePayeeVotes.erase(it++);
+            UnindexBlockPayees(winner.nBlockHeight);
             mapMasternodeBlocks.erase(winner.nBlockHeight);
         } else {
             ++it;
@@ -691,12 +741,11 @@ bool CMasternodePayments::ProcessBlock(int nBlockHeight)
 
 void CMasternodePayments::Sync(CNode* node, int nCountNeeded)
 {
-    LOCK(cs_mapMasternodePayeeVotes);
-
     int nHeight = mnodeman.GetBestHeight();
     int nCount = (mnodeman.CountEnabled() * 1.25);
     if (nCountNeeded > nCount) nCountNeeded = nCount;
 
+    LOCK(cs_mapMasternodePayeeVotes);
     int nInvCount = 0;
     std::map<uint256, CMasternodePaymentWinner>::iterator it = mapMasternodePayeeVotes.begin();
     while (it != mapMasternodePayeeVotes.end()) {
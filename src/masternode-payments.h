@@ -23,6 +23,8 @@ extern CMasternodePayments masternodePayments;
 
 #define MNPAYMENTS_SIGNATURES_REQUIRED 6
 #define MNPAYMENTS_SIGNATURES_TOTAL 10
+// Votes needed for a payee to be considered paid at a given height (see CMasternodeMan::GetLastPaid)
+#define MNPAYMENTS_PAID_VOTES_REQUIRED 2
 
 void ProcessMessageMasternodePayments(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 bool IsBlockPayeeValid(const CBlock& block, int nBlockHeight);
@@ -231,6 +233,13 @@ class CMasternodePayments
 private:
     int nLastBlockHeight;
 
+    // Index over mapMasternodeBlocks: payee script -> heights at which the payee
+    // has at least MNPAYMENTS_PAID_VOTES_REQUIRED votes (guarded by cs_mapMasternodeBlocks)
+    std::map<CScript, std::set<int>> mapPayeePaidHeights;
+
+    void RebuildPaidHeightsIndex();
+    void UnindexBlockPayees(int nBlockHeight);
+
 public:
     std::map<uint256, CMasternodePaymentWinner> mapMasternodePayeeVotes;
     std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
@@ -246,6 +255,7 @@ public:
         LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePayeeVotes);
         mapMasternodeBlocks.clear();
         mapMasternodePayeeVotes.clear();
+        mapPayeePaidHeights.clear();
     }
 
     bool AddWinningMasternode(CMasternodePaymentWinner& winner);
@@ -257,6 +267,8 @@ public:
     bool GetBlockPayee(int nBlockHeight, CScript& payee);
     bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight);
     bool IsScheduled(const CMasternode& mn, int nNotBlockHeight);
+    // Highest height in [nMinHeight, nMaxHeight] at which payee was voted paid
+    bool GetLastPaidHeight(const CScript& payee, int nMinHeight, int nMaxHeight, int& nHeightRet) const;
 
     bool CanVote(const COutPoint& outMasternode, int nBlockHeight)
     {
@@ -285,6 +297,9 @@ public:
     {
         READWRITE(mapMasternodePayeeVotes);
         READWRITE(mapMasternodeBlocks);
+        if (ser_action.ForRead()) {
+            RebuildPaidHeightsIndex();
+        }
     }
 };
 
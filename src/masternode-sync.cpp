@@ -91,9 +91,12 @@ void CMasternodeSync::Reset()
     lastMasternodeList = 0;
     lastMasternodeWinner = 0;
     lastBudgetItem = 0;
-    mapSeenSyncMNB.clear();
-    mapSeenSyncMNW.clear();
-    mapSeenSyncBudget.clear();
+    {
+        LOCK(cs_seen);
+        mapSeenSyncMNB.clear();
+        mapSeenSyncMNW.clear();
+        mapSeenSyncBudget.clear();
+    }
     lastFailure = 0;
     nCountFailures = 0;
     sumMasternodeList = 0;
@@ -111,7 +114,9 @@ void CMasternodeSync::Reset()
 
 void CMasternodeSync::AddedMasternodeList(const uint256& hash)
 {
-    if (mnodeman.mapSeenMasternodeBroadcast.count(hash)) {
+    const bool fSeen = WITH_LOCK(mnodeman.cs_seen, return mnodeman.mapSeenMasternodeBroadcast.count(hash));
+    LOCK(cs_seen);
+    if (fSeen) {
         if (mapSeenSyncMNB[hash] < MASTERNODE_SYNC_THRESHOLD) {
             lastMasternodeList = GetTime();
             mapSeenSyncMNB[hash]++;
@@ -124,7 +129,9 @@ void CMasternodeSync::AddedMasternodeList(const uint256& hash)
 
 void CMasternodeSync::AddedMasternodeWinner(const uint256& hash)
 {
-    if (masternodePayments.mapMasternodePayeeVotes.count(hash)) {
+    const bool fSeen = WITH_LOCK(cs_mapMasternodePayeeVotes, return masternodePayments.mapMasternodePayeeVotes.count(hash));
+    LOCK(cs_seen);
+    if (fSeen) {
         if (mapSeenSyncMNW[hash] < MASTERNODE_SYNC_THRESHOLD) {
             lastMasternodeWinner = GetTime();
             mapSeenSyncMNW[hash]++;
@@ -137,10 +144,12 @@ void CMasternodeSync::AddedMasternodeWinner(const uint256& hash)
 
 void CMasternodeSync::AddedBudgetItem(const uint256& hash)
 {
-    if (g_budgetman.HaveProposal(hash) ||
+    const bool fSeen = g_budgetman.HaveProposal(hash) ||
             g_budgetman.HaveSeenProposalVote(hash) ||
             g_budgetman.HaveFinalizedBudget(hash) ||
-            g_budgetman.HaveSeenFinalizedBudgetVote(hash)) {
+            g_budgetman.HaveSeenFinalizedBudgetVote(hash);
+    LOCK(cs_seen);
+    if (fSeen) {
         if (mapSeenSyncBudget[hash] < MASTERNODE_SYNC_THRESHOLD) {
             lastBudgetItem = GetTime();
             mapSeenSyncBudget[hash]++;
@@ -151,6 +160,18 @@ void CMasternodeSync::AddedBudgetItem(const uint256& hash)
     }
 }
 
+void CMasternodeSync::EraseSeenSyncMNB(const uint256& hash)
+{
+    LOCK(cs_seen);
+    mapSeenSyncMNB.erase(hash);
+}
+
+void CMasternodeSync::EraseSeenSyncMNW(const uint256& hash)
+{
+    LOCK(cs_seen);
+    mapSeenSyncMNW.erase(hash);
+}
+
 bool CMasternodeSync::IsBudgetPropEmpty()
 {
     return sumBudgetItemProp == 0 && countBudgetItemProp > 0;
@@ -320,7 +341,7 @@ bool CMasternodeSync::SyncWithNode(CNode* pnode)
 
     if (pnode->nVersion >= ActiveProtocol()) {
         if (RequestedMasternodeAssets == MASTERNODE_SYNC_LIST) {
-            LogPrint(BCLog::MASTERNODE, "CMasternodeSync::Process() - lastMasternodeList %lld (GetTime() - MASTERNODE_SYNC_TIMEOUT) %lld\n", lastMasternodeList, GetTime() - MASTERNODE_SYNC_TIMEOUT);
+            LogPrint(BCLog::MASTERNODE, "CMasternodeSync::Process() - lastMasternodeList %lld (GetTime() - MASTERNODE_SYNC_TIMEOUT) %lld\n", lastMasternodeList.load(), GetTime() - MASTERNODE_SYNC_TIMEOUT);
             if (lastMasternodeList > 0 && lastMasternodeList < GetTime() - MASTERNODE_SYNC_TIMEOUT * 2 && RequestedMasternodeAttempt >= MASTERNODE_SYNC_THRESHOLD) { //hasn't received a new item in the last five seconds, so we'll move to the
                 GetNextAsset();
                 return false;
@@ -42,13 +42,17 @@ struct TierTwoPeerData {
 class CMasternodeSync
 {
 public:
+    // critical section to protect the maps of seen items, updated from the threads of the
+    // tier two messages. Nothing else is locked while holding it.
+    mutable RecursiveMutex cs_seen;
     std::map<uint256, int> mapSeenSyncMNB;
     std::map<uint256, int> mapSeenSyncMNW;
     std::map<uint256, int> mapSeenSyncBudget;
 
-    int64_t lastMasternodeList;
-    int64_t lastMasternodeWinner;
-    int64_t lastBudgetItem;
+    // times of the last items received, set from the threads of the tier two messages
+    std::atomic<int64_t> lastMasternodeList;
+    std::atomic<int64_t> lastMasternodeWinner;
+    std::atomic<int64_t> lastBudgetItem;
     int64_t lastFailure;
     int nCountFailures;
 
@@ -78,6 +82,8 @@ public:
     void AddedMasternodeList(const uint256& hash);
     void AddedMasternodeWinner(const uint256& hash);
     void AddedBudgetItem(const uint256& hash);
+    void EraseSeenSyncMNB(const uint256& hash);
+    void EraseSeenSyncMNW(const uint256& hash);
     void GetNextAsset();
     std::string GetSyncStatus();
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
@@ -133,7 +133,7 @@ bool CMasternode::UpdateFromNewBroadcast(CMasternodeBroadcast& mnb)
         int nDoS = 0;
         if (mnb.lastPing.IsNull() || (!mnb.lastPing.IsNull() && mnb.lastPing.CheckAndUpdate(nDoS, false))) {
             lastPing = mnb.lastPing;
-            mnodeman.mapSeenMasternodePing.emplace(lastPing.GetHash(), lastPing);
+            WITH_LOCK(mnodeman.cs_seen, mnodeman.mapSeenMasternodePing.emplace(lastPing.GetHash(), lastPing); );
         }
         return true;
     }
@@ -191,6 +191,14 @@ bool CMasternode::IsInputAssociatedWithPubkey() const
     CScript payee;
     payee = GetScriptForDestination(pubKeyCollateralAddress.GetID());
 
+    // The collateral is normally unspent: check it in the UTXO set, which
+    // doesn't need the (possibly pruned) block data.
+    {
+        LOCK(cs_main);
+        const Coin& coin = pcoinsTip->AccessCoin(vin.prevout);
+        if (!coin.IsSpent() && coin.out.nValue == MN_COLL_AMT && coin.out.scriptPubKey == payee) return true;
+    }
+
     CTransactionRef txVin;
     uint256 hash;
     if(GetTransaction(vin.prevout.hash, txVin, hash, true)) {
@@ -498,8 +506,8 @@ bool CMasternodeBroadcast::CheckInputsAndAdd(int nChainHeight, int& nDoS)
     if (collateralUtxoDepth < MasternodeCollateralMinConf()) {
         LogPrint(BCLog::MASTERNODE,"mnb - Input must have at least %d confirmations\n", MasternodeCollateralMinConf());
         // maybe we miss few blocks, let this mnb to be checked again later
-        mnodeman.mapSeenMasternodeBroadcast.erase(GetHash());
-        masternodeSync.mapSeenSyncMNB.erase(GetHash());
+        WITH_LOCK(mnodeman.cs_seen, mnodeman.mapSeenMasternodeBroadcast.erase(GetHash()); );
+        masternodeSync.EraseSeenSyncMNB(GetHash());
         return false;
     }
 
@@ -625,7 +633,7 @@ bool CMasternodePing::CheckAndUpdate(int& nDos, bool fRequireAvailable, bool fCh
             }
 
             // ping have passed the basic checks, can be updated now
-            mnodeman.mapSeenMasternodePing.emplace(GetHash(), *this);
+            WITH_LOCK(mnodeman.cs_seen, mnodeman.mapSeenMasternodePing.emplace(GetHash(), *this); );
 
             // SetLastPing locks masternode cs. Be careful with the lock ordering.
             pmn->SetLastPing(*this);
@@ -633,8 +641,12 @@ bool CMasternodePing::CheckAndUpdate(int& nDos, bool fRequireAvailable, bool fCh
             //mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
             CMasternodeBroadcast mnb(*pmn);
             const uint256& hash = mnb.GetHash();
-            if (mnodeman.mapSeenMasternodeBroadcast.count(hash)) {
-                mnodeman.mapSeenMasternodeBroadcast[hash].lastPing = *this;
+            {
+                LOCK(mnodeman.cs_seen);
+                auto it = mnodeman.mapSeenMasternodeBroadcast.find(hash);
+                if (it != mnodeman.mapSeenMasternodeBroadcast.end()) {
+                    it->second.lastPing = *this;
+                }
             }
 
             if (!pmn->IsEnabled()) return false;
@@ -8,6 +8,7 @@
 
 #include "addrman.h"
 #include "fs.h"
+#include "index/txindex.h"
 #include "masternode-payments.h"
 #include "masternode-sync.h"
 #include "masternode.h"
@@ -241,13 +242,16 @@ int CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
             //erase all of the broadcasts we've seen from this vin
             // -- if we missed a few pings and the node was removed, this will allow is to get it back without them
             //    sending a brand new mnb
-            std::map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
-            while (it3 != mapSeenMasternodeBroadcast.end()) {
-                if (it3->second.vin == it->second->vin) {
-                    masternodeSync.mapSeenSyncMNB.erase((*it3).first);
-                    it3 = mapSeenMasternodeBroadcast.erase(it3);
-                } else {
-                    ++it3;
+            {
+                LOCK(cs_seen);
+                std::map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
+                while (it3 != mapSeenMasternodeBroadcast.end()) {
+                    if (it3->second.vin == it->second->vin) {
+                        masternodeSync.EraseSeenSyncMNB((*it3).first);
+                        it3 = mapSeenMasternodeBroadcast.erase(it3);
+                    } else {
+                        ++it3;
+                    }
                 }
             }
 
@@ -299,11 +303,13 @@ int CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
         }
     }
 
+    LOCK(cs_seen);
+
     // remove expired mapSeenMasternodeBroadcast
     std::map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
     while (it3 != mapSeenMasternodeBroadcast.end()) {
         if ((*it3).second.lastPing.sigTime < GetTime() - (MasternodeRemovalSeconds() * 2)) {
-            masternodeSync.mapSeenSyncMNB.erase((*it3).second.GetHash());
+            masternodeSync.EraseSeenSyncMNB((*it3).second.GetHash());
             it3 = mapSeenMasternodeBroadcast.erase(it3);
         } else {
             ++it3;
@@ -330,8 +336,11 @@ void CMasternodeMan::Clear()
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
-    mapSeenMasternodeBroadcast.clear();
-    mapSeenMasternodePing.clear();
+    {
+        LOCK(cs_seen);
+        mapSeenMasternodeBroadcast.clear();
+        mapSeenMasternodePing.clear();
+    }
     nDsqCount = 0;
 }
 
@@ -497,7 +506,7 @@ const CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlock
         //make sure it has as many confirmations as there are masternodes
         if (pcoinsTip->GetCoinDepthAtHeight(mn->vin.prevout, nBlockHeight) < nMnCount) continue;
 
-        vecMasternodeLastPaid.emplace_back(SecondsSincePayment(mn, BlockReading), mn->vin);
+        vecMasternodeLastPaid.emplace_back(SecondsSincePayment(mn, BlockReading, nMnCount), mn->vin);
     }
 
     nCount = (int)vecMasternodeLastPaid.size();
@@ -654,7 +663,7 @@ std::vector<std::pair<int64_t, MasternodeRef>> CMasternodeMan::GetMasternodeRank
 int CMasternodeMan::ProcessMNBroadcast(CNode* pfrom, CMasternodeBroadcast& mnb)
 {
     const uint256& mnbHash = mnb.GetHash();
-    if (mapSeenMasternodeBroadcast.count(mnbHash)) { //seen
+    if (WITH_LOCK(cs_seen, return mapSeenMasternodeBroadcast.count(mnbHash))) { //seen
         masternodeSync.AddedMasternodeList(mnbHash);
         return 0;
     }
@@ -667,12 +676,21 @@ int CMasternodeMan::ProcessMNBroadcast(CNode* pfrom, CMasternodeBroadcast& mnb)
     // make sure the vout that was signed is related to the transaction that spawned the Masternode
     //  - this is expensive, so it's only done once per Masternode
     if (!mnb.IsInputAssociatedWithPubkey()) {
-        LogPrintf("CMasternodeMan::ProcessMessage() : mnb - Got mismatched pubkey and vin\n");
-        return 33;
+        // A spent collateral is looked up in the txindex, which is built in the
+        // background: until it got in sync, the mnb can't be validated yet.
+        if (g_txindex && !g_txindex->BlockUntilSyncedToCurrentChain()) {
+            LogPrint(BCLog::MASTERNODE, "mnb - txindex is syncing, can't check vin %s yet\n", mnb.vin.prevout.hash.ToString());
+            return 0;
+        }
+        // Retry once the latest blocks are indexed
+        if (!g_txindex || !mnb.IsInputAssociatedWithPubkey()) {
+            LogPrintf("CMasternodeMan::ProcessMessage() : mnb - Got mismatched pubkey and vin\n");
+            return 33;
+        }
     }
 
     // now that did the basic mnb checks, can add it.
-    mapSeenMasternodeBroadcast.emplace(mnbHash, mnb);
+    WITH_LOCK(cs_seen, mapSeenMasternodeBroadcast.emplace(mnbHash, mnb); );
 
     // make sure it's still unspent
     //  - this is checked later by .check() in many places and by ThreadCheckObfuScationPool()
@@ -691,7 +709,7 @@ int CMasternodeMan::ProcessMNBroadcast(CNode* pfrom, CMasternodeBroadcast& mnb)
 int CMasternodeMan::ProcessMNPing(CNode* pfrom, CMasternodePing& mnp)
 {
     const uint256& mnpHash = mnp.GetHash();
-    if (mapSeenMasternodePing.count(mnpHash)) return 0; //seen
+    if (WITH_LOCK(cs_seen, return mapSeenMasternodePing.count(mnpHash))) return 0; //seen
 
     int nDoS = 0;
     if (mnp.CheckAndUpdate(nDoS)) return 0;
@@ -749,7 +767,7 @@ int CMasternodeMan::ProcessGetMNList(CNode* pfrom, CTxIn& vin)
                     pfrom->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
                     nInvCount++;
 
-                    if (!mapSeenMasternodeBroadcast.count(hash)) mapSeenMasternodeBroadcast.emplace(hash, mnb);
+                    WITH_LOCK(cs_seen, mapSeenMasternodeBroadcast.emplace(hash, mnb); );
 
                     if (vin == mn->vin) {
                         LogPrint(BCLog::MASTERNODE, "dseg - Sent 1 Masternode entry to peer %i\n", pfrom->GetId());
@@ -818,8 +836,11 @@ void CMasternodeMan::Remove(const COutPoint& collateralOut)
 
 void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast& mnb)
 {
-    mapSeenMasternodePing.emplace(mnb.lastPing.GetHash(), mnb.lastPing);
-    mapSeenMasternodeBroadcast.emplace(mnb.GetHash(), mnb);
+    {
+        LOCK(cs_seen);
+        mapSeenMasternodePing.emplace(mnb.lastPing.GetHash(), mnb.lastPing);
+        mapSeenMasternodeBroadcast.emplace(mnb.GetHash(), mnb);
+    }
     masternodeSync.AddedMasternodeList(mnb.GetHash());
 
     LogPrint(BCLog::MASTERNODE,"CMasternodeMan::UpdateMasternodeList() -- masternode=%s\n", mnb.vin.prevout.ToString());
@@ -833,9 +854,9 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast& mnb)
     }
 }
 
-int64_t CMasternodeMan::SecondsSincePayment(const MasternodeRef& mn, const CBlockIndex* BlockReading) const
+int64_t CMasternodeMan::SecondsSincePayment(const MasternodeRef& mn, const CBlockIndex* BlockReading, int nMnCount) const
 {
-    int64_t sec = (GetAdjustedTime() - GetLastPaid(mn, BlockReading));
+    int64_t sec = (GetAdjustedTime() - GetLastPaid(mn, BlockReading, nMnCount));
     int64_t month = 60 * 60 * 24 * 30;
     if (sec < month) return sec; //if it's less than 30 days, give seconds
 
@@ -848,7 +869,7 @@ int64_t CMasternodeMan::SecondsSincePayment(const MasternodeRef& mn, const CBloc
     return month + hash.GetCompact(false);
 }
 
-int64_t CMasternodeMan::GetLastPaid(const MasternodeRef& mn, const CBlockIndex* BlockReading) const
+int64_t CMasternodeMan::GetLastPaid(const MasternodeRef& mn, const CBlockIndex* BlockReading, int nMnCount) const
 {
     if (BlockReading == nullptr) return false;
 
@@ -863,23 +884,19 @@ int64_t CMasternodeMan::GetLastPaid(const MasternodeRef& mn, const CBlockIndex*
     // use a deterministic offset to break a tie -- 2.5 minutes
     int64_t nOffset = hash.GetCompact(false) % 150;
 
-    int nMnCount = CountEnabled() * 1.25;
-    for (int n = 0; n < nMnCount; n++) {
-        const auto& it = masternodePayments.mapMasternodeBlocks.find(BlockReading->nHeight);
-        if (it != masternodePayments.mapMasternodeBlocks.end()) {
-            // Search for this payee, with at least 2 votes. This will aid in consensus
-            // allowing the network to converge on the same payees quickly, then keep the same schedule.
-            if (it->second.HasPayeeWithVotes(mnpayee, 2))
-                return BlockReading->nTime + nOffset;
-        }
-        BlockReading = BlockReading->pprev;
+    // Look back over the last (enabled masternodes * 1.25) blocks for this payee, with at
+    // least 2 votes. This will aid in consensus allowing the network to converge on the
+    // same payees quickly, then keep the same schedule.
+    int nDepth = (nMnCount < 0 ? CountEnabled() : nMnCount) * 1.25;
+    if (nDepth <= 0) return 0;
 
-        if (BlockReading == nullptr || BlockReading->nHeight <= 0) {
-            break;
-        }
-    }
+    int nPaidHeight;
+    const int nMinHeight = std::max(BlockReading->nHeight - nDepth + 1, 1);
+    if (!masternodePayments.GetLastPaidHeight(mnpayee, nMinHeight, BlockReading->nHeight, nPaidHeight))
+        return 0;
 
-    return 0;
+    const CBlockIndex* pindexPaid = BlockReading->GetAncestor(nPaidHeight);
+    return pindexPaid ? pindexPaid->nTime + nOffset : 0;
 }
 
 std::string CMasternodeMan::ToString() const
@@ -87,6 +87,11 @@ private:
     int ProcessMessageInner(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
 public:
+    // critical section to protect the maps of seen messages, read by the message handler thread
+    // while the masternode messages are processed on their own thread. Only the lock of a
+    // masternode and masternodeSync.cs_seen can be taken while holding it.
+    mutable RecursiveMutex cs_seen;
+
     // Keep track of all broadcasts I've seen
     std::map<uint256, CMasternodeBroadcast> mapSeenMasternodeBroadcast;
     // Keep track of all pings I've seen
@@ -108,6 +113,7 @@ public:
         READWRITE(mWeAskedForMasternodeListEntry);
         READWRITE(nDsqCount);
 
+        LOCK(cs_seen);
         READWRITE(mapSeenMasternodeBroadcast);
         READWRITE(mapSeenMasternodePing);
     }
@@ -172,9 +178,9 @@ public:
     /// Update masternode list and maps using provided CMasternodeBroadcast
     void UpdateMasternodeList(CMasternodeBroadcast& mnb);
 
-    /// Get the time a masternode was last paid
-    int64_t GetLastPaid(const MasternodeRef& mn, const CBlockIndex* BlockReading) const;
-    int64_t SecondsSincePayment(const MasternodeRef& mn, const CBlockIndex* BlockReading) const;
+    /// Get the time a masternode was last paid (nMnCount: enabled masternodes, computed if negative)
+    int64_t GetLastPaid(const MasternodeRef& mn, const CBlockIndex* BlockReading, int nMnCount = -1) const;
+    int64_t SecondsSincePayment(const MasternodeRef& mn, const CBlockIndex* BlockReading, int nMnCount = -1) const;
 
     // Block hashes cycling vector management
     void CacheBlockHash(const CBlockIndex* pindex);
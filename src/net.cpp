@@ -29,6 +29,15 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
+#endif
+
+#ifdef USE_POLL
+#include <poll.h>
+#endif
+
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
 #endif
 
 #ifdef USE_UPNP
@@ -39,10 +48,24 @@
 
 
 #include <math.h>
+#include <unordered_map>
 
 // Dump addresses to peers.dat and banlist.dat every 15 minutes (900s)
 #define DUMP_ADDRESSES_INTERVAL 900
 
+/** How long to wait for the sockets to be ready, before looking again for data to send */
+static const int SELECT_TIMEOUT_MILLISECONDS = 50;
+
+#ifdef USE_EPOLL
+/** Maximum number of socket events returned by a single epoll_wait() */
+static const int MAX_EPOLL_EVENTS = 1024;
+#endif
+
+#ifndef WIN32
+/** Maximum number of buffers of the send queue written by a single sendmsg() (well below IOV_MAX) */
+static const int MAX_SEND_IOV = 64;
+#endif
+
 // We add a random period time (0 to 1 seconds) to feeler connections to prevent synchronization.
 #define FEELER_SLEEP_WINDOW 1
 
@@ -814,26 +837,52 @@ size_t CConnman::SocketSendData(CNode* pnode)
     size_t nSentSize = 0;
 
     while (it != pnode->vSendMsg.end()) {
-        const auto& data = *it;
-        assert(data.size() > pnode->nSendOffset);
+        assert((*it)->size() > pnode->nSendOffset);
         int nBytes = 0;
+        size_t nToSend = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
-            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#ifdef WIN32
+            const auto& data = **it;
+            nToSend = data.size() - pnode->nSendOffset;
+            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, nToSend, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+            // Gather the queued headers and payloads into a single system call
+            struct iovec iov[MAX_SEND_IOV];
+            int nIov = 0;
+            for (auto itBuf = it; itBuf != pnode->vSendMsg.end() && nIov < MAX_SEND_IOV; ++itBuf, ++nIov) {
+                const size_t nOffset = (nIov == 0) ? pnode->nSendOffset : 0;
+                iov[nIov].iov_base = const_cast<unsigned char*>((*itBuf)->data()) + nOffset;
+                iov[nIov].iov_len = (*itBuf)->size() - nOffset;
+                nToSend += iov[nIov].iov_len;
+            }
+            struct msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = nIov;
+            nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         }
         if (nBytes > 0) {
             pnode->nLastSend = GetTime();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             nSentSize += nBytes;
-            if (pnode->nSendOffset == data.size()) {
+            // Drop the buffers which were sent completely
+            size_t nLeft = nBytes;
+            while (nLeft > 0) {
+                const size_t nBufferLeft = (*it)->size() - pnode->nSendOffset;
+                if (nLeft < nBufferLeft) {
+                    pnode->nSendOffset += nLeft;
+                    break;
+                }
+                nLeft -= nBufferLeft;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
-                pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+                pnode->nSendSize -= (*it)->size();
                 it++;
-            } else {
+            }
+            pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+            if ((size_t)nBytes < nToSend) {
                 // could not send full message; stop sending more
                 break;
             }
@@ -1069,6 +1118,240 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     }
 }
 
+bool CConnman::GenerateSelectSet(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        recv_set.insert(hListenSocket.socket);
+    }
+
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes) {
+            // Implement the following logic:
+            // * If there is data to send, select() for sending data. As this only
+            //   happens when optimistic write failed, we choose to first drain the
+            //   write buffer in this case before receiving more. This avoids
+            //   needlessly queueing received data, if the remote peer is not themselves
+            //   receiving data. This means properly utilizing TCP flow control signalling.
+            // * Otherwise, if there is space left in the receive buffer, select() for
+            //   receiving data.
+            // * Hand off all complete messages to the processor, to be handled without
+            //   blocking here.
+
+            bool select_recv = !pnode->fPauseRecv;
+            bool select_send;
+            {
+                LOCK(pnode->cs_vSend);
+                select_send = !pnode->vSendMsg.empty();
+            }
+
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            error_set.insert(pnode->hSocket);
+            if (select_send) {
+                send_set.insert(pnode->hSocket);
+                continue;
+            }
+            if (select_recv) {
+                recv_set.insert(pnode->hSocket);
+            }
+        }
+    }
+
+    return !recv_set.empty() || !send_set.empty() || !error_set.empty();
+}
+
+#ifdef USE_EPOLL
+void CConnman::SocketEventsEpoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    // The sockets stay registered until they are closed: only the nodes whose
+    // interest changed since the last time (a new node, data to send, or a
+    // paused or resumed receive) are updated, following the logic of
+    // GenerateSelectSet.
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes) {
+            bool select_recv = !pnode->fPauseRecv;
+            bool select_send;
+            {
+                LOCK(pnode->cs_vSend);
+                select_send = !pnode->vSendMsg.empty();
+            }
+
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            // Errors and hangups are always reported: the events are never 0 once registered
+            uint32_t events = EPOLLERR | EPOLLHUP;
+            if (select_send)
+                events |= EPOLLOUT;
+            else if (select_recv)
+                events |= EPOLLIN;
+            if (events == pnode->nEpollEvents)
+                continue;
+
+            struct epoll_event event = {};
+            event.events = events;
+            event.data.fd = pnode->hSocket;
+            if (epoll_ctl(epollfd, pnode->nEpollEvents == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, pnode->hSocket, &event) == 0) {
+                pnode->nEpollEvents = events;
+            } else {
+                LogPrint(BCLog::NET, "epoll_ctl failed for peer=%d: %s\n", pnode->GetId(), NetworkErrorString(WSAGetLastError()));
+            }
+        }
+    }
+
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int nEvents = epoll_wait(epollfd, events, MAX_EPOLL_EVENTS, SELECT_TIMEOUT_MILLISECONDS);
+    if (nEvents == SOCKET_ERROR) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINTR) {
+            LogPrintf("socket epoll_wait error %s\n", NetworkErrorString(nErr));
+            interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        }
+        return;
+    }
+
+    for (int i = 0; i < nEvents; i++) {
+        if (events[i].events & EPOLLIN)
+            recv_set.insert(events[i].data.fd);
+        if (events[i].events & EPOLLOUT)
+            send_set.insert(events[i].data.fd);
+        if (events[i].events & (EPOLLERR | EPOLLHUP))
+            error_set.insert(events[i].data.fd);
+    }
+}
+#endif
+
+#ifdef USE_POLL
+void CConnman::SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+#ifdef USE_EPOLL
+    if (epollfd != -1) {
+        SocketEventsEpoll(recv_set, send_set, error_set);
+        return;
+    }
+#endif
+
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    if (!GenerateSelectSet(recv_select_set, send_select_set, error_select_set)) {
+        interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        return;
+    }
+
+    std::unordered_map<SOCKET, struct pollfd> pollfds;
+    for (SOCKET socket_id : recv_select_set) {
+        pollfds[socket_id].fd = socket_id;
+        pollfds[socket_id].events |= POLLIN;
+    }
+
+    for (SOCKET socket_id : send_select_set) {
+        pollfds[socket_id].fd = socket_id;
+        pollfds[socket_id].events |= POLLOUT;
+    }
+
+    for (SOCKET socket_id : error_select_set) {
+        pollfds[socket_id].fd = socket_id;
+        // These flags are ignored, but we set them for clarity
+        pollfds[socket_id].events |= POLLERR | POLLHUP;
+    }
+
+    std::vector<struct pollfd> vpollfds;
+    vpollfds.reserve(pollfds.size());
+    for (const auto& it : pollfds) {
+        vpollfds.push_back(it.second);
+    }
+
+    if (poll(vpollfds.data(), vpollfds.size(), SELECT_TIMEOUT_MILLISECONDS) < 0)
+        return;
+
+    if (interruptNet)
+        return;
+
+    for (const struct pollfd& pollfd_entry : vpollfds) {
+        if (pollfd_entry.revents & POLLIN)
+            recv_set.insert(pollfd_entry.fd);
+        if (pollfd_entry.revents & POLLOUT)
+            send_set.insert(pollfd_entry.fd);
+        if (pollfd_entry.revents & (POLLERR | POLLHUP))
+            error_set.insert(pollfd_entry.fd);
+    }
+}
+#else
+void CConnman::SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    if (!GenerateSelectSet(recv_select_set, send_select_set, error_select_set)) {
+        interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        return;
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = SELECT_TIMEOUT_MILLISECONDS * 1000; // frequency to poll pnode->vSend
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+
+    for (SOCKET hSocket : recv_select_set) {
+        FD_SET(hSocket, &fdsetRecv);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+
+    for (SOCKET hSocket : send_select_set) {
+        FD_SET(hSocket, &fdsetSend);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+
+    for (SOCKET hSocket : error_select_set) {
+        FD_SET(hSocket, &fdsetError);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+
+    int nSelect = select(hSocketMax + 1, &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+
+    if (interruptNet)
+        return;
+
+    if (nSelect == SOCKET_ERROR) {
+        int nErr = WSAGetLastError();
+        LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+        for (unsigned int i = 0; i <= hSocketMax; i++)
+            FD_SET(i, &fdsetRecv);
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        if (!interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS)))
+            return;
+    }
+
+    for (SOCKET hSocket : recv_select_set) {
+        if (FD_ISSET(hSocket, &fdsetRecv)) {
+            recv_set.insert(hSocket);
+        }
+    }
+
+    for (SOCKET hSocket : send_select_set) {
+        if (FD_ISSET(hSocket, &fdsetSend)) {
+            send_set.insert(hSocket);
+        }
+    }
+
+    for (SOCKET hSocket : error_select_set) {
+        if (FD_ISSET(hSocket, &fdsetError)) {
+            error_set.insert(hSocket);
+        }
+    }
+}
+#endif
+
 void CConnman::ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
@@ -1135,87 +1418,17 @@ void CConnman::ThreadSocketHandler()
         //
         // Find which sockets have data to receive
         //
-        struct timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        for (const ListenSocket& hListenSocket : vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
-        {
-            LOCK(cs_vNodes);
-            for (CNode* pnode : vNodes) {
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is space left in the receive buffer, select() for
-                //   receiving data.
-                // * Hand off all complete messages to the processor, to be handled without
-                //   blocking here.
-
-                bool select_recv = !pnode->fPauseRecv;
-                bool select_send;
-                {
-                    LOCK(pnode->cs_vSend);
-                    select_send = !pnode->vSendMsg.empty();
-                }
-
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
+        std::set<SOCKET> recv_set, send_set, error_set;
+        SocketEvents(recv_set, send_set, error_set);
 
-                if (select_send) {
-                    FD_SET(pnode->hSocket, &fdsetSend);
-                    continue;
-                }
-                if (select_recv) {
-                    FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
-
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
         if (interruptNet)
             return;
 
-        if (nSelect == SOCKET_ERROR) {
-            if (have_fds) {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            if (!interruptNet.sleep_for(std::chrono::milliseconds(timeout.tv_usec/1000)))
-                return;
-        }
-
         //
         // Accept new connections
         //
         for (const ListenSocket& hListenSocket : vhListenSocket) {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv)) {
+            if (hListenSocket.socket != INVALID_SOCKET && recv_set.count(hListenSocket.socket) > 0) {
                 AcceptConnection(hListenSocket);
             }
         }
@@ -1244,9 +1457,9 @@ void CConnman::ThreadSocketHandler()
                 LOCK(pnode->cs_hSocket);
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-                sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-                errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
+                recvSet = recv_set.count(pnode->hSocket) > 0;
+                sendSet = send_set.count(pnode->hSocket) > 0;
+                errorSet = error_set.count(pnode->hSocket) > 0;
             }
             if (recvSet || errorSet) {
                 {
@@ -1889,6 +2102,50 @@ void CConnman::ThreadMessageHandler()
     }
 }
 
+bool CConnman::PushTierTwoWork(TierTwoMessageClass cls, CNode* pnode, const std::function<void()>& work)
+{
+    TierTwoQueue& q = tierTwoQueues[cls];
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.queue.size() >= MAX_TIERTWO_MSG_QUEUE)
+            return false;
+        pnode->AddRef();
+        q.queue.push_back({pnode, work});
+    }
+    q.cond.notify_one();
+    return true;
+}
+
+bool CConnman::IsTierTwoQueueFull(TierTwoMessageClass cls)
+{
+    TierTwoQueue& q = tierTwoQueues[cls];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    return q.queue.size() >= MAX_TIERTWO_MSG_QUEUE;
+}
+
+void CConnman::ThreadTierTwoMessageHandler(TierTwoMessageClass cls)
+{
+    TierTwoQueue& q = tierTwoQueues[cls];
+    while (!flagInterruptMsgProc) {
+        TierTwoWork item;
+        {
+            std::unique_lock<std::mutex> lock(q.mutex);
+            q.cond.wait(lock, [this, &q] { return flagInterruptMsgProc || !q.queue.empty(); });
+            if (flagInterruptMsgProc)
+                return;
+            item = std::move(q.queue.front());
+            q.queue.pop_front();
+        }
+
+        // The messages of a disconnected peer are dropped, like on the message handler thread
+        if (!item.pnode->fDisconnect)
+            item.work();
+
+        LOCK(cs_vNodes);
+        item.pnode->Release();
+    }
+}
+
 bool CConnman::BindListenPort(const CService& addrBind, std::string& strError, bool fWhitelisted)
 {
     strError = "";
@@ -2124,6 +2381,25 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
         fMsgProcWake = false;
     }
 
+#ifdef USE_EPOLL
+    // The listening sockets are registered once; the sockets of the nodes are
+    // registered by the socket handler.
+    if (epollfd == -1) {
+        epollfd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollfd == -1) {
+            LogPrintf("epoll_create1 failed: %s, using poll() instead\n", NetworkErrorString(WSAGetLastError()));
+        } else {
+            for (const ListenSocket& hListenSocket : vhListenSocket) {
+                struct epoll_event event = {};
+                event.events = EPOLLIN;
+                event.data.fd = hListenSocket.socket;
+                if (epoll_ctl(epollfd, EPOLL_CTL_ADD, hListenSocket.socket, &event) == SOCKET_ERROR)
+                    LogPrintf("epoll_ctl failed for a listening socket: %s\n", NetworkErrorString(WSAGetLastError()));
+            }
+        }
+    }
+#endif
+
     // Send and receive from sockets, accept connections
     threadSocketHandler = std::thread(&TraceThread<std::function<void()> >, "net", std::function<void()>(std::bind(&CConnman::ThreadSocketHandler, this)));
 
@@ -2142,6 +2418,10 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
     // Process messages
     threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
 
+    // Process the masternode and budget messages, each class on its own thread
+    tierTwoQueues[TIERTWO_MSG_MASTERNODES].thread = std::thread(&TraceThread<std::function<void()> >, "mnmsg", std::function<void()>(std::bind(&CConnman::ThreadTierTwoMessageHandler, this, TIERTWO_MSG_MASTERNODES)));
+    tierTwoQueues[TIERTWO_MSG_BUDGET].thread = std::thread(&TraceThread<std::function<void()> >, "budgetmsg", std::function<void()>(std::bind(&CConnman::ThreadTierTwoMessageHandler, this, TIERTWO_MSG_BUDGET)));
+
     // Dump network addresses
     scheduler.scheduleEvery(std::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL * 1000);
 
@@ -2178,6 +2458,12 @@ void CConnman::Interrupt()
         flagInterruptMsgProc = true;
     }
     condMsgProc.notify_all();
+    for (TierTwoQueue& q : tierTwoQueues) {
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+        }
+        q.cond.notify_all();
+    }
 
     interruptNet();
     InterruptSocks5(true);
@@ -2191,6 +2477,14 @@ void CConnman::Stop()
 {
     if (threadMessageHandler.joinable())
         threadMessageHandler.join();
+    for (TierTwoQueue& q : tierTwoQueues) {
+        if (q.thread.joinable())
+            q.thread.join();
+        // Drop the messages that were never processed, and their references to the nodes
+        for (TierTwoWork& item : q.queue)
+            item.pnode->Release();
+        q.queue.clear();
+    }
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
@@ -2224,6 +2518,12 @@ void CConnman::Stop()
     vNodes.clear();
     vNodesDisconnected.clear();
     vhListenSocket.clear();
+#ifdef USE_EPOLL
+    if (epollfd != -1) {
+        close(epollfd);
+        epollfd = -1;
+    }
+#endif
     delete semOutbound;
     semOutbound = NULL;
     if(pnodeLocalHost)
@@ -2509,19 +2809,45 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
     return pnode && pnode->fSuccessfullyConnected && !pnode->fDisconnect;
 }
 
-void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
+static std::vector<unsigned char> SerializeMessageHeader(const std::string& command, const std::vector<unsigned char>& data)
 {
-    size_t nMessageSize = msg.data.size();
-    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
-    LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->id);
-
     std::vector<unsigned char> serializedHeader;
     serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
-    uint256 hash = Hash(msg.data.data(), msg.data.data() + nMessageSize);
-    CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), nMessageSize);
+    uint256 hash = Hash(data.data(), data.data() + data.size());
+    CMessageHeader hdr(Params().MessageStart(), command.c_str(), data.size());
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
     CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, serializedHeader, 0, hdr};
+    return serializedHeader;
+}
+
+CSerializedNetMsg CSerializedNetMsg::Copy()
+{
+    if (!sharedData) {
+        sharedHeader = std::make_shared<const std::vector<unsigned char>>(SerializeMessageHeader(command, data));
+        sharedData = std::make_shared<const std::vector<unsigned char>>(std::move(data));
+        data.clear();
+    }
+    CSerializedNetMsg msg;
+    msg.command = command;
+    msg.sharedHeader = sharedHeader;
+    msg.sharedData = sharedData;
+    return msg;
+}
+
+void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
+{
+    size_t nMessageSize = msg.sharedData ? msg.sharedData->size() : msg.data.size();
+    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
+    LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->id);
+
+    // The buffers of a shared message are queued as they are, without copying them
+    CSendBufferRef serializedHeader = msg.sharedHeader;
+    if (!serializedHeader)
+        serializedHeader = std::make_shared<const std::vector<unsigned char>>(SerializeMessageHeader(msg.command, msg.data));
+    CSendBufferRef payload = std::move(msg.sharedData);
+    if (!payload && nMessageSize)
+        payload = std::make_shared<const std::vector<unsigned char>>(std::move(msg.data));
 
     size_t nBytesSent = 0;
     {
@@ -2536,7 +2862,7 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
             pnode->fPauseSend = true;
         pnode->vSendMsg.push_back(std::move(serializedHeader));
         if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
+            pnode->vSendMsg.push_back(std::move(payload));
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend == true)
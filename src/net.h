@@ -26,6 +26,7 @@
 
 #include <atomic>
 #include <deque>
+#include <set>
 #include <stdint.h>
 #include <thread>
 #include <memory>
@@ -77,6 +78,15 @@ static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 125;
 /** Maximum number of peers added to setOffsetDisconnectedPeers before triggering a warning */
 #define MAX_TIMEOFFSET_DISCONNECTIONS 16
 
+/** The tier-two messages processed on their own thread, each class serially */
+enum TierTwoMessageClass {
+    TIERTWO_MSG_MASTERNODES,    // masternode broadcasts, pings and payment votes
+    TIERTWO_MSG_BUDGET,         // budget proposals, finalized budgets and their votes
+    TIERTWO_MSG_CLASSES
+};
+/** Maximum number of messages waiting to be processed, per class */
+static const size_t MAX_TIERTWO_MSG_QUEUE = 10000;
+
 static const ServiceFlags REQUIRED_SERVICES = NODE_NETWORK;
 
 static const bool DEFAULT_FORCEDNSSEED = false;
@@ -107,6 +117,9 @@ class CTransaction;
 class CNodeStats;
 class CClientUIInterface;
 
+/** A buffer of the send queue of a peer, which may be shared with the queues of other peers */
+typedef std::shared_ptr<const std::vector<unsigned char>> CSendBufferRef;
+
 struct CSerializedNetMsg
 {
     CSerializedNetMsg() = default;
@@ -116,8 +129,19 @@ struct CSerializedNetMsg
     CSerializedNetMsg(const CSerializedNetMsg& msg) = delete;
     CSerializedNetMsg& operator=(const CSerializedNetMsg&) = delete;
 
+    /**
+     * A message with the same command and payload, to send the same message to
+     * several peers. The first call moves data, with its header, to buffers
+     * shared by this message and all its copies: the payload is neither copied
+     * nor hashed again when they are pushed.
+     */
+    CSerializedNetMsg Copy();
+
     std::vector<unsigned char> data;
     std::string command;
+    // Set by Copy(): the serialized header and payload, data is empty then
+    CSendBufferRef sharedHeader;
+    CSendBufferRef sharedData;
 };
 
 
@@ -157,6 +181,12 @@ public:
 
     void PushMessage(CNode* pnode, CSerializedNetMsg&& msg);
 
+    /** Queue the processing of a tier-two message of pnode on the thread of its class.
+     *  Returns false, without queuing it, if too many messages of that class are waiting. */
+    bool PushTierTwoWork(TierTwoMessageClass cls, CNode* pnode, const std::function<void()>& work);
+    /** Whether too many tier-two messages of that class are waiting to be processed. */
+    bool IsTierTwoQueueFull(TierTwoMessageClass cls);
+
     template<typename Callable>
     bool ForEachNodeContinueIf(Callable&& func)
     {
@@ -288,7 +318,13 @@ private:
     void ProcessOneShot();
     void ThreadOpenConnections();
     void ThreadMessageHandler();
+    void ThreadTierTwoMessageHandler(TierTwoMessageClass cls);
     void AcceptConnection(const ListenSocket& hListenSocket);
+    bool GenerateSelectSet(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    void SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+#ifdef USE_EPOLL
+    void SocketEventsEpoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+#endif
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
 
@@ -309,7 +345,11 @@ private:
 
     NodeId GetNewNodeId();
 
+protected:
+    /** Send as much of the queued messages of a node as its socket takes. Requires pnode->cs_vSend. */
     size_t SocketSendData(CNode *pnode);
+
+private:
     //!check is the banlist has unwritten changes
     bool BannedSetIsDirty();
     //!set the "dirty" flag for the banlist
@@ -342,6 +382,10 @@ private:
     unsigned int nReceiveFloodSize{0};
 
     std::vector<ListenSocket> vhListenSocket;
+#ifdef USE_EPOLL
+    //! epoll instance of the socket handler, or -1 to use poll()
+    int epollfd{-1};
+#endif
     banmap_t setBanned;
     RecursiveMutex cs_setBanned;
     bool setBannedIsDirty{false};
@@ -379,6 +423,18 @@ private:
     std::mutex mutexMsgProc;
     std::atomic<bool> flagInterruptMsgProc;
 
+    struct TierTwoWork {
+        CNode* pnode;
+        std::function<void()> work;
+    };
+    struct TierTwoQueue {
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::deque<TierTwoWork> queue;
+        std::thread thread;
+    };
+    TierTwoQueue tierTwoQueues[TIERTWO_MSG_CLASSES];
+
     CThreadInterrupt interruptNet;
 
     std::thread threadDNSAddressSeed;
@@ -545,7 +601,7 @@ public:
     size_t nSendSize;   // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<std::vector<unsigned char>> vSendMsg;
+    std::deque<CSendBufferRef> vSendMsg;
     RecursiveMutex cs_vSend;
     RecursiveMutex cs_hSocket;
     RecursiveMutex cs_vRecv;
@@ -594,10 +650,15 @@ public:
     const uint64_t nKeyedNetGroup;
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+#ifdef USE_EPOLL
+    //! Events the socket is registered for in the epoll instance, 0 if it isn't (only used by the socket handler)
+    uint32_t nEpollEvents{0};
+#endif
 protected:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
 
+    RecursiveMutex cs_vecRequestsFulfilled; // the tier-two requests are processed on several threads
     std::vector<std::string> vecRequestsFulfilled; //keep track of what client has asked for
 
 public:
@@ -768,6 +829,7 @@ public:
 
     bool HasFulfilledRequest(std::string strRequest)
     {
+        LOCK(cs_vecRequestsFulfilled);
         for (std::string& type : vecRequestsFulfilled) {
             if (type == strRequest) return true;
         }
@@ -776,6 +838,7 @@ public:
 
     void ClearFulfilledRequest(std::string strRequest)
     {
+        LOCK(cs_vecRequestsFulfilled);
         std::vector<std::string>::iterator it = vecRequestsFulfilled.begin();
         while (it != vecRequestsFulfilled.end()) {
             if ((*it) == strRequest) {
@@ -788,6 +851,7 @@ public:
 
     void FulfilledRequest(std::string strRequest)
     {
+        LOCK(cs_vecRequestsFulfilled);
         if (HasFulfilledRequest(strRequest)) return;
         vecRequestsFulfilled.push_back(strRequest);
     }
@@ -7,6 +7,7 @@
 
 #include "net_processing.h"
 
+#include "blockencodings.h"
 #include "budget/budgetmanager.h"
 #include "chain.h"
 #include "masternodeman.h"
@@ -15,6 +16,7 @@
 #include "merkleblock.h"
 #include "netbase.h"
 #include "netmessagemaker.h"
+#include "pow.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "sporkdb.h"
@@ -45,6 +47,9 @@ int nSyncStarted = 0;
  */
 std::map<uint256, NodeId> mapBlockSource;
 
+/** Peers we asked to announce new blocks as compact blocks, oldest first. Protected by cs_main. */
+std::list<NodeId> lNodesAnnouncingHeaderAndIDs;
+
 /**
  * Filter for transactions that were recently rejected by
  * AcceptToMemoryPool. These are not rerequested until the chain tip
@@ -84,6 +89,43 @@ int nQueuedValidatedHeaders = 0;
 /** Number of preferable block download peers. */
 int nPreferredDownload = 0;
 
+/**
+ * Blocks downloaded before their parent, keyed by the hash of the parent. Proof-of-stake
+ * blocks can only be validated on top of their parent, so the blocks downloaded in
+ * parallel are processed in chain order. Protected by cs_main.
+ */
+struct PendingBlock {
+    std::shared_ptr<const CBlock> block;
+    NodeId fromPeer;
+    int64_t nTimeReceived;
+};
+std::multimap<uint256, PendingBlock> mapBlocksPendingParent;
+std::set<uint256> setBlocksPendingParent;
+
+/**
+ * Blocks with pending children connected outside of the block download (submitblock, import).
+ * Protected by cs_main; the flag lets the message handler check for them without taking it.
+ */
+std::vector<uint256> vPendingParentsConnected;
+std::atomic<bool> fPendingParentsConnected{false};
+
+/** Time of the next removal of the blocks waiting too long for their parent. */
+std::atomic<int64_t> nNextPendingBlocksExpiry{0};
+
+/** Drop the pending blocks matching a predicate, so they are downloaded again. Requires cs_main. */
+template <typename Predicate>
+void EraseBlocksPendingParent(Predicate pred)
+{
+    for (auto it = mapBlocksPendingParent.begin(); it != mapBlocksPendingParent.end();) {
+        if (pred(it->second)) {
+            setBlocksPendingParent.erase(it->second.block->GetHash());
+            it = mapBlocksPendingParent.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 } // anon namespace
 
 
@@ -204,12 +246,22 @@ struct CNodeState {
     const CBlockIndex* pindexLastCommonBlock;
     //! Whether we've started headers synchronization with this peer.
     bool fSyncStarted;
+    //! Number of headers messages from this peer that didn't connect to our block index.
+    int nUnconnectingHeaders;
+    //! Whether the headers of this peer went too far ahead of the active chain, to be asked again later.
+    bool fHeadersAhead;
     //! Since when we're stalling block download progress (in microseconds), or 0.
     int64_t nStallingSince;
     std::list<QueuedBlock> vBlocksInFlight;
     int nBlocksInFlight;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
+    //! Whether this peer wants new blocks announced as compact blocks rather than invs.
+    bool fPreferHeaderAndIDs;
+    //! Whether this peer can send us compact blocks.
+    bool fProvidesHeaderAndIDs;
+    //! The compact block of this peer waiting for the missing transactions (blocktxn), if any.
+    std::unique_ptr<PartiallyDownloadedBlock> partialBlock;
 
     CNodeBlocks nodeBlocks;
 
@@ -221,9 +273,13 @@ struct CNodeState {
         hashLastUnknownBlock.SetNull();
         pindexLastCommonBlock = NULL;
         fSyncStarted = false;
+        nUnconnectingHeaders = 0;
+        fHeadersAhead = false;
         nStallingSince = 0;
         nBlocksInFlight = 0;
         fPreferredDownload = false;
+        fPreferHeaderAndIDs = false;
+        fProvidesHeaderAndIDs = false;
     }
 };
 
@@ -294,9 +350,12 @@ void FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTime)
         fUpdateConnectionTime = true;
     }
 
-    for (const QueuedBlock& entry : state->vBlocksInFlight)
+    for (const QueuedBlock& entry : state->vBlocksInFlight) {
+        nQueuedValidatedHeaders -= entry.fValidatedHeaders;
         mapBlocksInFlight.erase(entry.hash);
+    }
     EraseOrphansFor(nodeid);
+    EraseBlocksPendingParent([nodeid](const PendingBlock& pending) { return pending.fromPeer == nodeid; });
     nPreferredDownload -= state->fPreferredDownload;
 
     mapNodeState.erase(nodeid);
@@ -367,6 +426,35 @@ void UpdateBlockAvailability(NodeId nodeid, const uint256& hash)
     }
 }
 
+/** Ask a peer which just gave us a new tip to announce its next blocks as compact blocks, as we
+ *  would have to fetch them anyway. Only the last three such peers are kept. Requires cs_main. */
+void MaybeSetPeerAsAnnouncingHeaderAndIDs(CNode* pfrom, CConnman& connman)
+{
+    const CNodeState* nodestate = State(pfrom->GetId());
+    if (!nodestate || !nodestate->fProvidesHeaderAndIDs)
+        return;
+
+    for (std::list<NodeId>::iterator it = lNodesAnnouncingHeaderAndIDs.begin(); it != lNodesAnnouncingHeaderAndIDs.end(); it++) {
+        if (*it == pfrom->GetId()) {
+            lNodesAnnouncingHeaderAndIDs.erase(it);
+            lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
+            return;
+        }
+    }
+    bool fAnnounceUsingCMPCTBLOCK = false;
+    uint64_t nCMPCTBLOCKVersion = 1;
+    if (lNodesAnnouncingHeaderAndIDs.size() >= 3) {
+        connman.ForNode(lNodesAnnouncingHeaderAndIDs.front(), [&connman, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion](CNode* pnodeStop) {
+            connman.PushMessage(pnodeStop, CNetMsgMaker(pnodeStop->GetSendVersion()).Make(NetMsgType::SENDCMPCT, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion));
+            return true;
+        });
+        lNodesAnnouncingHeaderAndIDs.pop_front();
+    }
+    fAnnounceUsingCMPCTBLOCK = true;
+    connman.PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::SENDCMPCT, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion));
+    lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
+}
+
 /** Update pindexLastCommonBlock and add not-in-flight missing successors to vBlocks, until it has
  *  at most count entries. */
 void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller)
@@ -429,6 +517,9 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
             if (pindex->nStatus & BLOCK_HAVE_DATA) {
                 if (pindex->nChainTx)
                     state->pindexLastCommonBlock = pindex;
+            } else if (setBlocksPendingParent.count(pindex->GetBlockHash())) {
+                // The block is downloaded, and waits for its parent.
+                continue;
             } else if (mapBlocksInFlight.count(pindex->GetBlockHash()) == 0) {
                 // The block is not already downloaded, and not yet in flight.
                 if (pindex->nHeight > nWindowEnd) {
@@ -594,11 +685,44 @@ void Misbehaving(NodeId pnode, int howmuch) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 // blockchain -> download logic notification
 //
 
+//! The instance receiving the validation callbacks, which also keeps the state shared by the peers
+static PeerLogicValidation* pPeerLogic = nullptr;
+
 PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn) :
         connman(connmanIn)
 {
     // Initialize global variables that cannot be constructed at startup.
     recentRejects.reset(new CRollingBloomFilter(120000, 0.000001));
+    pPeerLogic = this;
+}
+
+PeerLogicValidation::~PeerLogicValidation()
+{
+    // The message handler is stopped: drop the buffer of the last block sent
+    LOCK(cs_main);
+    if (pPeerLogic == this)
+        pPeerLogic = nullptr;
+}
+
+/** Read a block from disk into a block message. The bytes on disk are the network serialization
+ *  of the block: they are sent as they are, without deserializing the block. */
+static CSerializedNetMsg ReadBlockMessage(const CBlockIndex* pindex)
+{
+    CSerializedNetMsg msg;
+    msg.command = NetMsgType::BLOCK;
+    if (!ReadRawBlockFromDisk(msg.data, pindex))
+        assert(!"cannot load block from disk");
+    return msg;
+}
+
+CSerializedNetMsg PeerLogicValidation::MakeBlockMessage(const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    if (hashLastBlockSent != pindex->GetBlockHash() || msgLastBlockSent.command.empty()) {
+        msgLastBlockSent = ReadBlockMessage(pindex);
+        hashLastBlockSent = pindex->GetBlockHash();
+    }
+    return msgLastBlockSent.Copy();
 }
 
 void PeerLogicValidation::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
@@ -608,10 +732,30 @@ void PeerLogicValidation::UpdatedBlockTip(const CBlockIndex* pindexNew, const CB
 
     if (!fInitialDownload) {
         const uint256& hashNewTip = pindexNew->GetBlockHash();
+        // A new tip extending the previous one is pushed as a compact block to the peers
+        // which asked for it, which saves them the inv/getdata round-trip.
+        // The message is serialized once, its serialization doesn't depend on the version of the peer.
+        std::set<NodeId> setCmpctPeers;
+        CSerializedNetMsg msgCmpctBlock;
+        if (pindexNew->pprev == pindexFork) {
+            LOCK(cs_main);
+            for (const auto& it : mapNodeState) {
+                if (it.second.fPreferHeaderAndIDs)
+                    setCmpctPeers.insert(it.first);
+            }
+            CBlock block;
+            if (!setCmpctPeers.empty() && ReadBlockFromDisk(block, pindexNew))
+                msgCmpctBlock = CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::CMPCTBLOCK, CBlockHeaderAndShortTxIDs(block));
+        }
         // Relay inventory, but don't relay old inventory during initial block download.
-        connman->ForEachNode([nNewHeight, hashNewTip](CNode* pnode) {
+        connman->ForEachNode([this, nNewHeight, hashNewTip, &setCmpctPeers, &msgCmpctBlock](CNode* pnode) {
             if (nNewHeight > (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : 0)) {
-                pnode->PushInventory(CInv(MSG_BLOCK, hashNewTip));
+                if (!msgCmpctBlock.command.empty() && setCmpctPeers.count(pnode->GetId())) {
+                    pnode->AddInventoryKnown(CInv(MSG_BLOCK, hashNewTip));
+                    connman->PushMessage(pnode, msgCmpctBlock.Copy());
+                } else {
+                    pnode->PushInventory(CInv(MSG_BLOCK, hashNewTip));
+                }
             }
         });
     }
@@ -619,6 +763,18 @@ void PeerLogicValidation::UpdatedBlockTip(const CBlockIndex* pindexNew, const CB
     nTimeBestReceived = GetTime();
 }
 
+void PeerLogicValidation::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted)
+{
+    // The blocks waiting for this one are processed by the message handler, validation
+    // can't be called from here.
+    LOCK(cs_main);
+    const uint256& hash = pindex->GetBlockHash();
+    if (mapBlocksPendingParent.count(hash)) {
+        vPendingParentsConnected.push_back(hash);
+        fPendingParentsConnected = true;
+    }
+}
+
 void PeerLogicValidation::BlockChecked(const CBlock& block, const CValidationState& state)
 {
     LOCK(cs_main);
@@ -680,7 +836,7 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
     case MSG_SPORK:
         return mapSporks.count(inv.hash);
     case MSG_MASTERNODE_WINNER:
-        if (masternodePayments.mapMasternodePayeeVotes.count(inv.hash)) {
+        if (WITH_LOCK(cs_mapMasternodePayeeVotes, return masternodePayments.mapMasternodePayeeVotes.count(inv.hash))) {
             masternodeSync.AddedMasternodeWinner(inv.hash);
             return true;
         }
@@ -710,13 +866,13 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
         }
         return false;
     case MSG_MASTERNODE_ANNOUNCE:
-        if (mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)) {
+        if (WITH_LOCK(mnodeman.cs_seen, return mnodeman.mapSeenMasternodeBroadcast.count(inv.hash))) {
             masternodeSync.AddedMasternodeList(inv.hash);
             return true;
         }
         return false;
     case MSG_MASTERNODE_PING:
-        return mnodeman.mapSeenMasternodePing.count(inv.hash);
+        return WITH_LOCK(mnodeman.cs_seen, return mnodeman.mapSeenMasternodePing.count(inv.hash));
     }
     // Don't know what it is, just say we already got one
     return true;
@@ -774,10 +930,16 @@ bool static PushTierTwoGetDataRequest(const CInv& inv,
     }
 
     if (inv.type == MSG_MASTERNODE_WINNER) {
-        if (masternodePayments.mapMasternodePayeeVotes.count(inv.hash)) {
-            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-            ss.reserve(1000);
-            ss << masternodePayments.mapMasternodePayeeVotes[inv.hash];
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        {
+            LOCK(cs_mapMasternodePayeeVotes);
+            auto it = masternodePayments.mapMasternodePayeeVotes.find(inv.hash);
+            if (it != masternodePayments.mapMasternodePayeeVotes.end()) {
+                ss.reserve(1000);
+                ss << it->second;
+            }
+        }
+        if (!ss.empty()) {
             connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNWINNER, ss));
             return true;
         }
@@ -812,20 +974,32 @@ bool static PushTierTwoGetDataRequest(const CInv& inv,
     }
 
     if (inv.type == MSG_MASTERNODE_ANNOUNCE) {
-        if (mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)) {
-            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-            ss.reserve(1000);
-            ss << mnodeman.mapSeenMasternodeBroadcast[inv.hash];
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        {
+            LOCK(mnodeman.cs_seen);
+            auto it = mnodeman.mapSeenMasternodeBroadcast.find(inv.hash);
+            if (it != mnodeman.mapSeenMasternodeBroadcast.end()) {
+                ss.reserve(1000);
+                ss << it->second;
+            }
+        }
+        if (!ss.empty()) {
             connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNBROADCAST, ss));
             return true;
         }
     }
 
     if (inv.type == MSG_MASTERNODE_PING) {
-        if (mnodeman.mapSeenMasternodePing.count(inv.hash)) {
-            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-            ss.reserve(1000);
-            ss << mnodeman.mapSeenMasternodePing[inv.hash];
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        {
+            LOCK(mnodeman.cs_seen);
+            auto it = mnodeman.mapSeenMasternodePing.find(inv.hash);
+            if (it != mnodeman.mapSeenMasternodePing.end()) {
+                ss.reserve(1000);
+                ss << it->second;
+            }
+        }
+        if (!ss.empty()) {
             connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNPING, ss));
             return true;
         }
@@ -858,14 +1032,24 @@ void static ProcessGetBlockData(CNode* pfrom, const CInv& inv, CConnman& connman
     }
     // Don't send not-validated blocks
     if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
+        // A compact block is only sent for a recent block, the peer is unlikely to
+        // have the transactions of an older one: it gets the full block instead.
+        const bool fSendCompact = inv.type == MSG_CMPCT_BLOCK &&
+                                  mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH;
         // Send block from disk
-        CBlock block;
-        if (!ReadBlockFromDisk(block, (*mi).second))
-            assert(!"cannot load block from disk");
-        if (inv.type == MSG_BLOCK)
-            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
-        else // MSG_FILTERED_BLOCK)
+        if (inv.type == MSG_BLOCK || (inv.type == MSG_CMPCT_BLOCK && !fSendCompact)) {
+            connman.PushMessage(pfrom, pPeerLogic ? pPeerLogic->MakeBlockMessage(mi->second) : ReadBlockMessage(mi->second));
+        } else if (inv.type == MSG_CMPCT_BLOCK) {
+            CBlock block;
+            if (!ReadBlockFromDisk(block, (*mi).second))
+                assert(!"cannot load block from disk");
+            CBlockHeaderAndShortTxIDs cmpctblock(block);
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CMPCTBLOCK, cmpctblock));
+        } else // MSG_FILTERED_BLOCK)
         {
+            CBlock block;
+            if (!ReadBlockFromDisk(block, (*mi).second))
+                assert(!"cannot load block from disk");
             bool send_ = false;
             CMerkleBlock merkleBlock;
             {
@@ -965,7 +1149,7 @@ void static ProcessGetData(CNode* pfrom, CConnman& connman, const std::atomic<bo
     if (it != pfrom->vRecvGetData.end()) {
         const CInv &inv = *it;
         it++;
-        if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK) {
+        if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK) {
             ProcessGetBlockData(pfrom, inv, connman, interruptMsgProc);
         }
     }
@@ -1018,7 +1202,234 @@ static void CheckBlockSpam(CValidationState& state, CNode* pfrom, const uint256&
     }
 }
 
+/** Ask a peer for the blocks between our tip and a block it sent us, whose parent we don't know. */
+static void RequestBlockParents(CNode* pfrom, const CBlockHeader& header, CConnman& connman)
+{
+    const uint256& hashBlock = header.GetHash();
+    CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    if (pfrom->nVersion >= HEADERS_SYNC_VERSION) {
+        // Fetch the missing headers: the block download logic then fetches the blocks
+        CBlockLocator locator = WITH_LOCK(cs_main, return chainActive.GetLocator(pindexBestHeader););
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, locator, hashBlock));
+        return;
+    }
+    CBlockLocator locator = WITH_LOCK(cs_main, return chainActive.GetLocator(););
+    if (find(pfrom->vBlockRequested.begin(), pfrom->vBlockRequested.end(), hashBlock) != pfrom->vBlockRequested.end()) {
+        // we already asked for this block, so lets work backwards and ask for the previous block
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETBLOCKS, locator, header.hashPrevBlock));
+        pfrom->vBlockRequested.emplace_back(header.hashPrevBlock);
+    } else {
+        // ask to sync to this block
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETBLOCKS, locator, hashBlock));
+        pfrom->vBlockRequested.emplace_back(hashBlock);
+    }
+}
+
+/** Whether the block is stored on disk (its header may be known without it). Requires cs_main. */
+static bool HaveBlockData(const uint256& hash)
+{
+    BlockMap::const_iterator mi = mapBlockIndex.find(hash);
+    return mi != mapBlockIndex.end() && (mi->second->nStatus & BLOCK_HAVE_DATA);
+}
+
+/**
+ * Keep a block whose parent header is known, but not the parent block, until the parent is
+ * processed. Past the download window the block is dropped, to be downloaded again later.
+ * Requires cs_main.
+ */
+static bool HoldBlockForParent(const std::shared_ptr<const CBlock>& pblock, NodeId nodeid)
+{
+    BlockMap::const_iterator mi = mapBlockIndex.find(pblock->hashPrevBlock);
+    if (mi == mapBlockIndex.end() || (mi->second->nStatus & (BLOCK_HAVE_DATA | BLOCK_FAILED_MASK)))
+        return false;
+
+    const uint256& hash = pblock->GetHash();
+    MarkBlockAsReceived(hash);
+    if (setBlocksPendingParent.size() < BLOCK_DOWNLOAD_WINDOW && setBlocksPendingParent.insert(hash).second) {
+        mapBlocksPendingParent.emplace(pblock->hashPrevBlock, PendingBlock{pblock, nodeid, GetTime()});
+        LogPrint(BCLog::NET, "%s: block %s waits for its parent %s, peer=%d\n", __func__, hash.ToString(),
+                 pblock->hashPrevBlock.ToString(), nodeid);
+    }
+    return true;
+}
+
+/**
+ * Process the blocks that were waiting for the block just processed, and their own
+ * descendants. The descendants of a block that couldn't be stored are dropped.
+ */
+static void ProcessBlocksPendingParent(const uint256& hashParent)
+{
+    AssertLockNotHeld(cs_main);
+    std::deque<uint256> vParents(1, hashParent);
+    while (!vParents.empty()) {
+        const uint256 hashPrev = vParents.front();
+        vParents.pop_front();
+
+        std::vector<PendingBlock> vChildren;
+        bool fHaveParent;
+        {
+            LOCK(cs_main);
+            auto range = mapBlocksPendingParent.equal_range(hashPrev);
+            for (auto it = range.first; it != range.second; ++it) {
+                setBlocksPendingParent.erase(it->second.block->GetHash());
+                vChildren.emplace_back(std::move(it->second));
+            }
+            mapBlocksPendingParent.erase(range.first, range.second);
+            fHaveParent = HaveBlockData(hashPrev);
+        }
+
+        for (const PendingBlock& pending : vChildren) {
+            const uint256& hash = pending.block->GetHash();
+            vParents.push_back(hash);
+            if (!fHaveParent)
+                continue;
+            WITH_LOCK(cs_main, mapBlockSource.emplace(hash, pending.fromPeer); );
+            CValidationState state;
+            ProcessNewBlock(state, nullptr, pending.block, nullptr);
+            int nDoS;
+            if (state.IsInvalid(nDoS) && nDoS > 0) {
+                LOCK(cs_main);
+                Misbehaving(pending.fromPeer, nDoS);
+            }
+        }
+    }
+}
+
+/**
+ * Process the blocks waiting for a parent connected outside of the block download, and drop
+ * the ones waiting for too long: their parent may never come from this peer.
+ */
+static void UpdateBlocksPendingParent()
+{
+    const int64_t nNow = GetTime();
+    if (!fPendingParentsConnected && nNow < nNextPendingBlocksExpiry)
+        return;
+
+    std::vector<uint256> vParents;
+    {
+        LOCK(cs_main);
+        fPendingParentsConnected = false;
+        vParents.swap(vPendingParentsConnected);
+        if (nNow >= nNextPendingBlocksExpiry) {
+            nNextPendingBlocksExpiry = nNow + PENDING_BLOCK_EXPIRE_INTERVAL;
+            EraseBlocksPendingParent([nNow](const PendingBlock& pending) {
+                return pending.nTimeReceived + PENDING_BLOCK_EXPIRE_TIME < nNow;
+            });
+        }
+    }
+    for (const uint256& hash : vParents)
+        ProcessBlocksPendingParent(hash);
+}
+
+/** Process a block received from a peer, in full or reconstructed from a compact block. */
+static void ProcessReceivedBlock(CNode* pfrom, const std::shared_ptr<CBlock>& pblock, CConnman& connman)
+{
+    const uint256& hashBlock = pblock->GetHash();
+    CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    pfrom->AddInventoryKnown(CInv(MSG_BLOCK, hashBlock));
+    CValidationState state;
+    bool fHaveBlock;
+    {
+        LOCK(cs_main);
+        fHaveBlock = HaveBlockData(hashBlock);
+        if (!fHaveBlock && HoldBlockForParent(pblock, pfrom->GetId()))
+            return;
+    }
+    if (!fHaveBlock) {
+        WITH_LOCK(cs_main, MarkBlockAsReceived(hashBlock); );
+        bool fAccepted = true;
+        ProcessNewBlock(state, pfrom, pblock, nullptr, &fAccepted);
+        if (!fAccepted) {
+            CheckBlockSpam(state, pfrom, hashBlock);
+        }
+        {
+            LOCK(cs_main);
+            mapBlockSource.emplace(hashBlock, pfrom->GetId());
+            // The peer gave us our new tip: have it announce the next ones as compact blocks
+            if (fAccepted && chainActive.Tip()->GetBlockHash() == hashBlock && !IsInitialBlockDownload())
+                MaybeSetPeerAsAnnouncingHeaderAndIDs(pfrom, connman);
+        }
+        int nDoS;
+        if(state.IsInvalid(nDoS)) {
+            assert (state.GetRejectCode() < REJECT_INTERNAL); // Blocks are never rejected with internal reject codes
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::REJECT, std::string(NetMsgType::BLOCK), state.GetRejectCode(),
+                state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), hashBlock));
+            if(nDoS > 0) {
+                TRY_LOCK(cs_main, lockMain);
+                if(lockMain) Misbehaving(pfrom->GetId(), nDoS);
+            }
+        }
+        //disconnect this node if its old protocol version
+        pfrom->DisconnectOldProtocol(pfrom->nVersion, ActiveProtocol(), NetMsgType::BLOCK);
+        ProcessBlocksPendingParent(hashBlock);
+    } else {
+        LogPrint(BCLog::NET, "%s : Already processed block %s, skipping ProcessNewBlock()\n", __func__, hashBlock.GetHex());
+    }
+}
+
+/** Ask a peer for a block in full, when it couldn't be reconstructed from its compact block. */
+static void RequestFullBlock(CNode* pfrom, const uint256& hashBlock, CConnman& connman)
+{
+    std::vector<CInv> vInv(1, CInv(MSG_BLOCK, hashBlock));
+    connman.PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::GETDATA, vInv));
+}
+
+/** Complete a compact block with the transactions the mempool didn't have. On failure, the
+ *  full block is requested, or the peer punished if it was invalid. Requires cs_main. */
+static bool FillCompactBlock(CNode* pfrom, PartiallyDownloadedBlock& partialBlock, const std::vector<CTransactionRef>& vtx_missing, CBlock& block, CConnman& connman)
+{
+    const uint256 hashBlock = partialBlock.header.GetHash();
+    ReadStatus status = partialBlock.FillBlock(block, vtx_missing);
+    if (status == READ_STATUS_INVALID) {
+        Misbehaving(pfrom->GetId(), 100);
+        LogPrintf("Peer %d sent us invalid compact block/non-matching block transactions\n", pfrom->GetId());
+        return false;
+    } else if (status == READ_STATUS_FAILED) {
+        // Might have collided, fall back to the full block
+        RequestFullBlock(pfrom, hashBlock, connman);
+        return false;
+    }
+    return true;
+}
+
 bool fRequestedSporksIDB = false;
+// The tier-two messages that are processed on their own thread, rather than on the message
+// handler one. The sync messages stay on the latter: they drive the state of masternodeSync.
+static bool GetTierTwoMessageClass(const std::string& strCommand, TierTwoMessageClass& cls)
+{
+    if (strCommand == NetMsgType::MNBROADCAST || strCommand == NetMsgType::MNPING ||
+            strCommand == NetMsgType::GETMNWINNERS || strCommand == NetMsgType::MNWINNER) {
+        cls = TIERTWO_MSG_MASTERNODES;
+        return true;
+    }
+    if (strCommand == NetMsgType::BUDGETVOTESYNC || strCommand == NetMsgType::BUDGETPROPOSAL ||
+            strCommand == NetMsgType::BUDGETVOTE || strCommand == NetMsgType::FINALBUDGET ||
+            strCommand == NetMsgType::FINALBUDGETVOTE) {
+        cls = TIERTWO_MSG_BUDGET;
+        return true;
+    }
+    return false;
+}
+
+static void ProcessTierTwoMessage(CNode* pfrom, std::string strCommand, CDataStream& vRecv, TierTwoMessageClass cls, CConnman& connman)
+{
+    try {
+        if (cls == TIERTWO_MSG_MASTERNODES) {
+            mnodeman.ProcessMessage(pfrom, strCommand, vRecv);
+            masternodePayments.ProcessMessageMasternodePayments(pfrom, strCommand, vRecv);
+        } else {
+            g_budgetman.ProcessMessage(pfrom, strCommand, vRecv);
+        }
+    } catch (const std::ios_base::failure& e) {
+        connman.PushMessage(pfrom, CNetMsgMaker(INIT_PROTO_VERSION).Make(NetMsgType::REJECT, strCommand, REJECT_MALFORMED, std::string("error parsing message")));
+        LogPrint(BCLog::NET, "%s(%s, peer=%d): Exception '%s' caught\n", __func__, SanitizeString(strCommand), pfrom->GetId(), e.what());
+    } catch (const std::exception& e) {
+        PrintExceptionContinue(&e, "ProcessTierTwoMessage()");
+    } catch (...) {
+        PrintExceptionContinue(NULL, "ProcessTierTwoMessage()");
+    }
+}
+
 bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vRecv, int64_t nTimeReceived, CConnman& connman, std::atomic<bool>& interruptMsgProc)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->id);
@@ -1212,6 +1623,14 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         LogPrintf("New outbound peer connected: version: %d, blocks=%d, peer=%d%s\n",
                   pfrom->nVersion.load(), pfrom->nStartingHeight, pfrom->GetId(),
                   (fLogIPs ? strprintf(", peeraddr=%s", pfrom->addr.ToString()) : ""));
+
+        if (pfrom->nVersion >= SHORT_IDS_BLOCKS_VERSION) {
+            // Tell our peer we can send compact blocks, but don't want
+            // new blocks announced that way until it gave us a new tip.
+            bool fAnnounceUsingCMPCTBLOCK = false;
+            uint64_t nCMPCTBLOCKVersion = 1;
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDCMPCT, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion));
+        }
     }
 
 
@@ -1271,6 +1690,11 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         LOCK(cs_main);
 
         std::vector<CInv> vToFetch;
+        // Once synced, new blocks are fetched as compact blocks from the peers which can send them
+        const bool fFetchCompact = State(pfrom->GetId())->fProvidesHeaderAndIDs && !IsInitialBlockDownload();
+        // While syncing, the headers are fetched first, and the blocks downloaded from all the peers
+        const bool fFetchHeaders = pfrom->nVersion >= HEADERS_SYNC_VERSION && IsInitialBlockDownload();
+        uint256 hashLastBlock;
 
         for (unsigned int nInv = 0; nInv < vInv.size(); nInv++) {
             const CInv& inv = vInv[nInv];
@@ -1296,14 +1720,25 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             if (inv.type == MSG_BLOCK) {
                 UpdateBlockAvailability(pfrom->GetId(), inv.hash);
                 if (!fAlreadyHave && !fImporting && !fReindex && !mapBlocksInFlight.count(inv.hash)) {
-                    // Add this to the list of blocks to request
-                    vToFetch.push_back(inv);
-                    LogPrint(BCLog::NET, "getblocks (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
+                    if (fFetchHeaders) {
+                        hashLastBlock = inv.hash;
+                    } else {
+                        // Add this to the list of blocks to request
+                        vToFetch.emplace_back(fFetchCompact ? MSG_CMPCT_BLOCK : MSG_BLOCK, inv.hash);
+                        // Only the peers we asked can send the compact block
+                        if (fFetchCompact)
+                            MarkBlockAsInFlight(pfrom->GetId(), inv.hash);
+                        LogPrint(BCLog::NET, "getblocks (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
+                    }
                 }
             }
 
         }
 
+        if (!hashLastBlock.IsNull()) {
+            LogPrint(BCLog::NET, "getheaders (%d) %s to peer=%d\n", pindexBestHeader->nHeight, hashLastBlock.ToString(), pfrom->id);
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), hashLastBlock));
+        }
         if (!vToFetch.empty())
             connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, vToFetch));
     }
@@ -1329,7 +1764,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
     }
 
 
-    else if (strCommand == NetMsgType::GETBLOCKS || strCommand == NetMsgType::GETHEADERS) {
+    else if (strCommand == NetMsgType::GETBLOCKS) {
         CBlockLocator locator;
         uint256 hashStop;
         vRecv >> locator >> hashStop;
@@ -1350,11 +1785,18 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             pindex = chainActive.Next(pindex);
         int nLimit = 500;
         LogPrint(BCLog::NET, "getblocks %d to %s limit %d from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.IsNull() ? "end" : hashStop.ToString(), nLimit, pfrom->id);
+        // If pruning, don't inv blocks unless we have on disk and are likely to still have
+        // for some reasonable time window (1 hour) that block relay might require.
+        const int nPrunedBlocksLikelyToHave = MIN_BLOCKS_TO_KEEP - 3600 / Params().GetConsensus().nTargetSpacing;
         for (; pindex; pindex = chainActive.Next(pindex)) {
             if (pindex->GetBlockHash() == hashStop) {
                 LogPrint(BCLog::NET, "  getblocks stopping at %d %s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
                 break;
             }
+            if (fPruneMode && (!(pindex->nStatus & BLOCK_HAVE_DATA) || pindex->nHeight <= chainActive.Tip()->nHeight - nPrunedBlocksLikelyToHave)) {
+                LogPrint(BCLog::NET, "  getblocks stopping, pruned or too old block at %d %s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
+                break;
+            }
             pfrom->PushInventory(CInv(MSG_BLOCK, pindex->GetBlockHash()));
             if (--nLimit <= 0) {
                 // When this block is requested, we'll send an inv that'll make them
@@ -1367,22 +1809,20 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
     }
 
 
-    else if (strCommand == NetMsgType::HEADERS && Params().HeadersFirstSyncingActive()) {
+    else if (strCommand == NetMsgType::GETHEADERS) {
         CBlockLocator locator;
         uint256 hashStop;
         vRecv >> locator >> hashStop;
 
         if (locator.vHave.size() > MAX_LOCATOR_SZ) {
-            LogPrint(BCLog::NET, "getblocks locator size %lld > %d, disconnect peer=%d\n", locator.vHave.size(), MAX_LOCATOR_SZ, pfrom->GetId());
+            LogPrint(BCLog::NET, "getheaders locator size %lld > %d, disconnect peer=%d\n", locator.vHave.size(), MAX_LOCATOR_SZ, pfrom->GetId());
             pfrom->fDisconnect = true;
             return true;
         }
 
+        // Served during initial block download too: the headers sent are the ones of the active chain
         LOCK(cs_main);
 
-        if (IsInitialBlockDownload())
-            return true;
-
         CBlockIndex* pindex = NULL;
         if (locator.IsNull()) {
             // If locator is null, return the hashStop block
@@ -1400,7 +1840,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
         std::vector<CBlock> vHeaders;
         int nLimit = MAX_HEADERS_RESULTS;
-        LogPrintf("getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.ToString(), pfrom->id);
+        LogPrint(BCLog::NET, "getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.ToString(), pfrom->id);
         for (; pindex; pindex = chainActive.Next(pindex)) {
             vHeaders.push_back(pindex->GetBlockHeader());
             if (--nLimit <= 0 || pindex->GetBlockHash() == hashStop)
@@ -1524,7 +1964,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         }
     }
 
-    else if (strCommand == NetMsgType::HEADERS && Params().HeadersFirstSyncingActive() && !fImporting && !fReindex) // Ignore headers received while importing
+    else if (strCommand == NetMsgType::HEADERS && !fImporting && !fReindex) // Ignore headers received while importing
     {
         std::vector<CBlockHeader> headers;
 
@@ -1536,47 +1976,66 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             return error("headers message size = %u", nCount);
         }
         headers.resize(nCount);
+        // Hash the headers together once read, which is faster for the legacy (Quark) ones
+        vRecv.SetType(vRecv.GetType() | SER_NOHASHCACHE);
         for (unsigned int n = 0; n < nCount; n++) {
             vRecv >> headers[n];
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
-
-        LOCK(cs_main);
+        vRecv.SetType(vRecv.GetType() & ~SER_NOHASHCACHE);
+        UpdateBlockHeaderHashCaches(headers);
 
         if (nCount == 0) {
             // Nothing interesting. Stop asking this peers for more headers.
             return true;
         }
-        CBlockIndex* pindexLast = NULL;
-        for (const CBlockHeader& header : headers) {
-            CValidationState state;
-            if (pindexLast != NULL && header.hashPrevBlock != pindexLast->GetBlockHash()) {
+
+        {
+            LOCK(cs_main);
+            CNodeState* nodestate = State(pfrom->GetId());
+            if (!mapBlockIndex.count(headers[0].hashPrevBlock)) {
+                // The peer is ahead of us, or on another chain: ask for the headers in between,
+                // but not indefinitely.
+                if (++nodestate->nUnconnectingHeaders % MAX_UNCONNECTING_HEADERS == 0)
+                    Misbehaving(pfrom->GetId(), 20);
+                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), UINT256_ZERO));
+                UpdateBlockAvailability(pfrom->GetId(), headers.back().GetHash());
+                return true;
+            }
+            nodestate->nUnconnectingHeaders = 0;
+        }
+
+        for (unsigned int n = 1; n < nCount; n++) {
+            if (headers[n].hashPrevBlock != headers[n - 1].GetHash()) {
+                LOCK(cs_main);
                 Misbehaving(pfrom->GetId(), 20);
                 return error("non-continuous headers sequence");
             }
+        }
 
-            /*TODO: this has a CBlock cast on it so that it will compile. There should be a solution for this
-             * before headers are reimplemented on mainnet
-             */
-            if (!AcceptBlockHeader((CBlock)header, state, &pindexLast)) {
-                int nDoS;
-                if (state.IsInvalid(nDoS)) {
-                    if (nDoS > 0)
-                        Misbehaving(pfrom->GetId(), nDoS);
-                    std::string strError = "invalid header received " + header.GetHash().ToString();
-                    return error(strError.c_str());
-                }
+        CValidationState state;
+        CBlockIndex* pindexLast = nullptr;
+        if (!ProcessNewBlockHeaders(headers, state, &pindexLast)) {
+            int nDoS;
+            if (state.IsInvalid(nDoS)) {
+                LOCK(cs_main);
+                if (nDoS > 0)
+                    Misbehaving(pfrom->GetId(), nDoS);
+                return error("invalid header received from peer=%d: %s", pfrom->id, FormatStateMessage(state));
             }
         }
 
+        LOCK(cs_main);
         if (pindexLast)
             UpdateBlockAvailability(pfrom->GetId(), pindexLast->GetBlockHash());
 
-        if (nCount == MAX_HEADERS_RESULTS && pindexLast) {
+        if (!pindexLast || pindexLast->GetBlockHash() != headers.back().GetHash()) {
+            // The headers went too far ahead of the active chain: they are asked again once
+            // the blocks are downloaded (see SendMessages).
+            State(pfrom->GetId())->fHeadersAhead = true;
+        } else if (nCount == MAX_HEADERS_RESULTS) {
             // Headers message had its maximum size; the peer may have more headers.
-            // TODO: optimize: if pindexLast is an ancestor of chainActive.Tip or pindexBestHeader, continue
-            // from there instead.
-            LogPrintf("more getheaders (%d) to end to peer=%d (startheight:%d)\n", pindexLast->nHeight, pfrom->id, pfrom->nStartingHeight);
+            LogPrint(BCLog::NET, "more getheaders (%d) to end to peer=%d (startheight:%d)\n", pindexLast->nHeight, pfrom->id, pfrom->nStartingHeight);
             connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexLast), UINT256_ZERO));
         }
     }
@@ -1585,49 +2044,170 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
     {
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
         vRecv >> *pblock;
-        const uint256& hashBlock = pblock->GetHash();
-        CInv inv(MSG_BLOCK, hashBlock);
-        LogPrint(BCLog::NET, "received block %s peer=%d\n", inv.hash.ToString(), pfrom->id);
+        LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->id);
 
         // sometimes we will be sent their most recent block and its not the one we want, in that case tell where we are
         if (!mapBlockIndex.count(pblock->hashPrevBlock)) {
-            CBlockLocator locator = WITH_LOCK(cs_main, return chainActive.GetLocator(););
-            if (find(pfrom->vBlockRequested.begin(), pfrom->vBlockRequested.end(), hashBlock) != pfrom->vBlockRequested.end()) {
-                // we already asked for this block, so lets work backwards and ask for the previous block
-                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETBLOCKS, locator, pblock->hashPrevBlock));
-                pfrom->vBlockRequested.emplace_back(pblock->hashPrevBlock);
-            } else {
-                // ask to sync to this block
-                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETBLOCKS, locator, hashBlock));
-                pfrom->vBlockRequested.emplace_back(hashBlock);
-            }
+            RequestBlockParents(pfrom, *pblock, connman);
         } else {
-            pfrom->AddInventoryKnown(inv);
-            CValidationState state;
-            if (!mapBlockIndex.count(hashBlock)) {
-                WITH_LOCK(cs_main, MarkBlockAsReceived(hashBlock); );
-                bool fAccepted = true;
-                ProcessNewBlock(state, pfrom, pblock, nullptr, &fAccepted);
-                if (!fAccepted) {
-                    CheckBlockSpam(state, pfrom, hashBlock);
+            ProcessReceivedBlock(pfrom, pblock, connman);
+        }
+    }
+
+
+    else if (strCommand == NetMsgType::SENDCMPCT) {
+        bool fAnnounceUsingCMPCTBLOCK = false;
+        uint64_t nCMPCTBLOCKVersion = 0;
+        vRecv >> fAnnounceUsingCMPCTBLOCK >> nCMPCTBLOCKVersion;
+        // Only version 1 (txid short ids) is known, others are ignored
+        if (nCMPCTBLOCKVersion == 1) {
+            LOCK(cs_main);
+            CNodeState* nodestate = State(pfrom->GetId());
+            nodestate->fProvidesHeaderAndIDs = true;
+            nodestate->fPreferHeaderAndIDs = fAnnounceUsingCMPCTBLOCK;
+        }
+    }
+
+
+    else if (strCommand == NetMsgType::CMPCTBLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+        const uint256& hashBlock = cmpctblock.header.GetHash();
+        LogPrint(BCLog::NET, "received cmpctblock %s peer=%d\n", hashBlock.ToString(), pfrom->id);
+
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        {
+            LOCK(cs_main);
+            if (HaveBlockData(hashBlock)) {
+                pfrom->AddInventoryKnown(CInv(MSG_BLOCK, hashBlock));
+                LogPrint(BCLog::NET, "%s : Already processed block %s, skipping cmpctblock\n", __func__, hashBlock.GetHex());
+                return true;
+            }
+
+            // Only accept the compact blocks we requested from this peer, or that a peer we
+            // selected to announce new blocks this way sent unsolicited.
+            const auto itInFlight = mapBlocksInFlight.find(hashBlock);
+            const bool fRequested = itInFlight != mapBlocksInFlight.end() && itInFlight->second.first == pfrom->GetId();
+            if (!fRequested && std::find(lNodesAnnouncingHeaderAndIDs.begin(), lNodesAnnouncingHeaderAndIDs.end(),
+                                         pfrom->GetId()) == lNodesAnnouncingHeaderAndIDs.end()) {
+                LogPrint(BCLog::NET, "Peer %d sent us an unrequested compact block %s\n", pfrom->id, hashBlock.ToString());
+                return true;
+            }
+
+            BlockMap::iterator mi = mapBlockIndex.find(cmpctblock.header.hashPrevBlock);
+            if (mi == mapBlockIndex.end()) {
+                RequestBlockParents(pfrom, cmpctblock.header, connman);
+                return true;
+            }
+
+            // The header of a proof-of-work block is checked before its transactions are looked up
+            const CBlockIndex* pindexPrev = mi->second;
+            if (!Params().GetConsensus().NetworkUpgradeActive(pindexPrev->nHeight + 1, Consensus::UPGRADE_POS)) {
+                const CBlock block(cmpctblock.header);
+                if (!CheckWork(block, pindexPrev) || !CheckProofOfWork(hashBlock, block.nBits)) {
+                    Misbehaving(pfrom->GetId(), 50);
+                    LogPrintf("Peer %d sent us a compact block with an invalid proof of work\n", pfrom->id);
+                    return true;
                 }
-                WITH_LOCK(cs_main, mapBlockSource.emplace(hashBlock, pfrom->GetId()); );
-                int nDoS;
-                if(state.IsInvalid(nDoS)) {
-                    assert (state.GetRejectCode() < REJECT_INTERNAL); // Blocks are never rejected with internal reject codes
-                    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::REJECT, strCommand, state.GetRejectCode(),
-                        state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash));
-                    if(nDoS > 0) {
-                        TRY_LOCK(cs_main, lockMain);
-                        if(lockMain) Misbehaving(pfrom->GetId(), nDoS);
+            }
+
+            // The header of a proof-of-stake block can't be checked without its coinstake,
+            // so there is no early header validation: at most one compact block per peer is
+            // kept, and a new one replaces it.
+            CNodeState* nodestate = State(pfrom->GetId());
+            nodestate->partialBlock.reset(new PartiallyDownloadedBlock(&mempool));
+            ReadStatus status = nodestate->partialBlock->InitData(cmpctblock);
+            if (status == READ_STATUS_INVALID) {
+                nodestate->partialBlock.reset();
+                Misbehaving(pfrom->GetId(), 100);
+                LogPrintf("Peer %d sent us invalid compact block\n", pfrom->id);
+                return true;
+            } else if (status == READ_STATUS_FAILED) {
+                // Short id collision, just request the full block
+                nodestate->partialBlock.reset();
+                RequestFullBlock(pfrom, hashBlock, connman);
+                return true;
+            }
+
+            BlockTransactionsRequest req;
+            for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
+                if (!nodestate->partialBlock->IsTxAvailable(i))
+                    req.indexes.push_back(i);
+            }
+            if (!req.indexes.empty()) {
+                req.blockhash = hashBlock;
+                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::GETBLOCKTXN, req));
+                return true;
+            }
+
+            // All the transactions were in the mempool
+            std::unique_ptr<PartiallyDownloadedBlock> partialBlock = std::move(nodestate->partialBlock);
+            if (!FillCompactBlock(pfrom, *partialBlock, std::vector<CTransactionRef>(), *pblock, connman))
+                return true;
+        }
+        ProcessReceivedBlock(pfrom, pblock, connman);
+    }
+
+
+    else if (strCommand == NetMsgType::BLOCKTXN && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        {
+            LOCK(cs_main);
+            CNodeState* nodestate = State(pfrom->GetId());
+            if (!nodestate->partialBlock || nodestate->partialBlock->header.GetHash() != resp.blockhash) {
+                LogPrint(BCLog::NET, "Peer %d sent us block transactions for block we weren't expecting\n", pfrom->id);
+                return true;
+            }
+            std::unique_ptr<PartiallyDownloadedBlock> partialBlock = std::move(nodestate->partialBlock);
+            if (!FillCompactBlock(pfrom, *partialBlock, resp.txn, *pblock, connman))
+                return true;
+        }
+        ProcessReceivedBlock(pfrom, pblock, connman);
+    }
+
+
+    else if (strCommand == NetMsgType::GETBLOCKTXN) {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        {
+            LOCK(cs_main);
+
+            BlockMap::iterator it = mapBlockIndex.find(req.blockhash);
+            if (it == mapBlockIndex.end() || !(it->second->nStatus & BLOCK_HAVE_DATA)) {
+                LogPrint(BCLog::NET, "Peer %d sent us a getblocktxn for a block we don't have\n", pfrom->id);
+                return true;
+            }
+
+            if (it->second->nHeight >= chainActive.Height() - MAX_BLOCKTXN_DEPTH) {
+                CBlock block;
+                if (!ReadBlockFromDisk(block, it->second))
+                    assert(!"cannot load block from disk");
+
+                BlockTransactions resp(req);
+                for (size_t i = 0; i < req.indexes.size(); i++) {
+                    if (req.indexes[i] >= block.vtx.size()) {
+                        Misbehaving(pfrom->GetId(), 100);
+                        LogPrintf("Peer %d sent us a getblocktxn with out-of-bounds tx indices\n", pfrom->id);
+                        return true;
                     }
+                    resp.txn[i] = block.vtx[req.indexes[i]];
                 }
-                //disconnect this node if its old protocol version
-                pfrom->DisconnectOldProtocol(pfrom->nVersion, ActiveProtocol(), strCommand);
-            } else {
-                LogPrint(BCLog::NET, "%s : Already processed block %s, skipping ProcessNewBlock()\n", __func__, pblock->GetHash().GetHex());
+                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCKTXN, resp));
+                return true;
             }
         }
+
+        // An older block is sent in full rather than with a blocktxn: a peer sending lots of
+        // getblocktxn to trigger disk reads then has to receive all the data read from disk.
+        LogPrint(BCLog::NET, "Peer %d sent us a getblocktxn for a block > %i deep\n", pfrom->id, MAX_BLOCKTXN_DEPTH);
+        pfrom->vRecvGetData.emplace_back(MSG_BLOCK, req.blockhash);
+        ProcessGetData(pfrom, connman, interruptMsgProc);
     }
 
     // This asymmetric behavior for inbound and outbound connections was introduced
@@ -1824,13 +2404,21 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             }
         }
 
-        if (found) {
+        TierTwoMessageClass cls;
+        if (found && GetTierTwoMessageClass(strCommand, cls)) {
+            // Hand the message over to the thread of its class, which processes them in order.
+            // ProcessMessages doesn't take it from the peer while that thread is too far behind.
+            std::shared_ptr<CDataStream> pMsg = std::make_shared<CDataStream>(std::move(vRecv));
+            std::function<void()> work = [pfrom, strCommand, pMsg, cls, &connman]() {
+                ProcessTierTwoMessage(pfrom, strCommand, *pMsg, cls, connman);
+            };
+            if (!connman.PushTierTwoWork(cls, pfrom, work))
+                LogPrint(BCLog::NET, "%s: too many %s messages waiting, dropped, peer=%d\n", __func__, strCommand, pfrom->id);
+        } else if (found) {
             // Check if the dispatcher can process this message first. If not, try going with the old flow.
             if (!masternodeSync.MessageDispatcher(pfrom, strCommand, vRecv)) {
                 //probably one the extensions
                 mnodeman.ProcessMessage(pfrom, strCommand, vRecv);
-                g_budgetman.ProcessMessage(pfrom, strCommand, vRecv);
-                masternodePayments.ProcessMessageMasternodePayments(pfrom, strCommand, vRecv);
                 sporkManager.ProcessSpork(pfrom, strCommand, vRecv);
                 masternodeSync.ProcessMessage(pfrom, strCommand, vRecv);
             }
@@ -1873,6 +2461,11 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, std::atomic<bool>& interru
         LOCK(pfrom->cs_vProcessMsg);
         if (pfrom->vProcessMsg.empty())
             return false;
+        // Leave a tier-two message there while the thread of its class is too far behind: the
+        // peer is then no longer read once its queue is full (fPauseRecv), and the order is kept.
+        TierTwoMessageClass cls;
+        if (GetTierTwoMessageClass(pfrom->vProcessMsg.front().hdr.GetCommand(), cls) && connman.IsTierTwoQueueFull(cls))
+            return false;
         // Just take one message
         msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
         pfrom->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
@@ -1962,6 +2555,8 @@ public:
 
 bool SendMessages(CNode* pto, CConnman& connman, std::atomic<bool>& interruptMsgProc)
 {
+    UpdateBlocksPendingParent();
+
     {
         // Don't send anything until the version handshake is complete
         if (!pto->fSuccessfullyConnected || pto->fDisconnect)
@@ -2063,12 +2658,22 @@ bool SendMessages(CNode* pto, CConnman& connman, std::atomic<bool>& interruptMsg
             if ((nSyncStarted == 0 && fFetch) || pindexBestHeader->GetBlockTime() > GetAdjustedTime() - 6 * 60 * 60) { // NOTE: was "close to today" and 24h in Bitcoin
                 state.fSyncStarted = true;
                 nSyncStarted++;
-                //CBlockIndex *pindexStart = pindexBestHeader->pprev ? pindexBestHeader->pprev : pindexBestHeader;
-                //LogPrint(BCLog::NET, "initial getheaders (%d) to peer=%d (startheight:%d)\n", pindexStart->nHeight, pto->id, pto->nStartingHeight);
-                //pto->PushMessage(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexStart), UINT256_ZERO);
-                connman.PushMessage(pto, msgMaker.Make(NetMsgType::GETBLOCKS, chainActive.GetLocator(chainActive.Tip()), UINT256_ZERO));
+                if (pto->nVersion >= HEADERS_SYNC_VERSION) {
+                    // Headers first: the blocks are then downloaded from all the peers having them
+                    CBlockIndex* pindexStart = pindexBestHeader->pprev ? pindexBestHeader->pprev : pindexBestHeader;
+                    LogPrint(BCLog::NET, "initial getheaders (%d) to peer=%d (startheight:%d)\n", pindexStart->nHeight, pto->id, pto->nStartingHeight);
+                    connman.PushMessage(pto, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexStart), UINT256_ZERO));
+                } else {
+                    connman.PushMessage(pto, msgMaker.Make(NetMsgType::GETBLOCKS, chainActive.GetLocator(chainActive.Tip()), UINT256_ZERO));
+                }
             }
         }
+        if (state.fHeadersAhead && pindexBestHeader->nHeight < chainActive.Height() + BLOCK_DOWNLOAD_WINDOW / 2) {
+            // Resume the headers sync stopped too far ahead of the active chain
+            state.fHeadersAhead = false;
+            LogPrint(BCLog::NET, "resume getheaders (%d) to peer=%d\n", pindexBestHeader->nHeight, pto->id);
+            connman.PushMessage(pto, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), UINT256_ZERO));
+        }
 
         // Resend wallet transactions that haven't gotten in a block yet
         // Except during reindex, importing and IBD, when old wallet
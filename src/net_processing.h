@@ -21,6 +21,12 @@ static const bool DEFAULT_BLOCK_SPAM_FILTER = true;
 static const unsigned int DEFAULT_BLOCK_SPAM_FILTER_MAX_SIZE = 100;
 /** Default for -blockspamfiltermaxavg, maximum average size of an index occurrence in the block spam filter */
 static const unsigned int DEFAULT_BLOCK_SPAM_FILTER_MAX_AVG = 10;
+/** Number of headers messages not connecting to our block index a peer can send before being punished */
+static const int MAX_UNCONNECTING_HEADERS = 10;
+/** Seconds after which a block downloaded before its parent is dropped, to be downloaded again */
+static const int64_t PENDING_BLOCK_EXPIRE_TIME = 10 * 60;
+/** Minimum seconds between two checks for the expired pending blocks */
+static const int64_t PENDING_BLOCK_EXPIRE_INTERVAL = 60;
 
 /** Average delay between trickled inventory transmissions in seconds.
  *  Blocks and whitelisted receivers bypass this, outbound peers get half this delay. */
@@ -38,11 +44,20 @@ class PeerLogicValidation : public CValidationInterface {
 private:
     CConnman* connman;
 
+    //! The last block sent from disk: a new block is requested by many peers at once,
+    //! they all share its buffer. Requires cs_main.
+    uint256 hashLastBlockSent;
+    CSerializedNetMsg msgLastBlockSent;
+
 public:
     PeerLogicValidation(CConnman* connmanIn);
-    ~PeerLogicValidation() = default;
+    ~PeerLogicValidation();
+
+    /** Make the message of a block read from disk, sharing the buffer of the last block sent. Requires cs_main. */
+    CSerializedNetMsg MakeBlockMessage(const CBlockIndex* pindex);
 
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockChecked(const CBlock& block, const CValidationState& state) override;
 };
 
@@ -14,6 +14,7 @@
 #include "uint256.h"
 #include "util.h"
 
+#include <limits>
 #include <math.h>
 
 
@@ -153,3 +154,24 @@ uint256 GetBlockProof(const CBlockIndex& block)
     // or ~bnTarget / (nTarget+1) + 1.
     return (~bnTarget / (bnTarget + 1)) + 1;
 }
+
+int64_t GetBlockProofEquivalentTime(const CBlockIndex& to, const CBlockIndex& from, const CBlockIndex& tip)
+{
+    uint256 r;
+    int sign = 1;
+    if (to.nChainWork > from.nChainWork) {
+        r = to.nChainWork - from.nChainWork;
+    } else {
+        r = from.nChainWork - to.nChainWork;
+        sign = -1;
+    }
+    const uint256 tipProof = GetBlockProof(tip);
+    if (tipProof.IsNull()) {
+        return sign * std::numeric_limits<int64_t>::max();
+    }
+    r = r * uint256(Params().GetConsensus().nTargetSpacing) / tipProof;
+    if (r.bits() > 63) {
+        return sign * std::numeric_limits<int64_t>::max();
+    }
+    return sign * r.GetLow64();
+}
@@ -7,6 +7,8 @@
 
 #include "primitives/block.h"
 
+#include "crypto/common.h"
+#include "crypto/quark.h"
 #include "hash.h"
 #include "script/standard.h"
 #include "script/sign.h"
@@ -15,6 +17,39 @@
 #include "util.h"
 
 uint256 CBlockHeader::GetHash() const
+{
+    if (hashCache.fSet &&
+            hashCache.nVersion == nVersion &&
+            hashCache.hashPrevBlock == hashPrevBlock &&
+            hashCache.hashMerkleRoot == hashMerkleRoot &&
+            hashCache.nTime == nTime &&
+            hashCache.nBits == nBits &&
+            hashCache.nNonce == nNonce &&
+            hashCache.hashFinalSaplingRoot == hashFinalSaplingRoot) {
+        return hashCache.hash;
+    }
+    return ComputeHash();
+}
+
+void CBlockHeader::UpdateHashCache()
+{
+    UpdateHashCache(ComputeHash());
+}
+
+void CBlockHeader::UpdateHashCache(const uint256& hash)
+{
+    hashCache.hash = hash;
+    hashCache.nVersion = nVersion;
+    hashCache.hashPrevBlock = hashPrevBlock;
+    hashCache.hashMerkleRoot = hashMerkleRoot;
+    hashCache.nTime = nTime;
+    hashCache.nBits = nBits;
+    hashCache.nNonce = nNonce;
+    hashCache.hashFinalSaplingRoot = hashFinalSaplingRoot;
+    hashCache.fSet = true;
+}
+
+uint256 CBlockHeader::ComputeHash() const
 {
     if (nVersion < 4)  {
 #if defined(WORDS_BIGENDIAN)
@@ -34,6 +69,45 @@ uint256 CBlockHeader::GetHash() const
     return SerializeHash(*this);
 }
 
+std::vector<uint256> GetBlockHeaderHashes(const std::vector<CBlockHeader>& headers)
+{
+    std::vector<uint256> hashes(headers.size());
+    std::vector<size_t> legacy;
+    std::vector<unsigned char> data;
+    for (size_t i = 0; i < headers.size(); i++) {
+        const CBlockHeader& header = headers[i];
+        if (header.nVersion >= 4) {
+            hashes[i] = header.GetHash();
+            continue;
+        }
+        legacy.push_back(i);
+        data.resize(data.size() + 80);
+        unsigned char* p = data.data() + data.size() - 80;
+        WriteLE32(&p[0], header.nVersion);
+        memcpy(&p[4], header.hashPrevBlock.begin(), header.hashPrevBlock.size());
+        memcpy(&p[36], header.hashMerkleRoot.begin(), header.hashMerkleRoot.size());
+        WriteLE32(&p[68], header.nTime);
+        WriteLE32(&p[72], header.nBits);
+        WriteLE32(&p[76], header.nNonce);
+    }
+    if (!legacy.empty()) {
+        std::vector<unsigned char> out(legacy.size() * 32);
+        QuarkHashMulti(out.data(), data.data(), 80, legacy.size());
+        for (size_t i = 0; i < legacy.size(); i++) {
+            memcpy(hashes[legacy[i]].begin(), out.data() + i * 32, 32);
+        }
+    }
+    return hashes;
+}
+
+void UpdateBlockHeaderHashCaches(std::vector<CBlockHeader>& headers)
+{
+    const std::vector<uint256> hashes = GetBlockHeaderHashes(headers);
+    for (size_t i = 0; i < headers.size(); i++) {
+        headers[i].UpdateHashCache(hashes[i]);
+    }
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
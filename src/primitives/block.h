@@ -52,6 +52,10 @@ public:
         // Sapling active
         if (nVersion >= 8)
             READWRITE(hashFinalSaplingRoot);
+
+        // Hash it once here: headers read from disk or network are hashed several times
+        if (ser_action.ForRead() && !(s.GetType() & SER_NOHASHCACHE))
+            UpdateHashCache();
     }
 
     void SetNull()
@@ -63,6 +67,7 @@ public:
         nBits = 0;
         nNonce = 0;
         hashFinalSaplingRoot.SetNull();
+        hashCache = HashCache();
     }
 
     bool IsNull() const
@@ -70,14 +75,46 @@ public:
         return (nBits == 0);
     }
 
+    // Return the cached hash, if the header didn't change since it was computed
     uint256 GetHash() const;
 
+    // Compute the hash and cache it
+    void UpdateHashCache();
+
+    // Cache a hash computed by the caller with GetBlockHeaderHashes
+    void UpdateHashCache(const uint256& hash);
+
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
     }
+
+private:
+    // memory only: the hash of the header, and the fields it was computed from.
+    // The fields are public, so they are compared on every use of the cache.
+    struct HashCache {
+        bool fSet{false};
+        uint256 hash;
+        int32_t nVersion{0};
+        uint256 hashPrevBlock;
+        uint256 hashMerkleRoot;
+        uint32_t nTime{0};
+        uint32_t nBits{0};
+        uint32_t nNonce{0};
+        uint256 hashFinalSaplingRoot;
+    };
+    HashCache hashCache;
+
+    uint256 ComputeHash() const;
 };
 
+/** Compute the hashes of a batch of headers. The legacy (Quark) headers are hashed
+ *  together, which is faster than hashing them one by one. */
+std::vector<uint256> GetBlockHeaderHashes(const std::vector<CBlockHeader>& headers);
+
+/** Hash a batch of headers read with SER_NOHASHCACHE, and cache the hashes in them. */
+void UpdateBlockHeaderHashCaches(std::vector<CBlockHeader>& headers);
+
 
 class CBlock : public CBlockHeader
 {
@@ -90,6 +127,9 @@ public:
 
     // memory only
     mutable bool fChecked{false};
+    // memory only: the merkle root and the block signature were checked ahead of CheckBlock
+    mutable bool fCheckedMerkleRoot{false};
+    mutable bool fCheckedSignature{false};
 
     CBlock()
     {
@@ -117,20 +157,17 @@ public:
         CBlockHeader::SetNull();
         vtx.clear();
         fChecked = false;
+        fCheckedMerkleRoot = false;
+        fCheckedSignature = false;
         vchBlockSig.clear();
     }
 
     CBlockHeader GetBlockHeader() const
     {
-        CBlockHeader block;
-        block.nVersion       = nVersion;
-        block.hashPrevBlock  = hashPrevBlock;
-        block.hashMerkleRoot = hashMerkleRoot;
-        block.nTime          = nTime;
-        block.nBits          = nBits;
-        block.nNonce         = nNonce;
-        if (nVersion >= 8)
-            block.hashFinalSaplingRoot   = hashFinalSaplingRoot;
+        // Copy the header fields (and the cached hash)
+        CBlockHeader block(*this);
+        if (nVersion < 8)
+            block.hashFinalSaplingRoot.SetNull();
         return block;
     }
 
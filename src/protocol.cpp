@@ -39,6 +39,10 @@ const char* FILTERADD = "filteradd";
 const char* FILTERCLEAR = "filterclear";
 const char* REJECT = "reject";
 const char* SENDHEADERS = "sendheaders";
+const char* SENDCMPCT = "sendcmpct";
+const char* CMPCTBLOCK = "cmpctblock";
+const char* GETBLOCKTXN = "getblocktxn";
+const char* BLOCKTXN = "blocktxn";
 const char* SPORK = "spork";
 const char* GETSPORKS = "getsporks";
 const char* MNBROADCAST = "mnb";
@@ -71,7 +75,8 @@ static const char* ppszTypeName[] = {
     "mnq",
     NetMsgType::MNBROADCAST,
     NetMsgType::MNPING,
-    "dstx"  // deprecated
+    "dstx",  // deprecated
+    NetMsgType::CMPCTBLOCK
 };
 
 /** All known message types. Keep this in the same order as the list of
@@ -100,6 +105,10 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::FILTERCLEAR,
     NetMsgType::REJECT,
     NetMsgType::SENDHEADERS,
+    NetMsgType::SENDCMPCT,
+    NetMsgType::CMPCTBLOCK,
+    NetMsgType::GETBLOCKTXN,
+    NetMsgType::BLOCKTXN,
     "filtered block", // Should never occur
     "ix",   // deprecated
     "txlvote", // deprecated
@@ -216,7 +225,7 @@ bool CInv::IsKnownType() const
 }
 
 bool CInv::IsMasterNodeType() const{
-     return type > 2;
+     return type > 2 && type != MSG_CMPCT_BLOCK;
 }
 
 const char* CInv::GetCommand() const
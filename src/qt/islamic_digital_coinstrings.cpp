@@ -358,6 +358,7 @@ static const char UNUSED* islamic_digital_coin_strings[] = {
     QT_TRANSLATE_NOOP("islamic digital coin", "Relay and mine data carrier transactions (default: %u)"),
     QT_TRANSLATE_NOOP("islamic digital coin", "Relay non-P2SH multisig (default: %u)"),
     QT_TRANSLATE_NOOP("islamic digital coin", "Replaying blocks..."),
+    QT_TRANSLATE_NOOP("islamic digital coin", "Rescan stopped before the chain tip: shutdown requested or block data unavailable. Exiting."),
     QT_TRANSLATE_NOOP("islamic digital coin", "Rescan the block chain for missing wallet transactions"),
     QT_TRANSLATE_NOOP("islamic digital coin", "Rescanning..."),
     QT_TRANSLATE_NOOP("islamic digital coin", "Run a thread to flush wallet periodically (default: %u)"),
@@ -373,7 +374,6 @@ static const char UNUSED* islamic_digital_coin_strings[] = {
     QT_TRANSLATE_NOOP("islamic digital coin", "Sets the DB_PRIVATE flag in the wallet db environment (default: %u)"),
     QT_TRANSLATE_NOOP("islamic digital coin", "Show all debugging options (usage: --help -help-debug)"),
     QT_TRANSLATE_NOOP("islamic digital coin", "Shrink debug.log file on client startup (default: 1 when no -debug)"),
-    QT_TRANSLATE_NOOP("islamic digital coin", "Shutdown requested over the txs scan. Exiting."),
     QT_TRANSLATE_NOOP("islamic digital coin", "Signing transaction failed"),
     QT_TRANSLATE_NOOP("islamic digital coin", "Specify configuration file (default: %s)"),
     QT_TRANSLATE_NOOP("islamic digital coin", "Specify connection timeout in milliseconds (minimum: 1, default: %d)"),
@@ -427,7 +427,6 @@ static const char UNUSED* islamic_digital_coin_strings[] = {
     QT_TRANSLATE_NOOP("islamic digital coin", "Warning: This version is obsolete, upgrade required!"),
     QT_TRANSLATE_NOOP("islamic digital coin", "Warning: Unsupported argument -benchmark ignored, use -debug=bench."),
     QT_TRANSLATE_NOOP("islamic digital coin", "Warning: Unsupported argument -debugnet ignored, use -debug=net."),
-    QT_TRANSLATE_NOOP("islamic digital coin", "You need to rebuild the database using -reindex to change -txindex"),
     QT_TRANSLATE_NOOP("islamic digital coin", "Zapping all transactions from wallet..."),
     QT_TRANSLATE_NOOP("islamic digital coin", "ZeroMQ notification options:"),
     QT_TRANSLATE_NOOP("islamic digital coin", "isValid(): Invalid -proxy address or hostname: '%s'"),
@@ -208,6 +208,7 @@ static bool rest_block(HTTPRequest* req,
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
     CBlock block;
+    std::vector<uint8_t> blockData;
     CBlockIndex* pblockindex = NULL;
     {
         LOCK(cs_main);
@@ -218,23 +219,26 @@ static bool rest_block(HTTPRequest* req,
         if (!(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex))
-            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        if (rf == RF_JSON) {
+            if (!ReadBlockFromDisk(block, pblockindex))
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        } else if (rf == RF_BINARY || rf == RF_HEX) {
+            // The block as stored on disk is its network serialization
+            if (!ReadRawBlockFromDisk(blockData, pblockindex))
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        }
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block;
-
     switch (rf) {
     case RF_BINARY: {
-        std::string binaryBlock = ssBlock.str();
+        std::string binaryBlock(blockData.begin(), blockData.end());
         req->WriteHeader("Content-Type", "application/octet-stream");
         req->WriteReply(HTTP_OK, binaryBlock);
         return true;
     }
 
     case RF_HEX: {
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
+        std::string strHex = HexStr(blockData.begin(), blockData.end()) + "\n";
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
         return true;
@@ -12,6 +12,7 @@
 #include "clientversion.h"
 #include "core_io.h"
 #include "consensus/upgrades.h"
+#include "index/coinstatsindex.h"
 #include "kernel.h"
 #include "masternodeman.h"
 #include "policy/feerate.h"
@@ -22,6 +23,7 @@
 #include "util.h"
 #include "utilmoneystr.h"
 #include "utilstrencodings.h"
+#include "utxosnapshot.h"
 #include "hash.h"
 #include "validationinterface.h"
 #include "wallet/wallet.h"
@@ -570,16 +572,20 @@ UniValue getblock(const JSONRPCRequest& request)
     CBlock block;
     CBlockIndex* pblockindex = mapBlockIndex[hash];
 
-    if (!ReadBlockFromDisk(block, pblockindex))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+        throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
 
     if (!fVerbose) {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
+        // The block as stored on disk is its network serialization
+        std::vector<uint8_t> blockData;
+        if (!ReadRawBlockFromDisk(blockData, pblockindex))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+        return HexStr(blockData.begin(), blockData.end());
     }
 
+    if (!ReadBlockFromDisk(block, pblockindex))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+
     return blockToJSON(block, pblockindex);
 }
 
@@ -687,40 +693,74 @@ UniValue getsupplyinfo(const JSONRPCRequest& request)
     return ret;
 }
 
+enum class CoinStatsHashType {
+    HASH_SERIALIZED,
+    MUHASH,
+    NONE,
+};
+
+static CoinStatsHashType ParseHashType(const UniValue& param)
+{
+    if (param.isNull() || param.get_str() == "hash_serialized_2") {
+        return CoinStatsHashType::HASH_SERIALIZED;
+    }
+    if (param.get_str() == "muhash") {
+        return CoinStatsHashType::MUHASH;
+    }
+    if (param.get_str() == "none") {
+        return CoinStatsHashType::NONE;
+    }
+    throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("%s is not a valid hash_type", param.get_str()));
+}
+
 struct CCoinsStats
 {
     int nHeight{0};
     uint256 hashBlock{UINT256_ZERO};
     uint64_t nTransactions{0};
     uint64_t nTransactionOutputs{0};
+    uint64_t nBogoSize{0};
     uint256 hashSerialized{UINT256_ZERO};
     uint64_t nDiskSize{0};
     CAmount nTotalAmount{0};
+    //! Whether the stats come from the coinstats index, which doesn't know nTransactions and nDiskSize
+    bool fFromIndex{false};
 };
 
-static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, MuHash3072& muhash, CoinStatsHashType hash_type,
+                       const uint256& hash, const std::map<uint32_t, Coin>& outputs)
 {
     assert(!outputs.empty());
-    ss << hash;
     const Coin& coin = outputs.begin()->second;
-    ss << VARINT(coin.nHeight * 4 + (coin.fCoinBase ? 2 : 0) + (coin.fCoinStake ? 1 : 0));
+    if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+        ss << hash;
+        ss << VARINT(coin.nHeight * 4 + (coin.fCoinBase ? 2 : 0) + (coin.fCoinStake ? 1 : 0));
+    }
     stats.nTransactions++;
     for (const auto& output : outputs) {
-        ss << VARINT(output.first + 1);
-        ss << output.second.out.scriptPubKey;
-        ss << VARINT(output.second.out.nValue);
+        if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+            ss << VARINT(output.first + 1);
+            ss << output.second.out.scriptPubKey;
+            ss << VARINT(output.second.out.nValue);
+        } else if (hash_type == CoinStatsHashType::MUHASH) {
+            TxOutHash(muhash, COutPoint(hash, output.first), output.second, true);
+        }
         stats.nTransactionOutputs++;
         stats.nTotalAmount += output.second.out.nValue;
+        stats.nBogoSize += GetBogoSize(output.second.out.scriptPubKey);
+    }
+    if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+        ss << VARINT(0);
     }
-    ss << VARINT(0);
 }
 
 //! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
+static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats, CoinStatsHashType hash_type)
 {
     std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    MuHash3072 muhash;
     stats.hashBlock = pcursor->GetBestBlock();
     {
         LOCK(cs_main);
@@ -735,7 +775,7 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
         Coin coin;
         if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
             if (!outputs.empty() && key.hash != prevkey) {
-                ApplyStats(stats, ss, prevkey, outputs);
+                ApplyStats(stats, ss, muhash, hash_type, prevkey, outputs);
                 outputs.clear();
             }
             prevkey = key.hash;
@@ -746,51 +786,189 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
         pcursor->Next();
     }
     if (!outputs.empty()) {
-        ApplyStats(stats, ss, prevkey, outputs);
+        ApplyStats(stats, ss, muhash, hash_type, prevkey, outputs);
+    }
+    if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+        stats.hashSerialized = ss.GetHash();
+    } else if (hash_type == CoinStatsHashType::MUHASH) {
+        muhash.Finalize(stats.hashSerialized.begin());
     }
-    stats.hashSerialized = ss.GetHash();
     stats.nDiskSize = view->EstimateSize();
     return true;
 }
 
+//! Read the statistics of the UTXO set after a block from the coinstats index
+static bool LookUpUTXOStats(const CBlockIndex* pindex, CCoinsStats& stats, CoinStatsHashType hash_type)
+{
+    CCoinStatsEntry entry;
+    if (!g_coinstatsindex->LookUpStats(pindex, entry)) {
+        return false;
+    }
+    stats.nHeight = pindex->nHeight;
+    stats.hashBlock = entry.hashBlock;
+    stats.nTransactionOutputs = entry.nTransactionOutputs;
+    stats.nBogoSize = entry.nBogoSize;
+    stats.nTotalAmount = entry.nTotalAmount;
+    if (hash_type == CoinStatsHashType::MUHASH) {
+        entry.muhash.Finalize(stats.hashSerialized.begin());
+    }
+    stats.fFromIndex = true;
+    return true;
+}
+
 UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 2)
         throw std::runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" hash_or_height )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Note this call may take some time, unless the statistics are read from the coinstats index (-coinstatsindex).\n"
+
+            "\nArguments:\n"
+            "1. \"hash_type\"      (string, optional, default=hash_serialized_2) Which UTXO set hash should be calculated.\n"
+            "                       Options: \"hash_serialized_2\" (the legacy algorithm), \"muhash\", \"none\".\n"
+            "                       The coinstats index is used for \"muhash\" and \"none\" when it is enabled.\n"
+            "2. hash_or_height     (string or numeric, optional) The block hash or height of the target height.\n"
+            "                       Only available with the coinstats index, and not with hash_serialized_2.\n"
 
             "\nResult:\n"
             "{\n"
-            "  \"height\":n,     (numeric) The current block height (index)\n"
-            "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
-            "  \"txouts\": n,            (numeric) The number of output transactions\n"
-            "  \"hash_serialized_2\": \"hash\",   (string) The serialized hash\n"
-            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
+            "  \"height\":n,     (numeric) The block height (index) of the returned statistics\n"
+            "  \"bestblock\": \"hex\",   (string) the hash of the block at which the statistics are calculated\n"
+            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs (not available with the coinstats index)\n"
+            "  \"txouts\": n,            (numeric) The number of unspent transaction outputs\n"
+            "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
+            "  \"hash_serialized_2\": \"hash\",   (string) The serialized hash (only present if 'hash_serialized_2' hash_type is chosen)\n"
+            "  \"muhash\": \"hash\",     (string) The MuHash of the UTXO set (only present if 'muhash' hash_type is chosen)\n"
+            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk (not available with the coinstats index)\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
 
             "\nExamples:\n" +
-            HelpExampleCli("gettxoutsetinfo", "") + HelpExampleRpc("gettxoutsetinfo", ""));
+            HelpExampleCli("gettxoutsetinfo", "") +
+            HelpExampleCli("gettxoutsetinfo", "\"none\"") +
+            HelpExampleCli("gettxoutsetinfo", "\"muhash\" 1000") +
+            HelpExampleRpc("gettxoutsetinfo", "\"muhash\", 1000"));
 
     UniValue ret(UniValue::VOBJ);
 
+    const CoinStatsHashType hash_type = ParseHashType(request.params[0]);
+    const bool fUseIndex = g_coinstatsindex && hash_type != CoinStatsHashType::HASH_SERIALIZED;
+
     CCoinsStats stats;
-    FlushStateToDisk();
-    if (GetUTXOStats(pcoinsTip, stats)) {
-        ret.pushKV("height", (int64_t)stats.nHeight);
-        ret.pushKV("bestblock", stats.hashBlock.GetHex());
+    if (request.params.size() > 1 && !request.params[1].isNull()) {
+        if (!g_coinstatsindex) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Querying specific block heights requires the coinstats index. Use -coinstatsindex to enable it");
+        }
+        if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "hash_serialized_2 hash type cannot be queried for a specific block");
+        }
+        g_coinstatsindex->BlockUntilSyncedToCurrentChain();
+
+        const CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            const UniValue& hash_or_height = request.params[1];
+            if (hash_or_height.isNum()) {
+                const int nHeight = hash_or_height.get_int();
+                if (nHeight < 0 || nHeight > chainActive.Height()) {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+                }
+                pindex = chainActive[nHeight];
+            } else {
+                BlockMap::const_iterator it = mapBlockIndex.find(ParseHashV(hash_or_height, "hash_or_height"));
+                if (it == mapBlockIndex.end()) {
+                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+                }
+                pindex = it->second;
+                if (!chainActive.Contains(pindex)) {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "Block is not in the main chain");
+                }
+            }
+        }
+        if (!LookUpUTXOStats(pindex, stats, hash_type)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set statistics: the coinstats index may still be syncing");
+        }
+    } else {
+        bool fFound = false;
+        if (fUseIndex && g_coinstatsindex->BlockUntilSyncedToCurrentChain()) {
+            const CBlockIndex* pindex = WITH_LOCK(cs_main, return chainActive.Tip(); );
+            fFound = LookUpUTXOStats(pindex, stats, hash_type);
+        }
+        // Walk the chainstate if the index can't answer yet
+        if (!fFound) {
+            FlushStateToDisk();
+            if (!GetUTXOStats(pcoinsTip, stats, hash_type)) {
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+            }
+        }
+    }
+
+    ret.pushKV("height", (int64_t)stats.nHeight);
+    ret.pushKV("bestblock", stats.hashBlock.GetHex());
+    if (!stats.fFromIndex) {
         ret.pushKV("transactions", (int64_t)stats.nTransactions);
-        ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
+    }
+    ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
+    ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+    if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
         ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
-        ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+    } else if (hash_type == CoinStatsHashType::MUHASH) {
+        ret.pushKV("muhash", stats.hashSerialized.GetHex());
+    }
+    ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+    if (!stats.fFromIndex) {
         ret.pushKV("disk_size", stats.nDiskSize);
     }
     return ret;
 }
 
+UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrite the unspent transaction output set, the Sapling state and the block index at the\n"
+            "current tip to a snapshot file, which a new node can start from with -loadsnapshot and\n"
+            "-loadsnapshothash=<snapshot_hash>.\n"
+            "Note this call may take some time.\n"
+
+            "\nArguments:\n"
+            "1. \"path\"          (string, required) The snapshot file. A relative path is relative to the data directory\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,    (numeric) The number of unspent outputs written\n"
+            "  \"base_hash\": \"hex\",   (string) The hash of the block at the tip of the snapshot\n"
+            "  \"base_height\": n,      (numeric) The height of that block\n"
+            "  \"path\": \"path\",       (string) The absolute path of the snapshot file\n"
+            "  \"snapshot_hash\": \"hex\" (string) The hash of the snapshot contents, to trust it when loading it\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("dumptxoutset", "\"utxo.dat\"") + HelpExampleRpc("dumptxoutset", "\"utxo.dat\""));
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+    }
+
+    SnapshotMetadata metadata;
+    uint256 hashContents;
+    std::string strError;
+    if (!DumpUTXOSnapshot(path, metadata, hashContents, strError)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to write snapshot: " + strError);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("coins_written", (int64_t)metadata.nCoins);
+    ret.pushKV("base_hash", metadata.hashBaseBlock.GetHex());
+    ret.pushKV("base_height", metadata.nBaseHeight);
+    ret.pushKV("path", path.string());
+    ret.pushKV("snapshot_hash", hashContents.GetHex());
+    return ret;
+}
+
 UniValue gettxout(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
@@ -990,6 +1168,8 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
             "    \"valueDelta\":        (numeric) Change in value held by the Sapling circuit over the chain tip block\n"
             "  },\n"
             "  \"initial_block_downloading\": true|false, (boolean) whether the node is in initial block downloading state or not\n"
+            "  \"pruned\": xx,             (boolean) if the blocks are subject to pruning\n"
+            "  \"pruneheight\": xxxxxx,    (numeric) lowest-height complete block stored (only present if pruning is enabled)\n"
             "  \"softforks\": [            (array) status of softforks in progress\n"
             "     {\n"
             "        \"id\": \"xxxx\",        (string) name of softfork\n"
@@ -1027,6 +1207,14 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
     // Sapling shield pool value
     obj.pushKV("shield_pool_value", pChainTip ? ValuePoolDesc(pChainTip->nChainSaplingValue, pChainTip->nSaplingValue) : 0);
     obj.pushKV("initial_block_downloading", IsInitialBlockDownload());
+    obj.pushKV("pruned", fPruneMode);
+    if (fPruneMode) {
+        const CBlockIndex* block = pChainTip;
+        while (block && block->pprev && (block->pprev->nStatus & BLOCK_HAVE_DATA))
+            block = block->pprev;
+        if (block)
+            obj.pushKV("pruneheight", block->nHeight);
+    }
     UniValue softforks(UniValue::VARR);
     softforks.push_back(SoftForkDesc("bip65", 5, pChainTip));
     obj.pushKV("softforks",             softforks);
@@ -1339,6 +1527,9 @@ UniValue getblockindexstats(const JSONRPCRequest& request) {
 
     while (pindex && pindex->nHeight >= heightStart) {
         CBlock block;
+        if (fHavePruned && !(pindex->nStatus & BLOCK_HAVE_DATA) && pindex->nTx > 0) {
+            throw JSONRPCError(RPC_MISC_ERROR, strprintf("Block %d not available (pruned data)", pindex->nHeight));
+        }
         if (!ReadBlockFromDisk(block, pindex)) {
             throw JSONRPCError(RPC_DATABASE_ERROR, "failed to read block from disk");
         }
@@ -1451,6 +1642,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getrawmempool",          &getrawmempool,          true  },
     { "blockchain",         "gettxout",               &gettxout,               true  },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           true  },
     { "blockchain",         "verifychain",            &verifychain,            true  },
 
     /* Not shown in help */
@@ -100,6 +100,10 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     { "getblockheader", 1 },
     { "gettransaction", 1 },
     { "getrawtransaction", 1 },
+    { "getaddressbalance", 0 },
+    { "getaddresstxids", 0 },
+    { "getaddressutxos", 0 },
+    { "getspentinfo", 0 },
     { "createrawtransaction", 0 },
     { "createrawtransaction", 1 },
     { "createrawtransaction", 2 },
@@ -110,6 +114,7 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     { "sethdseed", 0 },
     { "gettxout", 1 },
     { "gettxout", 2 },
+    { "gettxoutsetinfo", 1 },
     { "lockunspent", 0 },
     { "lockunspent", 1 },
     { "importprivkey", 2 },
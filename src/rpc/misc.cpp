@@ -9,6 +9,7 @@
 #include "base58.h"
 #include "clientversion.h"
 #include "httpserver.h"
+#include "index/addressindex.h"
 #include "init.h"
 #include "sapling/key_io_sapling.h"
 #include "masternode-sync.h"
@@ -195,9 +196,9 @@ UniValue mnsync(const JSONRPCRequest& request)
         UniValue obj(UniValue::VOBJ);
 
         obj.pushKV("IsBlockchainSynced", masternodeSync.IsBlockchainSynced());
-        obj.pushKV("lastMasternodeList", masternodeSync.lastMasternodeList);
-        obj.pushKV("lastMasternodeWinner", masternodeSync.lastMasternodeWinner);
-        obj.pushKV("lastBudgetItem", masternodeSync.lastBudgetItem);
+        obj.pushKV("lastMasternodeList", masternodeSync.lastMasternodeList.load());
+        obj.pushKV("lastMasternodeWinner", masternodeSync.lastMasternodeWinner.load());
+        obj.pushKV("lastBudgetItem", masternodeSync.lastBudgetItem.load());
         obj.pushKV("lastFailure", masternodeSync.lastFailure);
         obj.pushKV("nCountFailures", masternodeSync.nCountFailures);
         obj.pushKV("sumMasternodeList", masternodeSync.sumMasternodeList);
@@ -701,6 +702,269 @@ UniValue logging(const JSONRPCRequest& request)
     return result;
 }
 
+static void EnsureAddressIndex()
+{
+    if (!g_addressindex) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled. Use -addressindex to enable it");
+    }
+    if (!g_addressindex->BlockUntilSyncedToCurrentChain()) {
+        throw JSONRPCError(RPC_IN_WARMUP, "Address index is still being built");
+    }
+}
+
+/** Parse an address, or an object with an "addresses" array, into address index keys. */
+static std::vector<std::pair<AddressType, uint160>> ParseIndexedAddresses(const UniValue& param)
+{
+    std::vector<std::string> vStrAddresses;
+    if (param.isStr()) {
+        vStrAddresses.push_back(param.get_str());
+    } else if (param.isObject()) {
+        const UniValue& addresses = find_value(param.get_obj(), "addresses");
+        if (!addresses.isArray()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Addresses is expected to be an array");
+        }
+        for (unsigned int i = 0; i < addresses.size(); i++) {
+            vStrAddresses.push_back(addresses[i].get_str());
+        }
+    } else {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected an address or an object with an addresses array");
+    }
+
+    std::vector<std::pair<AddressType, uint160>> ret;
+    for (const std::string& strAddress : vStrAddresses) {
+        bool isStaking = false;
+        CTxDestination dest = DecodeDestination(strAddress, isStaking);
+        if (const CKeyID* keyID = boost::get<CKeyID>(&dest)) {
+            ret.emplace_back(isStaking ? AddressType::STAKER : AddressType::P2PKH, *keyID);
+        } else if (const CScriptID* scriptID = boost::get<CScriptID>(&dest)) {
+            ret.emplace_back(AddressType::P2SH, *scriptID);
+        } else {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address: " + strAddress);
+        }
+    }
+    return ret;
+}
+
+static std::string EncodeIndexedAddress(AddressType type, const uint160& hash)
+{
+    switch (type) {
+    case AddressType::P2SH:
+        return EncodeDestination(CScriptID(hash));
+    case AddressType::STAKER:
+        return EncodeDestination(CKeyID(hash), true);
+    default:
+        return EncodeDestination(CKeyID(hash));
+    }
+}
+
+#define ADDRESSES_ARG_HELP \
+    "1. \"address\" or {       (string or json object, required)\n" \
+    "      \"addresses\": [    (json array of strings, required) The islamic_digital_coin addresses\n" \
+    "        \"address\"       (string) An islamic_digital_coin address. Staking addresses select the cold\n" \
+    "                        stakes delegated to them, owner addresses include their delegated coins\n" \
+    "        ,...\n" \
+    "      ]\n"
+
+UniValue getaddressbalance(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "getaddressbalance \"address\"|{\"addresses\": [\"address\",...]}\n"
+            "\nReturns the balance of one or more addresses. Requires -addressindex.\n"
+
+            "\nArguments:\n"
+            ADDRESSES_ARG_HELP
+            "    }\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"balance\": xxx,      (numeric) The current balance in " + CURRENCY_UNIT + "\n"
+            "  \"received\": xxx      (numeric) The total amount received in " + CURRENCY_UNIT + "\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"DMJRSsuU9zfyrvxVaAEFQqK4MxZg6vgeS6\"]}'") +
+            HelpExampleRpc("getaddressbalance", "{\"addresses\": [\"DMJRSsuU9zfyrvxVaAEFQqK4MxZg6vgeS6\"]}"));
+
+    const auto addresses = ParseIndexedAddresses(request.params[0]);
+    EnsureAddressIndex();
+
+    CAmount nBalance = 0;
+    CAmount nReceived = 0;
+    for (const auto& addr : addresses) {
+        std::vector<std::pair<CAddressIndexKey, CAmount>> entries;
+        if (!g_addressindex->GetAddressIndex(addr.first, addr.second, entries)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read the address index");
+        }
+        for (const auto& entry : entries) {
+            nBalance += entry.second;
+            if (entry.second > 0) nReceived += entry.second;
+        }
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("balance", ValueFromAmount(nBalance));
+    result.pushKV("received", ValueFromAmount(nReceived));
+    return result;
+}
+
+UniValue getaddressutxos(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "getaddressutxos \"address\"|{\"addresses\": [\"address\",...]}\n"
+            "\nReturns the unspent outputs of one or more addresses, in chain order. Requires -addressindex.\n"
+
+            "\nArguments:\n"
+            ADDRESSES_ARG_HELP
+            "    }\n"
+
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"address\": \"address\",  (string) The address\n"
+            "    \"txid\": \"hash\",        (string) The transaction id\n"
+            "    \"vout\": n,             (numeric) The output index\n"
+            "    \"scriptPubKey\": \"hex\", (string) The script of the output\n"
+            "    \"amount\": xxx,         (numeric) The output value in " + CURRENCY_UNIT + "\n"
+            "    \"height\": n            (numeric) The height of the block containing the output\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"DMJRSsuU9zfyrvxVaAEFQqK4MxZg6vgeS6\"]}'") +
+            HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"DMJRSsuU9zfyrvxVaAEFQqK4MxZg6vgeS6\"]}"));
+
+    const auto addresses = ParseIndexedAddresses(request.params[0]);
+    EnsureAddressIndex();
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> unspent;
+    for (const auto& addr : addresses) {
+        if (!g_addressindex->GetAddressUnspent(addr.first, addr.second, unspent)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read the address index");
+        }
+    }
+    std::stable_sort(unspent.begin(), unspent.end(),
+                     [](const std::pair<CAddressUnspentKey, CAddressUnspentValue>& a,
+                        const std::pair<CAddressUnspentKey, CAddressUnspentValue>& b) {
+                         return a.second.blockHeight < b.second.blockHeight;
+                     });
+
+    UniValue result(UniValue::VARR);
+    for (const auto& it : unspent) {
+        UniValue output(UniValue::VOBJ);
+        output.pushKV("address", EncodeIndexedAddress(it.first.type, it.first.hashBytes));
+        output.pushKV("txid", it.first.txhash.GetHex());
+        output.pushKV("vout", (int)it.first.index);
+        output.pushKV("scriptPubKey", HexStr(it.second.script.begin(), it.second.script.end()));
+        output.pushKV("amount", ValueFromAmount(it.second.satoshis));
+        output.pushKV("height", it.second.blockHeight);
+        result.push_back(output);
+    }
+    return result;
+}
+
+UniValue getaddresstxids(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "getaddresstxids \"address\"|{\"addresses\": [\"address\",...], \"start\": n, \"end\": n}\n"
+            "\nReturns the ids of the transactions crediting or debiting one or more addresses, in chain order.\n"
+            "Requires -addressindex.\n"
+
+            "\nArguments:\n"
+            ADDRESSES_ARG_HELP
+            "      \"start\": n        (numeric, optional) The first block height to include\n"
+            "      \"end\": n          (numeric, optional) The last block height to include\n"
+            "    }\n"
+
+            "\nResult:\n"
+            "[\n"
+            "  \"txid\"                 (string) The transaction id\n"
+            "  ,...\n"
+            "]\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"DMJRSsuU9zfyrvxVaAEFQqK4MxZg6vgeS6\"]}'") +
+            HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"DMJRSsuU9zfyrvxVaAEFQqK4MxZg6vgeS6\"]}"));
+
+    const auto addresses = ParseIndexedAddresses(request.params[0]);
+    int nStart = 0;
+    int nEnd = 0;
+    if (request.params[0].isObject()) {
+        const UniValue& start = find_value(request.params[0].get_obj(), "start");
+        const UniValue& end = find_value(request.params[0].get_obj(), "end");
+        if (!start.isNull()) nStart = start.get_int();
+        if (!end.isNull()) nEnd = end.get_int();
+        if (nStart < 0 || nEnd < 0 || (nEnd > 0 && nEnd < nStart)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid start or end height");
+        }
+    }
+    EnsureAddressIndex();
+
+    // (height, position in block) -> txid, so that the ids come out in chain order
+    std::map<std::pair<int, unsigned int>, uint256> mapTxids;
+    for (const auto& addr : addresses) {
+        std::vector<std::pair<CAddressIndexKey, CAmount>> entries;
+        if (!g_addressindex->GetAddressIndex(addr.first, addr.second, entries, nStart, nEnd)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read the address index");
+        }
+        for (const auto& entry : entries) {
+            mapTxids.emplace(std::make_pair(entry.first.blockHeight, entry.first.txindex), entry.first.txhash);
+        }
+    }
+
+    UniValue result(UniValue::VARR);
+    for (const auto& it : mapTxids) {
+        result.push_back(it.second.GetHex());
+    }
+    return result;
+}
+
+UniValue getspentinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1 || !request.params[0].isObject())
+        throw std::runtime_error(
+            "getspentinfo {\"txid\": \"hash\", \"index\": n}\n"
+            "\nReturns the input spending an output. Requires -addressindex.\n"
+
+            "\nArguments:\n"
+            "1. {\n"
+            "      \"txid\": \"hash\",   (string, required) The id of the transaction holding the output\n"
+            "      \"index\": n        (numeric, required) The output index\n"
+            "    }\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"txid\": \"hash\",       (string) The id of the spending transaction\n"
+            "  \"index\": n,           (numeric) The index of the spending input\n"
+            "  \"height\": n           (numeric) The height of the block containing the spending transaction\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getspentinfo", "'{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}'") +
+            HelpExampleRpc("getspentinfo", "{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}"));
+
+    const uint256 txid = ParseHashO(request.params[0].get_obj(), "txid");
+    const UniValue& indexValue = find_value(request.params[0].get_obj(), "index");
+    if (!indexValue.isNum() || indexValue.get_int() < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid index");
+    }
+    EnsureAddressIndex();
+
+    CSpentIndexValue value;
+    if (!g_addressindex->GetSpentInfo(CSpentIndexKey(txid, indexValue.get_int()), value)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("txid", value.txid.GetHex());
+    result.pushKV("index", (int)value.inputIndex);
+    result.pushKV("height", value.blockHeight);
+    return result;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         okSafeMode
   //  --------------------- ------------------------  -----------------------  ----------
@@ -712,6 +976,12 @@ static const CRPCCommand commands[] =
     { "util",               "logging",                &logging,                true  },
     { "util",               "verifymessage",          &verifymessage,          true  },
 
+    /* Address index */
+    { "addressindex",       "getaddressbalance",      &getaddressbalance,      true  },
+    { "addressindex",       "getaddresstxids",        &getaddresstxids,        true  },
+    { "addressindex",       "getaddressutxos",        &getaddressutxos,        true  },
+    { "addressindex",       "getspentinfo",           &getspentinfo,           true  },
+
     /* Not shown in help */
     { "hidden",             "setmocktime",            &setmocktime,            true  },
 };
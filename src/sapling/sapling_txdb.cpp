@@ -88,3 +88,30 @@ bool CCoinsViewDB::BatchWriteSapling(const uint256& hashSaplingAnchor,
         batch.Write(DB_BEST_SAPLING_ANCHOR, hashSaplingAnchor);
     return true;
 }
+
+bool CCoinsViewDB::ForEachSaplingAnchor(CDBIterator& cursor, const std::function<bool(const uint256&, const SaplingMerkleTree&)>& fn)
+{
+    for (cursor.Seek(std::make_pair(DB_SAPLING_ANCHOR, UINT256_ZERO)); cursor.Valid(); cursor.Next()) {
+        std::pair<char, uint256> key;
+        if (!cursor.GetKey(key) || key.first != DB_SAPLING_ANCHOR)
+            break;
+        SaplingMerkleTree tree;
+        if (!cursor.GetValue(tree))
+            return error("%s : failed to read sapling anchor %s", __func__, key.second.ToString());
+        if (!fn(key.second, tree))
+            return false;
+    }
+    return true;
+}
+
+bool CCoinsViewDB::ForEachSaplingNullifier(CDBIterator& cursor, const std::function<bool(const uint256&)>& fn)
+{
+    for (cursor.Seek(std::make_pair(DB_SAPLING_NULLIFIER, UINT256_ZERO)); cursor.Valid(); cursor.Next()) {
+        std::pair<char, uint256> key;
+        if (!cursor.GetKey(key) || key.first != DB_SAPLING_NULLIFIER)
+            break;
+        if (!fn(key.second))
+            return false;
+    }
+    return true;
+}
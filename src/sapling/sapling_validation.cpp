@@ -104,6 +104,67 @@ bool CheckTransactionWithoutProofVerification(const CTransaction& tx, CValidatio
     return true;
 }
 
+// Verifies the spend/output proofs and the spend/binding signatures of a shielded tx
+static bool CheckTransactionProofs(const CTransaction& tx, CValidationState& state, const uint256& dataToBeSigned, int dosLevelPotentiallyRelaxing)
+{
+    // Sapling verification process
+    auto ctx = librustzcash_sapling_verification_ctx_init();
+
+    for (const SpendDescription &spend : tx.sapData->vShieldedSpend) {
+        if (!librustzcash_sapling_check_spend(
+                ctx,
+                spend.cv.begin(),
+                spend.anchor.begin(),
+                spend.nullifier.begin(),
+                spend.rk.begin(),
+                spend.zkproof.begin(),
+                spend.spendAuthSig.begin(),
+                dataToBeSigned.begin())) {
+            librustzcash_sapling_verification_ctx_free(ctx);
+            return state.DoS(
+                    dosLevelPotentiallyRelaxing,
+                    error("%s: Sapling spend description invalid", __func__ ),
+                    REJECT_INVALID, "bad-txns-sapling-spend-description-invalid");
+        }
+    }
+
+    for (const OutputDescription &output : tx.sapData->vShieldedOutput) {
+        if (!librustzcash_sapling_check_output(
+                ctx,
+                output.cv.begin(),
+                output.cmu.begin(),
+                output.ephemeralKey.begin(),
+                output.zkproof.begin())) {
+            librustzcash_sapling_verification_ctx_free(ctx);
+            // This should be a non-contextual check, but we check it here
+            // as we need to pass over the outputs anyway in order to then
+            // call librustzcash_sapling_final_check().
+            return state.DoS(100, error("%s: Sapling output description invalid", __func__ ),
+                             REJECT_INVALID, "bad-txns-sapling-output-description-invalid");
+        }
+    }
+
+    if (!librustzcash_sapling_final_check(
+            ctx,
+            tx.sapData->valueBalance,
+            tx.sapData->bindingSig.begin(),
+            dataToBeSigned.begin())) {
+        librustzcash_sapling_verification_ctx_free(ctx);
+        return state.DoS(
+                dosLevelPotentiallyRelaxing,
+                error("%s: Sapling binding signature invalid", __func__ ),
+                REJECT_INVALID, "bad-txns-sapling-binding-signature-invalid");
+    }
+
+    librustzcash_sapling_verification_ctx_free(ctx);
+    return true;
+}
+
+bool CSaplingProofCheck::operator()()
+{
+    return CheckTransactionProofs(*ptx, *pstate, dataToBeSigned, nDoSRelaxing);
+}
+
 /**
 * Check a transaction contextually against a set of consensus rules valid at a given block height.
 *
@@ -115,6 +176,8 @@ bool CheckTransactionWithoutProofVerification(const CTransaction& tx, CValidatio
 *    nHeight can become valid at a later height), we make the bans conditional on not
 *    being in Initial Block Download mode.
 * 4. The isInitBlockDownload argument is a function parameter to assist with testing.
+* 5. If pvChecks is not null, the proof and signature verification is not performed here,
+*    but appended to pvChecks (its result will be recorded in state).
 *
 */
 bool ContextualCheckTransaction(
@@ -123,7 +186,8 @@ bool ContextualCheckTransaction(
         const CChainParams& chainparams,
         const int nHeight,
         const bool isMined,
-        bool isInitBlockDownload)
+        bool isInitBlockDownload,
+        std::vector<CSaplingProofCheck>* pvChecks)
 {
     const int DOS_LEVEL_BLOCK = 100;
     // DoS level set to 10 to be more forgiving.
@@ -173,56 +237,12 @@ bool ContextualCheckTransaction(
                              REJECT_INVALID, "error-computing-signature-hash");
         }
 
-        // Sapling verification process
-        auto ctx = librustzcash_sapling_verification_ctx_init();
-
-        for (const SpendDescription &spend : tx.sapData->vShieldedSpend) {
-            if (!librustzcash_sapling_check_spend(
-                    ctx,
-                    spend.cv.begin(),
-                    spend.anchor.begin(),
-                    spend.nullifier.begin(),
-                    spend.rk.begin(),
-                    spend.zkproof.begin(),
-                    spend.spendAuthSig.begin(),
-                    dataToBeSigned.begin())) {
-                librustzcash_sapling_verification_ctx_free(ctx);
-                return state.DoS(
-                        dosLevelPotentiallyRelaxing,
-                        error("%s: Sapling spend description invalid", __func__ ),
-                        REJECT_INVALID, "bad-txns-sapling-spend-description-invalid");
-            }
-        }
-
-        for (const OutputDescription &output : tx.sapData->vShieldedOutput) {
-            if (!librustzcash_sapling_check_output(
-                    ctx,
-                    output.cv.begin(),
-                    output.cmu.begin(),
-                    output.ephemeralKey.begin(),
-                    output.zkproof.begin())) {
-                librustzcash_sapling_verification_ctx_free(ctx);
-                // This should be a non-contextual check, but we check it here
-                // as we need to pass over the outputs anyway in order to then
-                // call librustzcash_sapling_final_check().
-                return state.DoS(100, error("%s: Sapling output description invalid", __func__ ),
-                                 REJECT_INVALID, "bad-txns-sapling-output-description-invalid");
-            }
+        if (pvChecks) {
+            // Defer the (expensive) proof verification to the caller
+            pvChecks->emplace_back(tx, dataToBeSigned, dosLevelPotentiallyRelaxing, &state);
+        } else if (!CheckTransactionProofs(tx, state, dataToBeSigned, dosLevelPotentiallyRelaxing)) {
+            return false;
         }
-
-        if (!librustzcash_sapling_final_check(
-                ctx,
-                tx.sapData->valueBalance,
-                tx.sapData->bindingSig.begin(),
-                dataToBeSigned.begin())) {
-            librustzcash_sapling_verification_ctx_free(ctx);
-            return state.DoS(
-                    dosLevelPotentiallyRelaxing,
-                    error("%s: Sapling binding signature invalid", __func__ ),
-                    REJECT_INVALID, "bad-txns-sapling-binding-signature-invalid");
-        }
-
-        librustzcash_sapling_verification_ctx_free(ctx);
     }
     return true;
 }
@@ -8,12 +8,47 @@
 #define ISLAMIC_DIGITAL_COIN_SAPLING_VALIDATION_H
 
 #include "chainparams.h"
+#include "uint256.h"
+
+#include <vector>
 
 class CTransaction;
 class CValidationState;
 
 namespace SaplingValidation {
 
+/**
+ * Closure representing the proofs and signatures verification of one shielded transaction.
+ * Note that this stores references to the transaction and to the validation state, where
+ * the reason of a failure is recorded (so each check should have its own state object).
+ */
+class CSaplingProofCheck
+{
+private:
+    const CTransaction* ptx;
+    uint256 dataToBeSigned;
+    int nDoSRelaxing;
+    CValidationState* pstate;
+
+public:
+    CSaplingProofCheck() : ptx(nullptr), nDoSRelaxing(0), pstate(nullptr) {}
+    CSaplingProofCheck(const CTransaction& txIn, const uint256& dataToBeSignedIn, int nDoSRelaxingIn, CValidationState* pstateIn) :
+        ptx(&txIn),
+        dataToBeSigned(dataToBeSignedIn),
+        nDoSRelaxing(nDoSRelaxingIn),
+        pstate(pstateIn) {}
+
+    bool operator()();
+
+    void swap(CSaplingProofCheck& check)
+    {
+        std::swap(ptx, check.ptx);
+        std::swap(dataToBeSigned, check.dataToBeSigned);
+        std::swap(nDoSRelaxing, check.nDoSRelaxing);
+        std::swap(pstate, check.pstate);
+    }
+};
+
 /** Context-independent validity checks */
 // Note: for v3+, if the tx has no shielded data, this method returns true.
 // Note2: This function only performs shielded data related checks, it does NOT checks regular inputs and outputs.
@@ -22,9 +57,11 @@ bool CheckTransactionWithoutProofVerification(const CTransaction& tx, CValidatio
 
 /** Check a transaction contextually against a set of consensus rules */
 // Note: if v5 upgrade wasn't enforced, this method returns true without performing any check.
+// Note2: if pvChecks is not null, the proofs verification is deferred (appended to pvChecks).
 bool ContextualCheckTransaction(const CTransaction &tx, CValidationState &state,
                                 const CChainParams &chainparams, int nHeight, bool isMined,
-                                bool sInitBlockDownload);
+                                bool sInitBlockDownload,
+                                std::vector<CSaplingProofCheck>* pvChecks = nullptr);
 
 }; // End SaplingValidation namespace
 
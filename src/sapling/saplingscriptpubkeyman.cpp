@@ -6,8 +6,34 @@
 
 #include "sapling/saplingscriptpubkeyman.h"
 #include "chain.h" // for CBlockIndex
+#include "checkqueue.h"
 #include "validation.h" // for ReadBlockFromDisk()
 
+//! Number of incoming viewing keys tried by each trial decryption job
+static const size_t TRIAL_DECRYPTION_KEYS_PER_JOB = 8;
+
+static CCheckQueue<CSaplingTrialDecryption> saplingdecryptionqueue(16);
+// The check queue accepts a single master at a time
+static Mutex cs_saplingdecryptionqueue;
+
+void ThreadSaplingTrialDecryption()
+{
+    util::ThreadRename("islamic_digital_coin-saplingdc");
+    saplingdecryptionqueue.Thread();
+}
+
+bool CSaplingTrialDecryption::operator()()
+{
+    for (size_t i = nBegin; i < nEnd; i++) {
+        auto result = libzcash::SaplingNotePlaintext::decrypt(poutput->encCiphertext, (*pvIvk)[i], poutput->ephemeralKey, poutput->cmu);
+        if (result) {
+            *presult = std::make_pair(i, *result);
+            break;
+        }
+    }
+    return true;
+}
+
 void SaplingScriptPubKeyMan::AddToSaplingSpends(const uint256& nullifier, const uint256& wtxid)
 {
     AssertLockHeld(wallet->cs_wallet);
@@ -109,6 +135,24 @@ void SaplingScriptPubKeyMan::UpdateNullifierNoteMapWithTx(const CWalletTx& wtx)
     }
 }
 
+void SaplingScriptPubKeyMan::UpdateSaplingNoteTxsIndex(const CWalletTx& wtx)
+{
+    AssertLockHeld(wallet->cs_wallet);
+    for (const auto& item : wtx.mapSaplingNoteData) {
+        if (item.second.IsMyNote()) {
+            setSaplingNoteTxs.insert(wtx.GetHash());
+            return;
+        }
+    }
+    setSaplingNoteTxs.erase(wtx.GetHash());
+}
+
+void SaplingScriptPubKeyMan::EraseFromSaplingNoteTxsIndex(const uint256& txid)
+{
+    AssertLockHeld(wallet->cs_wallet);
+    setSaplingNoteTxs.erase(txid);
+}
+
 template<typename NoteDataMap>
 void CopyPreviousWitnesses(NoteDataMap& noteDataMap, int indexHeight, int64_t nWitnessCacheSize)
 {
@@ -138,8 +182,8 @@ void CopyPreviousWitnesses(NoteDataMap& noteDataMap, int indexHeight, int64_t nW
     }
 }
 
-template<typename NoteDataMap>
-void AppendNoteCommitment(NoteDataMap& noteDataMap, int indexHeight, int64_t nWitnessCacheSize, const uint256& note_commitment)
+template<typename NoteDataMap, typename NoteData>
+void CollectNotesToAppend(NoteDataMap& noteDataMap, int indexHeight, int64_t nWitnessCacheSize, std::map<NoteData*, size_t>& mapNotes)
 {
     for (auto& item : noteDataMap) {
         auto* nd = &(item.second);
@@ -149,19 +193,31 @@ void AppendNoteCommitment(NoteDataMap& noteDataMap, int indexHeight, int64_t nWi
             // Check the validity of the cache
             // See comment in CopyPreviousWitnesses about validity.
             assert(nWitnessCacheSize >= (int64_t) nd->witnesses.size());
-            nd->witnesses.front().append(note_commitment);
+            // existing witnesses get every commitment of the block
+            mapNotes[nd] = 0;
+        }
+    }
+}
+
+template<typename NoteData>
+void AppendNoteCommitments(std::map<NoteData*, size_t>& mapNotes, const std::vector<uint256>& vCommitments)
+{
+    for (auto& it : mapNotes) {
+        auto& witness = it.first->witnesses.front();
+        for (size_t i = it.second; i < vCommitments.size(); i++) {
+            witness.append(vCommitments[i]);
         }
     }
 }
 
 template<typename OutPoint, typename NoteData, typename Witness>
-void WitnessNoteIfMine(std::map<OutPoint, NoteData>& noteDataMap, int indexHeight, int64_t nWitnessCacheSize, const OutPoint& key, const Witness& witness)
+NoteData* WitnessNoteIfMine(std::map<OutPoint, NoteData>& noteDataMap, int indexHeight, int64_t nWitnessCacheSize, const OutPoint& key, const Witness& witness)
 {
     auto ndIt = noteDataMap.find(key);
     if (ndIt != noteDataMap.end()) {
         auto* nd = &ndIt->second;
         // skip externally sent and already witnessed notes
-        if (!nd->IsMyNote() || nd->witnessHeight >= indexHeight) return;
+        if (!nd->IsMyNote() || nd->witnessHeight >= indexHeight) return nullptr;
         if (nd->witnesses.size() > 0) {
             // We think this can happen because we write out the
             // witness cache state after every block increment or
@@ -184,7 +240,9 @@ void WitnessNoteIfMine(std::map<OutPoint, NoteData>& noteDataMap, int indexHeigh
         nd->witnessHeight = indexHeight - 1;
         // Check the validity of the cache
         assert(nWitnessCacheSize >= (int64_t) nd->witnesses.size());
+        return nd;
     }
+    return nullptr;
 }
 
 template<typename NoteDataMap>
@@ -209,8 +267,15 @@ void SaplingScriptPubKeyMan::IncrementNoteWitnesses(const CBlockIndex* pindex,
 {
     LOCK(wallet->cs_wallet);
     int chainHeight = pindex->nHeight;
-    for (std::pair<const uint256, CWalletTx>& wtxItem : wallet->mapWallet) {
-        ::CopyPreviousWitnesses(wtxItem.second.mapSaplingNoteData, chainHeight, nWitnessCacheSize);
+    // Only the txs holding our notes have witnesses to maintain
+    std::vector<mapSaplingNoteData_t*> vNoteDataMaps;
+    vNoteDataMaps.reserve(setSaplingNoteTxs.size());
+    for (const uint256& txid : setSaplingNoteTxs) {
+        vNoteDataMaps.emplace_back(&wallet->mapWallet.at(txid).mapSaplingNoteData);
+    }
+
+    for (mapSaplingNoteData_t* noteDataMap : vNoteDataMaps) {
+        ::CopyPreviousWitnesses(*noteDataMap, chainHeight, nWitnessCacheSize);
     }
 
     if (nWitnessCacheSize < WITNESS_CACHE_SIZE) {
@@ -218,34 +283,44 @@ void SaplingScriptPubKeyMan::IncrementNoteWitnesses(const CBlockIndex* pindex,
         nWitnessCacheNeedsUpdate = true;
     }
 
+    // Witnesses to be incremented, with the index of the first block
+    // commitment that each of them still needs to append
+    std::map<SaplingNoteData*, size_t> mapNotesToAppend;
+    for (mapSaplingNoteData_t* noteDataMap : vNoteDataMaps) {
+        ::CollectNotesToAppend(*noteDataMap, chainHeight, nWitnessCacheSize, mapNotesToAppend);
+    }
+
+    std::vector<uint256> vCommitments;
     for (const auto& tx : pblock->vtx) {
         if (!tx->IsShieldedTx()) continue;
 
         const uint256& hash = tx->GetHash();
-        bool txIsOurs = wallet->mapWallet.count(hash);
+        auto itWtx = wallet->mapWallet.find(hash);
+        bool txIsOurs = itWtx != wallet->mapWallet.end();
 
         // Sapling
         for (uint32_t i = 0; i < tx->sapData->vShieldedOutput.size(); i++) {
             const uint256& note_commitment = tx->sapData->vShieldedOutput[i].cmu;
             saplingTree.append(note_commitment);
-
-            // Increment existing witnesses
-            for (std::pair<const uint256, CWalletTx>& wtxItem : wallet->mapWallet) {
-                ::AppendNoteCommitment(wtxItem.second.mapSaplingNoteData, chainHeight, nWitnessCacheSize, note_commitment);
-            }
+            vCommitments.emplace_back(note_commitment);
 
             // If this is our note, witness it
             if (txIsOurs) {
                 SaplingOutPoint outPoint {hash, i};
-                ::WitnessNoteIfMine(wallet->mapWallet.at(hash).mapSaplingNoteData, chainHeight, nWitnessCacheSize, outPoint, saplingTree.witness());
+                SaplingNoteData* nd = ::WitnessNoteIfMine(itWtx->second.mapSaplingNoteData, chainHeight, nWitnessCacheSize, outPoint, saplingTree.witness());
+                // the new witness already includes every commitment up to this one
+                if (nd) mapNotesToAppend[nd] = vCommitments.size();
             }
         }
 
     }
 
+    // Increment witnesses, appending the block commitments in one pass per witness
+    ::AppendNoteCommitments(mapNotesToAppend, vCommitments);
+
     // Update witness heights
-    for (std::pair<const uint256, CWalletTx>& wtxItem : wallet->mapWallet) {
-        ::UpdateWitnessHeights(wtxItem.second.mapSaplingNoteData, chainHeight, nWitnessCacheSize);
+    for (mapSaplingNoteData_t* noteDataMap : vNoteDataMaps) {
+        ::UpdateWitnessHeights(*noteDataMap, chainHeight, nWitnessCacheSize);
     }
 
     // For performance reasons, we write out the witness cache in
@@ -298,8 +373,8 @@ void DecrementNoteWitnesses(NoteDataMap& noteDataMap, int indexHeight, int64_t n
 void SaplingScriptPubKeyMan::DecrementNoteWitnesses(int nChainHeight)
 {
     LOCK(wallet->cs_wallet);
-    for (std::pair<const uint256, CWalletTx>& wtxItem : wallet->mapWallet) {
-        ::DecrementNoteWitnesses(wtxItem.second.mapSaplingNoteData, nChainHeight, nWitnessCacheSize);
+    for (const uint256& txid : setSaplingNoteTxs) {
+        ::DecrementNoteWitnesses(wallet->mapWallet.at(txid).mapSaplingNoteData, nChainHeight, nWitnessCacheSize);
     }
     nWitnessCacheSize -= 1;
     nWitnessCacheNeedsUpdate = true;
@@ -328,35 +403,95 @@ std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> SaplingScriptPubKe
         return {};
     }
 
-    LOCK(wallet->cs_KeyStore);
-    const uint256& hash = tx.GetHash();
+    return TrialDecryptSaplingOutputs({&tx}).front();
+}
+
+std::vector<std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap>> SaplingScriptPubKeyMan::FindMySaplingNotes(const std::vector<CTransactionRef>& vtx) const
+{
+    std::vector<const CTransaction*> vptx;
+    vptx.reserve(vtx.size());
+    for (const auto& tx : vtx) {
+        vptx.emplace_back(tx.get());
+    }
+    return TrialDecryptSaplingOutputs(vptx);
+}
 
-    mapSaplingNoteData_t noteData;
-    SaplingIncomingViewingKeyMap viewingKeysToAdd;
+std::vector<std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap>> SaplingScriptPubKeyMan::TrialDecryptSaplingOutputs(const std::vector<const CTransaction*>& vtx) const
+{
+    std::vector<std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap>> vRet(vtx.size());
+
+    // Shielded outputs to scan, as (tx index, output index)
+    std::vector<std::pair<size_t, uint32_t>> vOutputs;
+    for (size_t nTx = 0; nTx < vtx.size(); nTx++) {
+        const CTransaction& tx = *vtx[nTx];
+        if (!tx.IsShieldedTx()) continue;
+        for (uint32_t i = 0; i < tx.sapData->vShieldedOutput.size(); ++i) {
+            vOutputs.emplace_back(nTx, i);
+        }
+    }
+    if (vOutputs.empty()) return vRet;
+
+    LOCK(wallet->cs_KeyStore);
+    std::vector<libzcash::SaplingIncomingViewingKey> vIvk;
+    vIvk.reserve(wallet->mapSaplingFullViewingKeys.size());
+    for (const auto& it : wallet->mapSaplingFullViewingKeys) {
+        vIvk.emplace_back(it.first);
+    }
+    if (vIvk.empty()) return vRet;
 
     // Protocol Spec: 4.19 Block Chain Scanning (Sapling)
-    for (uint32_t i = 0; i < tx.sapData->vShieldedOutput.size(); ++i) {
-        const OutputDescription output = tx.sapData->vShieldedOutput[i];
-        for (auto it = wallet->mapSaplingFullViewingKeys.begin(); it != wallet->mapSaplingFullViewingKeys.end(); ++it) {
-            libzcash::SaplingIncomingViewingKey ivk = it->first;
-            auto result = libzcash::SaplingNotePlaintext::decrypt(output.encCiphertext, ivk, output.ephemeralKey, output.cmu);
+    // Every output is tried against every ivk, split in jobs of TRIAL_DECRYPTION_KEYS_PER_JOB keys.
+    // Each job owns a result slot, so the outcome doesn't depend on the execution order.
+    const size_t nJobsPerOutput = (vIvk.size() + TRIAL_DECRYPTION_KEYS_PER_JOB - 1) / TRIAL_DECRYPTION_KEYS_PER_JOB;
+    std::vector<CSaplingTrialDecryption::Result> vResults(vOutputs.size() * nJobsPerOutput);
+    std::vector<CSaplingTrialDecryption> vJobs;
+    vJobs.reserve(vResults.size());
+    for (size_t n = 0; n < vOutputs.size(); n++) {
+        const OutputDescription* poutput = &vtx[vOutputs[n].first]->sapData->vShieldedOutput[vOutputs[n].second];
+        for (size_t j = 0; j < nJobsPerOutput; j++) {
+            const size_t nBegin = j * TRIAL_DECRYPTION_KEYS_PER_JOB;
+            const size_t nEnd = std::min(nBegin + TRIAL_DECRYPTION_KEYS_PER_JOB, vIvk.size());
+            vJobs.emplace_back(poutput, &vIvk, nBegin, nEnd, &vResults[n * nJobsPerOutput + j]);
+        }
+    }
+
+    if (nScriptCheckThreads && vJobs.size() > 1) {
+        LOCK(cs_saplingdecryptionqueue);
+        CCheckQueueControl<CSaplingTrialDecryption> control(&saplingdecryptionqueue);
+        control.Add(vJobs);
+        control.Wait();
+    } else {
+        for (CSaplingTrialDecryption& job : vJobs) {
+            job();
+        }
+    }
+
+    // Merge in (tx, output, ivk) order: an output belongs to the first ivk decrypting it
+    for (size_t n = 0; n < vOutputs.size(); n++) {
+        for (size_t j = 0; j < nJobsPerOutput; j++) {
+            const auto& result = vResults[n * nJobsPerOutput + j];
             if (!result) {
                 continue;
             }
 
+            const libzcash::SaplingIncomingViewingKey& ivk = vIvk[result->first];
+            const libzcash::SaplingNotePlaintext& plaintext = result->second;
+            auto& noteData = vRet[vOutputs[n].first].first;
+            auto& viewingKeysToAdd = vRet[vOutputs[n].first].second;
+
             // Check if we already have it.
-            Optional<libzcash::SaplingPaymentAddress> address = ivk.address(result.get().d);
+            Optional<libzcash::SaplingPaymentAddress> address = ivk.address(plaintext.d);
             if (address && wallet->mapSaplingIncomingViewingKeys.count(address.get()) == 0) {
                 viewingKeysToAdd[address.get()] = ivk;
             }
             // We don't cache the nullifier here as computing it requires knowledge of the note position
             // in the commitment tree, which can only be determined when the transaction has been mined.
-            SaplingOutPoint op {hash, i};
+            SaplingOutPoint op {vtx[vOutputs[n].first]->GetHash(), vOutputs[n].second};
             SaplingNoteData nd;
             nd.ivk = ivk;
-            nd.amount = result->value();
+            nd.amount = plaintext.value();
             nd.address = address;
-            const auto& memo = result->memo();
+            const auto& memo = plaintext.memo();
             // don't save empty memo (starting with 0xF6)
             if (memo[0] < 0xF6) {
                 nd.memo = memo;
@@ -366,7 +501,7 @@ std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> SaplingScriptPubKe
         }
     }
 
-    return std::make_pair(noteData, viewingKeysToAdd);
+    return vRet;
 }
 
 std::vector<libzcash::SaplingPaymentAddress> SaplingScriptPubKeyMan::FindMySaplingAddresses(const CTransaction& tx) const
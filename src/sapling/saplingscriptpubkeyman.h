@@ -134,6 +134,46 @@ enum KeyAddResult {
 
 typedef std::map<SaplingOutPoint, SaplingNoteData> mapSaplingNoteData_t;
 
+/**
+ * Closure representing the trial decryption of one Sapling output with a
+ * range of incoming viewing keys. The first key of the range able to
+ * decrypt the output is stored, together with the plaintext, in the
+ * result slot provided by the caller.
+ */
+class CSaplingTrialDecryption
+{
+public:
+    typedef Optional<std::pair<size_t, libzcash::SaplingNotePlaintext>> Result;
+
+private:
+    const OutputDescription* poutput{nullptr};
+    const std::vector<libzcash::SaplingIncomingViewingKey>* pvIvk{nullptr};
+    size_t nBegin{0};
+    size_t nEnd{0};
+    Result* presult{nullptr};
+
+public:
+    CSaplingTrialDecryption() {}
+    CSaplingTrialDecryption(const OutputDescription* poutputIn,
+                            const std::vector<libzcash::SaplingIncomingViewingKey>* pvIvkIn,
+                            size_t nBeginIn, size_t nEndIn, Result* presultIn) :
+                            poutput(poutputIn), pvIvk(pvIvkIn), nBegin(nBeginIn), nEnd(nEndIn), presult(presultIn) { }
+
+    bool operator()();
+
+    void swap(CSaplingTrialDecryption& check)
+    {
+        std::swap(poutput, check.poutput);
+        std::swap(pvIvk, check.pvIvk);
+        std::swap(nBegin, check.nBegin);
+        std::swap(nEnd, check.nEnd);
+        std::swap(presult, check.presult);
+    }
+};
+
+/** Run a Sapling trial decryption worker thread */
+void ThreadSaplingTrialDecryption();
+
 /*
  * Sapling keys manager
  * A class implementing SaplingScriptPubKeyMan manages all sapling keys and Notes used in a wallet.
@@ -173,6 +213,15 @@ public:
      */
     void UpdateNullifierNoteMapWithTx(const CWalletTx& wtx);
 
+    /**
+     * Keep track of the wallet txs holding at least one of our notes,
+     * so witnesses can be maintained without walking the whole mapWallet.
+     * Must be called every time a tx (or its note data) is added to mapWallet.
+     */
+    void UpdateSaplingNoteTxsIndex(const CWalletTx& wtx);
+    void EraseFromSaplingNoteTxsIndex(const uint256& txid);
+    const std::set<uint256>& GetSaplingNoteTxs() const { return setSaplingNoteTxs; }
+
     /**
      *  Update mapSaplingNullifiersToNotes, and NoteData of a specific outpoint,
      *  directly with nullifier provided by the caller.
@@ -272,6 +321,9 @@ public:
     //! Finds all output notes in the given tx that have been sent to a
     //! SaplingPaymentAddress in this wallet
     std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> FindMySaplingNotes(const CTransaction& tx) const;
+    //! Same as above, for every tx of a block (or block range). The (output x ivk)
+    //! trial decryptions are spread over the worker threads, results are in vtx order.
+    std::vector<std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap>> FindMySaplingNotes(const std::vector<CTransactionRef>& vtx) const;
 
     //! Find all of the addresses in the given tx that have been sent to a SaplingPaymentAddress in this wallet.
     std::vector<libzcash::SaplingPaymentAddress> FindMySaplingAddresses(const CTransaction& tx) const;
@@ -414,6 +466,11 @@ private:
     Optional<uint256> commonOVK;
     uint256 getCommonOVKFromSeed() const;
 
+    std::vector<std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap>> TrialDecryptSaplingOutputs(const std::vector<const CTransaction*>& vtx) const;
+
+    /* Wallet txs holding at least one of our notes (guarded by wallet->cs_wallet) */
+    std::set<uint256> setSaplingNoteTxs;
+
 
     /**
      * Used to keep track of spent Notes, and
@@ -7,10 +7,23 @@
 
 #include "chain.h"
 #include "txdb.h"
+#include "validation.h"
 #include "wallet/wallet.h"
 
 CIdcStake* CIdcStake::NewIdcStake(const CTxIn& txin)
 {
+    // Look the staked output up in the UTXO set first: unlike the previous
+    // transaction, it is available even if its block has been pruned.
+    {
+        LOCK(cs_main);
+        const Coin& coin = pcoinsTip->AccessCoin(txin.prevout);
+        if (!coin.IsSpent()) {
+            const CBlockIndex* pindexFrom = chainActive[coin.nHeight];
+            if (pindexFrom) {
+                return new CIdcStake(coin.out, txin.prevout, pindexFrom);
+            }
+        }
+    }
 
     // Find the previous transaction in database
     uint256 hashBlock;
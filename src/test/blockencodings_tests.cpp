@@ -0,0 +1,161 @@
+// Copyright (c) 2011-2016 The Bitcoin Core developers
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockencodings.h"
+#include "consensus/merkle.h"
+#include "policy/feerate.h"
+#include "streams.h"
+#include "txmempool.h"
+#include "version.h"
+
+#include "test/test_islamic_digital_coin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockencodings_tests, BasicTestingSetup)
+
+// A block with a coinbase and two transactions, or a coinstake and a transaction if fProofOfStake
+static CBlock BuildBlockTestCase(bool fProofOfStake)
+{
+    CBlock block;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig.resize(10);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 42;
+
+    block.vtx.resize(3);
+    block.vtx[0] = MakeTransactionRef(tx);
+    block.nVersion = 42;
+    block.hashPrevBlock = InsecureRand256();
+    block.nBits = 0x207fffff;
+
+    tx.vin[0].prevout.hash = InsecureRand256();
+    tx.vin[0].prevout.n = 0;
+    if (fProofOfStake) {
+        tx.vout.resize(2);
+        tx.vout[0].SetEmpty();
+        tx.vout[1].nValue = 42;
+    }
+    block.vtx[1] = MakeTransactionRef(tx);
+    BOOST_CHECK_EQUAL(block.vtx[1]->IsCoinStake(), fProofOfStake);
+
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 42;
+    tx.vin.resize(10);
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        tx.vin[i].prevout.hash = InsecureRand256();
+        tx.vin[i].prevout.n = 0;
+    }
+    block.vtx[2] = MakeTransactionRef(tx);
+
+    if (fProofOfStake)
+        block.vchBlockSig = {0x01, 0x02, 0x03};
+
+    bool mutated;
+    block.hashMerkleRoot = BlockMerkleRoot(block, &mutated);
+    assert(!mutated);
+    return block;
+}
+
+static CBlockHeaderAndShortTxIDs RoundTrip(const CBlockHeaderAndShortTxIDs& cmpctblock)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << cmpctblock;
+    CBlockHeaderAndShortTxIDs cmpctblock2;
+    stream >> cmpctblock2;
+    BOOST_CHECK(stream.empty());
+    return cmpctblock2;
+}
+
+BOOST_AUTO_TEST_CASE(SimpleRoundTripTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+    CBlock block(BuildBlockTestCase(false));
+
+    CMutableTransaction tx2(*block.vtx[2]);
+    LOCK(pool.cs);
+    pool.addUnchecked(block.vtx[2]->GetHash(), entry.FromTx(tx2));
+
+    CBlockHeaderAndShortTxIDs cmpctblock = RoundTrip(CBlockHeaderAndShortTxIDs(block));
+    BOOST_CHECK_EQUAL(cmpctblock.BlockTxCount(), 3);
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(cmpctblock) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(0));
+    BOOST_CHECK(!partialBlock.IsTxAvailable(1));
+    BOOST_CHECK(partialBlock.IsTxAvailable(2));
+
+    // Not enough transactions
+    PartiallyDownloadedBlock partialBlockCopy = partialBlock;
+    CBlock block2;
+    BOOST_CHECK(partialBlockCopy.FillBlock(block2, {}) == READ_STATUS_INVALID);
+
+    // A wrong transaction doesn't match the merkle root: the block is requested in full
+    partialBlockCopy = partialBlock;
+    BOOST_CHECK(partialBlockCopy.FillBlock(block2, {block.vtx[2]}) == READ_STATUS_FAILED);
+
+    CBlock block3;
+    BOOST_CHECK(partialBlock.FillBlock(block3, {block.vtx[1]}) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(block3.GetHash().ToString(), block.GetHash().ToString());
+    BOOST_CHECK_EQUAL(block3.hashMerkleRoot.ToString(), block.hashMerkleRoot.ToString());
+    BOOST_CHECK(block3.fCheckedMerkleRoot);
+}
+
+BOOST_AUTO_TEST_CASE(ProofOfStakeRoundTripTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    CBlock block(BuildBlockTestCase(true));
+
+    // The coinbase and the coinstake are prefilled
+    CBlockHeaderAndShortTxIDs cmpctblock = RoundTrip(CBlockHeaderAndShortTxIDs(block));
+    BOOST_CHECK_EQUAL(cmpctblock.BlockTxCount(), 3);
+    BOOST_CHECK(cmpctblock.vchBlockSig == block.vchBlockSig);
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(cmpctblock) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(0));
+    BOOST_CHECK(partialBlock.IsTxAvailable(1));
+    BOOST_CHECK(!partialBlock.IsTxAvailable(2));
+
+    CBlock block2;
+    BOOST_CHECK(partialBlock.FillBlock(block2, {block.vtx[2]}) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(block2.GetHash().ToString(), block.GetHash().ToString());
+    BOOST_CHECK(block2.IsProofOfStake());
+    BOOST_CHECK(block2.vchBlockSig == block.vchBlockSig);
+
+    // The reconstructed block serializes like the original one
+    CDataStream ss1(SER_NETWORK, PROTOCOL_VERSION), ss2(SER_NETWORK, PROTOCOL_VERSION);
+    ss1 << block;
+    ss2 << block2;
+    BOOST_CHECK(ss1.str() == ss2.str());
+}
+
+BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest)
+{
+    BlockTransactionsRequest req1;
+    req1.blockhash = InsecureRand256();
+    req1.indexes.resize(4);
+    req1.indexes[0] = 0;
+    req1.indexes[1] = 1;
+    req1.indexes[2] = 3;
+    req1.indexes[3] = 4;
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << req1;
+
+    BlockTransactionsRequest req2;
+    stream >> req2;
+
+    BOOST_CHECK_EQUAL(req1.blockhash.ToString(), req2.blockhash.ToString());
+    BOOST_CHECK_EQUAL(req1.indexes.size(), req2.indexes.size());
+    BOOST_CHECK_EQUAL(req1.indexes[0], req2.indexes[0]);
+    BOOST_CHECK_EQUAL(req1.indexes[1], req2.indexes[1]);
+    BOOST_CHECK_EQUAL(req1.indexes[2], req2.indexes[2]);
+    BOOST_CHECK_EQUAL(req1.indexes[3], req2.indexes[3]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
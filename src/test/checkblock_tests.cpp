@@ -9,6 +9,7 @@
 #include "test/test_islamic_digital_coin.h"
 
 #include "clientversion.h"
+#include "streams.h"
 #include "fs.h"
 #include "utiltime.h"
 #include "validation.h"
@@ -64,4 +65,38 @@ BOOST_AUTO_TEST_CASE(May15)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(header_hash_cache)
+{
+    // Quark (v3) and SHA256 (v4+) headers
+    for (int32_t nVersion : {3, 7, 10}) {
+        CBlockHeader header;
+        header.nVersion = nVersion;
+        header.hashPrevBlock = InsecureRand256();
+        header.hashMerkleRoot = InsecureRand256();
+        header.nTime = 1600000000;
+        header.nBits = 0x1e0ffff0;
+        header.nNonce = 1234;
+        if (nVersion >= 8) header.hashFinalSaplingRoot = InsecureRand256();
+        const uint256 hash = header.GetHash();
+
+        // The hash is cached on deserialization
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << header;
+        CBlock block;
+        ss >> *static_cast<CBlockHeader*>(&block);
+        BOOST_CHECK(block.GetHash() == hash);
+        BOOST_CHECK(block.GetBlockHeader().GetHash() == hash);
+
+        // and not used once the header changes
+        block.nNonce++;
+        header.nNonce++;
+        BOOST_CHECK(block.GetHash() == header.GetHash());
+        BOOST_CHECK(block.GetHash() != hash);
+        block.nNonce--;
+        BOOST_CHECK(block.GetHash() == hash);
+        block.hashMerkleRoot = InsecureRand256();
+        BOOST_CHECK(block.GetHash() != hash);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
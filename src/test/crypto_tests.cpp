@@ -7,14 +7,20 @@
 #include "crypto/aes.h"
 #include "crypto/rfc6979_hmac_sha256.h"
 #include "crypto/chacha20.h"
+#include "crypto/muhash.h"
+#include "crypto/quark.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "hash.h"
+#include "primitives/block.h"
 #include "random.h"
+#include "streams.h"
 #include "utilstrencodings.h"
+#include "version.h"
 #include "test/test_islamic_digital_coin.h"
 
 #include <vector>
@@ -269,6 +275,131 @@ BOOST_AUTO_TEST_CASE(sha256_testvectors) {
     TestSHA256(test1, "a316d55510b49662420f49d145d42fb83f31ef8dc016aa4e32df049991a91e26");
 }
 
+BOOST_AUTO_TEST_CASE(sha256d64)
+{
+    // Check every available backend against the generic double-SHA256.
+    const sha256_implementation::UseImplementation impls[] = {
+        sha256_implementation::STANDARD,
+        sha256_implementation::USE_SSE41,
+        sha256_implementation::USE_SSE41_AND_AVX2,
+        sha256_implementation::USE_SHANI,
+        sha256_implementation::USE_ALL,
+    };
+    for (const auto impl : impls) {
+        SHA256AutoDetect(impl);
+        for (int i = 0; i <= 32; ++i) {
+            unsigned char in[64 * 32];
+            unsigned char out1[32 * 32], out2[32 * 32];
+            for (int j = 0; j < 64 * i; ++j) {
+                in[j] = InsecureRandBits(8);
+            }
+            for (int j = 0; j < i; ++j) {
+                CHash256().Write(in + 64 * j, 64).Finalize(out1 + 32 * j);
+            }
+            SHA256D64(out2, in, i);
+            BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+        }
+        // Long messages go through the (possibly accelerated) multi-block Transform.
+        TestSHA256(std::string(1000000, 'a'),
+                   "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+    }
+    SHA256AutoDetect();
+}
+
+BOOST_AUTO_TEST_CASE(sha256d_multi)
+{
+    // Check every available backend against the generic double-SHA256,
+    // for messages of one, two and three blocks once padded.
+    const sha256_implementation::UseImplementation impls[] = {
+        sha256_implementation::STANDARD,
+        sha256_implementation::USE_SSE41,
+        sha256_implementation::USE_SSE41_AND_AVX2,
+        sha256_implementation::USE_SHANI,
+        sha256_implementation::USE_ALL,
+    };
+    const size_t lens[] = {0, 52, 55, 56, 64, 76, 119, 120, 150};
+    for (const auto impl : impls) {
+        SHA256AutoDetect(impl);
+        for (const size_t len : lens) {
+            for (int i = 0; i <= 19; ++i) {
+                std::vector<unsigned char> in(len * i);
+                std::vector<unsigned char> out1(32 * i), out2(32 * i);
+                for (unsigned char& c : in) {
+                    c = InsecureRandBits(8);
+                }
+                for (int j = 0; j < i; ++j) {
+                    CHash256().Write(in.data() + len * j, len).Finalize(out1.data() + 32 * j);
+                }
+                SHA256DMulti(out2.data(), in.data(), len, i);
+                BOOST_CHECK(out1 == out2);
+            }
+        }
+    }
+    SHA256AutoDetect();
+}
+
+BOOST_AUTO_TEST_CASE(quark_multi)
+{
+    // Check every available backend against HashQuark, for header-sized
+    // messages and for lengths around the single-block BLAKE-512 limit.
+    const quark_implementation::UseImplementation impls[] = {
+        quark_implementation::STANDARD,
+        quark_implementation::USE_AVX2,
+    };
+    const size_t lens[] = {0, 64, 80, 111, 112, 150};
+    for (const auto impl : impls) {
+        QuarkAutoDetect(impl);
+        for (const size_t len : lens) {
+            for (int i = 0; i <= 19; ++i) {
+                std::vector<unsigned char> in(len * i);
+                std::vector<unsigned char> out1(32 * i), out2(32 * i);
+                for (unsigned char& c : in) {
+                    c = InsecureRandBits(8);
+                }
+                for (int j = 0; j < i; ++j) {
+                    const unsigned char* begin = in.data() + len * j;
+                    uint256 hash = HashQuark(begin, begin + len);
+                    memcpy(out1.data() + 32 * j, hash.begin(), 32);
+                }
+                QuarkHashMulti(out2.data(), in.data(), len, i);
+                BOOST_CHECK(out1 == out2);
+            }
+        }
+    }
+    QuarkAutoDetect();
+}
+
+BOOST_AUTO_TEST_CASE(block_header_batch_hash)
+{
+    // Legacy (Quark) and current headers, read without hashing and hashed in a batch
+    std::vector<CBlockHeader> headers(11);
+    for (size_t i = 0; i < headers.size(); i++) {
+        CBlockHeader& header = headers[i];
+        header.nVersion = i % 3 ? 3 : CBlockHeader::CURRENT_VERSION;
+        header.hashPrevBlock = InsecureRand256();
+        header.hashMerkleRoot = InsecureRand256();
+        header.nTime = InsecureRand32();
+        header.nBits = InsecureRand32();
+        header.nNonce = InsecureRand32();
+        if (header.nVersion >= 8) header.hashFinalSaplingRoot = InsecureRand256();
+    }
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << headers;
+    ss.SetType(SER_NETWORK | SER_NOHASHCACHE);
+    std::vector<CBlockHeader> read;
+    ss >> read;
+    UpdateBlockHeaderHashCaches(read);
+
+    const std::vector<uint256> hashes = GetBlockHeaderHashes(headers);
+    BOOST_CHECK_EQUAL(read.size(), headers.size());
+    for (size_t i = 0; i < headers.size(); i++) {
+        const uint256 hash = headers[i].nVersion < 4 ? HashQuark(BEGIN(headers[i].nVersion), END(headers[i].nNonce))
+                                                     : SerializeHash(headers[i]);
+        BOOST_CHECK(hashes[i] == hash);
+        BOOST_CHECK(read[i].GetHash() == hash);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(sha512_testvectors) {
     TestSHA512("",
                "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
@@ -449,6 +580,76 @@ BOOST_AUTO_TEST_CASE(chacha20_testvector)
                  "fab78c9");
 }
 
+static MuHash3072 FromInt(unsigned char i)
+{
+    unsigned char tmp[32] = {i, 0};
+    return MuHash3072(tmp, sizeof(tmp));
+}
+
+static uint256 FinalizeMuHash(MuHash3072& muhash)
+{
+    uint256 out;
+    muhash.Finalize(out.begin());
+    return out;
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    uint256 res;
+    int table[4];
+    for (int i = 0; i < 4; ++i) {
+        table[i] = InsecureRandBits(3);
+    }
+    for (int order = 0; order < 4; ++order) {
+        MuHash3072 acc;
+        for (int i = 0; i < 4; ++i) {
+            int t = table[i ^ order];
+            if (t & 4) {
+                acc /= FromInt(t & 3);
+            } else {
+                acc *= FromInt(t & 3);
+            }
+        }
+        uint256 out = FinalizeMuHash(acc);
+        if (order == 0) {
+            res = out;
+        } else {
+            BOOST_CHECK(res == out);
+        }
+    }
+
+    // Removing what was inserted, in any order, gives back the empty set
+    MuHash3072 x = FromInt(InsecureRandBits(2));
+    MuHash3072 y = FromInt(InsecureRandBits(2));
+    MuHash3072 z;
+    z *= x;
+    z *= y;
+    z /= x;
+    z /= y;
+    MuHash3072 empty;
+    BOOST_CHECK(FinalizeMuHash(z) == FinalizeMuHash(empty));
+
+    // Test vector, compatible with the MuHash3072 of Bitcoin Core
+    MuHash3072 acc = FromInt(0);
+    acc *= FromInt(1);
+    acc /= FromInt(2);
+    BOOST_CHECK_EQUAL(FinalizeMuHash(acc).GetHex(), "10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863");
+
+    MuHash3072 acc2 = FromInt(0);
+    unsigned char tmp[32] = {1, 0};
+    acc2.Insert(tmp, sizeof(tmp));
+    unsigned char tmp2[32] = {2, 0};
+    acc2.Remove(tmp2, sizeof(tmp2));
+    BOOST_CHECK_EQUAL(FinalizeMuHash(acc2).GetHex(), "10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863");
+
+    // Finalizing keeps the value, and the state survives serialization
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << acc;
+    MuHash3072 acc3;
+    ss >> acc3;
+    BOOST_CHECK(FinalizeMuHash(acc3) == FinalizeMuHash(acc));
+}
+
 BOOST_AUTO_TEST_CASE(countbits_tests)
 {
     FastRandomContext ctx;
@@ -0,0 +1,109 @@
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_islamic_digital_coin.h"
+
+#include "chainparams.h"
+#include "kernel.h"
+#include "timedata.h"
+#include "utiltime.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(kernel_tests, BasicTestingSetup)
+
+// Stake input with a given uniqueness and value, passing or failing the contextual checks
+class CFakeStake : public CStakeInput
+{
+private:
+    CDataStream uniqueness;
+    CAmount nValue;
+    bool fContextCheck;
+
+public:
+    CFakeStake(const CBlockIndex* _pindexFrom, const CDataStream& _uniqueness, CAmount _nValue, bool _fContextCheck) :
+            CStakeInput(_pindexFrom), uniqueness(_uniqueness), nValue(_nValue), fContextCheck(_fContextCheck) {}
+
+    bool InitFromTxIn(const CTxIn& txin) override { return true; }
+    const CBlockIndex* GetIndexFrom() const override { return pindexFrom; }
+    bool CreateTxIn(CWallet* pwallet, CTxIn& txIn, uint256 hashTxOut) override { return false; }
+    bool GetTxOutFrom(CTxOut& out) const override { return false; }
+    CAmount GetValue() const override { return nValue; }
+    bool CreateTxOuts(CWallet* pwallet, std::vector<CTxOut>& vout, CAmount nTotal, const bool onlyP2PK) override { return false; }
+    CDataStream GetUniqueness() const override { return uniqueness; }
+    bool ContextCheck(int nHeight, uint32_t nTime) override { return fContextCheck; }
+};
+
+BOOST_AUTO_TEST_CASE(find_kernel_matches_stake)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    SetMockTime(1600000000);
+
+    // Parent block past the modifier v2 upgrade
+    CBlockIndex indexPrev;
+    indexPrev.nHeight = 300;
+    indexPrev.nTime = GetTime() - 60;
+    indexPrev.SetStakeModifier(InsecureRand256());
+    std::vector<CBlockIndex> vIndexFrom(4);
+    for (size_t i = 0; i < vIndexFrom.size(); i++) {
+        vIndexFrom[i].nHeight = 100 + i;
+        vIndexFrom[i].nTime = GetTime() - 3600 * (i + 1);
+    }
+
+    // Target of 2^248 per 100 satoshis: a stake of k * 100 satoshis hits with probability k / 256
+    const unsigned int nBits = 0x20010000;
+    const CStakeKernelSearch kernelSearch(&indexPrev, nBits);
+
+    int nHits = 0;
+    int nMisses = 0;
+    for (int round = 0; round < 20; round++) {
+        std::vector<std::unique_ptr<CFakeStake>> vStakes;
+        std::vector<CStakeInput*> vInputs;
+        for (int i = 0; i < 64; i++) {
+            CDataStream uniqueness(SER_GETHASH, 0);
+            uniqueness << COutPoint(InsecureRand256(), InsecureRandRange(4));
+            // Kernels of different lengths are hashed one by one
+            if (round % 4 == 3 && i % 7 == 0) uniqueness << (uint8_t) InsecureRandBits(8);
+            vStakes.emplace_back(new CFakeStake(&vIndexFrom[InsecureRandRange(vIndexFrom.size())],
+                                                uniqueness,
+                                                (1 + InsecureRandRange(32)) * 100,
+                                                InsecureRandRange(8) != 0));
+            vInputs.emplace_back(i == 5 && round % 2 ? nullptr : vStakes.back().get());
+        }
+
+        // Check each candidate on its own
+        std::vector<bool> vHit(vInputs.size());
+        std::vector<int64_t> vTime(vInputs.size(), 0);
+        for (size_t i = 0; i < vInputs.size(); i++) {
+            vHit[i] = Stake(&indexPrev, vInputs[i], nBits, vTime[i]);
+            if (vHit[i]) nHits++;
+            else nMisses++;
+        }
+
+        // The search finds the same kernels, in order, with the same time
+        size_t nStart = 0;
+        while (true) {
+            std::vector<CStakeInput*> vSearched(vInputs.begin() + nStart, vInputs.end());
+            int64_t nTimeTx = 0;
+            const int nFound = kernelSearch.FindKernel(vSearched, nTimeTx);
+            BOOST_CHECK_EQUAL(nTimeTx, GetAdjustedTime());
+            size_t nExpected = nStart;
+            while (nExpected < vInputs.size() && !vHit[nExpected]) nExpected++;
+            if (nExpected == vInputs.size()) {
+                BOOST_CHECK_EQUAL(nFound, -1);
+                break;
+            }
+            BOOST_CHECK_EQUAL(nFound, (int) (nExpected - nStart));
+            if (nFound < 0) break;
+            BOOST_CHECK_EQUAL(nTimeTx, vTime[nExpected]);
+            nStart = nExpected + 1;
+        }
+    }
+    BOOST_CHECK(nHits > 0);
+    BOOST_CHECK(nMisses > 0);
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
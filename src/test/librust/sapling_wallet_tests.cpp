@@ -177,6 +177,20 @@ BOOST_AUTO_TEST_CASE(FindMySaplingNotes) {
     noteMap = wallet.GetSaplingScriptPubKeyMan()->FindMySaplingNotes(*wtx.tx).first;
     BOOST_CHECK_EQUAL(2, noteMap.size());
 
+    // Scanning several txs at once, with the keys spread over more than one
+    // decryption job, gives the same notes as the single tx scan
+    for (int i = 0; i < 10; i++) {
+        wallet.GenerateNewSaplingZKey();
+    }
+    noteMap = wallet.GetSaplingScriptPubKeyMan()->FindMySaplingNotes(*wtx.tx).first;
+    BOOST_CHECK_EQUAL(2, noteMap.size());
+    std::vector<CTransactionRef> vtx = {wtx.tx, MakeTransactionRef(CMutableTransaction()), wtx.tx};
+    auto vNotes = wallet.GetSaplingScriptPubKeyMan()->FindMySaplingNotes(vtx);
+    BOOST_CHECK_EQUAL(3, vNotes.size());
+    BOOST_CHECK(vNotes[0].first == noteMap);
+    BOOST_CHECK(vNotes[1].first.empty());
+    BOOST_CHECK(vNotes[2].first == noteMap);
+
     // Revert to default
     RegtestDeactivateSapling();
 }
@@ -631,6 +645,8 @@ BOOST_AUTO_TEST_CASE(CachedWitnessesEmptyChain) {
     BOOST_CHECK(!(bool) saplingWitnesses[0]);
 
     wallet.LoadToWallet(wtx);
+    // The tx holding our note is tracked for witness updates
+    BOOST_CHECK(WITH_LOCK(wallet.cs_wallet, return wallet.GetSaplingScriptPubKeyMan()->GetSaplingNoteTxs().count(wtx.GetHash())));
 
     ::GetWitnessesAndAnchors(wallet, saplingNotes, saplingWitnesses);
 
@@ -924,6 +940,80 @@ BOOST_AUTO_TEST_CASE(ClearNoteWitnessCache) {
     BOOST_CHECK_EQUAL(0, wallet.GetSaplingScriptPubKeyMan()->nWitnessCacheSize);
 }
 
+BOOST_AUTO_TEST_CASE(SaplingNoteTxsIndex) {
+    auto consensusParams = RegtestActivateSapling();
+
+    libzcash::SaplingExtendedSpendingKey sk = GetTestMasterSaplingSpendingKey();
+    CWallet& wallet = *pwalletMain;
+    {
+        LOCK(wallet.cs_wallet);
+        setupWallet(wallet);
+        BOOST_CHECK(wallet.AddSaplingZKey(sk));
+    }
+    SaplingScriptPubKeyMan* sspkm = wallet.GetSaplingScriptPubKeyMan();
+    auto getNoteTxs = [&]() { return WITH_LOCK(wallet.cs_wallet, return sspkm->GetSaplingNoteTxs()); };
+
+    // Empty index: the witness cache moves with the chain, with no tx to visit
+    BOOST_CHECK(getNoteTxs().empty());
+    CBlock block1;
+    block1.vtx.emplace_back(GetValidSaplingReceive(Params().GetConsensus(), wallet, sk, 10, true).tx);
+    CBlockIndex index1(block1);
+    index1.nHeight = 1;
+    CBlock block2;
+    block2.vtx.emplace_back(GetValidSaplingReceive(Params().GetConsensus(), wallet, sk, 10, true).tx);
+    CBlockIndex index2(block2);
+    index2.nHeight = 2;
+    SaplingMerkleTree saplingTree;
+    wallet.IncrementNoteWitnesses(&index1, &block1, saplingTree);
+    SaplingMerkleTree saplingTree1 = saplingTree;
+    wallet.IncrementNoteWitnesses(&index2, &block2, saplingTree);
+    BOOST_CHECK_EQUAL(sspkm->nWitnessCacheSize, 2);
+    wallet.DecrementNoteWitnesses(&index2);
+    BOOST_CHECK_EQUAL(sspkm->nWitnessCacheSize, 1);
+    wallet.IncrementNoteWitnesses(&index2, &block2, saplingTree1);
+    BOOST_CHECK_EQUAL(sspkm->nWitnessCacheSize, 2);
+    BOOST_CHECK(getNoteTxs().empty());
+
+    // A tx without note data isn't indexed
+    CWalletTx wtx = GetValidSaplingReceive(Params().GetConsensus(), wallet, sk, 10, true);
+    const uint256 hash = wtx.GetHash();
+    BOOST_CHECK(wallet.AddToWallet(wtx));
+    BOOST_CHECK(getNoteTxs().empty());
+
+    // Until its note data is replaced with one of our notes
+    CWalletTx wtxMine = wtx;
+    auto saplingNotes = SetSaplingNoteData(wtxMine);
+    BOOST_CHECK(wallet.AddToWallet(wtxMine));
+    BOOST_CHECK(getNoteTxs() == std::set<uint256>{hash});
+
+    // And removed when the note data is replaced with notes not ours
+    CWalletTx wtxNotMine = wtx;
+    mapSaplingNoteData_t noteDataNotMine;
+    noteDataNotMine[saplingNotes[0]] = SaplingNoteData();
+    wtxNotMine.SetSaplingNoteData(noteDataNotMine);
+    BOOST_CHECK(wallet.AddToWallet(wtxNotMine));
+    BOOST_CHECK(getNoteTxs().empty());
+
+    // Or when the tx is erased from the wallet
+    BOOST_CHECK(wallet.AddToWallet(wtxMine));
+    BOOST_CHECK(getNoteTxs() == std::set<uint256>{hash});
+    wallet.EraseFromWallet(hash);
+    BOOST_CHECK(getNoteTxs().empty());
+
+    // The erased tx isn't visited by the next witness updates
+    CBlock block3;
+    block3.vtx.emplace_back(wtx.tx);
+    CBlockIndex index3(block3);
+    index3.nHeight = 3;
+    wallet.IncrementNoteWitnesses(&index3, &block3, saplingTree);
+    BOOST_CHECK_EQUAL(sspkm->nWitnessCacheSize, 3);
+    wallet.DecrementNoteWitnesses(&index3);
+    BOOST_CHECK_EQUAL(sspkm->nWitnessCacheSize, 2);
+
+    // Revert to default
+    RegtestDeactivateSapling();
+}
+
 BOOST_AUTO_TEST_CASE(UpdatedSaplingNoteData) {
     auto consensusParams = RegtestActivateSapling();
 
@@ -103,6 +103,25 @@ BOOST_AUTO_TEST_CASE(SaplingToSapling) {
     BOOST_CHECK(SaplingValidation::ContextualCheckTransaction(tx2, state, Params(), 3, true, false));
     BOOST_CHECK_EQUAL(state.GetRejectReason(), "");
 
+    // The proofs verification can be deferred (as done for blocks, with the check queue)
+    std::vector<SaplingValidation::CSaplingProofCheck> vChecks;
+    CValidationState state2;
+    BOOST_CHECK(SaplingValidation::ContextualCheckTransaction(tx2, state2, Params(), 3, true, false, &vChecks));
+    BOOST_CHECK_EQUAL(vChecks.size(), 1);
+    BOOST_CHECK(vChecks[0]());
+    BOOST_CHECK(state2.IsValid());
+
+    // An invalid binding signature is detected by the deferred check, and recorded in its state
+    CMutableTransaction mtx2(tx2);
+    mtx2.sapData->bindingSig[0] ^= 1;
+    CTransaction tx3(mtx2);
+    vChecks.clear();
+    CValidationState state3;
+    BOOST_CHECK(SaplingValidation::ContextualCheckTransaction(tx3, state3, Params(), 3, true, false, &vChecks));
+    BOOST_CHECK_EQUAL(vChecks.size(), 1);
+    BOOST_CHECK(!vChecks[0]());
+    BOOST_CHECK_EQUAL(state3.GetRejectReason(), "bad-txns-sapling-binding-signature-invalid");
+
     // Revert to default
     RegtestDeactivateSapling();
 }
@@ -0,0 +1,75 @@
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_islamic_digital_coin.h"
+
+#include "masternode-payments.h"
+#include "streams.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(masternode_payments_tests, BasicTestingSetup)
+
+// Votes of nVotes different masternodes for payee at nHeight
+static void AddVotes(CMasternodePayments& payments, const CScript& payee, int nHeight, int nVotes)
+{
+    for (int i = 0; i < nVotes; i++) {
+        CMasternodePaymentWinner winner(CTxIn(COutPoint(InsecureRand256(), 0)));
+        winner.nBlockHeight = nHeight;
+        winner.AddPayee(payee);
+        BOOST_CHECK(payments.AddWinningMasternode(winner));
+        // The same vote again is ignored
+        BOOST_CHECK(!payments.AddWinningMasternode(winner));
+    }
+}
+
+static int LastPaidHeight(const CMasternodePayments& payments, const CScript& payee, int nMinHeight, int nMaxHeight)
+{
+    int nHeight = -1;
+    return payments.GetLastPaidHeight(payee, nMinHeight, nMaxHeight, nHeight) ? nHeight : -1;
+}
+
+BOOST_AUTO_TEST_CASE(last_paid_height_index)
+{
+    const CScript payeeA = CScript() << OP_TRUE;
+    const CScript payeeB = CScript() << OP_FALSE;
+    CMasternodePayments payments;
+    AddVotes(payments, payeeA, 10, 2);
+    AddVotes(payments, payeeA, 40, 3);
+    AddVotes(payments, payeeA, 60, 1);
+    AddVotes(payments, payeeB, 60, 2);
+
+    // The latest height with enough votes, within the range
+    BOOST_CHECK_EQUAL(LastPaidHeight(payments, payeeA, 0, 100), 40);
+    BOOST_CHECK_EQUAL(LastPaidHeight(payments, payeeA, 0, 40), 40);
+    BOOST_CHECK_EQUAL(LastPaidHeight(payments, payeeA, 0, 39), 10);
+    BOOST_CHECK_EQUAL(LastPaidHeight(payments, payeeA, 11, 39), -1);
+    BOOST_CHECK_EQUAL(LastPaidHeight(payments, payeeA, 0, 9), -1);
+    BOOST_CHECK_EQUAL(LastPaidHeight(payments, payeeB, 0, 100), 60);
+    BOOST_CHECK_EQUAL(LastPaidHeight(payments, CScript() << OP_2, 0, 100), -1);
+
+    // A height is indexed once the payee gets enough votes for it
+    AddVotes(payments, payeeA, 60, 1);
+    BOOST_CHECK_EQUAL(LastPaidHeight(payments, payeeA, 0, 100), 60);
+
+    // The index is rebuilt when the payments are loaded
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << payments;
+    CMasternodePayments paymentsLoaded;
+    ss >> paymentsLoaded;
+    BOOST_CHECK_EQUAL(LastPaidHeight(paymentsLoaded, payeeA, 0, 100), 60);
+    BOOST_CHECK_EQUAL(LastPaidHeight(paymentsLoaded, payeeA, 0, 59), 40);
+    BOOST_CHECK_EQUAL(LastPaidHeight(paymentsLoaded, payeeB, 0, 100), 60);
+
+    // The heights removed from the payment list are removed from the index
+    payments.CleanPaymentList(0, 1045);
+    BOOST_CHECK_EQUAL(LastPaidHeight(payments, payeeA, 0, 100), 60);
+    BOOST_CHECK_EQUAL(LastPaidHeight(payments, payeeA, 0, 59), -1);
+    BOOST_CHECK_EQUAL(LastPaidHeight(payments, payeeB, 0, 100), 60);
+    payments.CleanPaymentList(0, 1100);
+    BOOST_CHECK_EQUAL(LastPaidHeight(payments, payeeA, 0, 100), -1);
+    BOOST_CHECK_EQUAL(LastPaidHeight(payments, payeeB, 0, 100), -1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
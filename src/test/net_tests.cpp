@@ -7,6 +7,7 @@
 #include "hash.h"
 #include "net.h"
 #include "netbase.h"
+#include "netmessagemaker.h"
 #include "serialize.h"
 #include "streams.h"
 
@@ -176,4 +177,104 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+BOOST_AUTO_TEST_CASE(cnetmsg_copy)
+{
+    const std::vector<unsigned char> payload(1000, 0x42);
+    CSerializedNetMsg msg = CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::BLOCK);
+    msg.data = payload;
+
+    // The copies share the payload and the header, which are moved out of the original message
+    CSerializedNetMsg copy1 = msg.Copy();
+    CSerializedNetMsg copy2 = msg.Copy();
+    BOOST_CHECK(msg.data.empty());
+    BOOST_CHECK(copy1.data.empty() && copy2.data.empty());
+    BOOST_CHECK_EQUAL(copy1.command, NetMsgType::BLOCK);
+    BOOST_CHECK_EQUAL(copy2.command, NetMsgType::BLOCK);
+    BOOST_CHECK(copy1.sharedData == copy2.sharedData);
+    BOOST_CHECK(copy1.sharedHeader == copy2.sharedHeader);
+    BOOST_CHECK(*copy1.sharedData == payload);
+
+    // The header is the one of the payload
+    CMessageHeader hdr(Params().MessageStart());
+    CDataStream ss(*copy1.sharedHeader, SER_NETWORK, INIT_PROTO_VERSION);
+    ss >> hdr;
+    BOOST_CHECK(hdr.IsValid(Params().MessageStart()));
+    BOOST_CHECK_EQUAL(hdr.GetCommand(), NetMsgType::BLOCK);
+    BOOST_CHECK_EQUAL(hdr.nMessageSize, payload.size());
+    uint256 hash = Hash(payload.begin(), payload.end());
+    BOOST_CHECK(memcmp(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE) == 0);
+}
+
+#ifndef WIN32
+class CConnmanTest : public CConnman
+{
+public:
+    CConnmanTest() : CConnman(0x1337, 0x1337) {}
+    using CConnman::SocketSendData;
+};
+
+BOOST_AUTO_TEST_CASE(socket_send_data_partial)
+{
+    // The socket takes a few KiB at once: the messages queued are sent in several
+    // system calls, which end in the middle of a header or a payload.
+    int fds[2];
+    BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    int nBufSize = 4096;
+    BOOST_REQUIRE(setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &nBufSize, sizeof(nBufSize)) == 0);
+
+    CConnmanTest connman;
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = 0xa0b0c001;
+    CAddress addr = CAddress(CService(ipv4Addr, 7777), NODE_NETWORK);
+    // The node owns and closes fds[0]
+    CNode node(0, NODE_NETWORK, 0, fds[0], addr, 0, 0, "", false);
+
+    // Messages with no, small and large payloads, some sharing their buffers
+    std::vector<unsigned char> expected;
+    CSerializedNetMsg msgShared = CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::BLOCK);
+    msgShared.data = InsecureRandBytes(30000);
+    for (int i = 0; i < 40; i++) {
+        CSerializedNetMsg msg;
+        if (i % 4 == 0) {
+            msg = msgShared.Copy();
+        } else {
+            msg = CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::TX);
+            msg.data = InsecureRandBytes(i % 4 == 1 ? 0 : InsecureRandRange(i % 4 == 2 ? 100 : 20000));
+            msg = msg.Copy();
+        }
+        expected.insert(expected.end(), msg.sharedHeader->begin(), msg.sharedHeader->end());
+        if (msg.sharedData)
+            expected.insert(expected.end(), msg.sharedData->begin(), msg.sharedData->end());
+        connman.PushMessage(&node, std::move(msg));
+    }
+
+    std::vector<unsigned char> received;
+    bool fPartial = false;
+    for (int nTries = 0; nTries < 10000; nTries++) {
+        unsigned char buf[1000];
+        ssize_t nRead;
+        while ((nRead = recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+            received.insert(received.end(), buf, buf + nRead);
+
+        LOCK(node.cs_vSend);
+        // The size queued is the one of the buffers left, of which only the first is partly sent
+        size_t nQueued = 0;
+        for (const CSendBufferRef& buffer : node.vSendMsg)
+            nQueued += buffer->size();
+        BOOST_CHECK_EQUAL(node.nSendSize, nQueued);
+        BOOST_CHECK_EQUAL(received.size() + nQueued - node.nSendOffset, expected.size());
+        BOOST_CHECK_EQUAL(node.nSendBytes, received.size());
+        if (node.vSendMsg.empty())
+            break;
+        BOOST_CHECK(node.nSendOffset < node.vSendMsg.front()->size());
+        fPartial |= node.nSendOffset != 0;
+        connman.SocketSendData(&node);
+    }
+    BOOST_CHECK(fPartial);
+    BOOST_CHECK_EQUAL(node.nSendOffset, 0U);
+    BOOST_CHECK(received == expected);
+    close(fds[1]);
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
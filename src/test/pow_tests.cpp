@@ -0,0 +1,37 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "chainparams.h"
+#include "pow.h"
+#include "test/test_islamic_digital_coin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(pow_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
+{
+    const int64_t nTargetSpacing = Params().GetConsensus().nTargetSpacing;
+    std::vector<CBlockIndex> blocks(10000);
+    for (int i = 0; i < 10000; i++) {
+        blocks[i].pprev = i ? &blocks[i - 1] : nullptr;
+        blocks[i].nHeight = i;
+        blocks[i].nTime = 1269211443 + i * nTargetSpacing;
+        blocks[i].nBits = 0x207fffff; /* target 0x7fffff000... */
+        blocks[i].nChainWork = i ? blocks[i - 1].nChainWork + GetBlockProof(blocks[i - 1]) : UINT256_ZERO;
+    }
+
+    for (int j = 0; j < 1000; j++) {
+        CBlockIndex* p1 = &blocks[InsecureRandRange(10000)];
+        CBlockIndex* p2 = &blocks[InsecureRandRange(10000)];
+        CBlockIndex* p3 = &blocks[InsecureRandRange(10000)];
+
+        int64_t tdiff = GetBlockProofEquivalentTime(*p1, *p2, *p3);
+        BOOST_CHECK_EQUAL(tdiff, p1->GetBlockTime() - p2->GetBlockTime());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
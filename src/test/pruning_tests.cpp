@@ -0,0 +1,114 @@
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_islamic_digital_coin.h"
+
+#include "chain.h"
+#include "fs.h"
+#include "validation.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(pruning_tests, BasicTestingSetup)
+
+static const uint64_t MiB = 1024 * 1024;
+
+// Files of 9 MiB, with 100 blocks each
+static std::vector<CBlockFileInfo> BuildFileInfos(size_t nFiles)
+{
+    std::vector<CBlockFileInfo> vinfo(nFiles);
+    for (size_t i = 0; i < nFiles; i++) {
+        vinfo[i].nBlocks = 100;
+        vinfo[i].nSize = 8 * MiB;
+        vinfo[i].nUndoSize = 1 * MiB;
+        vinfo[i].nHeightFirst = 100 * i;
+        vinfo[i].nHeightLast = 100 * i + 99;
+    }
+    return vinfo;
+}
+
+static std::set<int> Range(int begin, int end)
+{
+    std::set<int> ret;
+    for (int i = begin; i < end; i++) ret.insert(i);
+    return ret;
+}
+
+BOOST_AUTO_TEST_CASE(select_files_to_prune)
+{
+    std::vector<CBlockFileInfo> vinfo = BuildFileInfos(10);
+    const int nLastFile = 9;
+    std::set<int> setFilesToPrune;
+
+    // Below the target (with the allocation buffer): nothing to prune
+    BOOST_CHECK_EQUAL(SelectFilesToPrune(vinfo, nLastFile, 200 * MiB, 1000, setFilesToPrune), 90 * MiB);
+    BOOST_CHECK(setFilesToPrune.empty());
+
+    // The oldest files are pruned until the usage and the buffer are below the target
+    BOOST_CHECK_EQUAL(SelectFilesToPrune(vinfo, nLastFile, 60 * MiB, 1000, setFilesToPrune), 36 * MiB);
+    BOOST_CHECK(setFilesToPrune == Range(0, 6));
+
+    // The file being written to is kept
+    setFilesToPrune.clear();
+    BOOST_CHECK_EQUAL(SelectFilesToPrune(vinfo, nLastFile, 0, 1000, setFilesToPrune), 9 * MiB);
+    BOOST_CHECK(setFilesToPrune == Range(0, 9));
+
+    // The files with a block too close to the tip are kept
+    setFilesToPrune.clear();
+    BOOST_CHECK_EQUAL(SelectFilesToPrune(vinfo, nLastFile, 0, 250, setFilesToPrune), 72 * MiB);
+    BOOST_CHECK(setFilesToPrune == Range(0, 2));
+
+    // The files already pruned are skipped
+    vinfo[1].SetNull();
+    setFilesToPrune.clear();
+    BOOST_CHECK_EQUAL(SelectFilesToPrune(vinfo, nLastFile, 0, 1000, setFilesToPrune), 0 * MiB);
+    std::set<int> setExpected = Range(0, 9);
+    setExpected.erase(1);
+    BOOST_CHECK(setFilesToPrune == setExpected);
+}
+
+BOOST_AUTO_TEST_CASE(last_block_we_can_prune)
+{
+    // The last MIN_BLOCKS_TO_KEEP blocks are kept, the chain is too short to prune below that
+    BOOST_CHECK_EQUAL(GetLastBlockWeCanPrune(0), -1);
+    BOOST_CHECK_EQUAL(GetLastBlockWeCanPrune(100), -1);
+    BOOST_CHECK_EQUAL(GetLastBlockWeCanPrune(MIN_BLOCKS_TO_KEEP), -1);
+    BOOST_CHECK_EQUAL(GetLastBlockWeCanPrune(MIN_BLOCKS_TO_KEEP + 1), 1);
+    BOOST_CHECK_EQUAL(GetLastBlockWeCanPrune(1000), 1000 - (int)MIN_BLOCKS_TO_KEEP);
+
+    // Or the last -maxreorg blocks, if more
+    gArgs.ForceSetArg("-maxreorg", "500");
+    BOOST_CHECK_EQUAL(GetLastBlockWeCanPrune(400), -1);
+    BOOST_CHECK_EQUAL(GetLastBlockWeCanPrune(500), -1);
+    BOOST_CHECK_EQUAL(GetLastBlockWeCanPrune(1000), 500);
+    gArgs.ForceSetArg("-maxreorg", "10");
+    BOOST_CHECK_EQUAL(GetLastBlockWeCanPrune(1000), 1000 - (int)MIN_BLOCKS_TO_KEEP);
+    gArgs.ForceSetArg("-maxreorg", std::to_string(DEFAULT_MAX_REORG_DEPTH));
+}
+
+BOOST_FIXTURE_TEST_CASE(prune_block_file, TestChain100Setup)
+{
+    const CBlockIndex* pindex = WITH_LOCK(cs_main, return chainActive[50]);
+    CBlock block;
+    BOOST_CHECK(ReadBlockFromDisk(block, pindex));
+    BOOST_CHECK(pindex->nStatus & BLOCK_HAVE_UNDO);
+
+    const CDiskBlockPos pos(pindex->nFile, 0);
+    const fs::path pathBlocks = GetBlockPosFilename(pos, "blk");
+    const fs::path pathUndo = GetBlockPosFilename(pos, "rev");
+    BOOST_CHECK(fs::exists(pathBlocks));
+    BOOST_CHECK(fs::exists(pathUndo));
+
+    WITH_LOCK(cs_main, PruneOneBlockFile(pos.nFile); );
+    UnlinkPrunedFiles({pos.nFile});
+
+    // The files are deleted, and their blocks can't be served anymore
+    BOOST_CHECK(!fs::exists(pathBlocks));
+    BOOST_CHECK(!fs::exists(pathUndo));
+    BOOST_CHECK(!(pindex->nStatus & BLOCK_HAVE_DATA));
+    BOOST_CHECK(!(pindex->nStatus & BLOCK_HAVE_UNDO));
+    BOOST_CHECK(!ReadBlockFromDisk(block, pindex));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,8 @@
 #include "test/test_islamic_digital_coin.h"
 
 #include "blockassembler.h"
+#include "crypto/quark.h"
+#include "crypto/sha256.h"
 #include "guiinterface.h"
 #include "miner.h"
 #include "net_processing.h"
@@ -41,10 +43,13 @@ std::ostream& operator<<(std::ostream& os, const uint256& num)
 
 BasicTestingSetup::BasicTestingSetup()
 {
+        SHA256AutoDetect();
+        QuarkAutoDetect();
         RandomInit();
         ECC_Start();
         SetupEnvironment();
         InitSignatureCache();
+        InitScriptExecutionCache();
         fCheckBlockIndex = true;
         SelectParams(CBaseChainParams::MAIN);
 }
@@ -87,8 +92,10 @@ TestingSetup::TestingSetup()
             BOOST_CHECK(ok);
         }
         nScriptCheckThreads = 3;
-        for (int i=0; i < nScriptCheckThreads-1; i++)
+        for (int i=0; i < nScriptCheckThreads-1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadSaplingCheck);
+        }
         g_connman = std::unique_ptr<CConnman>(new CConnman(0x1337, 0x1337)); // Deterministic randomness for tests.
         connman = g_connman.get();
         RegisterNodeSignals(GetNodeSignals());
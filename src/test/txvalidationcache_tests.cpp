@@ -87,4 +87,53 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain100Setup)
     BOOST_CHECK_EQUAL(mempool.size(), 0);
 }
 
+BOOST_FIXTURE_TEST_CASE(script_execution_cache, TestChain100Setup)
+{
+    // Scripts of a transaction accepted to the memory pool are cached for the
+    // flags of the next block, so that connecting the block doesn't run them again.
+    CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout.hash = coinbaseTxns[0].GetHash();
+    spend.vin[0].prevout.n = 0;
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 11*CENT;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+
+    const CTransaction tx(spend);
+    unsigned int blockFlags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_DERSIG;
+    if (Params().GetConsensus().NetworkUpgradeActive(chainActive.Height(), Consensus::UPGRADE_BIP65))
+        blockFlags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
+
+    LOCK(cs_main);
+    PrecomputedTransactionData txdata(tx);
+    CValidationState state;
+    std::vector<CScriptCheck> vChecks;
+
+    // Not cached yet: the script checks are queued
+    BOOST_CHECK(CheckInputs(tx, state, *pcoinsTip, true, blockFlags, false, false, txdata, &vChecks));
+    BOOST_CHECK_EQUAL(vChecks.size(), 1U);
+    vChecks.clear();
+
+    BOOST_CHECK(ToMemPool(spend));
+
+    // Cached with the block flags: nothing left to check
+    BOOST_CHECK(CheckInputs(tx, state, *pcoinsTip, true, blockFlags, false, false, txdata, &vChecks));
+    BOOST_CHECK(vChecks.empty());
+
+    // ... but only for those flags
+    BOOST_CHECK(CheckInputs(tx, state, *pcoinsTip, true, blockFlags | SCRIPT_VERIFY_LOW_S, false, false, txdata, &vChecks));
+    BOOST_CHECK_EQUAL(vChecks.size(), 1U);
+
+    mempool.clear();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
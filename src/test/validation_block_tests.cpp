@@ -6,10 +6,12 @@
 
 #include "blockassembler.h"
 #include "chainparams.h"
+#include "clientversion.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
 #include "pow.h"
 #include "random.h"
+#include "streams.h"
 #include "test/test_islamic_digital_coin.h"
 #include "validation.h"
 #include "validationinterface.h"
@@ -175,4 +177,64 @@ BOOST_AUTO_TEST_CASE(processnewblock_signals_ordering)
     BOOST_CHECK_EQUAL(sub.m_expected_tip, WITH_LOCK(cs_main, return chainActive.Tip()->GetBlockHash()));
 }
 
+// construct a valid block at the given height
+std::shared_ptr<const CBlock> GoodBlockAt(const uint256& prev_hash, int nHeight)
+{
+    auto pblock = Block(prev_hash);
+    CMutableTransaction txCoinbase(*pblock->vtx[0]);
+    txCoinbase.vin[0].scriptSig = CScript() << nHeight << OP_0;
+    pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
+    return FinalizeBlock(pblock);
+}
+
+static void WriteBlockRecord(CDataStream& stream, const std::vector<unsigned char>& data)
+{
+    stream.write((const char*)Params().MessageStart(), MESSAGE_START_SIZE);
+    stream << (unsigned int)data.size();
+    stream.write((const char*)data.data(), data.size());
+}
+
+BOOST_AUTO_TEST_CASE(loadexternalblockfile_corrupt_block)
+{
+    std::vector<std::shared_ptr<const CBlock>> blocks;
+    uint256 hashPrev = Params().GenesisBlock().GetHash();
+    for (int i = 1; i <= 20; i++) {
+        blocks.emplace_back(GoodBlockAt(hashPrev, i));
+        hashPrev = blocks.back()->GetHash();
+    }
+
+    // The size of the corrupt record covers the first blocks and some padding, up to the
+    // rewind window of the file reader: the blocks after it are read ahead past that window.
+    CDataStream inside(SER_DISK, CLIENT_VERSION);
+    for (int i = 0; i < 5; i++) {
+        CDataStream block(SER_DISK, CLIENT_VERSION);
+        block << *blocks[i];
+        WriteBlockRecord(inside, std::vector<unsigned char>(block.begin(), block.end()));
+    }
+    std::vector<unsigned char> corrupt(200, 0xff); // the transaction count doesn't deserialize
+    corrupt.insert(corrupt.end(), inside.begin(), inside.end());
+    corrupt.resize(MAX_BLOCK_SIZE_CURRENT, 0);
+
+    CDataStream file(SER_DISK, CLIENT_VERSION);
+    WriteBlockRecord(file, corrupt);
+    for (size_t i = 5; i < blocks.size(); i++) {
+        CDataStream block(SER_DISK, CLIENT_VERSION);
+        block << *blocks[i];
+        WriteBlockRecord(file, std::vector<unsigned char>(block.begin(), block.end()));
+    }
+
+    const fs::path path = pathTemp / "corrupt_blocks.dat";
+    FILE* fileOut = fsbridge::fopen(path, "wb");
+    BOOST_REQUIRE(fileOut);
+    BOOST_REQUIRE_EQUAL(fwrite(file.data(), 1, file.size(), fileOut), file.size());
+    fclose(fileOut);
+
+    // The blocks inside the corrupt record are found again, and then the ones after it
+    FILE* fileIn = fsbridge::fopen(path, "rb");
+    BOOST_REQUIRE(fileIn);
+    BOOST_CHECK(LoadExternalBlockFile(fileIn));
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(WITH_LOCK(cs_main, return chainActive.Tip()->GetBlockHash()), blocks.back()->GetHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,10 +4,13 @@
 // file COPYING or https://www.opensource.org/licenses/mit-license.php.
 
 #include "test/test_islamic_digital_coin.h"
+#include "chain.h"
+#include "pow.h"
 #include "primitives/transaction.h"
 #include "sapling/sapling_validation.h"
 #include "tiertwo/specialtx_validation.h"
 #include "test/librust/utiltest.h"
+#include "validation.h"
 
 #include <boost/test/unit_test.hpp>
 
@@ -153,4 +156,57 @@ BOOST_AUTO_TEST_CASE(test_simple_shielded_invalid)
     SelectParams(CBaseChainParams::MAIN);
 }
 
+static void BuildIndexChain(std::vector<CBlockIndex>& blocks, CBlockIndex* pindexFork, int64_t nTime)
+{
+    const int64_t nTargetSpacing = Params().GetConsensus().nTargetSpacing;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        CBlockIndex* pprev = i ? &blocks[i - 1] : pindexFork;
+        blocks[i].pprev = pprev;
+        blocks[i].nHeight = pprev ? pprev->nHeight + 1 : 0;
+        blocks[i].nTime = nTime + blocks[i].nHeight * nTargetSpacing;
+        blocks[i].nBits = 0x207fffff;
+        blocks[i].nChainWork = pprev ? pprev->nChainWork + GetBlockProof(*pprev) : UINT256_ZERO;
+        blocks[i].BuildSkip();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(assumevalid_test)
+{
+    Consensus::Params consensus = Params().GetConsensus();
+    consensus.nMinimumChainWork = UINT256_ZERO;
+    // Number of blocks in two weeks of work, past which the scripts can be skipped
+    const int nBuried = 60 * 60 * 24 * 7 * 2 / consensus.nTargetSpacing;
+
+    std::vector<CBlockIndex> chain(nBuried + 2000);
+    BuildIndexChain(chain, nullptr, 1269211443);
+    const CBlockIndex* pindexBest = &chain.back();
+    const CBlockIndex* pindexAssumeValid = &chain[1500];
+
+    // Ancestors of the assumed valid block, buried enough: skipped
+    BOOST_CHECK(IsAssumedValid(&chain[0], pindexAssumeValid, pindexBest, consensus));
+    BOOST_CHECK(IsAssumedValid(&chain[1000], pindexAssumeValid, pindexBest, consensus));
+    BOOST_CHECK(IsAssumedValid(&chain[1500], pindexAssumeValid, pindexBest, consensus));
+    // Above the assumed valid block: checked
+    BOOST_CHECK(!IsAssumedValid(&chain[1501], pindexAssumeValid, pindexBest, consensus));
+    BOOST_CHECK(!IsAssumedValid(&chain[5000], pindexAssumeValid, pindexBest, consensus));
+
+    // Less than two weeks of work on top of the block: checked
+    const CBlockIndex* pindexShortBest = &chain[1000 + nBuried - 1];
+    BOOST_CHECK(!IsAssumedValid(&chain[1000], pindexAssumeValid, pindexShortBest, consensus));
+    BOOST_CHECK(IsAssumedValid(&chain[500], pindexAssumeValid, pindexShortBest, consensus));
+
+    // Best header without the minimum chain work: checked
+    Consensus::Params consensusMinWork = consensus;
+    consensusMinWork.nMinimumChainWork = pindexBest->nChainWork + GetBlockProof(*pindexBest);
+    BOOST_CHECK(!IsAssumedValid(&chain[1000], pindexAssumeValid, pindexBest, consensusMinWork));
+
+    // Assumed valid block on a fork, not in the best chain: only the common ancestors are skipped
+    std::vector<CBlockIndex> fork(2000);
+    BuildIndexChain(fork, &chain[500], 1269211443);
+    const CBlockIndex* pindexForkAssumeValid = &fork[1000];
+    BOOST_CHECK(!IsAssumedValid(&fork[200], pindexForkAssumeValid, pindexBest, consensus));
+    BOOST_CHECK(!IsAssumedValid(&fork[1000], pindexForkAssumeValid, pindexBest, consensus));
+    BOOST_CHECK(IsAssumedValid(&chain[400], pindexForkAssumeValid, pindexBest, consensus));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
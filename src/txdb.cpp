@@ -19,7 +19,6 @@
 static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
-static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
@@ -29,6 +28,9 @@ static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
 // static const char DB_MONEY_SUPPLY = 'M';
 
+//! Number of block index entries read and hashed together by LoadBlockIndexGuts
+static const size_t BLOCK_INDEX_LOAD_BATCH = 1024;
+
 namespace {
 
 struct CoinEntry
@@ -154,6 +156,28 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins,
     return ret;
 }
 
+bool CCoinsViewDB::WriteCoins(CCoinsMap& mapCoins)
+{
+    CDBBatch batch;
+    size_t batch_size = (size_t) gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            CoinEntry entry(&it->first);
+            if (it->second.coin.IsSpent())
+                batch.Erase(entry);
+            else
+                batch.Write(entry, it->second.coin);
+        }
+        CCoinsMap::iterator itOld = it++;
+        mapCoins.erase(itOld);
+        if (batch.SizeEstimate() > batch_size) {
+            if (!db.WriteBatch(batch)) return false;
+            batch.Clear();
+        }
+    }
+    return db.WriteBatch(batch);
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
@@ -168,6 +192,15 @@ bool CBlockTreeDB::WriteBlockIndex(const CDiskBlockIndex& blockindex)
     return Write(std::make_pair(DB_BLOCK_INDEX, blockindex.GetBlockHash()), blockindex);
 }
 
+bool CBlockTreeDB::WriteBlockIndexBatch(const std::vector<CDiskBlockIndex>& vBlockIndex, bool fSync)
+{
+    CDBBatch batch;
+    for (const CDiskBlockIndex& blockindex : vBlockIndex) {
+        batch.Write(std::make_pair(DB_BLOCK_INDEX, blockindex.GetBlockHash()), blockindex);
+    }
+    return WriteBatch(batch, fSync);
+}
+
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo& info)
 {
     return Read(std::make_pair(DB_BLOCK_FILES, nFile), info);
@@ -259,19 +292,6 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     return WriteBatch(batch, true);
 }
 
-bool CBlockTreeDB::ReadTxIndex(const uint256& txid, CDiskTxPos& pos)
-{
-    return Read(std::make_pair(DB_TXINDEX, txid), pos);
-}
-
-bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& vect)
-{
-    CDBBatch batch;
-    for (std::vector<std::pair<uint256, CDiskTxPos> >::const_iterator it = vect.begin(); it != vect.end(); it++)
-        batch.Write(std::make_pair(DB_TXINDEX, it->first), it->second);
-    return WriteBatch(batch);
-}
-
 bool CBlockTreeDB::WriteFlag(const std::string& name, bool fValue)
 {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
@@ -303,46 +323,59 @@ bool CBlockTreeDB::LoadBlockIndexGuts(std::function<CBlockIndex*(const uint256&)
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, UINT256_ZERO));
 
     // Load mapBlockIndex
-    while (pcursor->Valid()) {
+    std::vector<CDiskBlockIndex> vDiskIndex;
+    std::vector<CBlockHeader> vHeaders;
+    while (true) {
         boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight = diskindex.nHeight;
-                pindexNew->nFile = diskindex.nFile;
-                pindexNew->nDataPos = diskindex.nDataPos;
-                pindexNew->nUndoPos = diskindex.nUndoPos;
-                pindexNew->nVersion = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime = diskindex.nTime;
-                pindexNew->nBits = diskindex.nBits;
-                pindexNew->nNonce = diskindex.nNonce;
-                pindexNew->nStatus = diskindex.nStatus;
-                pindexNew->nTx = diskindex.nTx;
-
-                // sapling
-                pindexNew->nSaplingValue  = diskindex.nSaplingValue;
-                pindexNew->hashFinalSaplingRoot = diskindex.hashFinalSaplingRoot;
-
-                //Proof Of Stake
-                pindexNew->nFlags = diskindex.nFlags;
-                pindexNew->vStakeModifier = diskindex.vStakeModifier;
-
-                if (!Params().GetConsensus().NetworkUpgradeActive(pindexNew->nHeight, Consensus::UPGRADE_POS)) {
-                    if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits))
-                        return error("LoadBlockIndex() : CheckProofOfWork failed: %s", pindexNew->ToString());
-                }
-
-                pcursor->Next();
-            } else {
+        // Read the entries in batches, so that the block hashes (Quark for the
+        // legacy headers) can be computed together
+        vDiskIndex.clear();
+        while (vDiskIndex.size() < BLOCK_INDEX_LOAD_BATCH && pcursor->Valid()) {
+            std::pair<char, uint256> key;
+            if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX)
+                break;
+            vDiskIndex.emplace_back();
+            if (!pcursor->GetValue(vDiskIndex.back()))
                 return error("%s : failed to read value", __func__);
-            }
-        } else {
+            pcursor->Next();
+        }
+        if (vDiskIndex.empty())
             break;
+
+        vHeaders.clear();
+        for (const CDiskBlockIndex& diskindex : vDiskIndex)
+            vHeaders.push_back(diskindex.GetBlockHeader());
+        const std::vector<uint256> vHashes = GetBlockHeaderHashes(vHeaders);
+
+        for (size_t i = 0; i < vDiskIndex.size(); i++) {
+            const CDiskBlockIndex& diskindex = vDiskIndex[i];
+            // Construct block index object
+            CBlockIndex* pindexNew = insertBlockIndex(vHashes[i]);
+            pindexNew->pprev = insertBlockIndex(diskindex.hashPrev);
+            pindexNew->nHeight = diskindex.nHeight;
+            pindexNew->nFile = diskindex.nFile;
+            pindexNew->nDataPos = diskindex.nDataPos;
+            pindexNew->nUndoPos = diskindex.nUndoPos;
+            pindexNew->nVersion = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime = diskindex.nTime;
+            pindexNew->nBits = diskindex.nBits;
+            pindexNew->nNonce = diskindex.nNonce;
+            pindexNew->nStatus = diskindex.nStatus;
+            pindexNew->nTx = diskindex.nTx;
+
+            // sapling
+            pindexNew->nSaplingValue  = diskindex.nSaplingValue;
+            pindexNew->hashFinalSaplingRoot = diskindex.hashFinalSaplingRoot;
+
+            //Proof Of Stake
+            pindexNew->nFlags = diskindex.nFlags;
+            pindexNew->vStakeModifier = diskindex.vStakeModifier;
+
+            if (!Params().GetConsensus().NetworkUpgradeActive(pindexNew->nHeight, Consensus::UPGRADE_POS)) {
+                if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits))
+                    return error("LoadBlockIndex() : CheckProofOfWork failed: %s", pindexNew->ToString());
+            }
         }
     }
 
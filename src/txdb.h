@@ -12,6 +12,7 @@
 #include "chain.h"
 #include "dbwrapper.h"
 
+#include <functional>
 #include <map>
 #include <string>
 #include <utility>
@@ -30,6 +31,14 @@ static const int64_t nDefaultDbBatchSize = 16 << 20;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
+//! Max memory allocated to block tree DB specific cache (MiB)
+static const int64_t nMaxBlockDBCache = 2;
+//! Max memory allocated to tx index DB specific cache (MiB)
+static const int64_t nMaxTxIndexCache = 1024;
+//! Max memory allocated to address index DB specific cache (MiB)
+static const int64_t nMaxAddressIndexCache = 1024;
+//! Max memory allocated to coinstats index DB specific cache (MiB)
+static const int64_t nMaxCoinStatsIndexCache = 128;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -84,6 +93,8 @@ public:
                     const uint256& hashSaplingAnchor,
                     CAnchorsSaplingMap& mapSaplingAnchors,
                     CNullifiersMap& mapSaplingNullifiers) override;
+    //! Write coins without moving the best block, for a chainstate built in several batches.
+    bool WriteCoins(CCoinsMap& mapCoins);
 
     // Sapling, the implementation of the following functions can be found in sapling_txdb.cpp.
     bool GetSaplingAnchorAt(const uint256 &rt, SaplingMerkleTree &tree) const override;
@@ -93,6 +104,13 @@ public:
                            CAnchorsSaplingMap& mapSaplingAnchors,
                            CNullifiersMap& mapSaplingNullifiers,
                            CDBBatch& batch);
+
+    //! A raw iterator, which keeps seeing the database as it was when created
+    CDBIterator* NewIterator() const { return const_cast<CDBWrapper&>(db).NewIterator(); }
+
+    //! Visit every Sapling anchor (resp. nullifier) seen by an iterator of the database, until fn returns false.
+    static bool ForEachSaplingAnchor(CDBIterator& cursor, const std::function<bool(const uint256&, const SaplingMerkleTree&)>& fn);
+    static bool ForEachSaplingNullifier(CDBIterator& cursor, const std::function<bool(const uint256&)>& fn);
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -129,13 +147,12 @@ private:
 
 public:
     bool WriteBlockIndex(const CDiskBlockIndex& blockindex);
+    bool WriteBlockIndexBatch(const std::vector<CDiskBlockIndex>& vBlockIndex, bool fSync);
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo& fileinfo);
     bool ReadLastBlockFile(int& nFile);
     bool WriteReindexing(bool fReindex);
     bool ReadReindexing(bool& fReindex);
-    bool ReadTxIndex(const uint256& txid, CDiskTxPos& pos);
-    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& list);
     bool WriteFlag(const std::string& name, bool fValue);
     bool ReadFlag(const std::string& name, bool& fValue);
     bool WriteInt(const std::string& name, int nValue);
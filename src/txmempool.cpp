@@ -750,7 +750,7 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
         else {
             CValidationState state;
             PrecomputedTransactionData precomTxData(tx);
-            assert(CheckInputs(tx, state, mempoolDuplicate, false, 0, false, precomTxData, NULL));
+            assert(CheckInputs(tx, state, mempoolDuplicate, false, 0, false, false, precomTxData, NULL));
             UpdateCoins(tx, mempoolDuplicate, 1000000);
         }
     }
@@ -766,7 +766,7 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
             assert(stepsSinceLastRemove < waitingOnDependants.size());
         } else {
             PrecomputedTransactionData precomTxData(entry->GetTx());
-            assert(CheckInputs(entry->GetTx(), state, mempoolDuplicate, false, 0, false, precomTxData, NULL));
+            assert(CheckInputs(entry->GetTx(), state, mempoolDuplicate, false, 0, false, false, precomTxData, NULL));
             UpdateCoins(entry->GetTx(), mempoolDuplicate, 1000000);
             stepsSinceLastRemove = 0;
         }
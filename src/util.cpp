@@ -736,6 +736,21 @@ void AllocateFileRange(FILE* file, unsigned int offset, unsigned int length)
 #endif
 }
 
+/**
+ * Tell the OS that a file is going to be read sequentially, so that it reads
+ * ahead more aggressively. This function is advisory.
+ */
+void FileSequentialReadHint(FILE* file)
+{
+#if defined(MAC_OSX)
+    fcntl(fileno(file), F_RDAHEAD, 1);
+#elif defined(__linux__)
+    posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#else
+    (void)file;
+#endif
+}
+
 #ifdef WIN32
 fs::path GetSpecialFolderPath(int nFolder, bool fCreate)
 {
@@ -0,0 +1,461 @@
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxosnapshot.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "checkpoints.h"
+#include "clientversion.h"
+#include "guiinterface.h"
+#include "hash.h"
+#include "init.h"
+#include "pow.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+#include "validation.h"
+
+static const unsigned char SNAPSHOT_MAGIC_BYTES[5] = {'u', 't', 'x', 'o', 0xff};
+
+//! Number of block index entries hashed and written together
+static const size_t SNAPSHOT_BLOCK_INDEX_BATCH = 1024;
+//! Number of coins written to the chainstate database together
+static const size_t SNAPSHOT_COINS_BATCH = 100000;
+
+namespace {
+
+/** Writes to a file while hashing the written data. */
+class CHashedFileWriter
+{
+private:
+    CAutoFile& file;
+    CHashWriter hasher;
+
+public:
+    explicit CHashedFileWriter(CAutoFile& fileIn) : file(fileIn), hasher(fileIn.GetType(), fileIn.GetVersion()) {}
+
+    int GetType() const { return file.GetType(); }
+    int GetVersion() const { return file.GetVersion(); }
+
+    void write(const char* pch, size_t nSize)
+    {
+        file.write(pch, nSize);
+        hasher.write(pch, nSize);
+    }
+
+    uint256 GetHash() { return hasher.GetHash(); }
+
+    template <typename T>
+    CHashedFileWriter& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj);
+        return *this;
+    }
+};
+
+} // anon namespace
+
+bool DumpUTXOSnapshot(const fs::path& path, SnapshotMetadata& metadata, uint256& hashContents, std::string& strError)
+{
+    std::vector<const CBlockIndex*> vChain;
+    std::unique_ptr<CCoinsViewCursor> pcursorCount, pcursor;
+    std::unique_ptr<CDBIterator> pcursorSapling;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+
+        const CBlockIndex* pindexBase = chainActive.Tip();
+        if (pcoinsdbview->GetBestBlock() != pindexBase->GetBlockHash()) {
+            strError = "chainstate database is not flushed to the tip";
+            return false;
+        }
+
+        metadata = SnapshotMetadata();
+        memcpy(metadata.pchMessageStart, Params().MessageStart(), sizeof(metadata.pchMessageStart));
+        metadata.hashBaseBlock = pindexBase->GetBlockHash();
+        metadata.nBaseHeight = pindexBase->nHeight;
+        metadata.hashSaplingAnchor = pcoinsdbview->GetBestAnchor();
+
+        // The database iterators see the chainstate as it is now, whatever is
+        // written to it once cs_main is released.
+        pcursorCount.reset(pcoinsdbview->Cursor());
+        pcursor.reset(pcoinsdbview->Cursor());
+        pcursorSapling.reset(pcoinsdbview->NewIterator());
+        vChain.reserve(pindexBase->nHeight + 1);
+        for (int nHeight = 0; nHeight <= pindexBase->nHeight; nHeight++) {
+            vChain.push_back(chainActive[nHeight]);
+        }
+    }
+
+    // The header carries the number of entries of each section: count them first
+    for (; pcursorCount->Valid(); pcursorCount->Next()) {
+        metadata.nCoins++;
+    }
+    pcursorCount.reset();
+    CCoinsViewDB::ForEachSaplingAnchor(*pcursorSapling, [&metadata](const uint256&, const SaplingMerkleTree&) {
+        metadata.nSaplingAnchors++;
+        return true;
+    });
+    CCoinsViewDB::ForEachSaplingNullifier(*pcursorSapling, [&metadata](const uint256&) {
+        metadata.nSaplingNullifiers++;
+        return true;
+    });
+
+    const fs::path temppath = path.string() + ".incomplete";
+    CAutoFile file(fsbridge::fopen(temppath, "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        strError = strprintf("unable to open %s for writing", temppath.string());
+        return false;
+    }
+
+    try {
+        CHashedFileWriter writer(file);
+        writer << FLATDATA(SNAPSHOT_MAGIC_BYTES) << metadata;
+
+        // Block index of the chain up to the base block. The blocks themselves stay
+        // behind: drop their disk positions and keep only the validity of the entries.
+        std::vector<CDiskBlockIndex> vDiskIndex;
+        for (size_t nHeight = 0; nHeight < vChain.size();) {
+            vDiskIndex.clear();
+            {
+                LOCK(cs_main);
+                for (; nHeight < vChain.size() && vDiskIndex.size() < SNAPSHOT_BLOCK_INDEX_BATCH; nHeight++) {
+                    vDiskIndex.emplace_back(vChain[nHeight]);
+                    CDiskBlockIndex& diskindex = vDiskIndex.back();
+                    diskindex.nStatus &= BLOCK_VALID_MASK;
+                    diskindex.nFile = 0;
+                    diskindex.nDataPos = 0;
+                    diskindex.nUndoPos = 0;
+                }
+            }
+            for (const CDiskBlockIndex& diskindex : vDiskIndex) {
+                writer << diskindex;
+            }
+        }
+
+        // Unspent outputs, grouped by txid (the cursor iterates them in key order)
+        std::vector<std::pair<uint32_t, Coin>> outputs;
+        uint256 hashPrev;
+        auto writeOutputs = [&writer, &outputs, &hashPrev]() {
+            uint64_t nOutputs = outputs.size();
+            writer << hashPrev << COMPACTSIZE(nOutputs);
+            for (const auto& output : outputs) {
+                writer << VARINT(output.first) << output.second;
+            }
+            outputs.clear();
+        };
+        uint64_t nCoinsWritten = 0;
+        for (; pcursor->Valid(); pcursor->Next()) {
+            COutPoint key;
+            Coin coin;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+                strError = "unable to read the coins database";
+                return false;
+            }
+            if (!outputs.empty() && key.hash != hashPrev) {
+                writeOutputs();
+            }
+            hashPrev = key.hash;
+            outputs.emplace_back(key.n, std::move(coin));
+            nCoinsWritten++;
+        }
+        if (!outputs.empty()) {
+            writeOutputs();
+        }
+        assert(nCoinsWritten == metadata.nCoins);
+
+        // Sapling state
+        CCoinsViewDB::ForEachSaplingAnchor(*pcursorSapling, [&writer](const uint256& root, const SaplingMerkleTree& tree) {
+            writer << root << tree;
+            return true;
+        });
+        CCoinsViewDB::ForEachSaplingNullifier(*pcursorSapling, [&writer](const uint256& nullifier) {
+            writer << nullifier;
+            return true;
+        });
+
+        hashContents = writer.GetHash();
+        file << hashContents;
+    } catch (const std::exception& e) {
+        strError = strprintf("failed to write %s: %s", temppath.string(), e.what());
+        return false;
+    }
+
+    file.fclose();
+    if (!RenameOver(temppath, path)) {
+        strError = strprintf("unable to rename %s to %s", temppath.string(), path.string());
+        return false;
+    }
+    LogPrintf("Wrote UTXO snapshot at block %s (height %d, %u coins) to %s, hash %s\n",
+              metadata.hashBaseBlock.ToString(), metadata.nBaseHeight, metadata.nCoins,
+              path.string(), hashContents.ToString());
+    return true;
+}
+
+/**
+ * Read a snapshot file, checking its consistency as it goes. Without
+ * databases, only verifies the file: with them, also writes its contents,
+ * and only moves the chainstate to the base block if they hash to
+ * hashRequired, as the file may have changed since it was verified.
+ */
+static bool ReadUTXOSnapshot(const fs::path& path, CBlockTreeDB* pblocktreeIn, CCoinsViewDB* pcoinsdb,
+                             const uint256& hashRequired, SnapshotMetadata& metadata, uint256& hashContents,
+                             std::string& strError)
+{
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        strError = strprintf("unable to open %s", path.string());
+        return false;
+    }
+
+    const bool fWrite = pblocktreeIn != nullptr;
+    const CChainParams& chainparams = Params();
+    const Consensus::Params& consensus = chainparams.GetConsensus();
+    try {
+        CHashVerifier<CAutoFile> verifier(&file);
+
+        unsigned char magic[sizeof(SNAPSHOT_MAGIC_BYTES)];
+        verifier >> FLATDATA(magic);
+        if (memcmp(magic, SNAPSHOT_MAGIC_BYTES, sizeof(magic)) != 0) {
+            strError = "not a UTXO snapshot file";
+            return false;
+        }
+        verifier >> metadata;
+        if (metadata.nVersion != SnapshotMetadata::CURRENT_VERSION) {
+            strError = strprintf("unsupported snapshot version %d", metadata.nVersion);
+            return false;
+        }
+        if (memcmp(metadata.pchMessageStart, chainparams.MessageStart(), sizeof(metadata.pchMessageStart)) != 0) {
+            strError = "snapshot taken on a different network";
+            return false;
+        }
+        if (metadata.nBaseHeight < 0) {
+            strError = "invalid base block height";
+            return false;
+        }
+
+        // Block index: consecutive heights from the genesis block to the base block
+        uint256 hashPrev;
+        std::vector<CDiskBlockIndex> vDiskIndex;
+        std::vector<CBlockHeader> vHeaders;
+        for (int nHeight = 0; nHeight <= metadata.nBaseHeight;) {
+            if (ShutdownRequested()) {
+                strError = "interrupted";
+                return false;
+            }
+            vDiskIndex.clear();
+            vHeaders.clear();
+            for (; nHeight <= metadata.nBaseHeight && vDiskIndex.size() < SNAPSHOT_BLOCK_INDEX_BATCH; nHeight++) {
+                vDiskIndex.emplace_back();
+                verifier >> vDiskIndex.back();
+                vHeaders.push_back(vDiskIndex.back().GetBlockHeader());
+            }
+            const std::vector<uint256> vHashes = GetBlockHeaderHashes(vHeaders);
+            for (size_t i = 0; i < vDiskIndex.size(); i++) {
+                const CDiskBlockIndex& diskindex = vDiskIndex[i];
+                const int nExpectedHeight = nHeight - (int)vDiskIndex.size() + (int)i;
+                if (diskindex.nHeight != nExpectedHeight || diskindex.hashPrev != hashPrev ||
+                    (diskindex.nStatus & ~BLOCK_VALID_MASK) != 0 || diskindex.nTx == 0) {
+                    strError = strprintf("invalid block index entry at height %d", nExpectedHeight);
+                    return false;
+                }
+                if (nExpectedHeight == 0) {
+                    if (vHashes[i] != consensus.hashGenesisBlock) {
+                        strError = "snapshot doesn't start at the genesis block";
+                        return false;
+                    }
+                } else {
+                    // Cheap checks of the headers, the trusted hash vouches for the rest
+                    if (!Checkpoints::CheckBlock(nExpectedHeight, vHashes[i])) {
+                        strError = strprintf("block index entry at height %d doesn't match the checkpoint", nExpectedHeight);
+                        return false;
+                    }
+                    if (!consensus.NetworkUpgradeActive(nExpectedHeight, Consensus::UPGRADE_POS) &&
+                        !CheckProofOfWork(vHashes[i], diskindex.nBits)) {
+                        strError = strprintf("invalid proof of work at height %d", nExpectedHeight);
+                        return false;
+                    }
+                }
+                hashPrev = vHashes[i];
+            }
+            if (fWrite && !pblocktreeIn->WriteBlockIndexBatch(vDiskIndex, false)) {
+                strError = "failed to write the block index";
+                return false;
+            }
+        }
+        if (hashPrev != metadata.hashBaseBlock) {
+            strError = "block index doesn't end at the base block";
+            return false;
+        }
+
+        // Unspent outputs
+        CCoinsMap mapCoins;
+        CAnchorsSaplingMap mapSaplingAnchors;
+        CNullifiersMap mapSaplingNullifiers;
+        uint64_t nCoinsRead = 0;
+        int nLastProgress = -1;
+        while (nCoinsRead < metadata.nCoins) {
+            if (ShutdownRequested()) {
+                strError = "interrupted";
+                return false;
+            }
+            uint256 txid;
+            uint64_t nOutputs = 0;
+            verifier >> txid >> COMPACTSIZE(nOutputs);
+            if (nOutputs == 0 || nOutputs > metadata.nCoins - nCoinsRead) {
+                strError = strprintf("invalid number of outputs for tx %s", txid.ToString());
+                return false;
+            }
+            for (uint64_t i = 0; i < nOutputs; i++) {
+                uint32_t n = 0;
+                Coin coin;
+                verifier >> VARINT(n) >> coin;
+                if (coin.IsSpent() || (int)coin.nHeight > metadata.nBaseHeight) {
+                    strError = strprintf("invalid coin %s:%d", txid.ToString(), n);
+                    return false;
+                }
+                if (fWrite) {
+                    CCoinsCacheEntry& entry = mapCoins[COutPoint(txid, n)];
+                    entry.coin = std::move(coin);
+                    entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+                }
+            }
+            nCoinsRead += nOutputs;
+
+            if (fWrite && mapCoins.size() >= SNAPSHOT_COINS_BATCH) {
+                // The chainstate has no best block until the last batch
+                if (!pcoinsdb->WriteCoins(mapCoins)) {
+                    strError = "failed to write the coins database";
+                    return false;
+                }
+                const int nProgress = (int)(nCoinsRead * 100 / metadata.nCoins);
+                if (nProgress != nLastProgress) {
+                    uiInterface.ShowProgress(_("Loading UTXO snapshot..."), nProgress);
+                    nLastProgress = nProgress;
+                }
+            }
+        }
+
+        // Sapling state
+        bool fFoundAnchor = metadata.hashSaplingAnchor == SaplingMerkleTree::empty_root();
+        for (uint64_t i = 0; i < metadata.nSaplingAnchors; i++) {
+            uint256 root;
+            SaplingMerkleTree tree;
+            verifier >> root >> tree;
+            if (tree.root() != root) {
+                strError = strprintf("invalid sapling anchor %s", root.ToString());
+                return false;
+            }
+            fFoundAnchor |= root == metadata.hashSaplingAnchor;
+            if (fWrite) {
+                CAnchorsSaplingCacheEntry& entry = mapSaplingAnchors[root];
+                entry.entered = true;
+                entry.tree = tree;
+                entry.flags = CAnchorsSaplingCacheEntry::DIRTY;
+            }
+        }
+        if (!fFoundAnchor) {
+            strError = "best sapling anchor missing from the snapshot";
+            return false;
+        }
+        for (uint64_t i = 0; i < metadata.nSaplingNullifiers; i++) {
+            uint256 nullifier;
+            verifier >> nullifier;
+            if (fWrite) {
+                CNullifiersCacheEntry& entry = mapSaplingNullifiers[nullifier];
+                entry.entered = true;
+                entry.flags = CNullifiersCacheEntry::DIRTY;
+            }
+        }
+
+        hashContents = verifier.GetHash();
+        uint256 hashExpected;
+        file >> hashExpected;
+        if (hashContents != hashExpected) {
+            strError = strprintf("snapshot content hash mismatch (expected %s, got %s)",
+                                 hashExpected.ToString(), hashContents.ToString());
+            return false;
+        }
+
+        if (fWrite && hashContents != hashRequired) {
+            strError = strprintf("snapshot content hash changed since it was verified (expected %s, got %s)",
+                                 hashRequired.ToString(), hashContents.ToString());
+            return false;
+        }
+
+        if (fWrite) {
+            // The last batch also marks the chainstate as being at the base block
+            if (!pcoinsdb->BatchWrite(mapCoins, metadata.hashBaseBlock, metadata.hashSaplingAnchor,
+                                      mapSaplingAnchors, mapSaplingNullifiers)) {
+                strError = "failed to write the coins database";
+                return false;
+            }
+            if (!pblocktreeIn->WriteBlockIndexBatch({}, true)) {
+                strError = "failed to write the block index";
+                return false;
+            }
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("failed to read %s: %s", path.string(), e.what());
+        return false;
+    }
+
+    return true;
+}
+
+bool LoadUTXOSnapshot(const fs::path& path, const uint256& hashTrusted, size_t nCoinDBCache, std::string& strError)
+{
+    // A load interrupted half-way left a partial chainstate: start it over.
+    bool fResume = false;
+    pblocktree->ReadFlag("snapshotload", fResume);
+    if (!fResume) {
+        CCoinsViewDB coinsdb(nCoinDBCache);
+        if (!coinsdb.GetBestBlock().IsNull() || !coinsdb.GetHeadBlocks().empty()) {
+            LogPrintf("%s: chainstate is not empty, ignoring -loadsnapshot\n", __func__);
+            return true;
+        }
+    }
+
+    SnapshotMetadata metadata;
+    uint256 hashContents;
+    LogPrintf("Verifying UTXO snapshot %s...\n", path.string());
+    if (!ReadUTXOSnapshot(path, nullptr, nullptr, UINT256_ZERO, metadata, hashContents, strError)) {
+        return false;
+    }
+    LogPrintf("UTXO snapshot at block %s (height %d, %u coins), hash %s\n",
+              metadata.hashBaseBlock.ToString(), metadata.nBaseHeight, metadata.nCoins, hashContents.ToString());
+
+    // The content hash only guards against corruption: the file itself must be trusted
+    const MapAssumeutxo& mapAssumeutxo = Params().Assumeutxo();
+    const auto it = mapAssumeutxo.find(metadata.nBaseHeight);
+    const bool fPinned = it != mapAssumeutxo.end() && it->second.hashBaseBlock == metadata.hashBaseBlock &&
+                         it->second.hashSnapshot == hashContents;
+    if (!fPinned && (hashTrusted.IsNull() || hashTrusted != hashContents)) {
+        strError = strprintf("snapshot hash %s is not trusted: it is neither pinned for block %s nor given with -loadsnapshothash",
+                             hashContents.ToString(), metadata.hashBaseBlock.ToString());
+        return false;
+    }
+
+    if (!pblocktree->WriteFlag("snapshotload", true)) {
+        strError = "failed to write the block index";
+        return false;
+    }
+    {
+        CCoinsViewDB coinsdb(nCoinDBCache, false, true);
+        const uint256 hashVerified = hashContents;
+        if (!ReadUTXOSnapshot(path, pblocktree, &coinsdb, hashVerified, metadata, hashContents, strError)) {
+            return false;
+        }
+    }
+    uiInterface.ShowProgress("", 100);
+
+    // The blocks below the base block will never be on disk
+    if (!pblocktree->WriteFlag("prunedblockfiles", true) || !pblocktree->WriteFlag("snapshotload", false)) {
+        strError = "failed to write the block index";
+        return false;
+    }
+    LogPrintf("Loaded UTXO snapshot, chain tip at height %d\n", metadata.nBaseHeight);
+    return true;
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef ISLAMIC_DIGITAL_COIN_UTXOSNAPSHOT_H
+#define ISLAMIC_DIGITAL_COIN_UTXOSNAPSHOT_H
+
+#include "fs.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <string>
+
+/**
+ * Header of a UTXO snapshot file.
+ *
+ * It is followed by the block index of the chain up to the base block (so that
+ * the stake modifiers and Sapling values are available to validate the blocks
+ * after it), the unspent outputs grouped by txid, the Sapling anchors and
+ * nullifiers, and finally a double-SHA256 of everything before it.
+ */
+class SnapshotMetadata
+{
+public:
+    static const uint32_t CURRENT_VERSION = 1;
+
+    uint32_t nVersion{CURRENT_VERSION};
+    //! Network the snapshot was taken on
+    unsigned char pchMessageStart[4]{};
+    uint256 hashBaseBlock;
+    int nBaseHeight{0};
+    uint256 hashSaplingAnchor;
+    uint64_t nCoins{0};
+    uint64_t nSaplingAnchors{0};
+    uint64_t nSaplingNullifiers{0};
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nVersion);
+        READWRITE(FLATDATA(pchMessageStart));
+        READWRITE(hashBaseBlock);
+        READWRITE(nBaseHeight);
+        READWRITE(hashSaplingAnchor);
+        READWRITE(nCoins);
+        READWRITE(nSaplingAnchors);
+        READWRITE(nSaplingNullifiers);
+    }
+};
+
+/**
+ * Write the chainstate at the current tip to a snapshot file.
+ * cs_main is only held to flush the chainstate and open cursors on it, which
+ * keep seeing the database as it was then, and briefly for each batch of the
+ * block index: blocks keep being processed during the dump.
+ */
+bool DumpUTXOSnapshot(const fs::path& path, SnapshotMetadata& metadata, uint256& hashContents, std::string& strError);
+
+/**
+ * Initialize the block index and an empty chainstate from a snapshot file
+ * (-loadsnapshot). The whole file is verified before anything is written: its
+ * content hash must be the one pinned in the chain parameters for its base
+ * block, or hashTrusted (-loadsnapshothash) if not null, as nothing else
+ * vouches for the coins and the block index it carries. The blocks before the
+ * base block are not on disk, so the node then runs as if it had pruned them.
+ * Must be called before LoadBlockIndex. A no-op if the chainstate isn't empty,
+ * unless a previous load was interrupted: that one is started over, and the
+ * node refuses to start without -loadsnapshot or -reindex until it completes.
+ */
+bool LoadUTXOSnapshot(const fs::path& path, const uint256& hashTrusted, size_t nCoinDBCache, std::string& strError);
+
+#endif // ISLAMIC_DIGITAL_COIN_UTXOSNAPSHOT_H
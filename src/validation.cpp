@@ -22,8 +22,10 @@
 #include "consensus/merkle.h"
 #include "consensus/tx_verify.h"
 #include "consensus/validation.h"
+#include "cuckoocache.h"
 #include "fs.h"
 #include "guiinterface.h"
+#include "index/txindex.h"
 #include "init.h"
 #include "interfaces/handler.h"
 #include "kernel.h"
@@ -53,7 +55,9 @@
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
 #include <atomic>
+#include <condition_variable>
 #include <queue>
+#include <thread>
 
 
 #if defined(NDEBUG)
@@ -90,10 +94,13 @@ int64_t g_best_block_time = 0;
 int nScriptCheckThreads = 0;
 std::atomic<bool> fImporting{false};
 std::atomic<bool> fReindex{false};
-bool fTxIndex = true;
+bool fHavePruned = false;
+bool fPruneMode = false;
 bool fCheckBlockIndex = false;
 bool fVerifyingBlocks = false;
+uint256 hashAssumeValid;
 size_t nCoinCacheUsage = 5000 * 300;
+uint64_t nPruneTarget = 0;
 
 /* If the tip is older than this (in seconds), the node is considered to be in initial block download. */
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
@@ -112,6 +119,15 @@ CMoneySupply MoneySupply;
 
 static void CheckBlockIndex();
 
+/** Returns the script flags which should be checked for the block after pindexPrev. */
+static unsigned int GetBlockScriptFlags(const CBlockIndex* pindexPrev, const Consensus::Params& consensus)
+{
+    unsigned int flags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_DERSIG;
+    if (pindexPrev && consensus.NetworkUpgradeActive(pindexPrev->nHeight, Consensus::UPGRADE_BIP65))
+        flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
+    return flags;
+}
+
 /** Constant stuff for coinbase transactions we create: */
 CScript COINBASE_FLAGS;
 
@@ -173,6 +189,12 @@ std::set<CBlockIndex*> setDirtyBlockIndex;
 
 /** Dirty block file entries. */
 std::set<int> setDirtyFileInfo;
+
+/** Global flag to indicate we should check to see if there are
+ *  block/undo files that should be deleted.  Set on startup
+ *  or if we allocate more file space when we're in prune mode
+ */
+bool fCheckForPruning = false;
 } // anon namespace
 
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator)
@@ -202,6 +224,7 @@ CBlockIndex* GetChainTip()
 }
 
 CCoinsViewCache* pcoinsTip = NULL;
+CCoinsViewDB* pcoinsdbview = NULL;
 CBlockTreeDB* pblocktree = NULL;
 CSporkDB* pSporkDB = NULL;
 
@@ -214,6 +237,7 @@ enum FlushStateMode {
 
 // See definition for documentation
 bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode);
+static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight);
 
 bool CheckFinalTx(const CTransactionRef& tx, int flags)
 {
@@ -538,24 +562,26 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
             flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
 
         PrecomputedTransactionData precomTxData(tx);
-        if (!CheckInputs(tx, state, view, true, flags, true, precomTxData)) {
+        if (!CheckInputs(tx, state, view, true, flags, true, false, precomTxData)) {
             return false;
         }
 
-        // Check again against just the consensus-critical mandatory script
-        // verification flags, in case of bugs in the standard flags that cause
-        // transactions to pass as valid when they're actually invalid. For
-        // instance the STRICTENC flag was incorrectly allowing certain
+        // Check again against the consensus-critical script verification
+        // flags of the next block, in case of bugs in the standard flags that
+        // cause transactions to pass as valid when they're actually invalid.
+        // For instance the STRICTENC flag was incorrectly allowing certain
         // CHECKSIG NOT scripts to pass, even though they were invalid.
         //
         // There is a similar check in CreateNewBlock() to prevent creating
         // invalid blocks, however allowing such transactions into the mempool
         // can be exploited as a DoS attack.
-        flags = MANDATORY_SCRIPT_VERIFY_FLAGS;
-        if (fCLTVIsActivated)
-            flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
-        if (!CheckInputs(tx, state, view, true, flags, true, precomTxData)) {
-            return error("%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s, %s",
+        //
+        // Using the exact block flags lets this pass be stored in the script
+        // execution cache, so ConnectBlock can skip the scripts of this
+        // transaction when it is mined.
+        flags = GetBlockScriptFlags(chainActive.Tip(), consensus);
+        if (!CheckInputs(tx, state, view, true, flags, true, true, precomTxData)) {
+            return error("%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against block but not STANDARD flags %s, %s",
                     __func__, hash.ToString(), FormatStateMessage(state));
         }
         // todo: pool.removeStaged for all conflicting entries
@@ -631,28 +657,10 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, uint256& hashBl
             return true;
         }
 
-        if (fTxIndex) {
-            CDiskTxPos postx;
-            if (pblocktree->ReadTxIndex(hash, postx)) {
-                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-                if (file.IsNull())
-                    return error("%s: OpenBlockFile failed", __func__);
-                CBlockHeader header;
-                try {
-                    file >> header;
-                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                    file >> txOut;
-                } catch (const std::exception& e) {
-                    return error("%s : Deserialize or I/O error - %s", __func__, e.what());
-                }
-                hashBlock = header.GetHash();
-                if (txOut->GetHash() != hash)
-                    return error("%s : txid mismatch", __func__);
-                return true;
-            }
-
-            // transaction not found in the index, nothing more can be done
-            return false;
+        // The index is built in the background: a transaction missing from it
+        // may just not be indexed yet, so fall back to the slow lookup.
+        if (g_txindex && g_txindex->FindTx(hash, hashBlock, txOut)) {
+            return true;
         }
 
         if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
@@ -661,7 +669,8 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, uint256& hashBl
         }
     }
 
-    if (pindexSlow) {
+    // The block data may have been pruned
+    if (pindexSlow && (pindexSlow->nStatus & BLOCK_HAVE_DATA)) {
         CBlock block;
         if (ReadBlockFromDisk(block, pindexSlow)) {
             for (const auto& tx : block.vtx) {
@@ -704,20 +713,57 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos)
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos)
 {
-    block.SetNull();
+    // Seek back to the index header written by WriteBlockToDisk
+    if (pos.nPos < 8)
+        return error("%s : invalid block position %s", __func__, pos.ToString());
+    CDiskBlockPos hpos = pos;
+    hpos.nPos -= 8;
 
     // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
-        return error("ReadBlockFromDisk : OpenBlockFile failed");
+        return error("%s : OpenBlockFile failed for %s", __func__, pos.ToString());
+
+    try {
+        unsigned char blk_start[MESSAGE_START_SIZE];
+        unsigned int blk_size;
+        filein >> FLATDATA(blk_start) >> blk_size;
+
+        if (memcmp(blk_start, Params().MessageStart(), MESSAGE_START_SIZE))
+            return error("%s : block magic mismatch for %s", __func__, pos.ToString());
+        if (blk_size < 80 || blk_size > MAX_BLOCK_SIZE_CURRENT)
+            return error("%s : invalid block size %u for %s", __func__, blk_size, pos.ToString());
+
+        // A single read of the whole block, straight into the buffer
+        block.resize(blk_size);
+        filein.read((char*)block.data(), blk_size);
+    } catch (const std::exception& e) {
+        return error("%s : I/O error - %s for %s", __func__, e.what(), pos.ToString());
+    }
+
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex)
+{
+    return ReadRawBlockFromDisk(block, pindex->GetBlockPos());
+}
+
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
+{
+    block.SetNull();
+
+    std::vector<uint8_t> data;
+    if (!ReadRawBlockFromDisk(data, pos))
+        return error("ReadBlockFromDisk : failed to read block at %s", pos.ToString());
 
     // Read block
     try {
-        filein >> block;
+        VectorReader(SER_DISK, CLIENT_VERSION, data, 0) >> block;
     } catch (const std::exception& e) {
-        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        return error("%s : Deserialize error - %s", __func__, e.what());
     }
 
     // Check the header
@@ -1016,7 +1062,27 @@ bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoins
 }
 }// namespace Consensus
 
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck> *pvChecks)
+namespace {
+/**
+ * Transactions whose scripts all passed with a given set of flags, to skip
+ * script evaluation of mempool transactions when they are included in a block.
+ * Entries are SHA256(nonce || tx hash || flags). Guarded by cs_main.
+ */
+CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache;
+uint256 scriptExecutionCacheNonce(GetRandHash());
+}
+
+void InitScriptExecutionCache()
+{
+    // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
+    // setup_bytes creates the minimum possible cache (2 elements).
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) / 2), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = scriptExecutionCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for script execution cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck> *pvChecks)
 {
     if (!tx.IsCoinBase()) {
 
@@ -1031,6 +1097,21 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
         // before the last block chain checkpoint. This is safe because block merkle hashes are
         // still computed and checked, and any change will be caught at the next checkpoint.
         if (fScriptChecks) {
+            // First check if script executions have been cached with the same
+            // flags. Note that this assumes that the inputs provided are
+            // correct (ie that the transaction hash which is in tx's prevouts
+            // properly commits to the scriptPubKey in the inputs view of that
+            // transaction).
+            uint256 hashCacheEntry;
+            // We only use the first 19 bytes of nonce to avoid a second SHA
+            // round - giving us 19 + 32 + 4 = 55 bytes (+ 8 + 1 = 64)
+            static_assert(55 - sizeof(flags) - 32 >= 128/8, "Want at least 128 bits of nonce for script execution cache");
+            CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - sizeof(flags) - 32).Write(tx.GetHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
+            AssertLockHeld(cs_main);
+            if (scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
+                return true;
+            }
+
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint& prevout = tx.vin[i].prevout;
                 const Coin& coin = inputs.AccessCoin(prevout);
@@ -1045,7 +1126,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                 const CAmount amount = coin.out.nValue;
 
                 // Verify signature
-                CScriptCheck check(scriptPubKey, amount, tx, i, flags, cacheStore, &precomTxData);
+                CScriptCheck check(scriptPubKey, amount, tx, i, flags, cacheSigStore, &precomTxData);
                 if (pvChecks) {
                     pvChecks->emplace_back();
                     check.swap(pvChecks->back());
@@ -1058,7 +1139,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                         // avoid splitting the network between upgraded and
                         // non-upgraded nodes.
                         CScriptCheck check2(scriptPubKey, amount, tx, i,
-                            flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore, &precomTxData);
+                            flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheSigStore, &precomTxData);
                         if (check2())
                             return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
                     }
@@ -1072,6 +1153,12 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                     return state.DoS(100, false, REJECT_INVALID, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(check.GetScriptError())));
                 }
             }
+
+            if (cacheFullScriptStore && !pvChecks) {
+                // We executed all of the provided scripts, and were told to
+                // cache the result. Do so now.
+                scriptExecutionCache.insert(hashCacheEntry);
+            }
         }
     }
 
@@ -1152,6 +1239,15 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uin
 
 } // anon namespace
 
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    const CDiskBlockPos pos = pindex->GetUndoPos();
+    if (pos.IsNull() || !pindex->pprev) {
+        return error("%s : no undo data available for block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+    return UndoReadFromDisk(blockundo, pos, pindex->pprev->GetBlockHash());
+}
+
 enum DisconnectResult
 {
     DISCONNECT_OK,      // All good.
@@ -1195,24 +1291,13 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
 }
 
 
-/** Undo the effects of this block (with given index) on the UTXO set represented by coins.
- *  When FAILED is returned, view is left in an indeterminate state. */
-DisconnectResult DisconnectBlock(CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view)
+/** Undo the effects of this block (with given index and undo data) on the UTXO set represented by coins.
+ *  The undo data is consumed. When FAILED is returned, view is left in an indeterminate state. */
+static DisconnectResult DisconnectBlock(CBlock& block, CBlockUndo& blockUndo, const CBlockIndex* pindex, CCoinsViewCache& view)
 {
     AssertLockHeld(cs_main);
     bool fClean = true;
 
-    CBlockUndo blockUndo;
-    CDiskBlockPos pos = pindex->GetUndoPos();
-    if (pos.IsNull()) {
-        error("%s: no undo data available", __func__);
-        return DISCONNECT_FAILED;
-    }
-    if (!UndoReadFromDisk(blockUndo, pos, pindex->pprev->GetBlockHash())) {
-        error("%s: failure reading undo data", __func__);
-        return DISCONNECT_FAILED;
-    }
-
     if (blockUndo.vtxundo.size() + 1 != block.vtx.size()) {
         error("%s: block and undo data inconsistent", __func__);
         return DISCONNECT_FAILED;
@@ -1282,6 +1367,23 @@ DisconnectResult DisconnectBlock(CBlock& block, const CBlockIndex* pindex, CCoin
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
+/** Undo the effects of this block (with given index) on the UTXO set represented by coins.
+ *  When FAILED is returned, view is left in an indeterminate state. */
+DisconnectResult DisconnectBlock(CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view)
+{
+    CBlockUndo blockUndo;
+    CDiskBlockPos pos = pindex->GetUndoPos();
+    if (pos.IsNull()) {
+        error("%s: no undo data available", __func__);
+        return DISCONNECT_FAILED;
+    }
+    if (!UndoReadFromDisk(blockUndo, pos, pindex->pprev->GetBlockHash())) {
+        error("%s: failure reading undo data", __func__);
+        return DISCONNECT_FAILED;
+    }
+    return DisconnectBlock(block, blockUndo, pindex, view);
+}
+
 void static FlushBlockFile(bool fFinalize = false)
 {
     LOCK(cs_LastBlockFile);
@@ -1315,12 +1417,39 @@ void ThreadScriptCheck()
     scriptcheckqueue.Thread();
 }
 
+// Each job verifies all the proofs of one shielded transaction, so keep the batches small.
+static CCheckQueue<SaplingValidation::CSaplingProofCheck> saplingcheckqueue(4);
+
+void ThreadSaplingCheck()
+{
+    util::ThreadRename("islamic_digital_coin-saplingch");
+    saplingcheckqueue.Thread();
+}
+
 static int64_t nTimeVerify = 0;
 static int64_t nTimeConnect = 0;
 static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
+bool IsAssumedValid(const CBlockIndex* pindex, const CBlockIndex* pindexAssumeValid, const CBlockIndex* pindexBest, const Consensus::Params& consensus)
+{
+    if (pindexAssumeValid->GetAncestor(pindex->nHeight) != pindex ||
+            pindexBest->GetAncestor(pindex->nHeight) != pindex ||
+            pindexBest->nChainWork < consensus.nMinimumChainWork)
+        return false;
+    // This block is a member of the assumed verified chain and an ancestor of the best header.
+    // The equivalent time check discourages hashpower from extorting the network via DOS attack
+    // into accepting an invalid block through telling users they must manually set assumevalid.
+    // Requiring a software change or burying the invalid block, regardless of the setting, makes
+    // it hard to hide the implication of the demand. This also avoids having release candidates
+    // that are hardly doing any signature verification at all in testing without having to
+    // artificially set the default assumed verified block further back.
+    // The test against nMinimumChainWork prevents the skipping when denied access to any chain at
+    // least as good as the expected chain.
+    return GetBlockProofEquivalentTime(*pindexBest, *pindex, *pindexBest) > 60 * 60 * 24 * 7 * 2;
+}
+
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
@@ -1380,22 +1509,27 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     }
 
     bool fScriptChecks = pindex->nHeight >= Checkpoints::GetTotalBlocksEstimate();
-
-    // If scripts won't be checked anyways, don't bother seeing if CLTV is activated
-    bool fCLTVIsActivated = false;
-    if (fScriptChecks && pindex->pprev) {
-        fCLTVIsActivated = consensus.NetworkUpgradeActive(pindex->pprev->nHeight, Consensus::UPGRADE_BIP65);
+    if (fScriptChecks && !hashAssumeValid.IsNull()) {
+        // We've been configured with the hash of a block which has been externally verified to have a valid history.
+        // A suitable default value is included with the software and updated from time to time. Because validity
+        // relative to a piece of software is an objective fact these defaults can be easily reviewed.
+        // This setting doesn't force the selection of any particular chain but makes validating some faster by
+        // effectively caching the result of part of the verification.
+        // Only the script evaluation is skipped: the UTXO, stake, budget and value checks below still run in full.
+        BlockMap::const_iterator it = mapBlockIndex.find(hashAssumeValid);
+        if (it != mapBlockIndex.end())
+            fScriptChecks = !IsAssumedValid(pindex, it->second, pindexBestHeader, consensus);
     }
 
+    // If scripts won't be checked anyways, don't bother computing the flags
+    const unsigned int flags = fScriptChecks ? GetBlockScriptFlags(pindex->pprev, consensus) : 0;
+
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
 
     int64_t nTimeStart = GetTimeMicros();
     CAmount nFees = 0;
     int nInputs = 0;
     unsigned int nSigOps = 0;
-    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
-    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
-    vPos.reserve(block.vtx.size());
     CBlockUndo blockundo;
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
     CAmount nValueOut = 0;
@@ -1457,12 +1591,8 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
             nValueIn += view.GetValueIn(tx);
 
             std::vector<CScriptCheck> vChecks;
-            unsigned int flags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_DERSIG;
-            if (fCLTVIsActivated)
-                flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
-
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, precomTxData[i], nScriptCheckThreads ? &vChecks : NULL))
+            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, precomTxData[i], nScriptCheckThreads ? &vChecks : NULL))
                 return error("%s: Check inputs on %s failed with %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
             control.Add(vChecks);
         }
@@ -1481,9 +1611,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
                 sapling_tree.append(outputDescription.cmu);
             }
         }
-
-        vPos.emplace_back(tx.GetHash(), pos);
-        pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
 
     // Push new tree anchor
@@ -1555,11 +1682,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         setDirtyBlockIndex.insert(pindex);
     }
 
-
-    if (fTxIndex)
-        if (!pblocktree->WriteTxIndex(vPos))
-            return AbortNode(state, "Failed to write transaction index");
-
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -1579,6 +1701,8 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
  * The caches and indexes are flushed if either they're too large, forceWrite is set, or
  * fast is not set and it's been a while since the last write.
  * Full flush also updates the money supply from disk (except during shutdown)
+ * In prune mode, the block files selected by FindFilesToPrune are deleted once the
+ * block index and the chainstate no longer need them.
  */
 bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
 {
@@ -1587,7 +1711,20 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
     static int64_t nLastWrite = 0;
     static int64_t nLastFlush = 0;
     static int64_t nLastSetChain = 0;
+    std::set<int> setFilesToPrune;
+    bool fFlushForPrune = false;
     try {
+        if (fPruneMode && fCheckForPruning && !fReindex) {
+            FindFilesToPrune(setFilesToPrune, Params().PruneAfterHeight());
+            fCheckForPruning = false;
+            if (!setFilesToPrune.empty()) {
+                fFlushForPrune = true;
+                if (!fHavePruned) {
+                    pblocktree->WriteFlag("prunedblockfiles", true);
+                    fHavePruned = true;
+                }
+            }
+        }
         int64_t nNow = GetTimeMicros();
         // Avoid writing/flushing immediately after startup.
         if (nLastWrite == 0) {
@@ -1614,7 +1751,7 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
         // It's been very long since we flushed the cache. Do this infrequently, to optimize cache usage.
         bool fPeriodicFlush = mode == FLUSH_STATE_PERIODIC && nNow > nLastFlush + (int64_t)DATABASE_FLUSH_INTERVAL * 1000000;
         // Combine all conditions that result in a full cache flush.
-        bool fDoFullFlush = (mode == FLUSH_STATE_ALWAYS) || fCacheLarge || fCacheCritical || fPeriodicFlush;
+        bool fDoFullFlush = (mode == FLUSH_STATE_ALWAYS) || fCacheLarge || fCacheCritical || fPeriodicFlush || fFlushForPrune;
         // Write blocks and block index to disk.
         if (fDoFullFlush || fPeriodicWrite) {
             // Depend on nMinDiskSpace to ensure we can write block index
@@ -1660,6 +1797,10 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
             if (!ShutdownRequested() && !IsInitialBlockDownload()) {
                 MoneySupply.Update(pcoinsTip->GetTotalAmount(), chainActive.Height());
             }
+            // Finally remove any pruned files: neither the block index nor the
+            // chainstate on disk refer to them anymore.
+            if (fFlushForPrune)
+                UnlinkPrunedFiles(setFilesToPrune);
         }
         if ((mode == FLUSH_STATE_ALWAYS || mode == FLUSH_STATE_PERIODIC) && nNow > nLastSetChain + (int64_t)DATABASE_WRITE_INTERVAL * 1000000) {
             // Update best block in wallet (so we can detect restored wallets).
@@ -1679,6 +1820,13 @@ void FlushStateToDisk()
     FlushStateToDisk(state, FLUSH_STATE_ALWAYS);
 }
 
+void PruneAndFlush()
+{
+    CValidationState state;
+    fCheckForPruning = true;
+    FlushStateToDisk(state, FLUSH_STATE_NONE);
+}
+
 /** Update chainActive and related internal data structures. */
 void static UpdateTip(CBlockIndex* pindexNew)
 {
@@ -2260,6 +2408,20 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex* pindex)
     return true;
 }
 
+/** Compute and set the stake modifier of a block index, from its block transactions. */
+static void SetNewStakeModifier(CBlockIndex* pindexNew, const CBlock& block)
+{
+    const Consensus::Params& consensus = Params().GetConsensus();
+    if (!consensus.NetworkUpgradeActive(pindexNew->nHeight, Consensus::UPGRADE_V3_4)) {
+        // compute and set new V1 stake modifier (entropy bits)
+        pindexNew->SetNewStakeModifier();
+
+    } else {
+        // compute and set new V2 stake modifier (hash of prevout and prevModifier)
+        pindexNew->SetNewStakeModifier(block.vtx[1]->vin[0].prevout.hash);
+    }
+}
+
 CBlockIndex* AddToBlockIndex(const CBlock& block)
 {
     // Check for duplicate
@@ -2284,15 +2446,11 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
         pindexNew->nHeight = pindexNew->pprev->nHeight + 1;
         pindexNew->BuildSkip();
 
-        const Consensus::Params& consensus = Params().GetConsensus();
-        if (!consensus.NetworkUpgradeActive(pindexNew->nHeight, Consensus::UPGRADE_V3_4)) {
-            // compute and set new V1 stake modifier (entropy bits)
-            pindexNew->SetNewStakeModifier();
-
-        } else {
-            // compute and set new V2 stake modifier (hash of prevout and prevModifier)
-            pindexNew->SetNewStakeModifier(block.vtx[1]->vin[0].prevout.hash);
-        }
+        // A header alone (headers-first sync) has no coinstake, and the modifier
+        // depends on the type of the previous blocks: it is set by
+        // ReceivedBlockTransactions once the block data arrives.
+        if (!block.vtx.empty())
+            SetNewStakeModifier(pindexNew, block);
     }
     pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
@@ -2309,6 +2467,9 @@ bool ReceivedBlockTransactions(const CBlock& block, CValidationState& state, CBl
 {
     if (block.IsProofOfStake())
         pindexNew->SetProofOfStake();
+    // Index entry added from the header only: its parent has its block data by now
+    if (pindexNew->pprev && pindexNew->vStakeModifier.empty())
+        SetNewStakeModifier(pindexNew, block);
     pindexNew->nTx = block.vtx.size();
     pindexNew->nChainTx = 0;
 
@@ -2404,6 +2565,8 @@ bool FindBlockPos(CValidationState& state, CDiskBlockPos& pos, unsigned int nAdd
         unsigned int nOldChunks = (pos.nPos + BLOCKFILE_CHUNK_SIZE - 1) / BLOCKFILE_CHUNK_SIZE;
         unsigned int nNewChunks = (vinfoBlockFile[nFile].nSize + BLOCKFILE_CHUNK_SIZE - 1) / BLOCKFILE_CHUNK_SIZE;
         if (nNewChunks > nOldChunks) {
+            if (fPruneMode)
+                fCheckForPruning = true;
             if (CheckDiskSpace(nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos)) {
                 FILE* file = OpenBlockFile(pos);
                 if (file) {
@@ -2434,6 +2597,8 @@ bool FindUndoPos(CValidationState& state, int nFile, CDiskBlockPos& pos, unsigne
     unsigned int nOldChunks = (pos.nPos + UNDOFILE_CHUNK_SIZE - 1) / UNDOFILE_CHUNK_SIZE;
     unsigned int nNewChunks = (nNewSize + UNDOFILE_CHUNK_SIZE - 1) / UNDOFILE_CHUNK_SIZE;
     if (nNewChunks > nOldChunks) {
+        if (fPruneMode)
+            fCheckForPruning = true;
         if (CheckDiskSpace(nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos)) {
             FILE* file = OpenUndoFile(pos);
             if (file) {
@@ -2466,11 +2631,19 @@ bool CheckColdStakeFreeOutput(const CTransaction& tx, const int nHeight)
         // if mnsync is incomplete, we cannot verify if this is a budget block.
         // so we check that the staker is not transferring value to the free output
         if (!masternodeSync.IsSynced()) {
-            // First try finding the previous transaction in database
-            CTransactionRef txPrev; uint256 hashBlock;
-            if (!GetTransaction(tx.vin[0].prevout.hash, txPrev, hashBlock, true))
-                return error("%s : read txPrev failed: %s",  __func__, tx.vin[0].prevout.hash.GetHex());
-            CAmount amtIn = txPrev->vout[tx.vin[0].prevout.n].nValue + GetBlockValue(nHeight);
+            // First try finding the staked output in the UTXO set (its block may have been
+            // pruned), then the previous transaction in database
+            CAmount amtIn;
+            const Coin& coin = pcoinsTip->AccessCoin(tx.vin[0].prevout);
+            if (!coin.IsSpent()) {
+                amtIn = coin.out.nValue + GetBlockValue(nHeight);
+            } else {
+                CTransactionRef txPrev; uint256 hashBlock;
+                if (!GetTransaction(tx.vin[0].prevout.hash, txPrev, hashBlock, true))
+                    return error("%s : read txPrev failed: %s%s",  __func__, tx.vin[0].prevout.hash.GetHex(),
+                                 g_txindex && !g_txindex->IsSynced() ? " (txindex is syncing)" : "");
+                amtIn = txPrev->vout[tx.vin[0].prevout.n].nValue + GetBlockValue(nHeight);
+            }
             CAmount amtOut = 0;
             for (unsigned int i = 1; i < outs-1; i++) amtOut += tx.vout[i].nValue;
             if (amtOut != amtIn)
@@ -2522,7 +2695,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
     // because we receive the wrong transactions for it.
 
     // Check the merkle root.
-    if (fCheckMerkleRoot) {
+    if (fCheckMerkleRoot && !block.fCheckedMerkleRoot) {
         bool mutated;
         uint256 hashMerkleRoot2 = BlockMerkleRoot(block, &mutated);
         if (block.hashMerkleRoot != hashMerkleRoot2)
@@ -2623,7 +2796,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
             REJECT_INVALID, "bad-blk-sigops", true);
 
     // Check PoS signature.
-    if (fCheckSig && !CheckBlockSignature(block)) {
+    if (fCheckSig && !block.fCheckedSignature && !CheckBlockSignature(block)) {
         return state.DoS(100, error("%s : bad proof-of-stake block signature", __func__),
                          REJECT_INVALID, "bad-PoS-sig", true);
     }
@@ -2760,15 +2933,40 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIn
     const int nHeight = pindexPrev == nullptr ? 0 : pindexPrev->nHeight + 1;
     const CChainParams& chainparams = Params();
 
-    // Check that all transactions are finalized
-    for (const auto& tx : block.vtx) {
+    // Sapling proofs are verified in parallel by the check queue. Every transaction
+    // gets its own validation state, so that (once all the jobs are done) the failure
+    // of the first invalid transaction can be reported.
+    std::vector<CValidationState> vTxState(block.vtx.size());
+    size_t nNonFinalTx = block.vtx.size();
+    {
+        CCheckQueueControl<SaplingValidation::CSaplingProofCheck> control(nScriptCheckThreads ? &saplingcheckqueue : nullptr);
+        const bool fInitialBlockDownload = IsInitialBlockDownload();
+
+        // Check that all transactions are finalized
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            const CTransactionRef& tx = block.vtx[i];
+
+            // Sapling: Check transaction contextually against consensus rules at block height
+            std::vector<SaplingValidation::CSaplingProofCheck> vChecks;
+            if (!SaplingValidation::ContextualCheckTransaction(*tx, vTxState[i], chainparams, nHeight, true, fInitialBlockDownload,
+                                                               nScriptCheckThreads ? &vChecks : nullptr)) {
+                break; // Failure reason has been set in validation state object
+            }
+            control.Add(vChecks);
 
-        // Sapling: Check transaction contextually against consensus rules at block height
-        if (!SaplingValidation::ContextualCheckTransaction(*tx, state, chainparams, nHeight, true, IsInitialBlockDownload())) {
-            return false; // Failure reason has been set in validation state object
+            if (!IsFinalTx(tx, nHeight, block.GetBlockTime())) {
+                nNonFinalTx = i;
+                break;
+            }
         }
-
-        if (!IsFinalTx(tx, nHeight, block.GetBlockTime())) {
+        control.Wait();
+    }
+    for (size_t i = 0; i < vTxState.size(); i++) {
+        if (!vTxState[i].IsValid()) {
+            state = vTxState[i];
+            return false;
+        }
+        if (i == nNonFinalTx) {
             return state.DoS(10, false, REJECT_INVALID, "bad-txns-nonfinal", false, "non-final transaction");
         }
     }
@@ -2869,11 +3067,21 @@ bool AcceptBlock(const CBlock& block, CValidationState& state, CBlockIndex** ppi
     if (block.GetHash() != consensus.hashGenesisBlock && !CheckWork(block, pindexPrev))
         return false;
 
+    // A parent known from its header only has no stake modifier yet
+    if (pindexPrev && pindexPrev->pprev && pindexPrev->vStakeModifier.empty())
+        return state.Error(strprintf("%s: parent block %s not received yet", __func__, pindexPrev->GetBlockHash().GetHex()));
+
     bool isPoS = block.IsProofOfStake();
     if (isPoS) {
         std::string strError;
-        if (!CheckProofOfStake(block, strError, pindexPrev))
+        if (!CheckProofOfStake(block, strError, pindexPrev)) {
+            // The stake input of a block off the active chain may only be found
+            // with the txindex: while it is being built, the block can't be
+            // validated yet, it isn't known to be invalid.
+            if (g_txindex && !g_txindex->IsSynced())
+                return state.Error(strprintf("%s: can't check proof of stake while txindex is syncing (%s)", __func__, strError));
             return state.DoS(100, error("%s: proof of stake check failed (%s)", __func__, strError));
+        }
     }
 
     if (!AcceptBlockHeader(block, state, &pindex, pindexPrev))
@@ -3012,6 +3220,9 @@ bool AcceptBlock(const CBlock& block, CValidationState& state, CBlockIndex** ppi
         return AbortNode(state, std::string("System error: ") + e.what());
     }
 
+    if (fCheckForPruning)
+        FlushStateToDisk(state, FLUSH_STATE_NONE); // we just allocated more disk space for block files
+
     return true;
 }
 
@@ -3058,6 +3269,39 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, const std::shared_pt
     return true;
 }
 
+bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, CBlockIndex** ppindex)
+{
+    LOCK(cs_main);
+    const Consensus::Params& consensus = Params().GetConsensus();
+    for (const CBlockHeader& header : headers) {
+        const CBlock block(header);
+        CBlockIndex* pindexPrev = nullptr;
+        CBlockIndex* pindex = nullptr;
+        if (!mapBlockIndex.count(block.GetHash())) {
+            if (!GetPrevIndex(block, &pindexPrev, state))
+                return false;
+            const int nHeight = pindexPrev->nHeight + 1;
+            if (consensus.NetworkUpgradeActive(nHeight, Consensus::UPGRADE_POS) &&
+                    nHeight > chainActive.Height() + BLOCK_DOWNLOAD_WINDOW) {
+                LogPrint(BCLog::NET, "%s: header %s at height %d too far ahead of the active chain, ignored\n",
+                         __func__, block.GetHash().ToString(), nHeight);
+                return true;
+            }
+            // The proof of stake needs the coinstake of the block: it is checked by AcceptBlock
+            if (!CheckWork(block, pindexPrev))
+                return state.DoS(50, false, REJECT_INVALID, "bad-diffbits", false, "incorrect difficulty");
+            if (!consensus.NetworkUpgradeActive(nHeight, Consensus::UPGRADE_POS) &&
+                    !CheckProofOfWork(block.GetHash(), block.nBits))
+                return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
+        }
+        if (!AcceptBlockHeader(block, state, &pindex, pindexPrev))
+            return false;
+        if (ppindex)
+            *ppindex = pindex;
+    }
+    return true;
+}
+
 bool TestBlockValidity(CValidationState& state, const CBlock& block, CBlockIndex* const pindexPrev, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckBlockSig)
 {
     AssertLockHeld(cs_main);
@@ -3086,6 +3330,143 @@ bool TestBlockValidity(CValidationState& state, const CBlock& block, CBlockIndex
     return true;
 }
 
+/* Calculate the amount of disk space the block & undo files currently use */
+uint64_t CalculateCurrentUsage()
+{
+    uint64_t retval = 0;
+    for (const CBlockFileInfo& file : vinfoBlockFile) {
+        retval += file.nSize + file.nUndoSize;
+    }
+    return retval;
+}
+
+/* Prune a block file (modify associated database entries)*/
+void PruneOneBlockFile(const int fileNumber)
+{
+    AssertLockHeld(cs_main);
+
+    for (BlockMap::iterator it = mapBlockIndex.begin(); it != mapBlockIndex.end(); ++it) {
+        CBlockIndex* pindex = it->second;
+        if (pindex->nFile == fileNumber) {
+            pindex->nStatus &= ~BLOCK_HAVE_DATA;
+            pindex->nStatus &= ~BLOCK_HAVE_UNDO;
+            pindex->nFile = 0;
+            pindex->nDataPos = 0;
+            pindex->nUndoPos = 0;
+            setDirtyBlockIndex.insert(pindex);
+
+            // Prune from mapBlocksUnlinked -- any block we prune would have
+            // to be downloaded again in order to consider its chain, at which
+            // point it would be considered as a candidate for
+            // mapBlocksUnlinked or setBlockIndexCandidates.
+            std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindex->pprev);
+            while (range.first != range.second) {
+                std::multimap<CBlockIndex*, CBlockIndex*>::iterator _it = range.first;
+                range.first++;
+                if (_it->second == pindex) {
+                    mapBlocksUnlinked.erase(_it);
+                }
+            }
+        }
+    }
+
+    vinfoBlockFile[fileNumber].SetNull();
+    setDirtyFileInfo.insert(fileNumber);
+}
+
+void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
+{
+    for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
+        CDiskBlockPos pos(*it, 0);
+        fs::remove(GetBlockPosFilename(pos, "blk"));
+        fs::remove(GetBlockPosFilename(pos, "rev"));
+        LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
+    }
+}
+
+int GetLastBlockWeCanPrune(int nTipHeight)
+{
+    const int nKeepDepth = std::max<int>(MIN_BLOCKS_TO_KEEP, gArgs.GetArg("-maxreorg", DEFAULT_MAX_REORG_DEPTH));
+    return nTipHeight > nKeepDepth ? nTipHeight - nKeepDepth : -1;
+}
+
+uint64_t SelectFilesToPrune(const std::vector<CBlockFileInfo>& vinfo, int nLastFile, uint64_t nTarget,
+                           unsigned int nLastBlockWeCanPrune, std::set<int>& setFilesToPrune)
+{
+    uint64_t nCurrentUsage = 0;
+    for (const CBlockFileInfo& file : vinfo) {
+        nCurrentUsage += file.nSize + file.nUndoSize;
+    }
+    // We don't check to prune until after we've allocated new space for files
+    // So we should leave a buffer under our target to account for another allocation
+    // before the next pruning.
+    uint64_t nBuffer = BLOCKFILE_CHUNK_SIZE + UNDOFILE_CHUNK_SIZE;
+    if (nCurrentUsage + nBuffer < nTarget) {
+        return nCurrentUsage;
+    }
+
+    // The file being written to is never pruned
+    for (int fileNumber = 0; fileNumber < nLastFile && fileNumber < (int)vinfo.size(); fileNumber++) {
+        if (vinfo[fileNumber].nSize == 0)
+            continue;
+
+        if (nCurrentUsage + nBuffer < nTarget) // are we below our target?
+            break;
+
+        // don't prune files that could have a block within MIN_BLOCKS_TO_KEEP of the main chain's tip but keep scanning
+        if (vinfo[fileNumber].nHeightLast > nLastBlockWeCanPrune)
+            continue;
+
+        // Queue up the files for removal
+        setFilesToPrune.insert(fileNumber);
+        nCurrentUsage -= vinfo[fileNumber].nSize + vinfo[fileNumber].nUndoSize;
+    }
+    return nCurrentUsage;
+}
+
+/**
+ * Prune block and undo files (blk???.dat and rev???.dat) so that the disk space used is less than a user-defined target.
+ * The user sets the target (in MB) on the command line or in config file.  This will be run on startup and whenever new
+ * space is allocated in a block or undo file, staying below the target. Changing back to unpruned requires a reindex
+ * (which in this case means the blockchain must be re-downloaded.)
+ *
+ * Pruning functions are called from FlushStateToDisk when the global fCheckForPruning flag has been set.
+ * Block and undo files are deleted in lock-step (when blk00003.dat is deleted, so is rev00003.dat.)
+ * Pruning cannot take place until the longest chain is at least a certain length (100000 on mainnet, 1000 on testnet, 1000 on regtest).
+ * Pruning will never delete a block within a defined distance (currently 288) from the active chain's tip,
+ * nor within the maximum reorganization depth (-maxreorg), which AcceptBlock walks back over when a fork
+ * block arrives.
+ * The block index is updated by unsetting HAVE_DATA and HAVE_UNDO for any blocks that were stored in the deleted files.
+ * A db flag records the fact that at least some block files have been pruned.
+ *
+ * @param[out]   setFilesToPrune   The set of file indices that can be unlinked will be returned
+ */
+static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight)
+{
+    LOCK2(cs_main, cs_LastBlockFile);
+    if (chainActive.Tip() == NULL || nPruneTarget == 0) {
+        return;
+    }
+    if ((uint64_t)chainActive.Tip()->nHeight <= nPruneAfterHeight) {
+        return;
+    }
+
+    const int nLastBlockWeCanPrune = GetLastBlockWeCanPrune(chainActive.Tip()->nHeight);
+    if (nLastBlockWeCanPrune < 0) {
+        return;
+    }
+    uint64_t nCurrentUsage = SelectFilesToPrune(vinfoBlockFile, nLastBlockFile, nPruneTarget, nLastBlockWeCanPrune, setFilesToPrune);
+    for (const int fileNumber : setFilesToPrune) {
+        PruneOneBlockFile(fileNumber);
+    }
+    const size_t count = setFilesToPrune.size();
+
+    LogPrint(BCLog::PRUNE, "Prune: target=%dMiB actual=%dMiB diff=%dMiB max_prune_height=%d removed %d blk/rev pairs\n",
+           nPruneTarget/1024/1024, nCurrentUsage/1024/1024,
+           ((int64_t)nPruneTarget - (int64_t)nCurrentUsage)/1024/1024,
+           nLastBlockWeCanPrune, count);
+}
+
 bool CheckDiskSpace(uint64_t nAdditionalBytes)
 {
     uint64_t nFreeBytesAvailable = fs::space(GetDataDir()).available;
@@ -3177,7 +3558,9 @@ bool static LoadBlockIndexDB(std::string& strError)
 
         CBlockIndex* pindex = item.second;
         pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
-        if (pindex->nStatus & BLOCK_HAVE_DATA) {
+        // We can link the chain of blocks for which we've received transactions at some point.
+        // Pruned nodes may have deleted the block.
+        if (pindex->nTx > 0) {
             if (pindex->pprev) {
                 if (pindex->pprev->nChainTx) {
                     pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
@@ -3246,15 +3629,16 @@ bool static LoadBlockIndexDB(std::string& strError)
     pblocktree->ReadFlag("shutdown", fLastShutdownWasPrepared);
     LogPrintf("%s: Last shutdown was prepared: %s\n", __func__, fLastShutdownWasPrepared);
 
+    // Check whether we have ever pruned block & undo files
+    pblocktree->ReadFlag("prunedblockfiles", fHavePruned);
+    if (fHavePruned)
+        LogPrintf("LoadBlockIndexDB(): Block files have previously been pruned\n");
+
     // Check whether we need to continue reindexing
     bool fReindexing = false;
     pblocktree->ReadReindexing(fReindexing);
     if (fReindexing) fReindex = true;
 
-    // Check whether we have a transaction index
-    pblocktree->ReadFlag("txindex", fTxIndex);
-    LogPrintf("LoadBlockIndexDB(): transaction index %s\n", fTxIndex ? "enabled" : "disabled");
-
     // If this is written true before the next client init, then we know the shutdown process failed
     pblocktree->WriteFlag("shutdown", false);
 
@@ -3306,6 +3690,132 @@ CVerifyDB::~CVerifyDB()
     uiInterface.ShowProgress("", 100);
 }
 
+namespace {
+
+/**
+ * Reads the blocks checked by CVerifyDB on a pool of threads, along with the
+ * checks that don't depend on the chain state: the merkle root and the block
+ * signature (level 1) and the undo data (level 2). The blocks are handed out
+ * in the given order, at most four blocks per thread ahead of the caller, which does
+ * the rest of the checks under cs_main.
+ */
+class VerifyDBPipeline
+{
+public:
+    struct Item {
+        CBlock block;
+        CBlockUndo undo;
+        bool fDone{false};
+        std::string strError;
+    };
+
+private:
+    const std::vector<const CBlockIndex*> m_index;
+    const int m_check_level;
+    const size_t m_window;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv_done;
+    std::condition_variable m_cv_window;
+    //! Ring buffer of the blocks being checked and ready, indexed by position modulo m_window
+    std::vector<Item> m_items;
+    size_t m_next_work{0};
+    size_t m_next_out{0};
+    bool m_stop{false};
+    std::vector<std::thread> m_threads;
+
+    void Check(const CBlockIndex* pindex, Item& item) const
+    {
+        // check level 0: read from disk
+        if (!ReadBlockFromDisk(item.block, pindex)) {
+            item.strError = strprintf("ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+            return;
+        }
+        // check level 1: the context-free checks of CheckBlock that don't need cs_main
+        if (m_check_level >= 1) {
+            bool mutated;
+            if (BlockMerkleRoot(item.block, &mutated) != item.block.hashMerkleRoot || mutated) {
+                item.strError = strprintf("found bad block at %d, hash=%s (bad merkle root)", pindex->nHeight, pindex->GetBlockHash().ToString());
+                return;
+            }
+            if (!CheckBlockSignature(item.block)) {
+                item.strError = strprintf("found bad block at %d, hash=%s (bad block signature)", pindex->nHeight, pindex->GetBlockHash().ToString());
+                return;
+            }
+        }
+        // check level 2: verify undo validity
+        if (m_check_level >= 2) {
+            CDiskBlockPos pos = pindex->GetUndoPos();
+            if (!pos.IsNull() && !UndoReadFromDisk(item.undo, pos, pindex->pprev->GetBlockHash())) {
+                item.strError = strprintf("found bad undo data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+                return;
+            }
+        }
+    }
+
+    void ThreadWork()
+    {
+        util::ThreadRename("islamic_digital_coin-verifydb");
+        while (true) {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv_window.wait(lock, [this] { return m_stop || m_next_work >= m_index.size() || m_next_work < m_next_out + m_window; });
+                if (m_stop || m_next_work >= m_index.size()) return;
+                i = m_next_work++;
+            }
+            Item item;
+            Check(m_index[i], item);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_items[i % m_window] = std::move(item);
+                m_items[i % m_window].fDone = true;
+            }
+            m_cv_done.notify_all();
+        }
+    }
+
+public:
+    VerifyDBPipeline(std::vector<const CBlockIndex*> vIndex, int nCheckLevel, int nThreads)
+        : m_index(std::move(vIndex)), m_check_level(nCheckLevel), m_window(4 * nThreads), m_items(m_window)
+    {
+        for (int i = 0; i < nThreads; i++) {
+            m_threads.emplace_back(&VerifyDBPipeline::ThreadWork, this);
+        }
+    }
+
+    ~VerifyDBPipeline()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv_window.notify_all();
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    /** Wait for the next block, in order. */
+    Item Next()
+    {
+        Item item;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            assert(m_next_out < m_index.size());
+            Item& slot = m_items[m_next_out % m_window];
+            m_cv_done.wait(lock, [&slot] { return slot.fDone; });
+            item = std::move(slot);
+            slot = Item();
+            m_next_out++;
+        }
+        m_cv_window.notify_all();
+        return item;
+    }
+};
+
+} // namespace
+
 bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth)
 {
     LOCK(cs_main);
@@ -3319,71 +3829,100 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
     if (nCheckDepth > chainHeight)
         nCheckDepth = chainHeight;
     nCheckLevel = std::max(0, std::min(4, nCheckLevel));
-    LogPrintf("Verifying last %i blocks at level %i\n", nCheckDepth, nCheckLevel);
+    // Blocks are read and checked ahead on these threads, while this one
+    // does the checks that need the chain state.
+    const int nThreads = std::max(1, nScriptCheckThreads);
+    LogPrintf("Verifying last %i blocks at level %i, using %i threads\n", nCheckDepth, nCheckLevel, nThreads);
+    const int64_t nStart = GetTimeMillis();
+
+    std::vector<const CBlockIndex*> vIndex;
+    for (const CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev) {
+        if (pindex->nHeight < chainHeight - nCheckDepth)
+            break;
+        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+            // If pruning, only go back as far as we have data.
+            LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
+            break;
+        }
+        vIndex.push_back(pindex);
+    }
+
     CCoinsViewCache coins(coinsview);
     CBlockIndex* pindexState = chainActive.Tip();
-    CBlockIndex* pindexFailure = NULL;
+    const CBlockIndex* pindexFailure = NULL;
     int nGoodTransactions = 0;
+    int nReportDone = 0;
     CValidationState state;
-    for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev) {
-        boost::this_thread::interruption_point();
-        uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainHeight - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
-        if (pindex->nHeight < chainHeight - nCheckDepth)
-            break;
-        CBlock block;
-        // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex))
-            return error("%s: *** ReadBlockFromDisk failed at %d, hash=%s", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
-        // check level 1: verify block validity
-        if (nCheckLevel >= 1 && !CheckBlock(block, state))
-            return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__, pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            CDiskBlockPos pos = pindex->GetUndoPos();
-            if (!pos.IsNull()) {
-                if (!UndoReadFromDisk(undo, pos, pindex->pprev->GetBlockHash()))
-                    return error("%s: *** found bad undo data at %d, hash=%s\n", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
-            }
-        }
-        // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
-            assert(coins.GetBestBlock() == pindex->GetBlockHash());
-            DisconnectResult res = DisconnectBlock(block, pindex, coins);
-            if (res == DISCONNECT_FAILED) {
-                return error("%s: *** irrecoverable inconsistency in block data at %d, hash=%s", __func__,
-                             pindex->nHeight, pindex->GetBlockHash().ToString());
+    {
+        VerifyDBPipeline pipeline(vIndex, nCheckLevel, nThreads);
+        for (const CBlockIndex* pindex : vIndex) {
+            boost::this_thread::interruption_point();
+            const int nPercentageDone = std::max(1, std::min(99, (int)(((double)(chainHeight - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100))));
+            if (nPercentageDone >= nReportDone + 10) {
+                nReportDone = nPercentageDone / 10 * 10;
+                LogPrintf("Verification progress: %d%%\n", nReportDone);
             }
-            pindexState = pindex->pprev;
-            if (res == DISCONNECT_UNCLEAN) {
-                nGoodTransactions = 0;
-                pindexFailure = pindex;
-            } else {
-                nGoodTransactions += block.vtx.size();
+            uiInterface.ShowProgress(_("Verifying blocks..."), nPercentageDone);
+            VerifyDBPipeline::Item item = pipeline.Next();
+            if (!item.strError.empty())
+                return error("%s: *** %s", __func__, item.strError);
+            // check level 1: verify block validity (the merkle root and signature were checked by the pipeline)
+            if (nCheckLevel >= 1 && !CheckBlock(item.block, state, true, false, false))
+                return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__, pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
+            // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
+            if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
+                assert(coins.GetBestBlock() == pindex->GetBlockHash());
+                if (pindex->GetUndoPos().IsNull()) {
+                    return error("%s: *** no undo data at %d, hash=%s", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
+                }
+                DisconnectResult res = DisconnectBlock(item.block, item.undo, pindex, coins);
+                if (res == DISCONNECT_FAILED) {
+                    return error("%s: *** irrecoverable inconsistency in block data at %d, hash=%s", __func__,
+                                 pindex->nHeight, pindex->GetBlockHash().ToString());
+                }
+                pindexState = pindex->pprev;
+                if (res == DISCONNECT_UNCLEAN) {
+                    nGoodTransactions = 0;
+                    pindexFailure = pindex;
+                } else {
+                    nGoodTransactions += item.block.vtx.size();
+                }
             }
+            if (ShutdownRequested())
+                return true;
         }
-        if (ShutdownRequested())
-            return true;
     }
     if (pindexFailure)
         return error("%s: *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", __func__, chainHeight - pindexFailure->nHeight + 1, nGoodTransactions);
 
     // check level 4: try reconnecting blocks
-    if (nCheckLevel >= 4) {
-        CBlockIndex* pindex = pindexState;
-        while (pindex != chainActive.Tip()) {
+    if (nCheckLevel >= 4 && pindexState != chainActive.Tip()) {
+        std::vector<const CBlockIndex*> vReconnect;
+        for (CBlockIndex* pindex = chainActive.Next(pindexState); pindex; pindex = chainActive.Next(pindex)) {
+            vReconnect.push_back(pindex);
+        }
+        // Only read the blocks: they were checked above
+        VerifyDBPipeline pipeline(vReconnect, 0, nThreads);
+        for (const CBlockIndex* pindexConst : vReconnect) {
             boost::this_thread::interruption_point();
-            uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 100 - (int)(((double)(chainHeight - pindex->nHeight)) / (double)nCheckDepth * 50))));
-            pindex = chainActive.Next(pindex);
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex))
-                return error("%s: *** ReadBlockFromDisk failed at %d, hash=%s", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
-            if (!ConnectBlock(block, state, pindex, coins, false))
+            CBlockIndex* pindex = chainActive[pindexConst->nHeight];
+            const int nPercentageDone = std::max(1, std::min(99, 100 - (int)(((double)(chainHeight - pindex->nHeight)) / (double)nCheckDepth * 50)));
+            if (nPercentageDone >= nReportDone + 10) {
+                nReportDone = nPercentageDone / 10 * 10;
+                LogPrintf("Verification progress: %d%%\n", nReportDone);
+            }
+            uiInterface.ShowProgress(_("Verifying blocks..."), nPercentageDone);
+            VerifyDBPipeline::Item item = pipeline.Next();
+            if (!item.strError.empty())
+                return error("%s: *** %s", __func__, item.strError);
+            if (!ConnectBlock(item.block, state, pindex, coins, false))
                 return error("%s: *** found unconnectable block at %d, hash=%s", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
         }
     }
 
+    const int64_t nElapsed = std::max<int64_t>(1, GetTimeMillis() - nStart);
     LogPrintf("No coin database inconsistencies in last %i blocks (%i transactions)\n", chainHeight - pindexState->nHeight, nGoodTransactions);
+    LogPrintf("Verified %u blocks in %.2fs (%.1f blocks/s)\n", vIndex.size(), nElapsed * 0.001, vIndex.size() * 1000.0 / nElapsed);
 
     return true;
 }
@@ -3496,6 +4035,7 @@ void UnloadBlockIndex()
     nBlockSequenceId = 1;
     setDirtyBlockIndex.clear();
     setDirtyFileInfo.clear();
+    fHavePruned = false;
 
     for (BlockMap::value_type& entry : mapBlockIndex) {
         delete entry.second;
@@ -3520,9 +4060,6 @@ bool LoadBlockIndex(std::string& strError)
         // needs_init.
 
         LogPrintf("Initializing databases...\n");
-        // Use the provided setting for -txindex in the new database
-        fTxIndex = gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX);
-        pblocktree->WriteFlag("txindex", fTxIndex);
     }
     return true;
 }
@@ -3561,6 +4098,161 @@ bool LoadGenesisBlock()
 }
 
 
+namespace {
+
+/**
+ * Deserializes the blocks found by LoadExternalBlockFile on a pool of threads,
+ * along with the checks of CheckBlock that don't depend on the chain state: the
+ * merkle root and the block signature. The caller queues the serialized blocks
+ * in file order and takes them back in the same order, to connect them.
+ */
+class BlockImportPipeline
+{
+public:
+    struct Item {
+        std::vector<uint8_t> data;
+        //! Position of the block in the file
+        CDiskBlockPos pos;
+        //! Where to look for a block header again if the block can't be deserialized
+        uint64_t nRewind{0};
+        std::shared_ptr<CBlock> block;
+        std::string strError;
+        bool fDone{false};
+    };
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv_work;
+    std::condition_variable m_cv_done;
+    //! The queued blocks, in file order
+    std::deque<std::shared_ptr<Item>> m_queue;
+    //! The queued blocks that no thread has started on yet
+    std::deque<std::shared_ptr<Item>> m_work;
+    bool m_stop{false};
+    std::vector<std::thread> m_threads;
+
+    //! Blocks a thread takes at once: their headers are hashed together
+    static const size_t HASH_BATCH = 4;
+
+    static void Check(const std::vector<std::shared_ptr<Item>>& batch)
+    {
+        std::vector<Item*> vRead;
+        std::vector<CBlockHeader> vHeaders;
+        for (const std::shared_ptr<Item>& item : batch) {
+            item->block = std::make_shared<CBlock>();
+            try {
+                VectorReader(SER_DISK | SER_NOHASHCACHE, CLIENT_VERSION, item->data, 0) >> *item->block;
+            } catch (const std::exception& e) {
+                item->strError = e.what();
+                continue;
+            }
+            std::vector<uint8_t>().swap(item->data);
+            vRead.push_back(item.get());
+            vHeaders.push_back(*item->block);
+        }
+        const std::vector<uint256> vHashes = GetBlockHeaderHashes(vHeaders);
+
+        for (size_t i = 0; i < vRead.size(); i++) {
+            CBlock& block = *vRead[i]->block;
+            block.UpdateHashCache(vHashes[i]);
+            // Only remember the checks that passed: CheckBlock reports the others
+            bool mutated;
+            if (BlockMerkleRoot(block, &mutated) == block.hashMerkleRoot && !mutated)
+                block.fCheckedMerkleRoot = true;
+            if (CheckBlockSignature(block))
+                block.fCheckedSignature = true;
+        }
+    }
+
+    void ThreadWork()
+    {
+        util::ThreadRename("islamic_digital_coin-blkcheck");
+        while (true) {
+            std::vector<std::shared_ptr<Item>> batch;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv_work.wait(lock, [this] { return m_stop || !m_work.empty(); });
+                if (m_stop) return;
+                while (!m_work.empty() && batch.size() < HASH_BATCH) {
+                    batch.push_back(m_work.front());
+                    m_work.pop_front();
+                }
+            }
+            Check(batch);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for (const std::shared_ptr<Item>& item : batch)
+                    item->fDone = true;
+            }
+            m_cv_done.notify_all();
+        }
+    }
+
+public:
+    explicit BlockImportPipeline(int nThreads)
+    {
+        for (int i = 0; i < nThreads; i++) {
+            m_threads.emplace_back(&BlockImportPipeline::ThreadWork, this);
+        }
+    }
+
+    ~BlockImportPipeline()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv_work.notify_all();
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_queue.size();
+    }
+
+    void Push(std::vector<uint8_t> data, const CDiskBlockPos& pos, uint64_t nRewind)
+    {
+        std::shared_ptr<Item> item = std::make_shared<Item>();
+        item->data = std::move(data);
+        item->pos = pos;
+        item->nRewind = nRewind;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(item);
+            m_work.push_back(item);
+        }
+        m_cv_work.notify_one();
+    }
+
+    /** Wait for the oldest queued block. */
+    Item Next()
+    {
+        std::shared_ptr<Item> item;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            assert(!m_queue.empty());
+            item = m_queue.front();
+            m_cv_done.wait(lock, [&item] { return item->fDone; });
+            m_queue.pop_front();
+        }
+        return std::move(*item);
+    }
+
+    /** Drop the queued blocks. Those being worked on are dropped once done. */
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.clear();
+        m_work.clear();
+    }
+};
+
+} // namespace
+
 bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
@@ -3568,44 +4260,88 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
     int64_t nStart = GetTimeMillis();
 
     int nLoaded = 0;
+    // The whole file is scanned from start to end
+    FileSequentialReadHint(fileIn);
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SIZE_CURRENT, MAX_BLOCK_SIZE_CURRENT + 8, SER_DISK, CLIENT_VERSION);
+        // Blocks are deserialized and checked ahead on these threads, while this
+        // one scans the file and connects them in order.
+        const int nThreads = std::max(1, nScriptCheckThreads);
+        const size_t nWindow = 4 * nThreads;
+        BlockImportPipeline pipeline(nThreads);
         uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        bool fScanned = false;
+        while (true) {
             boost::this_thread::interruption_point();
 
-            blkdat.SetPos(nRewind);
-            nRewind++;         // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[MESSAGE_START_SIZE];
-                blkdat.FindByte(Params().MessageStart()[0]);
-                nRewind = blkdat.GetPos() + 1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
+            // Queue the next blocks of the file
+            while (!fScanned && pipeline.size() < nWindow) {
+                blkdat.SetPos(nRewind);
+                if (blkdat.eof()) {
+                    fScanned = true;
+                    break;
+                }
+                nRewind++;         // start one byte further next time, in case of failure
+                blkdat.SetLimit(); // remove former limit
+                unsigned int nSize = 0;
+                try {
+                    // locate a header
+                    unsigned char buf[MESSAGE_START_SIZE];
+                    blkdat.FindByte(Params().MessageStart()[0]);
+                    nRewind = blkdat.GetPos() + 1;
+                    blkdat >> FLATDATA(buf);
+                    if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
+                        continue;
+                    // read size
+                    blkdat >> nSize;
+                    if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
+                        continue;
+                } catch (const std::exception&) {
+                    // no valid block header found; don't complain
+                    fScanned = true;
+                    break;
+                }
+                try {
+                    // read block
+                    uint64_t nBlockPos = blkdat.GetPos();
+                    blkdat.SetLimit(nBlockPos + nSize);
+                    std::vector<uint8_t> data(nSize);
+                    // in pieces: a single read can't be larger than the buffer minus the rewind window
+                    for (unsigned int nRead = 0; nRead < nSize;) {
+                        const unsigned int nChunk = std::min(nSize - nRead, 1u << 16);
+                        blkdat.read((char*)data.data() + nRead, nChunk);
+                        nRead += nChunk;
+                    }
+                    pipeline.Push(std::move(data), CDiskBlockPos(dbp ? dbp->nFile : -1, nBlockPos), nRewind);
+                    nRewind = blkdat.GetPos();
+                } catch (const std::exception& e) {
+                    LogPrintf("%s : I/O error - %s\n", __func__, e.what());
+                }
+            }
+            if (pipeline.size() == 0)
                 break;
+
+            BlockImportPipeline::Item item = pipeline.Next();
+            if (!item.strError.empty()) {
+                LogPrintf("%s : Deserialize error - %s\n", __func__, item.strError);
+                // Look for a header again from inside this block, like if it was never queued.
+                // The blocks read ahead may have moved the buffer past its rewind window: seek then.
+                pipeline.Clear();
+                if (!blkdat.SetPos(item.nRewind) && !blkdat.Seek(item.nRewind)) {
+                    LogPrintf("%s : can't go back to position %d, skipping the rest of the file\n", __func__, item.nRewind);
+                    break;
+                }
+                nRewind = item.nRewind;
+                fScanned = false;
+                continue;
             }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
+            if (dbp)
+                dbp->nPos = item.pos.nPos;
+            std::shared_ptr<const CBlock> block_ptr = std::move(item.block);
+            const CBlock& block = *block_ptr;
 
+            try {
                 // detect out of order blocks, and store them for later
                 uint256 hash = block.GetHash();
                 if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
@@ -3619,7 +4355,6 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
                 // process in case the block isn't known yet
                 if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
                     CValidationState state;
-                    std::shared_ptr<const CBlock> block_ptr = std::make_shared<const CBlock>(block);
                     if (ProcessNewBlock(state, nullptr, block_ptr, dbp))
                         nLoaded++;
                     if (state.IsError())
@@ -3637,14 +4372,14 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
                     std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
                     while (range.first != range.second) {
                         std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        if (ReadBlockFromDisk(block, it->second)) {
-                            LogPrintf("%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
+                        std::shared_ptr<CBlock> pchild = std::make_shared<CBlock>();
+                        if (ReadBlockFromDisk(*pchild, it->second)) {
+                            LogPrintf("%s: Processing out of order child %s of %s\n", __func__, pchild->GetHash().ToString(),
                                 head.ToString());
                             CValidationState dummy;
-                            std::shared_ptr<const CBlock> block_ptr = std::make_shared<const CBlock>(block);
-                            if (ProcessNewBlock(dummy, nullptr, block_ptr, &it->second)) {
+                            if (ProcessNewBlock(dummy, nullptr, pchild, &it->second)) {
                                 nLoaded++;
-                                queue.push_back(block.GetHash());
+                                queue.push_back(pchild->GetHash());
                             }
                         }
                         range.first++;
@@ -3699,6 +4434,7 @@ void static CheckBlockIndex()
     int nHeight = 0;
     CBlockIndex* pindexFirstInvalid = NULL;         // Oldest ancestor of pindex which is invalid.
     CBlockIndex* pindexFirstMissing = NULL;         // Oldest ancestor of pindex which does not have BLOCK_HAVE_DATA.
+    CBlockIndex* pindexFirstNeverProcessed = NULL;  // Oldest ancestor of pindex for which nTx == 0.
     CBlockIndex* pindexFirstNotTreeValid = NULL;    // Oldest ancestor of pindex which does not have BLOCK_VALID_TREE (regardless of being valid or not).
     CBlockIndex* pindexFirstNotChainValid = NULL;   // Oldest ancestor of pindex which does not have BLOCK_VALID_CHAIN (regardless of being valid or not).
     CBlockIndex* pindexFirstNotScriptsValid = NULL; // Oldest ancestor of pindex which does not have BLOCK_VALID_SCRIPTS (regardless of being valid or not).
@@ -3706,6 +4442,7 @@ void static CheckBlockIndex()
         nNodes++;
         if (pindexFirstInvalid == NULL && pindex->nStatus & BLOCK_FAILED_VALID) pindexFirstInvalid = pindex;
         if (pindexFirstMissing == NULL && !(pindex->nStatus & BLOCK_HAVE_DATA)) pindexFirstMissing = pindex;
+        if (pindexFirstNeverProcessed == NULL && pindex->nTx == 0) pindexFirstNeverProcessed = pindex;
         if (pindex->pprev != NULL && pindexFirstNotTreeValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TREE) pindexFirstNotTreeValid = pindex;
         if (pindex->pprev != NULL && pindexFirstNotChainValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_CHAIN) pindexFirstNotChainValid = pindex;
         if (pindex->pprev != NULL && pindexFirstNotScriptsValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_SCRIPTS) pindexFirstNotScriptsValid = pindex;
@@ -3716,12 +4453,20 @@ void static CheckBlockIndex()
             assert(pindex->GetBlockHash() == Params().GetConsensus().hashGenesisBlock); // Genesis block's hash must match.
             assert(pindex == chainActive.Genesis());                       // The current active chain's genesis block must be this block.
         }
-        // HAVE_DATA is equivalent to VALID_TRANSACTIONS and equivalent to nTx > 0 (we stored the number of transactions in the block)
-        assert(!(pindex->nStatus & BLOCK_HAVE_DATA) == (pindex->nTx == 0));
-        assert(((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_TRANSACTIONS) == (pindex->nTx > 0));
+        // HAVE_DATA is only equivalent to nTx > 0 (or VALID_TRANSACTIONS) if no pruning has occurred.
+        if (!fHavePruned) {
+            // If we've never pruned, then HAVE_DATA should be equivalent to nTx > 0
+            assert(!(pindex->nStatus & BLOCK_HAVE_DATA) == (pindex->nTx == 0));
+            assert(pindexFirstMissing == pindexFirstNeverProcessed);
+        } else {
+            // If we have pruned, then we can only say that HAVE_DATA implies nTx > 0
+            if (pindex->nStatus & BLOCK_HAVE_DATA) assert(pindex->nTx > 0);
+        }
+        if (pindex->nStatus & BLOCK_HAVE_UNDO) assert(pindex->nStatus & BLOCK_HAVE_DATA);
+        assert(((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_TRANSACTIONS) == (pindex->nTx > 0));            // This is pruning-independent.
         if (pindex->nChainTx == 0) assert(pindex->nSequenceId == 0); // nSequenceId can't be set for blocks that aren't linked
-        // All parents having data is equivalent to all parents being VALID_TRANSACTIONS, which is equivalent to nChainTx being set.
-        assert((pindexFirstMissing != NULL) == (pindex->nChainTx == 0));                                             // nChainTx == 0 is used to signal that all parent block's transaction data is available.
+        // All parents having had data (at some point) is equivalent to all parents being VALID_TRANSACTIONS, which is equivalent to nChainTx being set.
+        assert((pindexFirstNeverProcessed != NULL) == (pindex->nChainTx == 0));                                      // nChainTx != 0 is used to signal that all parent blocks have been processed (but may have been pruned).
         assert(pindex->nHeight == nHeight);                                                                          // nHeight must be consistent.
         assert(pindex->pprev == NULL || pindex->nChainWork >= pindex->pprev->nChainWork);                            // For every block except the genesis block, the chainwork must be larger than the parent's.
         assert(nHeight < 2 || (pindex->pskip && (pindex->pskip->nHeight < nHeight)));                                // The pskip pointer must point back for all but the first 2 blocks.
@@ -3733,9 +4478,18 @@ void static CheckBlockIndex()
             // Checks for not-invalid blocks.
             assert((pindex->nStatus & BLOCK_FAILED_MASK) == 0); // The failed mask cannot be set for blocks without invalid parents.
         }
-        if (!CBlockIndexWorkComparator()(pindex, chainActive.Tip()) && pindexFirstMissing == NULL) {
-            if (pindexFirstInvalid == NULL) { // If this block sorts at least as good as the current tip and is valid, it must be in setBlockIndexCandidates.
-                assert(setBlockIndexCandidates.count(pindex));
+        if (!CBlockIndexWorkComparator()(pindex, chainActive.Tip()) && pindexFirstNeverProcessed == NULL) {
+            if (pindexFirstInvalid == NULL) {
+                // If this block sorts at least as good as the current tip and
+                // is valid and we have all data for its parents, it must be in
+                // setBlockIndexCandidates.  chainActive.Tip() must also be there
+                // even if some data has been pruned.
+                if (pindexFirstMissing == NULL || pindex == chainActive.Tip()) {
+                    assert(setBlockIndexCandidates.count(pindex));
+                }
+                // If some parent is missing, then it could be that this block was in
+                // setBlockIndexCandidates but had to be removed because of the missing data.
+                // In this case it must be in mapBlocksUnlinked -- see test below.
             }
         } else { // If this block sorts worse than the current tip, it cannot be in setBlockIndexCandidates.
             assert(setBlockIndexCandidates.count(pindex) == 0);
@@ -3751,12 +4505,28 @@ void static CheckBlockIndex()
             }
             rangeUnlinked.first++;
         }
-        if (pindex->pprev && pindex->nStatus & BLOCK_HAVE_DATA && pindexFirstMissing != NULL) {
-            if (pindexFirstInvalid == NULL) { // If this block has block data available, some parent doesn't, and has no invalid parents, it must be in mapBlocksUnlinked.
-                assert(foundInUnlinked);
+        if (pindex->pprev && (pindex->nStatus & BLOCK_HAVE_DATA) && pindexFirstNeverProcessed != NULL && pindexFirstInvalid == NULL) {
+            // If this block has block data available, some parent was never received, and has no invalid parents, it must be in mapBlocksUnlinked.
+            assert(foundInUnlinked);
+        }
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA)) assert(!foundInUnlinked); // Can't be in mapBlocksUnlinked if we don't HAVE_DATA
+        if (pindexFirstMissing == NULL) assert(!foundInUnlinked); // We aren't missing data for any parent -- cannot be in mapBlocksUnlinked.
+        if (pindex->pprev && (pindex->nStatus & BLOCK_HAVE_DATA) && pindexFirstNeverProcessed == NULL && pindexFirstMissing != NULL) {
+            // We HAVE_DATA for this block, have received data for all parents at some point, but we're currently missing data for some parent.
+            assert(fHavePruned); // We must have pruned.
+            // This block may have entered mapBlocksUnlinked if:
+            //  - it has a descendant that at some point had more work than the
+            //    tip, and
+            //  - we tried switching to that descendant but were missing
+            //    data for some intermediate block between chainActive and the
+            //    tip.
+            // So if this block is itself better than chainActive.Tip() and it wasn't in
+            // setBlockIndexCandidates, then it must be in mapBlocksUnlinked.
+            if (!CBlockIndexWorkComparator()(pindex, chainActive.Tip()) && setBlockIndexCandidates.count(pindex) == 0) {
+                if (pindexFirstInvalid == NULL) {
+                    assert(foundInUnlinked);
+                }
             }
-        } else { // If this block does not have block data available, or all parents do, it cannot be in mapBlocksUnlinked.
-            assert(!foundInUnlinked);
         }
         // assert(pindex->GetBlockHash() == pindex->GetBlockHeader().GetHash()); // Perhaps too slow
         // End: actual consistency checks.
@@ -3776,6 +4546,7 @@ void static CheckBlockIndex()
             // If pindex was the first with a certain property, unset the corresponding variable.
             if (pindex == pindexFirstInvalid) pindexFirstInvalid = NULL;
             if (pindex == pindexFirstMissing) pindexFirstMissing = NULL;
+            if (pindex == pindexFirstNeverProcessed) pindexFirstNeverProcessed = NULL;
             if (pindex == pindexFirstNotTreeValid) pindexFirstNotTreeValid = NULL;
             if (pindex == pindexFirstNotChainValid) pindexFirstNotChainValid = NULL;
             if (pindex == pindexFirstNotScriptsValid) pindexFirstNotScriptsValid = NULL;
@@ -40,6 +40,8 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CCoinsViewDB;
+class CBlockUndo;
 class CBudgetManager;
 class CSporkDB;
 class CBloomFilter;
@@ -66,6 +68,9 @@ static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 72;
 /** Default for -txindex */
 static const bool DEFAULT_TXINDEX = true;
+/** Default for -addressindex */
+static const bool DEFAULT_ADDRESSINDEX = false;
+static const bool DEFAULT_COINSTATSINDEX = false;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 /** Default for -relaypriority */
 static const bool DEFAULT_RELAYPRIORITY = true;
@@ -87,6 +92,10 @@ static const int MAX_SCRIPTCHECK_THREADS = 16;
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Maximum depth of a block sent as a compact block: older transactions are unlikely to be in the mempool of the peer. */
+static const int MAX_CMPCTBLOCK_DEPTH = 5;
+/** Maximum depth of a block whose transactions are sent for a getblocktxn, the full block is sent otherwise. */
+static const int MAX_BLOCKTXN_DEPTH = 10;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
@@ -113,6 +122,9 @@ static const unsigned int DEFAULT_SHIELDEDTXFEE_K = 100;
 /** Enable bloom filter */
  static const bool DEFAULT_PEERBLOOMFILTERS = true;
 
+/** Block files containing a block-height within MIN_BLOCKS_TO_KEEP of chainActive.Tip() will not be pruned. */
+static const unsigned int MIN_BLOCKS_TO_KEEP = 288;
+
 /** If the tip is older than this (in seconds), the node is considered to be in initial block download. */
 static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
 
@@ -138,12 +150,20 @@ extern int64_t g_best_block_time;
 extern std::atomic<bool> fImporting;
 extern std::atomic<bool> fReindex;
 extern int nScriptCheckThreads;
-extern bool fTxIndex;
 extern bool fCheckBlockIndex;
 extern size_t nCoinCacheUsage;
 extern CFeeRate minRelayTxFee;
 extern int64_t nMaxTipAge;
 extern bool fVerifyingBlocks;
+/** Block hash whose ancestors we will assume to have valid scripts without checking them. */
+extern uint256 hashAssumeValid;
+
+/** True if any block files have ever been pruned. */
+extern bool fHavePruned;
+/** True if we're running in -prune mode. */
+extern bool fPruneMode;
+/** Number of MiB of block files that we're trying to stay below. */
+extern uint64_t nPruneTarget;
 
 extern bool fLargeWorkForkFound;
 extern bool fLargeWorkInvalidChainFound;
@@ -158,6 +178,18 @@ extern CBlockIndex* pindexBestHeader;
 /** Minimum disk space required - used in CheckDiskSpace() */
 static const uint64_t nMinDiskSpace = 52428800;
 
+/** Pruning-related variables and constants */
+/** Require that user allocate at least 945MB for block & undo files (blk???.dat and rev???.dat)
+ * At 2MB per block, 288 blocks = 576MB.
+ * Add 15% for Undo data = 662MB
+ * Add 20% for Orphan block rate = 795MB
+ * We want the low water mark after pruning to be at least 795 MB and since we prune in
+ * full block file chunks, we need the high water mark which triggers the prune to be
+ * one 128MB block file + added 15% undo data = 147MB greater for a total of 942MB
+ * Setting the target to > than 945MB will make it likely we can respect the target.
+ */
+static const uint64_t MIN_DISK_SPACE_FOR_BLOCK_FILES = 945 * 1024 * 1024;
+
 /**
  * Process an incoming block. This only returns after the best known valid
  * block is made active. Note that it does not, however, guarantee that the
@@ -194,6 +226,8 @@ void UnloadBlockIndex();
 int ActiveProtocol();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the shielded proofs checking thread */
+void ThreadSaplingCheck();
 
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
@@ -213,6 +247,27 @@ CAmount GetBlockValue(int nHeight);
 CBlockIndex* InsertBlockIndex(uint256 hash);
 /** Flush all state, indexes and buffers to disk. */
 void FlushStateToDisk();
+/** Prune block files and flush state to disk. */
+void PruneAndFlush();
+/** Calculate the amount of disk space the block & undo files currently use */
+uint64_t CalculateCurrentUsage();
+/**
+ * Select the block files to delete so that the block and undo files in vinfo use less than nTarget
+ * bytes, oldest first. The files that may have a block above nLastBlockWeCanPrune, and nLastFile,
+ * which is being written to, are kept.
+ * @return the disk space used once the selected files are deleted
+ */
+uint64_t SelectFilesToPrune(const std::vector<CBlockFileInfo>& vinfo, int nLastFile, uint64_t nTarget,
+                           unsigned int nLastBlockWeCanPrune, std::set<int>& setFilesToPrune);
+/**
+ * Height of the last block that may be pruned with the tip at nTipHeight, keeping the blocks a
+ * reorg could need, or -1 if the chain is too short to prune any.
+ */
+int GetLastBlockWeCanPrune(int nTipHeight);
+/** Mark one block file as pruned: clear the data and undo flags of its blocks in the index. */
+void PruneOneBlockFile(const int fileNumber);
+/** Actually unlink the specified files */
+void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune);
 
 
 /** (try to) add transaction to memory pool **/
@@ -249,8 +304,14 @@ CAmount GetShieldedTxMinFee(const CTransaction& tx);
  * Check whether all inputs of this transaction are valid (no double spends, scripts & sigs, amounts)
  * This does not modify the UTXO set. If pvChecks is not NULL, script checks are pushed onto it
  * instead of being performed inline.
+ * Transactions whose scripts all passed with the same flags are found in the script
+ * execution cache and skip script evaluation; cacheFullScriptStore records a full
+ * (inline) pass there, otherwise a cache hit consumes the entry.
  */
-bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, bool fScriptChecks, unsigned int flags, bool cacheStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck>* pvChecks = NULL);
+bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck>* pvChecks = NULL);
+
+/** Initializes the script-execution cache */
+void InitScriptExecutionCache();
 
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight, bool fSkipInvalid = false);
@@ -318,6 +379,11 @@ public:
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
+/** Read the serialized bytes of a block, as they are stored on disk and sent on
+ *  the network, without deserializing it. Does not check the block against its index. */
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos);
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
 
 
 /** Functions for validating blocks and updating the block tree */
@@ -326,10 +392,30 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
 bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckSig = true);
 bool CheckWork(const CBlock& block, const CBlockIndex* const pindexPrev);
 
+/**
+ * Whether the scripts of a block can be left unchecked: it is an ancestor of both the assumed
+ * valid block and the best header, which has the minimum chain work and two weeks of work on top.
+ */
+bool IsAssumedValid(const CBlockIndex* pindex, const CBlockIndex* pindexAssumeValid, const CBlockIndex* pindexBest, const Consensus::Params& consensus);
+
 /** Context-dependent validity checks */
 bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex* pindexPrev);
 bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindexPrev);
 
+/**
+ * Process block headers received without their blocks, and add them to the block index.
+ * Only the difficulty of the headers, and the proof of work of the ones before proof of
+ * stake, can be checked: the proof of stake is checked with the block.
+ * As proof-of-stake headers cost nothing to make, the ones more than BLOCK_DOWNLOAD_WINDOW
+ * blocks ahead of the active chain are not accepted yet, and the following ones are ignored.
+ *
+ * @param[in]   headers  The block headers, each one the parent of the next
+ * @param[out]  state    This may be set to an Invalid state if a header is invalid
+ * @param[out]  ppindex  If set, the pointer will be set to the index of the last accepted header
+ * @return False if a header is invalid
+ */
+bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, CBlockIndex** ppindex = nullptr);
+
 /** Check a block is completely valid from start to finish (only works on top of our current best block, with cs_main held) */
 bool TestBlockValidity(CValidationState& state, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckBlockSig = true);
 
@@ -365,6 +451,9 @@ extern CChain chainActive;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache* pcoinsTip;
 
+/** Global variable that points to the coins database (protected by cs_main) */
+extern CCoinsViewDB* pcoinsdbview;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB* pblocktree;
 
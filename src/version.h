@@ -12,7 +12,7 @@
  * network protocol versioning
  */
 
-static const int PROTOCOL_VERSION = 70922;
+static const int PROTOCOL_VERSION = 70924;
 
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
@@ -43,5 +43,11 @@ static const int MEMPOOL_GD_VERSION = 60002;
 //! "filter*" commands are disabled without NODE_BLOOM after and including this version
 static const int NO_BLOOM_VERSION = 70005;
 
+//! short-id-based block download starts with this version
+static const int SHORT_IDS_BLOCKS_VERSION = 70923;
+
+//! "getheaders" is answered with "headers", for headers-first sync, starting with this version
+static const int HEADERS_SYNC_VERSION = 70924;
+
 
 #endif // BITCOIN_VERSION_H
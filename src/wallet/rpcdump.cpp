@@ -75,6 +75,17 @@ std::string DecodeDumpString(const std::string& str)
     return ret.str();
 }
 
+/** Throw if a rescan starting at pindexStart would need blocks that have been pruned. */
+static void EnsureRescanNotPruned(const CBlockIndex* pindexStart)
+{
+    AssertLockHeld(cs_main);
+    if (!fHavePruned) return;
+    for (const CBlockIndex* pindex = pindexStart; pindex; pindex = chainActive.Next(pindex)) {
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+            throw JSONRPCError(RPC_WALLET_ERROR, "Can't rescan beyond pruned data. Use -reindex to download the whole blockchain again");
+    }
+}
+
 bool IsStakingDerPath(KeyOriginInfo keyOrigin)
 {
     return keyOrigin.path.size() > 3 && keyOrigin.path[3] == (2 | BIP32_HARDENED_KEY_LIMIT);
@@ -120,6 +131,7 @@ UniValue importprivkey(const JSONRPCRequest& request)
     {
         LOCK2(cs_main, pwalletMain->cs_wallet);
         EnsureWalletIsUnlocked();
+        if (fRescan) EnsureRescanNotPruned(chainActive.Genesis());
 
         pwalletMain->MarkDirty();
         pwalletMain->SetAddressBook(vchAddress, strLabel, (
@@ -212,6 +224,7 @@ UniValue importaddress(const JSONRPCRequest& request)
     const bool fP2SH = (request.params.size() > 3 ? request.params[3].get_bool() : false);
 
     LOCK2(cs_main, pwalletMain->cs_wallet);
+    if (fRescan) EnsureRescanNotPruned(chainActive.Genesis());
 
     bool isStakingAddress = false;
     CTxDestination dest = DecodeDestination(request.params[0].get_str(), isStakingAddress);
@@ -271,6 +284,7 @@ UniValue importpubkey(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Pubkey is not a valid public key");
 
     LOCK2(cs_main, pwalletMain->cs_wallet);
+    if (fRescan) EnsureRescanNotPruned(chainActive.Genesis());
 
     ImportAddress(pubKey.GetID(), strLabel, "receive");
     ImportScript(GetScriptForRawPubKey(pubKey), strLabel, false);
@@ -303,6 +317,9 @@ UniValue importwallet(const JSONRPCRequest& request)
             "\nImport using the json rpc call\n" +
             HelpExampleRpc("importwallet", "\"test\""));
 
+    if (fPruneMode)
+        throw JSONRPCError(RPC_WALLET_ERROR, "Importing wallets is disabled in pruned mode");
+
     LOCK2(cs_main, pwalletMain->cs_wallet);
 
     EnsureWalletIsUnlocked();
@@ -660,6 +677,7 @@ UniValue bip38decrypt(const JSONRPCRequest& request)
     LOCK2(cs_main, pwalletMain->cs_wallet);
 
     EnsureWalletIsUnlocked();
+    EnsureRescanNotPruned(chainActive.Genesis());
 
     /** Collect private key and passphrase **/
     std::string strKey = request.params[0].get_str();
@@ -766,6 +784,7 @@ UniValue importsaplingkey(const JSONRPCRequest& request)
     if (nRescanHeight < 0 || nRescanHeight > chainActive.Height()) {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
     }
+    if (fRescan) EnsureRescanNotPruned(chainActive[nRescanHeight]);
 
     std::string strSecret = request.params[0].get_str();
     auto spendingkey = KeyIO::DecodeSpendingKey(strSecret);
@@ -860,6 +879,7 @@ UniValue importsaplingviewingkey(const JSONRPCRequest& request)
     if (nRescanHeight < 0 || nRescanHeight > chainActive.Height()) {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
     }
+    if (fRescan) EnsureRescanNotPruned(chainActive[nRescanHeight]);
 
     std::string strVKey = request.params[0].get_str();
     libzcash::ViewingKey viewingkey = KeyIO::DecodeViewingKey(strVKey);
@@ -3773,6 +3773,44 @@ UniValue getwalletinfo(const JSONRPCRequest& request)
     return obj;
 }
 
+UniValue getrescaninfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getrescaninfo\n"
+            "Returns the progress of the wallet rescan, if one is running.\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"scanning\": true|false,          (boolean) whether the wallet is rescanning the chain\n"
+            "  \"start_height\": xxxxx,           (numeric) the height the rescan started from (only when scanning)\n"
+            "  \"height\": xxxxx,                 (numeric) the last block scanned (only when scanning)\n"
+            "  \"progress\": x.xxx,               (numeric) the estimated progress of the rescan, from 0 to 1 (only when scanning)\n"
+            "  \"duration\": xxxx,                (numeric) the elapsed seconds since the rescan started (only when scanning)\n"
+            "  \"blocks\": xxxxx,                 (numeric) the number of blocks scanned (only when scanning)\n"
+            "  \"blocks_per_second\": x.xxx       (numeric) the average scan throughput (only when scanning)\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getrescaninfo", "") + HelpExampleRpc("getrescaninfo", ""));
+
+    // No locks here: the import calls hold cs_wallet for the whole rescan
+    UniValue obj(UniValue::VOBJ);
+    const bool fScanning = pwalletMain->IsScanning();
+    obj.pushKV("scanning", fScanning);
+    if (fScanning) {
+        const int64_t nDurationMillis = pwalletMain->ScanningDuration();
+        const int64_t nBlocks = pwalletMain->ScanningBlocks();
+        obj.pushKV("start_height", pwalletMain->ScanningStartHeight());
+        obj.pushKV("height", pwalletMain->ScanningHeight());
+        obj.pushKV("progress", pwalletMain->ScanningProgress());
+        obj.pushKV("duration", nDurationMillis / 1000);
+        obj.pushKV("blocks", nBlocks);
+        obj.pushKV("blocks_per_second", nDurationMillis > 0 ? nBlocks * 1000.0 / nDurationMillis : 0.0);
+    }
+    return obj;
+}
+
 UniValue getstakingstatus(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -4225,6 +4263,7 @@ static const CRPCCommand commands[] =
     { "wallet",             "getstakesplitthreshold",   &getstakesplitthreshold,   false },
     { "wallet",             "getunconfirmedbalance",    &getunconfirmedbalance,    false },
     { "wallet",             "getwalletinfo",            &getwalletinfo,            false },
+    { "wallet",             "getrescaninfo",            &getrescaninfo,            true  },
     { "wallet",             "getstakingstatus",         &getstakingstatus,         false },
     { "wallet",             "importprivkey",            &importprivkey,            true  },
     { "wallet",             "importwallet",             &importwallet,             true  },
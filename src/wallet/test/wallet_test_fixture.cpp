@@ -25,6 +25,9 @@ WalletTestingSetup::WalletTestingSetup(): SaplingTestingSetup()
     clean(); // todo: research why we have an initialized bitdb here.
     bitdb.MakeMock();
     RegisterWalletRPCCommands(tableRPC);
+    for (int i = 0; i < nScriptCheckThreads - 1; i++) {
+        threadGroup.create_thread(&ThreadSaplingTrialDecryption);
+    }
 
     bool fFirstRun;
     std::unique_ptr<CWalletDBWrapper> dbw(new CWalletDBWrapper(&bitdb, "wallet_test.dat"));
@@ -7,6 +7,7 @@
 #include "wallet/test/wallet_test_fixture.h"
 
 #include "consensus/merkle.h"
+#include "script/standard.h"
 #include "txmempool.h"
 #include "validation.h"
 #include "wallet/wallet.h"
@@ -479,4 +480,132 @@ BOOST_AUTO_TEST_CASE(cached_balances_tests)
 
 }
 
+BOOST_AUTO_TEST_CASE(wallet_spends_counter)
+{
+    CWallet wallet;
+    LOCK2(cs_main, wallet.cs_wallet);
+    wallet.SetLastBlockProcessed(chainActive.Tip());
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript script = GetScriptForDestination(key.GetPubKey().GetID());
+    wallet.LoadKey(key, key.GetPubKey());
+
+    CWalletTx& wtxCredit = ReceiveBalanceWith({CTxOut(10 * COIN, script)}, wallet);
+    const COutPoint outpoint(wtxCredit.GetHash(), 0);
+    unsigned int nSpends = wallet.GetWalletSpends();
+    const auto CheckBumped = [&]() {
+        BOOST_CHECK(wallet.GetWalletSpends() != nSpends);
+        nSpends = wallet.GetWalletSpends();
+    };
+
+    // Spend added
+    CMutableTransaction mtx;
+    mtx.vin.emplace_back(outpoint);
+    mtx.vout.emplace_back(9 * COIN, script);
+    const CTransactionRef txSpend = MakeTransactionRef(mtx);
+    BOOST_CHECK(wallet.AddToWallet(CWalletTx(&wallet, txSpend)));
+    BOOST_CHECK(wallet.IsSpent(outpoint));
+    CheckBumped();
+
+    // Spend entering and leaving the mempool
+    wallet.TransactionAddedToMempool(txSpend);
+    CheckBumped();
+    wallet.TransactionRemovedFromMempool(txSpend);
+    CheckBumped();
+
+    // Spend abandoned
+    BOOST_CHECK(wallet.AbandonTransaction(txSpend->GetHash()));
+    BOOST_CHECK(!wallet.IsSpent(outpoint));
+    CheckBumped();
+
+    // Spend confirmed again
+    CWalletTx wtxConfirmed(&wallet, txSpend);
+    wtxConfirmed.m_confirm = CWalletTx::Confirmation(CWalletTx::Status::CONFIRMED, chainActive.Height(), chainActive.Tip()->GetBlockHash(), 1);
+    BOOST_CHECK(wallet.AddToWallet(wtxConfirmed));
+    BOOST_CHECK(wallet.IsSpent(outpoint));
+    CheckBumped();
+
+    // Spend conflicted by a double spend in a block
+    mtx.vout[0].nValue = 8 * COIN;
+    CWalletTx::Confirmation confirm(CWalletTx::Status::CONFIRMED, chainActive.Height(), chainActive.Tip()->GetBlockHash(), 2);
+    BOOST_CHECK(wallet.AddToWalletIfInvolvingMe(MakeTransactionRef(mtx), confirm, true));
+    BOOST_CHECK(wallet.mapWallet.at(txSpend->GetHash()).isConflicted());
+    CheckBumped();
+
+    // Spend removed
+    wallet.EraseFromWallet(txSpend->GetHash());
+    BOOST_CHECK(!wallet.mapWallet.count(txSpend->GetHash()));
+    CheckBumped();
+}
+
+static int RescanWallet(CWallet& wallet, const CKey& key, bool fPrefetch)
+{
+    gArgs.ForceSetArg("-rescanprefetch", fPrefetch ? "1" : "0");
+    wallet.LoadKey(key, key.GetPubKey());
+    CBlockIndex* pindexGenesis = WITH_LOCK(cs_main, return chainActive.Genesis());
+    int ret = wallet.ScanForWalletTransactions(pindexGenesis, true);
+    gArgs.ForceSetArg("-rescanprefetch", "1");
+    return ret;
+}
+
+BOOST_FIXTURE_TEST_CASE(rescan_prefetch, TestChain100Setup)
+{
+    // Spend some of the wallet coinbases to an external key, in the next blocks
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CKey keyExternal;
+    keyExternal.MakeNewKey(true);
+    CScript scriptExternal = GetScriptForDestination(keyExternal.GetPubKey().GetID());
+    const int nSpends = 30;
+    for (int i = 0; i < nSpends; i++) {
+        CMutableTransaction spend;
+        spend.nVersion = 1;
+        spend.vin.resize(1);
+        spend.vin[0].prevout = COutPoint(coinbaseTxns[i].GetHash(), 0);
+        spend.vout.resize(1);
+        spend.vout[0].nValue = 11 * CENT;
+        spend.vout[0].scriptPubKey = scriptExternal;
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        spend.vin[0].scriptSig << vchSig;
+        CreateAndProcessBlock({spend}, scriptExternal);
+    }
+    BOOST_CHECK_EQUAL(WITH_LOCK(cs_main, return chainActive.Height()), 100 + nSpends);
+
+    // More prefetcher threads than blocks read ahead by a single one
+    const int nScriptCheckThreadsOld = nScriptCheckThreads;
+    nScriptCheckThreads = 3;
+    CWallet walletPrefetch;
+    int retPrefetch = RescanWallet(walletPrefetch, coinbaseKey, true);
+    CWallet walletSerial;
+    int retSerial = RescanWallet(walletSerial, coinbaseKey, false);
+    nScriptCheckThreads = nScriptCheckThreadsOld;
+
+    // Both rescans find the coinbases and the spends, in the same blocks
+    BOOST_CHECK_EQUAL(retPrefetch, 100 + nSpends);
+    BOOST_CHECK_EQUAL(retSerial, retPrefetch);
+    {
+        LOCK2(walletPrefetch.cs_wallet, walletSerial.cs_wallet);
+        BOOST_CHECK_EQUAL(walletPrefetch.mapWallet.size(), walletSerial.mapWallet.size());
+        for (const auto& it : walletPrefetch.mapWallet) {
+            auto itSerial = walletSerial.mapWallet.find(it.first);
+            BOOST_CHECK(itSerial != walletSerial.mapWallet.end());
+            if (itSerial == walletSerial.mapWallet.end()) continue;
+            BOOST_CHECK(it.second.m_confirm.hashBlock == itSerial->second.m_confirm.hashBlock);
+            BOOST_CHECK_EQUAL(it.second.m_confirm.block_height, itSerial->second.m_confirm.block_height);
+            BOOST_CHECK_EQUAL(it.second.m_confirm.nIndex, itSerial->second.m_confirm.nIndex);
+        }
+    }
+
+    // Once the blocks are pruned, the rescans stop there and report it
+    const int nFile = WITH_LOCK(cs_main, return chainActive.Genesis()->nFile);
+    WITH_LOCK(cs_main, PruneOneBlockFile(nFile); );
+    UnlinkPrunedFiles({nFile});
+    CWallet walletPruned;
+    BOOST_CHECK_EQUAL(RescanWallet(walletPruned, coinbaseKey, true), -1);
+    BOOST_CHECK_EQUAL(RescanWallet(walletPruned, coinbaseKey, false), -1);
+    BOOST_CHECK(WITH_LOCK(walletPruned.cs_wallet, return walletPruned.mapWallet.empty()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
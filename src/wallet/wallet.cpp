@@ -21,8 +21,12 @@
 #include "spork.h"
 #include "util.h"
 #include "utilmoneystr.h"
+#include "util/threadnames.h"
 
+#include <condition_variable>
+#include <deque>
 #include <future>
+#include <thread>
 #include <boost/algorithm/string/replace.hpp>
 
 CWallet* pwalletMain = nullptr;
@@ -198,6 +202,7 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey& pubkey)
     AssertLockHeld(cs_wallet); // mapKeyMetadata
     if (!CCryptoKeyStore::AddKeyPubKey(secret, pubkey))
         return false;
+    nKeystoreUpdates++;
 
     // TODO: Move the follow block entirely inside the spkm (including WriteKey to AddKeyPubKeyWithDB)
     // check if we need to remove from watch-only
@@ -225,6 +230,7 @@ bool CWallet::AddCryptedKey(const CPubKey& vchPubKey,
 {
     if (!CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret))
         return false;
+    nKeystoreUpdates++;
     {
         LOCK(cs_wallet);
         if (pwalletdbEncryption)
@@ -256,6 +262,7 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    nKeystoreUpdates++;
     return CWalletDB(*dbw).WriteCScript(Hash160(redeemScript), redeemScript);
 }
 
@@ -278,6 +285,7 @@ bool CWallet::AddWatchOnly(const CScript& dest)
 {
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
+    nKeystoreUpdates++;
     nTimeFirstKey = 1; // No birthday information for watch-only keys.
     NotifyWatchonlyChanged(true);
     return CWalletDB(*dbw).WriteWatchOnly(dest);
@@ -467,30 +475,28 @@ void CWallet::SetBestChainInternal(CWalletDB& walletdb, const CBlockLocator& loc
         return;
     }
 
-    // For performance reasons, we update the witnesses data here and not when each transaction arrives
-    for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
-        auto wtx = wtxItem.second;
-        // We skip transactions for which mapSaplingNoteData is empty.
-        // This covers transactions that have no Sapling data
-        // (i.e. are purely transparent), as well as shielding and unshielding
-        // transactions in which we only have transparent addresses involved.
-        if (!wtx.mapSaplingNoteData.empty()) {
-            // Sanity check
-            if (!wtx.tx->isSaplingVersion()) {
-                LogPrintf("SetBestChain(): ERROR, Invalid tx version found with sapling data\n");
-                walletdb.TxnAbort();
-                uiInterface.ThreadSafeMessageBox(
-                        _("A fatal internal error occurred, see debug.log for details"),
-                        "Error", CClientUIInterface::MSG_ERROR);
-                StartShutdown();
-                return;
-            }
+    // For performance reasons, we update the witnesses data here and not when each transaction arrives.
+    // Only transactions holding our notes have witnesses and nullifiers updated by the chain.
+    // This skips transactions that have no Sapling data (i.e. are purely transparent),
+    // as well as shielding and unshielding transactions in which we only have transparent
+    // addresses involved.
+    for (const uint256& txid : m_sspk_man->GetSaplingNoteTxs()) {
+        const CWalletTx& wtx = mapWallet.at(txid);
+        // Sanity check
+        if (!wtx.tx->isSaplingVersion()) {
+            LogPrintf("SetBestChain(): ERROR, Invalid tx version found with sapling data\n");
+            walletdb.TxnAbort();
+            uiInterface.ThreadSafeMessageBox(
+                    _("A fatal internal error occurred, see debug.log for details"),
+                    "Error", CClientUIInterface::MSG_ERROR);
+            StartShutdown();
+            return;
+        }
 
-            if (!walletdb.WriteTx(wtx)) {
-                LogPrintf("SetBestChain(): Failed to write CWalletTx, aborting atomic write\n");
-                walletdb.TxnAbort();
-                return;
-            }
+        if (!walletdb.WriteTx(wtx)) {
+            LogPrintf("SetBestChain(): Failed to write CWalletTx, aborting atomic write\n");
+            walletdb.TxnAbort();
+            return;
         }
     }
 
@@ -630,6 +636,9 @@ void CWallet::SyncMetaData(std::pair<typename TxSpendMap<T>::iterator, typename
 
 bool CWallet::ParameterInteraction()
 {
+    if (gArgs.GetBoolArg("-rescan", false) && gArgs.GetArg("-prune", 0) > 0) {
+        return UIError(_("Rescans are not possible in pruned mode. You will need to use -reindex which will download the whole blockchain again."));
+    }
     if (gArgs.IsArgSet("-mintxfee")) {
         CAmount n = 0;
         if (ParseMoney(gArgs.GetArg("-mintxfee", ""), n) && n > 0)
@@ -729,6 +738,7 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.emplace(outpoint, wtxid);
+    nWalletSpends++;
     setLockedCoins.erase(outpoint);
 
     std::pair<TxSpends::iterator, TxSpends::iterator> range;
@@ -923,6 +933,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         wtxOrdered.emplace(wtx.nOrderPos, &wtx);
         wtx.UpdateTimeSmart();
         AddToSpends(hash);
+        AddToStakeCandidates(wtx);
     }
 
     bool fUpdated = false;
@@ -933,6 +944,8 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
             wtx.m_confirm.hashBlock = wtxIn.m_confirm.hashBlock;
             wtx.m_confirm.block_height = wtxIn.m_confirm.block_height;
             wtx.UpdateTimeSmart();
+            // e.g. an abandoned or conflicted spender confirmed: its inputs are spent again
+            nWalletSpends++;
             fUpdated = true;
         } else {
             assert(wtx.m_confirm.nIndex == wtxIn.m_confirm.nIndex);
@@ -947,6 +960,9 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
             fUpdated = true;
         }
     }
+    if (fInsertedNew || fUpdated) {
+        m_sspk_man->UpdateSaplingNoteTxsIndex(wtx);
+    }
 
     //// debug print
     LogPrintf("AddToWallet %s  %s%s\n", wtxIn.GetHash().ToString(), (fInsertedNew ? "new" : ""), (fUpdated ? "update" : ""));
@@ -1014,6 +1030,7 @@ bool CWallet::LoadToWallet(CWalletTx& wtxIn)
     wtx.BindWallet(this);
     // Sapling
     m_sspk_man->UpdateNullifierNoteMapWithTx(wtx);
+    m_sspk_man->UpdateSaplingNoteTxsIndex(wtx);
     wtxOrdered.emplace(wtx.nOrderPos, &wtx);
     AddToSpends(hash);
     for (const CTxIn& txin : wtx.tx->vin) {
@@ -1028,9 +1045,10 @@ bool CWallet::LoadToWallet(CWalletTx& wtxIn)
     return true;
 }
 
-bool CWallet::FindNotesDataAndAddMissingIVKToKeystore(const CTransaction& tx, Optional<mapSaplingNoteData_t>& saplingNoteData)
+bool CWallet::FindNotesDataAndAddMissingIVKToKeystore(const CTransaction& tx, Optional<mapSaplingNoteData_t>& saplingNoteData,
+                                                      const std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap>* pSaplingNotes)
 {
-    auto saplingNoteDataAndAddressesToAdd = m_sspk_man->FindMySaplingNotes(tx);
+    auto saplingNoteDataAndAddressesToAdd = pSaplingNotes ? *pSaplingNotes : m_sspk_man->FindMySaplingNotes(tx);
     saplingNoteData = saplingNoteDataAndAddressesToAdd.first;
     auto addressesToAdd = saplingNoteDataAndAddressesToAdd.second;
     // Add my addresses
@@ -1079,7 +1097,7 @@ void CWallet::AddExternalNotesDataToTx(CWalletTx& wtx) const
  * Abandoned state should probably be more carefully tracked via different
  * posInBlock signals or by checking mempool presence when necessary.
  */
-bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const CWalletTx::Confirmation& confirm, bool fUpdate)
+bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const CWalletTx::Confirmation& confirm, bool fUpdate, const TxScanResult* pScan)
 {
     const CTransaction& tx = *ptx;
     {
@@ -1104,13 +1122,14 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const CWallet
         // Check tx for Sapling notes
         Optional<mapSaplingNoteData_t> saplingNoteData {nullopt};
         if (HasSaplingSPKM()) {
-            if (!FindNotesDataAndAddMissingIVKToKeystore(tx, saplingNoteData)) {
+            if (!FindNotesDataAndAddMissingIVKToKeystore(tx, saplingNoteData, pScan && pScan->saplingNotes ? pScan->saplingNotes.get_ptr() : nullptr)) {
                 return false; // error adding incoming viewing key.
             }
         }
 
         bool isFromMe = IsFromMe(ptx);
-        if (fExisted || IsMine(ptx) || isFromMe || (saplingNoteData && !saplingNoteData->empty())) {
+        bool isMine = (pScan && pScan->fIsMine) ? *pScan->fIsMine : IsMine(ptx);
+        if (fExisted || isMine || isFromMe || (saplingNoteData && !saplingNoteData->empty())) {
 
             /* Check if any keys in the wallet keypool that were supposed to be unused
              * have appeared in a new transaction. If so, remove those keys from the keypool.
@@ -1196,6 +1215,8 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
                     _it->second.MarkDirty();
                 }
             }
+            AddInputsToStakeCandidates(wtx);
+            nWalletSpends++;
         }
     }
 
@@ -1255,13 +1276,15 @@ void CWallet::MarkConflicted(const uint256& hashBlock, int conflicting_height, c
                     _it->second.MarkDirty();
                 }
             }
+            AddInputsToStakeCandidates(wtx);
+            nWalletSpends++;
         }
     }
 }
 
-void CWallet::SyncTransaction(const CTransactionRef& ptx, const CWalletTx::Confirmation& confirm)
+void CWallet::SyncTransaction(const CTransactionRef& ptx, const CWalletTx::Confirmation& confirm, const TxScanResult* pScan)
 {
-    if (!AddToWalletIfInvolvingMe(ptx, confirm, true)) {
+    if (!AddToWalletIfInvolvingMe(ptx, confirm, true, pScan)) {
         return; // Not one of ours
     }
 
@@ -1277,6 +1300,7 @@ void CWallet::TransactionAddedToMempool(const CTransactionRef& ptx)
     auto it = mapWallet.find(ptx->GetHash());
     if (it != mapWallet.end()) {
         it->second.fInMempool = true;
+        nWalletSpends++;
     }
 }
 
@@ -1285,6 +1309,7 @@ void CWallet::TransactionRemovedFromMempool(const CTransactionRef &ptx) {
     auto it = mapWallet.find(ptx->GetHash());
     if (it != mapWallet.end()) {
         it->second.fInMempool = false;
+        nWalletSpends++;
     }
 }
 
@@ -1296,10 +1321,12 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
         m_last_block_processed = pindex->GetBlockHash();
         m_last_block_processed_time = pindex->GetBlockTime();
         m_last_block_processed_height = pindex->nHeight;
+        // Trial-decrypt the shielded outputs of the whole block at once
+        const std::vector<TxScanResult>& vScan = ScanBlockTxs(pblock->vtx, false);
         for (size_t index = 0; index < pblock->vtx.size(); index++) {
             CWalletTx::Confirmation confirm(CWalletTx::Status::CONFIRMED, m_last_block_processed_height,
                                             m_last_block_processed, index);
-            SyncTransaction(pblock->vtx[index], confirm);
+            SyncTransaction(pblock->vtx[index], confirm, &vScan[index]);
             TransactionRemovedFromMempool(pblock->vtx[index]);
         }
         for (const CTransactionRef& ptx : vtxConflicted) {
@@ -1411,6 +1438,12 @@ void CWallet::EraseFromWallet(const uint256& hash)
 {
     {
         LOCK(cs_wallet);
+        m_sspk_man->EraseFromSaplingNoteTxsIndex(hash);
+        auto it = mapWallet.find(hash);
+        if (it != mapWallet.end()) {
+            AddInputsToStakeCandidates(it->second);
+            nWalletSpends++;
+        }
         if (mapWallet.erase(hash))
             CWalletDB(*dbw).EraseTx(hash);
         LogPrintf("%s: Erased wtx %s from wallet\n", __func__, hash.GetHex());
@@ -1800,6 +1833,151 @@ bool CWallet::Upgrade(std::string& error, const int& prevVersion)
     return true;
 }
 
+std::vector<CWallet::TxScanResult> CWallet::ScanBlockTxs(const std::vector<CTransactionRef>& vtx, bool fCheckIsMine) const
+{
+    std::vector<TxScanResult> vScan(vtx.size());
+    if (fCheckIsMine) {
+        for (size_t i = 0; i < vtx.size(); i++) {
+            vScan[i].fIsMine = IsMine(vtx[i]);
+        }
+    }
+    if (HasSaplingSPKM()) {
+        auto vSaplingNotes = m_sspk_man->FindMySaplingNotes(vtx);
+        for (size_t i = 0; i < vtx.size(); i++) {
+            vScan[i].saplingNotes = std::move(vSaplingNotes[i]);
+        }
+    }
+    return vScan;
+}
+
+//! Number of blocks read ahead by each thread of the rescan prefetcher
+static const int RESCAN_PREFETCH_BLOCKS_PER_THREAD = 4;
+
+/**
+ * Read-ahead stage of the wallet rescan. Worker threads read the upcoming
+ * blocks from disk and run on them the wallet checks that don't need
+ * cs_wallet (CWallet::ScanBlockTxs), while the rescan applies the blocks
+ * already prefetched to the wallet, in chain order.
+ */
+class CWalletRescanPrefetcher
+{
+public:
+    struct Entry {
+        const CBlockIndex* pindex;
+        //! Taken under cs_main, the workers read the block without it
+        CDiskBlockPos pos;
+        uint256 hash;
+        CBlock block;
+        bool fRead{false};
+        //! Whether vScan holds the checks of the block
+        bool fScanned{false};
+        //! CWallet::nKeystoreUpdates when the checks were run
+        unsigned int nKeystoreUpdates{0};
+        std::vector<CWallet::TxScanResult> vScan;
+        bool fDone{false};
+
+        explicit Entry(const CBlockIndex* pindexIn) : pindex(pindexIn), pos(pindexIn->GetBlockPos()), hash(pindexIn->GetBlockHash()) {}
+    };
+
+private:
+    const CWallet* pwallet;
+    const std::atomic<unsigned int>& nKeystoreUpdates;
+    Mutex cs;
+    std::condition_variable cond;
+    //! Blocks handed to the prefetcher, in chain order
+    std::deque<std::shared_ptr<Entry>> vEntries;
+    //! Blocks not yet picked up by a worker
+    std::deque<std::shared_ptr<Entry>> vTodo;
+    bool fStop{false};
+    std::vector<std::thread> vThreads;
+
+    void Thread()
+    {
+        util::ThreadRename("islamic_digital_coin-rescan");
+        while (true) {
+            std::shared_ptr<Entry> entry;
+            {
+                WAIT_LOCK(cs, lock);
+                cond.wait(lock, [this]{ return fStop || !vTodo.empty(); });
+                if (fStop) return;
+                entry = vTodo.front();
+                vTodo.pop_front();
+            }
+
+            // The block file can be pruned meanwhile: a failed read is
+            // retried by the rescan, under cs_main.
+            entry->fRead = !entry->pos.IsNull() && ReadBlockFromDisk(entry->block, entry->pos) &&
+                           entry->block.GetHash() == entry->hash;
+            if (entry->fRead) {
+                entry->nKeystoreUpdates = nKeystoreUpdates;
+                entry->vScan = pwallet->ScanBlockTxs(entry->block.vtx, true);
+                entry->fScanned = true;
+            }
+
+            {
+                LOCK(cs);
+                entry->fDone = true;
+            }
+            cond.notify_all();
+        }
+    }
+
+public:
+    CWalletRescanPrefetcher(const CWallet* pwalletIn, const std::atomic<unsigned int>& nKeystoreUpdatesIn, int nThreads) :
+        pwallet(pwalletIn), nKeystoreUpdates(nKeystoreUpdatesIn)
+    {
+        for (int i = 0; i < nThreads; i++) {
+            vThreads.emplace_back(&CWalletRescanPrefetcher::Thread, this);
+        }
+    }
+
+    ~CWalletRescanPrefetcher()
+    {
+        {
+            LOCK(cs);
+            fStop = true;
+        }
+        cond.notify_all();
+        for (std::thread& t : vThreads) {
+            t.join();
+        }
+    }
+
+    size_t Size()
+    {
+        LOCK(cs);
+        return vEntries.size();
+    }
+
+    const CBlockIndex* Front()
+    {
+        LOCK(cs);
+        return vEntries.empty() ? nullptr : vEntries.front()->pindex;
+    }
+
+    void Push(const CBlockIndex* pindex)
+    {
+        {
+            LOCK(cs);
+            auto entry = std::make_shared<Entry>(pindex);
+            vEntries.push_back(entry);
+            vTodo.push_back(entry);
+        }
+        cond.notify_one();
+    }
+
+    //! Wait for the first block to be prefetched, and remove it from the queue
+    std::shared_ptr<Entry> Pop()
+    {
+        WAIT_LOCK(cs, lock);
+        assert(!vEntries.empty());
+        cond.wait(lock, [this]{ return vEntries.front()->fDone; });
+        std::shared_ptr<Entry> entry = vEntries.front();
+        vEntries.pop_front();
+        return entry;
+    }
+};
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
@@ -1829,6 +2007,27 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate, b
         double dProgressTip = 0.0;
         std::vector<uint256> myTxHashes;
 
+        // Exposed by getrescaninfo
+        fScanningWallet = true;
+        nScanStartTime = GetTimeMillis();
+        nScanStartHeight = pindex ? pindex->nHeight : 0;
+        nScanHeight = nScanStartHeight.load();
+        nScannedBlocks = 0;
+        dScanProgress = 0;
+        struct ScanningReset {
+            std::atomic<bool>& fScanning;
+            ~ScanningReset() { fScanning = false; }
+        } scanningReset{fScanningWallet};
+
+        // Blocks are read and filtered ahead by the prefetcher threads
+        const bool fPrefetch = gArgs.GetBoolArg("-rescanprefetch", DEFAULT_RESCAN_PREFETCH);
+        const int nPrefetchThreads = std::max(1, nScriptCheckThreads);
+        const size_t nPrefetchBlocks = nPrefetchThreads * RESCAN_PREFETCH_BLOCKS_PER_THREAD;
+        std::unique_ptr<CWalletRescanPrefetcher> prefetcher;
+        const CBlockIndex* pindexPrefetched = nullptr;
+        // Set if a block could not be read, the wallet then misses the transactions after it
+        bool fStopped = false;
+
         double gvp = dProgressStart;
         while (pindex) {
             gvp = Checkpoints::GuessVerificationProgress(pindex, false);
@@ -1845,10 +2044,42 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate, b
                 return -1;
             }
 
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex)) {
-                LogPrintf("Unable to read block %d (%s) from disk.", pindex->nHeight, pindex->GetBlockHash().ToString());
-                return -1;
+            std::shared_ptr<CWalletRescanPrefetcher::Entry> entry;
+            if (fPrefetch) {
+                {
+                    LOCK(cs_main);
+                    // (Re)start the prefetcher if the chain changed under it
+                    if (!prefetcher || prefetcher->Front() != pindex) {
+                        prefetcher.reset();
+                        prefetcher.reset(new CWalletRescanPrefetcher(this, nKeystoreUpdates, nPrefetchThreads));
+                        pindexPrefetched = nullptr;
+                    }
+                    while (prefetcher->Size() < nPrefetchBlocks) {
+                        const CBlockIndex* pnext = pindexPrefetched ? chainActive.Next(pindexPrefetched) : pindex;
+                        if (!pnext) break;
+                        prefetcher->Push(pnext);
+                        pindexPrefetched = pnext;
+                    }
+                }
+                entry = prefetcher->Pop();
+            } else {
+                entry = WITH_LOCK(cs_main, return std::make_shared<CWalletRescanPrefetcher::Entry>(pindex));
+            }
+            const CBlock& block = entry->block;
+            if (!entry->fRead) {
+                // Read the block here, pruning can't delete it while cs_main is held
+                LOCK(cs_main);
+                if (!(pindex->nStatus & BLOCK_HAVE_DATA)) {
+                    LogPrintf("Rescan stopped at block %d (%s): block data pruned.\n", pindex->nHeight, pindex->GetBlockHash().ToString());
+                    fStopped = true;
+                    break;
+                }
+                if (!ReadBlockFromDisk(entry->block, pindex)) {
+                    LogPrintf("Unable to read block %d (%s) from disk.\n", pindex->nHeight, pindex->GetBlockHash().ToString());
+                    fStopped = true;
+                    break;
+                }
+                entry->fRead = true;
             }
 
             {
@@ -1864,10 +2095,13 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate, b
                     // marking transactions as coming from the wrong block.
                     break;
                 }
+                // Keys added since the block was filtered (e.g. keypool top up) could
+                // make more outputs ours: let AddToWalletIfInvolvingMe check again.
+                const bool fScanOutdated = !entry->fScanned || entry->nKeystoreUpdates != nKeystoreUpdates;
                 for (int posInBlock = 0; posInBlock < (int) block.vtx.size(); posInBlock++) {
                     const auto& tx = block.vtx[posInBlock];
                     CWalletTx::Confirmation confirm(CWalletTx::Status::CONFIRMED, pindex->nHeight, pindex->GetBlockHash(), posInBlock);
-                    if (AddToWalletIfInvolvingMe(tx, confirm, fUpdate)) {
+                    if (AddToWalletIfInvolvingMe(tx, confirm, fUpdate, fScanOutdated ? nullptr : &entry->vScan[posInBlock])) {
                         myTxHashes.push_back(tx->GetHash());
                         ret++;
                     }
@@ -1885,9 +2119,16 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate, b
                     }
                 }
 
+                nScanHeight = pindex->nHeight;
+                nScannedBlocks++;
+                if (dProgressTip - dProgressStart > 0.0) {
+                    dScanProgress = std::max(0.0, std::min(1.0, (gvp - dProgressStart) / (dProgressTip - dProgressStart)));
+                }
+
                 pindex = chainActive.Next(pindex);
             }
         }
+        prefetcher.reset();
 
         // Sapling
         // After rescanning, persist Sapling note data that might have changed, e.g. nullifiers.
@@ -1903,6 +2144,9 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate, b
         }
 
         ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+        if (fStopped) {
+            return -1;
+        }
     }
     return ret;
 }
@@ -2611,6 +2855,31 @@ static void ApproximateBestSubset(std::vector<std::pair<CAmount, std::pair<const
     }
 }
 
+void CWallet::AddToStakeCandidates(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    if (fStakeCandidatesDirty) return;
+    const uint256& wtxid = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        if (IsMine(wtx.tx->vout[i]) != ISMINE_NO) {
+            setStakeCandidates.emplace(wtxid, i);
+        }
+    }
+}
+
+void CWallet::AddInputsToStakeCandidates(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    if (fStakeCandidatesDirty) return;
+    for (const CTxIn& txin : wtx.tx->vin) {
+        auto it = mapWallet.find(txin.prevout.hash);
+        if (it != mapWallet.end() && txin.prevout.n < it->second.tx->vout.size() &&
+                IsMine(it->second.tx->vout[txin.prevout.n]) != ISMINE_NO) {
+            setStakeCandidates.emplace(txin.prevout);
+        }
+    }
+}
+
 bool CWallet::StakeableCoins(std::vector<CStakeableOutput>* pCoins)
 {
     const bool fIncludeColdStaking = !sporkManager.IsSporkActive(SPORK_19_COLDSTAKING_MAINTENANCE) &&
@@ -2619,39 +2888,69 @@ bool CWallet::StakeableCoins(std::vector<CStakeableOutput>* pCoins)
     if (pCoins) pCoins->clear();
 
     LOCK2(cs_main, cs_wallet);
-    for (const auto& it : mapWallet) {
-        const uint256& wtxid = it.first;
-        const CWalletTx* pcoin = &(it).second;
-
-        // Check if the tx is selectable
-        int nDepth;
-        if (!CheckTXAvailability(pcoin, true, nDepth))
-            continue;
-
-        // Check min depth requirement for stake inputs
-        if (nDepth < Params().GetConsensus().nStakeMinDepth) continue;
-
-        const CBlockIndex* pindex = nullptr;
-        for (unsigned int index = 0; index < pcoin->tx->vout.size(); index++) {
 
-            auto res = CheckOutputAvailability(
-                    pcoin->tx->vout[index],
-                    index,
-                    wtxid,
-                    STAKEABLE_COINS,
-                    nullptr, // coin control
-                    false,   // fIncludeDelegated
-                    fIncludeColdStaking,
-                    false,
-                    false);   // fIncludeLocked
+    // (Re)build the stake candidates, if needed
+    if (fStakeCandidatesDirty || nStakeCandidatesKeystore != nKeystoreUpdates) {
+        setStakeCandidates.clear();
+        fStakeCandidatesDirty = false;
+        nStakeCandidatesKeystore = nKeystoreUpdates;
+        for (const auto& it : mapWallet) {
+            AddToStakeCandidates(it.second);
+        }
+    }
 
-            if (!res.available) continue;
+    const unsigned int nSpends = nWalletSpends;
+    const CWalletTx* pcoin = nullptr;
+    bool fAvailable = false;
+    int nDepth = 0;
+    const CBlockIndex* pindex = nullptr;
+    for (auto it = setStakeCandidates.begin(); it != setStakeCandidates.end();) {
+        const uint256& wtxid = it->hash;
+
+        // The candidates are sorted by tx: check each tx once
+        if (!pcoin || pcoin->GetHash() != wtxid) {
+            auto mi = mapWallet.find(wtxid);
+            if (mi == mapWallet.end()) {
+                it = setStakeCandidates.erase(it);
+                continue;
+            }
+            pcoin = &mi->second;
+            pindex = nullptr;
+            // Check if the tx is selectable, and the min depth requirement for stake inputs
+            fAvailable = CheckTXAvailability(pcoin, true, nDepth) &&
+                         nDepth >= Params().GetConsensus().nStakeMinDepth;
+        }
+        if (!fAvailable) {
+            it++;
+            continue;
+        }
 
-            // found valid coin
-            if (!pCoins) return true;
-            if (!pindex) pindex = mapBlockIndex.at(pcoin->m_confirm.hashBlock);
-            pCoins->emplace_back(CStakeableOutput(pcoin, (int) index, nDepth, res.spendable, res.solvable, pindex));
+        // Spent outputs can't be staked anymore
+        if (IsSpent(*it)) {
+            it = setStakeCandidates.erase(it);
+            continue;
         }
+
+        const unsigned int index = it->n;
+        it++;
+        auto res = CheckOutputAvailability(
+                pcoin->tx->vout[index],
+                index,
+                wtxid,
+                STAKEABLE_COINS,
+                nullptr, // coin control
+                false,   // fIncludeDelegated
+                fIncludeColdStaking,
+                false,
+                false);   // fIncludeLocked
+
+        if (!res.available) continue;
+
+        // found valid coin
+        if (!pCoins) return true;
+        if (!pindex) pindex = mapBlockIndex.at(pcoin->m_confirm.hashBlock);
+        pCoins->emplace_back(CStakeableOutput(pcoin, (int) index, nDepth, res.spendable, res.solvable, pindex));
+        pCoins->back().nWalletSpends = nSpends;
     }
     return (pCoins && !pCoins->empty());
 }
@@ -3134,42 +3433,58 @@ bool CWallet::CreateCoinStake(
     CScript scriptPubKeyKernel;
     bool fKernelFound = false;
     int nAttempts = 0;
-    for (auto it = availableCoins->begin(); it != availableCoins->end();) {
-        COutPoint outPoint = COutPoint(it->tx->GetHash(), it->i);
-        CIdcStake stakeInput(it->tx->tx->vout[it->i],
-                             outPoint,
-                             it->pindex);
-
-        // New block came in, move on
-        if (WITH_LOCK(cs_wallet, return m_last_block_processed_height) != pindexPrev->nHeight) return false;
-
-        // Make sure the wallet is unlocked and shutdown hasn't been requested
-        if (IsLocked() || ShutdownRequested()) return false;
-
-        // Make sure the stake input hasn't been spent since last check
-        if (WITH_LOCK(cs_wallet, return IsSpent(outPoint))) {
-            // remove it from the available coins
-            it = availableCoins->erase(it);
-            continue;
+    const CStakeKernelSearch kernelSearch(pindexPrev, nBits);
+    std::vector<CIdcStake> vStakeInputs;
+    int nKernel = -1;
+    for (auto it = availableCoins->begin(); it != availableCoins->end() || nKernel >= 0;) {
+        if (nKernel < 0) {
+            // New block came in, move on
+            if (WITH_LOCK(cs_wallet, return m_last_block_processed_height) != pindexPrev->nHeight) return false;
+
+            // Make sure the wallet is unlocked and shutdown hasn't been requested
+            if (IsLocked() || ShutdownRequested()) return false;
+
+            // Take the next batch of stake inputs
+            vStakeInputs.clear();
+            while (it != availableCoins->end() && vStakeInputs.size() < STAKE_KERNEL_SEARCH_BATCH) {
+                COutPoint outPoint = COutPoint(it->tx->GetHash(), it->i);
+                // Make sure the stake input hasn't been spent since last check
+                // (only if the wallet recorded any new spend in the meantime)
+                const unsigned int nSpends = nWalletSpends;
+                if (it->nWalletSpends != nSpends) {
+                    if (WITH_LOCK(cs_wallet, return IsSpent(outPoint))) {
+                        // remove it from the available coins
+                        it = availableCoins->erase(it);
+                        continue;
+                    }
+                    it->nWalletSpends = nSpends;
+                }
+                vStakeInputs.emplace_back(it->tx->tx->vout[it->i], outPoint, it->pindex);
+                it++;
+            }
         }
 
-
-        nCredit = 0;
-
-        nAttempts++;
-        fKernelFound = Stake(pindexPrev, &stakeInput, nBits, nTxNewTime);
+        // Hash the kernels of the batch (past the last one found)
+        std::vector<CStakeInput*> vInputs;
+        for (size_t i = nKernel + 1; i < vStakeInputs.size(); i++) {
+            vInputs.emplace_back(&vStakeInputs[i]);
+        }
+        const int nFound = kernelSearch.FindKernel(vInputs, nTxNewTime);
+        nAttempts += (nFound < 0 ? (int) vInputs.size() : nFound + 1);
+        nKernel = (nFound < 0 ? -1 : nKernel + 1 + nFound);
+        fKernelFound = nKernel >= 0;
 
         // update staker status (time, attempts)
         pStakerStatus->SetLastTime(nTxNewTime);
         pStakerStatus->SetLastTries(nAttempts);
 
         if (!fKernelFound) {
-            it++;
             continue;
         }
-
         // Found a kernel
         LogPrintf("CreateCoinStake : kernel found\n");
+        CIdcStake& stakeInput = vStakeInputs[nKernel];
+        nCredit = 0;
         nCredit += stakeInput.GetValue();
 
         // Add block reward to the credit
@@ -3179,7 +3494,6 @@ bool CWallet::CreateCoinStake(
         std::vector<CTxOut> vout;
         if (!stakeInput.CreateTxOuts(this, vout, nCredit, onlyP2PK)) {
             LogPrintf("%s : failed to create output\n", __func__);
-            it++;
             continue;
         }
         txNew.vout.insert(txNew.vout.end(), vout.begin(), vout.end());
@@ -3213,7 +3527,6 @@ bool CWallet::CreateCoinStake(
             LogPrintf("%s : failed to create TxIn\n", __func__);
             txNew.vin.clear();
             txNew.vout.clear();
-            it++;
             continue;
         }
         txNew.vin.emplace_back(in);
@@ -4133,6 +4446,7 @@ std::string CWallet::GetWalletHelpString(bool showDebug)
         strUsage += HelpMessageOpt("-printcoinstake", _("Display verbose coin stake messages in the debug.log file."));
         strUsage += HelpMessageOpt("-printstakemodifier", _("Display the stake modifier calculations in the debug.log file."));
         strUsage += HelpMessageOpt("-privdb", strprintf(_("Sets the DB_PRIVATE flag in the wallet db environment (default: %u)"), DEFAULT_WALLET_PRIVDB));
+        strUsage += HelpMessageOpt("-rescanprefetch", strprintf(_("Read and check the blocks ahead in parallel during wallet rescans (default: %u)"), DEFAULT_RESCAN_PREFETCH));
     }
 
     return strUsage;
@@ -4280,11 +4594,25 @@ CWallet* CWallet::CreateWalletFromFile(const std::string walletFile)
     RegisterValidationInterface(walletInstance);
 
     if (chainActive.Tip() && chainActive.Tip() != pindexRescan) {
+        // We can't rescan beyond non-pruned blocks, stop and throw an error.
+        // This might happen if a user uses an old wallet within a pruned node,
+        // or ran -disablewallet for a longer time, then decided to re-enable it.
+        if (fPruneMode) {
+            CBlockIndex* block = chainActive.Tip();
+            while (block && block->pprev && (block->pprev->nStatus & BLOCK_HAVE_DATA) && block->pprev->nTx > 0 && pindexRescan != block)
+                block = block->pprev;
+
+            if (pindexRescan != block) {
+                UIError(_("Prune: last wallet synchronisation goes beyond pruned data. You need to -reindex (download the whole blockchain again in case of pruned node)"));
+                return nullptr;
+            }
+        }
+
         uiInterface.InitMessage(_("Rescanning..."));
         LogPrintf("Rescanning last %i blocks (from block %i)...\n", chainActive.Height() - pindexRescan->nHeight, pindexRescan->nHeight);
         const int64_t nWalletRescanTime = GetTimeMillis();
         if (walletInstance->ScanForWalletTransactions(pindexRescan, true, true) == -1) {
-            UIError(_("Shutdown requested over the txs scan. Exiting."));
+            UIError(_("Rescan stopped before the chain tip: shutdown requested or block data unavailable. Exiting."));
             return nullptr;
         }
         LogPrintf("Rescan completed in %15dms\n", GetTimeMillis() - nWalletRescanTime);
@@ -4629,7 +4957,11 @@ void CWallet::IncrementNoteWitnesses(const CBlockIndex* pindex,
 
 void CWallet::DecrementNoteWitnesses(const CBlockIndex* pindex) { m_sspk_man->DecrementNoteWitnesses(pindex->nHeight); }
 
-bool CWallet::AddSaplingZKey(const libzcash::SaplingExtendedSpendingKey &key) { return m_sspk_man->AddSaplingZKey(key); }
+bool CWallet::AddSaplingZKey(const libzcash::SaplingExtendedSpendingKey &key)
+{
+    nKeystoreUpdates++;
+    return m_sspk_man->AddSaplingZKey(key);
+}
 
 bool CWallet::AddSaplingIncomingViewingKeyW(
         const libzcash::SaplingIncomingViewingKey &ivk,
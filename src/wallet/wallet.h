@@ -84,6 +84,8 @@ static const unsigned int DEFAULT_GENERATE_PROCLIMIT = 1;
 static const unsigned int DEFAULT_CREATEWALLETBACKUPS = 10;
 //! Default for -disablewallet
 static const bool DEFAULT_DISABLE_WALLET = false;
+//! Default for -rescanprefetch
+static const bool DEFAULT_RESCAN_PREFETCH = true;
 
 extern const char * DEFAULT_WALLET_DAT;
 
@@ -597,6 +599,38 @@ private:
     int m_last_block_processed_height GUARDED_BY(cs_wallet) = -1;
     int64_t m_last_block_processed_time GUARDED_BY(cs_wallet) = 0;
 
+    //! Bumped every time a key, script or watch-only address is added to the keystore,
+    //! so IsMine results computed ahead of time can be detected as outdated.
+    std::atomic<unsigned int> nKeystoreUpdates{0};
+
+    /**
+     * Outputs of the wallet that could be staked: mine and not known to be spent.
+     * Lets StakeableCoins go through these only, instead of the whole mapWallet.
+     * Outputs are added with their tx, pruned once found spent, and re-added
+     * when their spending tx is abandoned, conflicted or erased.
+     */
+    std::set<COutPoint> setStakeCandidates GUARDED_BY(cs_wallet);
+    //! Rebuild setStakeCandidates from mapWallet on the next StakeableCoins call
+    bool fStakeCandidatesDirty GUARDED_BY(cs_wallet){true};
+    //! nKeystoreUpdates when setStakeCandidates was last rebuilt (new keys can make more outputs ours)
+    unsigned int nStakeCandidatesKeystore GUARDED_BY(cs_wallet){0};
+    void AddToStakeCandidates(const CWalletTx& wtx);
+    void AddInputsToStakeCandidates(const CWalletTx& wtx);
+
+    //! Bumped every time the spent status of wallet outputs can change (new
+    //! spends, spenders abandoned, conflicted, confirmed again, entering or
+    //! leaving the mempool), so the staker only re-checks its coins when there
+    //! is something new.
+    std::atomic<unsigned int> nWalletSpends{0};
+
+    //! State of the running rescan, readable without locking the wallet
+    std::atomic<bool> fScanningWallet{false};
+    std::atomic<int64_t> nScanStartTime{0};
+    std::atomic<int> nScanStartHeight{0};
+    std::atomic<int> nScanHeight{0};
+    std::atomic<int64_t> nScannedBlocks{0};
+    std::atomic<double> dScanProgress{0};
+
     int64_t nNextResend;
     int64_t nLastResend;
 
@@ -617,8 +651,19 @@ private:
     void SyncMetaData(std::pair<typename TxSpendMap<T>::iterator, typename TxSpendMap<T>::iterator> range);
     void ChainTipAdded(const CBlockIndex *pindex, const CBlock *pblock, SaplingMerkleTree saplingTree);
 
+    /**
+     * Wallet relevance checks of a tx that don't need cs_wallet, run ahead of
+     * AddToWalletIfInvolvingMe for whole blocks (BlockConnected, rescan).
+     * Unset fields are computed by AddToWalletIfInvolvingMe itself.
+     */
+    struct TxScanResult {
+        Optional<bool> fIsMine{nullopt};
+        Optional<std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap>> saplingNotes{nullopt};
+    };
+    friend class CWalletRescanPrefetcher;
+
     /* Used by TransactionAddedToMemorypool/BlockConnected/Disconnected */
-    void SyncTransaction(const CTransactionRef& tx, const CWalletTx::Confirmation& confirm);
+    void SyncTransaction(const CTransactionRef& tx, const CWalletTx::Confirmation& confirm, const TxScanResult* pScan = nullptr);
 
     bool IsKeyUsed(const CPubKey& vchPubKey);
 
@@ -668,6 +713,8 @@ public:
         m_last_block_processed = pindex->GetBlockHash();
         m_last_block_processed_time = pindex->GetBlockTime();
     };
+    /** Number of times the spent status of wallet outputs changed, see nWalletSpends */
+    unsigned int GetWalletSpends() const { return nWalletSpends; }
 
     /* SPKM Helpers */
     const CKeyingMaterial& GetEncryptionKey() const;
@@ -846,7 +893,9 @@ public:
     //////////// Sapling //////////////////
 
     // Search for notes and addresses from this wallet in the tx, and add the addresses --> IVK mapping to the keystore if missing.
-    bool FindNotesDataAndAddMissingIVKToKeystore(const CTransaction& tx, Optional<mapSaplingNoteData_t>& saplingNoteData);
+    // pSaplingNotes: result of a previous SaplingScriptPubKeyMan::FindMySaplingNotes on the tx, if available.
+    bool FindNotesDataAndAddMissingIVKToKeystore(const CTransaction& tx, Optional<mapSaplingNoteData_t>& saplingNoteData,
+                                                 const std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap>* pSaplingNotes = nullptr);
     // Decrypt sapling output notes with the inputs ovk and updates saplingNoteDataMap
     void AddExternalNotesDataToTx(CWalletTx& wtx) const;
 
@@ -940,7 +989,9 @@ public:
     void TransactionAddedToMempool(const CTransactionRef& tx) override;
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const uint256& blockHash, int nBlockHeight, int64_t blockTime) override;
-    bool AddToWalletIfInvolvingMe(const CTransactionRef& tx, const CWalletTx::Confirmation& confirm, bool fUpdate);
+    bool AddToWalletIfInvolvingMe(const CTransactionRef& tx, const CWalletTx::Confirmation& confirm, bool fUpdate, const TxScanResult* pScan = nullptr);
+    //! Run the checks of TxScanResult on every tx of a block (Sapling outputs are trial-decrypted in one batch)
+    std::vector<TxScanResult> ScanBlockTxs(const std::vector<CTransactionRef>& vtx, bool fCheckIsMine) const;
     void EraseFromWallet(const uint256& hash);
 
     /**
@@ -949,7 +1000,19 @@ public:
     bool Upgrade(std::string& error, const int& prevVersion);
     bool ActivateSaplingWallet(bool memOnly = false);
 
+    /**
+     * Scan the active chain from pindexStart for wallet transactions.
+     * Returns the number of transactions found, or -1 if the scan stopped
+     * before the tip: shutdown requested (fromStartup), or a block pruned or
+     * unreadable from disk.
+     */
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false, bool fromStartup = false);
+    bool IsScanning() const { return fScanningWallet; }
+    int64_t ScanningDuration() const { return fScanningWallet ? GetTimeMillis() - nScanStartTime : 0; }
+    double ScanningProgress() const { return fScanningWallet ? (double) dScanProgress : 0; }
+    int ScanningStartHeight() const { return nScanStartHeight; }
+    int ScanningHeight() const { return nScanHeight; }
+    int64_t ScanningBlocks() const { return nScannedBlocks; }
     void TransactionRemovedFromMempool(const CTransactionRef &ptx) override;
     void ReacceptWalletTransactions(bool fFirstLoad = false);
     void ResendWalletTransactions(CConnman* connman) override;
@@ -1209,6 +1272,8 @@ class CStakeableOutput : public COutput
 {
 public:
     const CBlockIndex* pindex{nullptr};
+    //! CWallet::nWalletSpends when the output was last found unspent
+    unsigned int nWalletSpends{0};
 
     CStakeableOutput(const CWalletTx* txIn, int iIn, int nDepthIn, bool fSpendableIn, bool fSolvableIn,
                      const CBlockIndex*& pindex);
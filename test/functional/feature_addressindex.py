@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the address index and the getaddress* / getspentinfo RPCs.
+
+Node 0 runs with -addressindex, node 1 without it.
+Checks balances, utxos, txids and spent info across a spend, a reorg and a restart.
+"""
+
+from decimal import Decimal
+
+from test_framework.test_framework import islamic_digital_coinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    wait_until,
+)
+
+
+class AddressIndexTest(islamic_digital_coinTestFramework):
+
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.setup_clean_chain = True
+        self.extra_args = [["-addressindex"], []]
+
+    def wait_for_index(self, node):
+        # the index is built in the background, and answers RPC_IN_WARMUP until synced
+        def synced():
+            try:
+                node.getaddressbalance({"addresses": [node.getnewaddress()]})
+                return True
+            except Exception:
+                return False
+        wait_until(synced, timeout=30)
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(101)
+        self.sync_all()
+        self.wait_for_index(node)
+
+        self.log.info("Check that the RPCs require -addressindex")
+        assert_raises_rpc_error(-1, "Address index not enabled",
+                                self.nodes[1].getaddressbalance, self.nodes[1].getnewaddress())
+
+        self.log.info("Check an address receiving coins")
+        addr = node.getnewaddress()
+        assert_equal(node.getaddressbalance(addr), {"balance": Decimal("0"), "received": Decimal("0")})
+        txid = node.sendtoaddress(addr, 10)
+        node.generate(1)
+        height = node.getblockcount()
+        assert_equal(node.getaddressbalance({"addresses": [addr]}),
+                     {"balance": Decimal("10"), "received": Decimal("10")})
+        assert_equal(node.getaddresstxids(addr), [txid])
+        utxos = node.getaddressutxos({"addresses": [addr]})
+        assert_equal(len(utxos), 1)
+        assert_equal(utxos[0]["address"], addr)
+        assert_equal(utxos[0]["txid"], txid)
+        assert_equal(utxos[0]["amount"], Decimal("10"))
+        assert_equal(utxos[0]["height"], height)
+
+        self.log.info("Check an address spending coins")
+        dest = node.getnewaddress()
+        rawtx = node.createrawtransaction([{"txid": txid, "vout": utxos[0]["vout"]}], {dest: 9.99})
+        spend_txid = node.sendrawtransaction(node.signrawtransaction(rawtx)["hex"])
+        spend_block = node.generate(1)[0]
+        assert_equal(node.getaddressbalance(addr), {"balance": Decimal("0"), "received": Decimal("10")})
+        assert_equal(node.getaddressutxos(addr), [])
+        assert_equal(node.getaddresstxids(addr), [txid, spend_txid])
+        assert_equal(node.getaddresstxids({"addresses": [addr], "start": height + 1}), [spend_txid])
+        assert_equal(node.getaddresstxids({"addresses": [addr, dest]}), [txid, spend_txid])
+        spent = node.getspentinfo({"txid": txid, "index": utxos[0]["vout"]})
+        assert_equal(spent, {"txid": spend_txid, "index": 0, "height": height + 1})
+        assert_equal(node.getaddressbalance(dest)["balance"], Decimal("9.99"))
+
+        self.log.info("Check that a reorg removes the entries of the disconnected block")
+        node.invalidateblock(spend_block)
+        assert_equal(node.getblockcount(), height)
+        self.wait_for_index(node)
+        assert_equal(node.getaddressbalance(addr), {"balance": Decimal("10"), "received": Decimal("10")})
+        assert_equal(node.getaddresstxids(addr), [txid])
+        assert_equal(len(node.getaddressutxos(addr)), 1)
+        assert_equal(node.getaddressbalance(dest)["balance"], Decimal("0"))
+        assert_raises_rpc_error(-5, "Unable to get spent info",
+                                node.getspentinfo, {"txid": txid, "index": utxos[0]["vout"]})
+
+        self.log.info("Check that the index survives a restart")
+        self.stop_node(0)
+        self.start_node(0, self.extra_args[0])
+        self.wait_for_index(self.nodes[0])
+        assert_equal(self.nodes[0].getaddressbalance(addr)["balance"], Decimal("10"))
+
+        self.log.info("Check that reconnecting the block restores its entries")
+        self.nodes[0].reconsiderblock(spend_block)
+        assert_equal(self.nodes[0].getblockcount(), height + 1)
+        self.wait_for_index(self.nodes[0])
+        assert_equal(self.nodes[0].getaddressbalance(addr)["balance"], Decimal("0"))
+        assert_equal(self.nodes[0].getspentinfo({"txid": txid, "index": utxos[0]["vout"]})["txid"], spend_txid)
+
+        self.log.info("Check invalid addresses")
+        assert_raises_rpc_error(-5, "Invalid address", self.nodes[0].getaddressbalance, "notanaddress")
+
+
+if __name__ == '__main__':
+    AddressIndexTest().main()
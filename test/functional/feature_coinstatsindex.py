@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the coinstats index and gettxoutsetinfo with a hash_type and a height.
+
+Node 0 runs with -coinstatsindex, node 1 without it.
+Checks that the statistics of the index match a walk of the UTXO set, for the
+tip and for past heights, across a spend, a reorg and a restart.
+"""
+
+from test_framework.test_framework import islamic_digital_coinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    wait_until,
+)
+
+
+class CoinStatsIndexTest(islamic_digital_coinTestFramework):
+
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.setup_clean_chain = True
+        self.extra_args = [["-coinstatsindex"], []]
+
+    def wait_for_index(self, node):
+        # the index is built in the background: the tip is only queryable once synced
+        def synced():
+            try:
+                node.gettxoutsetinfo("muhash", node.getblockcount())
+                return True
+            except Exception:
+                return False
+        wait_until(synced, timeout=30)
+
+    def check_stats(self, indexed, scanned):
+        # the index doesn't know the number of transactions and the size of the chainstate
+        assert "transactions" not in indexed
+        assert "disk_size" not in indexed
+        for key in ["height", "bestblock", "txouts", "bogosize", "muhash", "total_amount"]:
+            assert_equal(indexed[key], scanned[key])
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(101)
+        self.sync_all()
+        self.wait_for_index(node)
+
+        self.log.info("Check that heights can only be queried with -coinstatsindex")
+        assert_raises_rpc_error(-1, "requires the coinstats index",
+                                self.nodes[1].gettxoutsetinfo, "muhash", 10)
+        assert_raises_rpc_error(-8, "hash_serialized_2 hash type cannot be queried",
+                                node.gettxoutsetinfo, "hash_serialized_2", 10)
+        assert_raises_rpc_error(-8, "not a valid hash_type", node.gettxoutsetinfo, "sha1")
+
+        self.log.info("Check that the index matches a walk of the UTXO set")
+        self.check_stats(node.gettxoutsetinfo("muhash"), self.nodes[1].gettxoutsetinfo("muhash"))
+        assert "muhash" not in node.gettxoutsetinfo("none")
+        assert "hash_serialized_2" in node.gettxoutsetinfo()
+
+        self.log.info("Check a spend and past heights")
+        height = node.getblockcount()
+        before = node.gettxoutsetinfo("muhash")
+        node.sendtoaddress(node.getnewaddress(), 10)
+        spend_block = node.generate(1)[0]
+        self.sync_all()
+        self.wait_for_index(node)
+        after = node.gettxoutsetinfo("muhash")
+        assert after["muhash"] != before["muhash"]
+        self.check_stats(after, self.nodes[1].gettxoutsetinfo("muhash"))
+        assert_equal(node.gettxoutsetinfo("muhash", height), before)
+        assert_equal(node.gettxoutsetinfo("muhash", before["bestblock"]), before)
+        assert_raises_rpc_error(-8, "Block height out of range", node.gettxoutsetinfo, "muhash", height + 2)
+
+        self.log.info("Check that a reorg drops the stats of the disconnected block")
+        node.invalidateblock(spend_block)
+        self.wait_for_index(node)
+        assert_equal(node.gettxoutsetinfo("muhash"), before)
+
+        self.log.info("Check that the index survives a restart")
+        self.stop_node(0)
+        self.start_node(0, self.extra_args[0])
+        self.wait_for_index(self.nodes[0])
+        assert_equal(self.nodes[0].gettxoutsetinfo("muhash"), before)
+
+        self.log.info("Check that reconnecting the block restores its stats")
+        self.nodes[0].reconsiderblock(spend_block)
+        self.wait_for_index(self.nodes[0])
+        assert_equal(self.nodes[0].gettxoutsetinfo("muhash"), after)
+
+
+if __name__ == '__main__':
+    CoinStatsIndexTest().main()
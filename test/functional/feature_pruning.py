@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the -prune option.
+
+Regtest blocks are far too small to reach the pruning target here, so this
+checks the option handling and what a pruning node reports to peers and RPC.
+The selection and deletion of the block files are covered by the pruning_tests
+unit tests.
+"""
+
+from test_framework.test_framework import islamic_digital_coinTestFramework
+from test_framework.util import (
+    assert_equal,
+)
+
+NODE_NETWORK = 1
+
+class PruningTest(islamic_digital_coinTestFramework):
+
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.setup_clean_chain = True
+        # -prune implies -txindex=0
+        self.extra_args = [[], ["-prune=945"]]
+
+    def run_test(self):
+        self.log.info("Mining blocks...")
+        self.nodes[0].generate(10)
+        self.sync_all()
+
+        self.log.info("Checking getblockchaininfo...")
+        info = self.nodes[0].getblockchaininfo()
+        assert_equal(info['pruned'], False)
+        assert 'pruneheight' not in info
+        info = self.nodes[1].getblockchaininfo()
+        assert_equal(info['pruned'], True)
+        assert_equal(info['pruneheight'], 0)
+
+        self.log.info("Checking that the pruning node doesn't advertise NODE_NETWORK...")
+        assert_equal(int(self.nodes[0].getnetworkinfo()['localservices'], 16) & NODE_NETWORK, NODE_NETWORK)
+        assert_equal(int(self.nodes[1].getnetworkinfo()['localservices'], 16) & NODE_NETWORK, 0)
+
+        # Blocks that haven't been pruned are still available
+        blockhash = self.nodes[1].getblockhash(1)
+        assert_equal(self.nodes[1].getblock(blockhash)['height'], 1)
+
+        self.log.info("Checking incompatible options...")
+        self.stop_node(1)
+        self.assert_start_raises_init_error(1, ["-prune=100"],
+                                            "Prune configured below the minimum of 945 MiB")
+        self.assert_start_raises_init_error(1, ["-prune=945", "-txindex=1"],
+                                            "Prune mode is incompatible with -txindex.")
+        self.assert_start_raises_init_error(1, ["-prune=945", "-rescan"],
+                                            "Rescans are not possible in pruned mode")
+
+        self.log.info("Restarting the pruning node...")
+        self.start_node(1, ["-prune=945"])
+        assert_equal(self.nodes[1].getblockcount(), 10)
+        assert_equal(self.nodes[1].getblockchaininfo()['pruned'], True)
+
+
+if __name__ == '__main__':
+    PruningTest().main()
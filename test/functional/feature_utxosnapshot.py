@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test dumptxoutset and -loadsnapshot.
+
+Node 0 dumps its chainstate to a snapshot.
+Node 1 starts from an empty datadir with -loadsnapshot.
+The snapshot is only loaded when its hash is trusted with -loadsnapshothash.
+It must end up with the same tip and UTXO set, then sync new blocks from node 0.
+"""
+
+import os
+import shutil
+
+from test_framework.test_framework import islamic_digital_coinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    connect_nodes,
+    get_datadir_path,
+)
+
+
+class UTXOSnapshotTest(islamic_digital_coinTestFramework):
+
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.setup_clean_chain = True
+
+    def setup_network(self):
+        self.setup_nodes()
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(120)
+        for _ in range(5):
+            node.sendtoaddress(node.getnewaddress(), 3)
+        node.generate(1)
+
+        self.log.info("Dump the UTXO set")
+        path = os.path.join(self.options.tmpdir, "utxo.dat")
+        res = node.dumptxoutset(path)
+        assert_equal(res["base_hash"], node.getbestblockhash())
+        assert_equal(res["base_height"], node.getblockcount())
+        assert_equal(res["path"], path)
+        assert_raises_rpc_error(-8, "already exists", node.dumptxoutset, path)
+        expected = node.gettxoutsetinfo()
+
+        self.log.info("Reject a corrupted snapshot")
+        self.stop_node(1)
+        datadir = os.path.join(get_datadir_path(self.options.tmpdir, 1), "regtest")
+        shutil.rmtree(datadir)
+        bad_path = os.path.join(self.options.tmpdir, "utxo_bad.dat")
+        with open(path, "rb") as f:
+            data = bytearray(f.read())
+        data[len(data) // 2] ^= 0xff
+        with open(bad_path, "wb") as f:
+            f.write(data)
+        trusted = "-loadsnapshothash=%s" % res["snapshot_hash"]
+        self.assert_start_raises_init_error(1, ["-loadsnapshot=%s" % bad_path, trusted], "Unable to load UTXO snapshot")
+
+        self.log.info("Reject a snapshot whose hash is not trusted")
+        shutil.rmtree(datadir)
+        self.assert_start_raises_init_error(1, ["-loadsnapshot=%s" % path], "is not trusted")
+        shutil.rmtree(datadir)
+        self.assert_start_raises_init_error(1, ["-loadsnapshot=%s" % path, "-loadsnapshothash=%064x" % 1], "is not trusted")
+
+        self.log.info("Start a fresh node from the snapshot")
+        shutil.rmtree(datadir)
+        self.start_node(1, ["-loadsnapshot=%s" % path, trusted])
+        assert_equal(self.nodes[1].getbestblockhash(), res["base_hash"])
+        loaded = self.nodes[1].gettxoutsetinfo()
+        for key in ("height", "bestblock", "transactions", "txouts", "hash_serialized_2", "total_amount"):
+            assert_equal(loaded[key], expected[key])
+        assert_equal(self.nodes[1].getblockchaininfo()["pruned"], True)
+
+        self.log.info("Sync the blocks after the snapshot")
+        connect_nodes(self.nodes[1], 0)
+        node.generate(5)
+        self.sync_blocks()
+        assert_equal(self.nodes[1].gettxoutsetinfo()["hash_serialized_2"], node.gettxoutsetinfo()["hash_serialized_2"])
+
+        self.log.info("The snapshot is ignored once the node has a chainstate")
+        self.restart_node(1, ["-loadsnapshot=%s" % path, trusted])
+        assert_equal(self.nodes[1].getbestblockhash(), node.getbestblockhash())
+
+
+if __name__ == '__main__':
+    UTXOSnapshotTest().main()
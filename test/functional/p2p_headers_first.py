@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the headers-first block download.
+
+Two peers speaking the headers sync protocol version are connected to the node.
+
+1. Both peers announce the same headers, for more blocks than can be in flight
+   from a single peer: the blocks are requested from both peers in parallel.
+2. The peers answer with the blocks in reverse order: the blocks arriving before
+   their parent are kept, and the node ends up at the announced tip.
+3. A block is sent without its parent, which is then given with submitblock:
+   the waiting block is processed once its parent is connected.
+4. Headers not connecting to the block index are answered with a getheaders,
+   until the peer is disconnected for sending too many of them.
+"""
+
+import random
+
+from test_framework.mininode import *
+from test_framework.test_framework import islamic_digital_coinTestFramework
+from test_framework.util import *
+from test_framework.blocktools import create_block, create_coinbase
+
+HEADERS_SYNC_VERSION = 70924
+MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16
+MAX_UNCONNECTING_HEADERS = 10
+
+
+class HeadersSyncNode(P2PInterface):
+    def __init__(self):
+        super().__init__()
+        self.requested_blocks = set()
+
+    def peer_connect(self, *args, services=NODE_NETWORK, send_version=True, **kwargs):
+        super().peer_connect(*args, send_version=False, **kwargs)
+        if send_version:
+            vt = msg_version()
+            vt.nVersion = HEADERS_SYNC_VERSION
+            vt.nServices = services
+            vt.addrTo.ip = self.dstaddr
+            vt.addrTo.port = self.dstport
+            vt.addrFrom.ip = "0.0.0.0"
+            vt.addrFrom.port = 0
+            self.send_message(vt, True)
+
+    def on_getdata(self, message):
+        for inv in message.inv:
+            if inv.type == 2:
+                self.requested_blocks.add(inv.hash)
+
+    def send_blocks(self, blocks):
+        for block in blocks:
+            self.send_message(msg_block(block))
+        self.sync_with_ping()
+
+
+class HeadersFirstTest(islamic_digital_coinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def build_chain(self, count):
+        tip = self.nodes[0].getblock(self.nodes[0].getbestblockhash())
+        hash_prev = int(tip["hash"], 16)
+        height = tip["height"] + 1
+        for _ in range(count):
+            block = create_block(hash_prev, create_coinbase(height), self.block_time)
+            block.solve()
+            self.blocks.append(block)
+            hash_prev = block.sha256
+            height += 1
+            self.block_time += 1
+        return self.blocks[-count:]
+
+    def run_test(self):
+        node = self.nodes[0]
+        peers = [node.add_p2p_connection(HeadersSyncNode()) for _ in range(2)]
+        network_thread_start()
+        for peer in peers:
+            peer.wait_for_verack()
+
+        # Leave IBD
+        node.generate(1)
+        self.block_time = node.getblock(node.getbestblockhash())["time"] + 1
+        self.blocks = []
+
+        self.log.info("Blocks are downloaded from both peers in parallel")
+        count = MAX_BLOCKS_IN_TRANSIT_PER_PEER + 4
+        blocks = self.build_chain(count)
+        headers = [CBlockHeader(b) for b in blocks]
+        for peer in peers:
+            peer.send_message(msg_headers(headers))
+        wanted = set(b.sha256 for b in blocks)
+        wait_until(lambda: peers[0].requested_blocks | peers[1].requested_blocks == wanted, timeout=60, lock=mininode_lock)
+        with mininode_lock:
+            for peer in peers:
+                assert peer.requested_blocks
+                assert len(peer.requested_blocks) <= MAX_BLOCKS_IN_TRANSIT_PER_PEER
+
+        self.log.info("Blocks arriving before their parent are processed in chain order")
+        # The last blocks come first, each peer sends its blocks in reverse order
+        for peer in reversed(peers):
+            with mininode_lock:
+                requested = [b for b in reversed(blocks) if b.sha256 in peer.requested_blocks]
+            peer.send_blocks(requested)
+        wait_until(lambda: node.getbestblockhash() == blocks[-1].hash, timeout=60)
+        assert_equal(node.getblockcount(), 1 + count)
+
+        self.log.info("A block waiting for its parent is processed when the parent is submitted")
+        for peer in peers:
+            with mininode_lock:
+                peer.requested_blocks.clear()
+        parent, child = self.build_chain(2)
+        peers[0].send_message(msg_headers([CBlockHeader(parent), CBlockHeader(child)]))
+        wait_until(lambda: child.sha256 in peers[0].requested_blocks, timeout=60, lock=mininode_lock)
+        peers[0].send_blocks([child])
+        assert_equal(node.getblockcount(), 1 + count)
+        node.submitblock(bytes_to_hex_str(parent.serialize()))
+        wait_until(lambda: node.getbestblockhash() == child.hash, timeout=60)
+
+        self.log.info("Unconnecting headers are answered with getheaders, up to a limit")
+        peer = peers[1]
+        for _ in range(5 * MAX_UNCONNECTING_HEADERS - 1):
+            block = create_block(random.getrandbits(256), create_coinbase(1), self.block_time)
+            with mininode_lock:
+                peer.last_message.pop("getheaders", None)
+            peer.send_message(msg_headers([CBlockHeader(block)]))
+            peer.wait_for_getheaders()
+        block = create_block(random.getrandbits(256), create_coinbase(1), self.block_time)
+        peer.send_message(msg_headers([CBlockHeader(block)]))
+        peer.wait_for_disconnect()
+
+        # The other peer is still connected, the node keeps its tip
+        peers[0].sync_with_ping()
+        assert_equal(node.getbestblockhash(), child.hash)
+
+
+if __name__ == '__main__':
+    HeadersFirstTest().main()
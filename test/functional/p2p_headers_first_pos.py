@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The ISLAMIC DIGITAL COIN developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the headers-first sync of proof-of-stake blocks.
+
+1. Node 0 builds a chain past the proof of stake and the stake modifier v2
+   upgrades (height 251 on regtest).
+2. Node 1 syncs it headers first: the headers are added to the block index
+   before their blocks, and the stake modifiers are set when the blocks arrive.
+   The stake modifiers must match the ones of node 0, also after a restart.
+"""
+
+from test_framework.test_framework import islamic_digital_coinTestFramework
+from test_framework.util import *
+
+UPGRADE_V3_4_HEIGHT = 251
+
+
+class HeadersFirstPoSTest(islamic_digital_coinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+
+    def setup_network(self):
+        # The nodes are connected once node 0 has built its chain
+        self.setup_nodes()
+
+    def check_stake_modifiers(self):
+        for height in range(UPGRADE_V3_4_HEIGHT - 5, self.nodes[0].getblockcount() + 1):
+            block_hash = self.nodes[0].getblockhash(height)
+            expected = self.nodes[0].getblock(block_hash)
+            block = self.nodes[1].getblock(block_hash)
+            assert_equal(block.get("stakeModifier"), expected.get("stakeModifier"))
+            assert_equal(block.get("hashProofOfStake"), expected.get("hashProofOfStake"))
+
+    def run_test(self):
+        self.log.info("Node 0 builds a chain past the stake modifier v2 upgrade")
+        self.nodes[0].generate(UPGRADE_V3_4_HEIGHT + 50)
+        tip = self.nodes[0].getbestblockhash()
+        assert "stakeModifier" in self.nodes[0].getblock(tip)
+        assert_equal(self.nodes[1].getblockcount(), 0)
+
+        self.log.info("Node 1 syncs the chain headers first")
+        connect_nodes(self.nodes[1], 0)
+        wait_until(lambda: self.nodes[1].getbestblockhash() == tip, timeout=120)
+        self.check_stake_modifiers()
+
+        self.log.info("The stake modifiers are kept in the block index")
+        self.restart_node(1)
+        assert_equal(self.nodes[1].getbestblockhash(), tip)
+        self.check_stake_modifiers()
+
+        self.log.info("Node 1 keeps up with the new blocks")
+        connect_nodes(self.nodes[1], 0)
+        self.nodes[0].generate(10)
+        self.sync_blocks()
+        self.check_stake_modifiers()
+
+
+if __name__ == '__main__':
+    HeadersFirstPoSTest().main()
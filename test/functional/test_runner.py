@@ -89,6 +89,12 @@ BASE_SCRIPTS= [
     'feature_reindex.py',                       # ~ 110 sec
     'interface_http.py',                        # ~ 105 sec
     'feature_blockhashcache.py',                # ~ 100 sec
+    'p2p_headers_first.py',                     # ~ 100 sec
+    'p2p_headers_first_pos.py',                 # ~ 100 sec
+    'feature_addressindex.py',                  # ~ 60 sec
+    'feature_utxosnapshot.py',                  # ~ 40 sec
+    'feature_coinstatsindex.py',                # ~ 30 sec
+    'feature_pruning.py',                       # ~ 30 sec
     'wallet_listtransactions.py',               # ~ 97 sec
     'mempool_reorg.py',                         # ~ 92 sec
     'wallet_encryption.py',                     # ~ 89 sec
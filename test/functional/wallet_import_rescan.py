@@ -174,5 +174,9 @@ class ImportRescanTest(islamic_digital_coinTestFramework):
             else:
                 variant.check()
 
+        # No rescan is left running once the import calls have returned.
+        for node in self.nodes:
+            assert_equal(node.getrescaninfo(), {"scanning": False})
+
 if __name__ == "__main__":
     ImportRescanTest().main()